@@ -11,6 +11,9 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
 #include "bst.h"
 
 /* Allocate memory for a binary search tree. Return the tree instance. */
@@ -18,9 +21,42 @@ BST_t* bst_create(void) {
     BST_t* tree = malloc(sizeof(BST_t));
     assert(tree);
     tree->root = NULL;
+    tree->block = NULL;
+    tree->block_len = 0;
+    tree->policy = BST_PLAIN;
+    tree->splay_every = 1;
+    tree->accesses = 0;
+#if BST_MULTISET
+    tree->multiset = false;
+#endif
     return tree;
 }
 
+/* Choose how the tree reacts to accesses. With BST_SPLAY, insertions and deletions
+always splay, while lookups splay once every `splay_every` calls (0 means 1). The
+policy can be changed at any time: every BST is a valid splay tree and vice versa. */
+void bst_set_policy(BST_t* tree, BST_POLICY policy, unsigned int splay_every) {
+    tree->policy = policy;
+    tree->splay_every = (splay_every) ? splay_every : 1;
+    tree->accesses = 0;
+}
+
+#if BST_MULTISET
+/* In multiset mode, inserting a key that is already in the tree increments the
+count of its node and deleting it decrements the count; the node goes away with
+the last occurrence. Otherwise every insertion adds a node. The mode can be 
+changed at any time: nodes with a count above 1 stay as they are. */
+void bst_set_multiset(BST_t* tree, bool multiset) {
+    tree->multiset = multiset;
+}
+
+/* Return the number of occurrences of the key in a multiset tree. */
+size_t bst_count(BST_t* tree, int key) {
+    treeNode_t* node = bst_search(tree->root, NULL, key);
+    return (node) ? node->count : 0;
+}
+#endif
+
 /* Return true if the tree does not contain any node, otherwise return false. */
 bool bst_is_empty(BST_t* tree) {
     if (!tree->root)
@@ -35,6 +71,12 @@ treeNode_t* bst_create_node(int key) {
     assert(new_node);
 
     new_node->key = key;
+#if BST_ORDER_STATISTICS
+    new_node->size = 1;
+#endif
+#if BST_MULTISET
+    new_node->count = 1;
+#endif
     new_node->left = NULL;
     new_node->right = NULL;
 
@@ -60,37 +102,229 @@ static treeNode_t* bst_search(treeNode_t* root, treeNode_t** pprev, int key) {
     return root;
 }
 
+#if BST_ORDER_STATISTICS
+#define SPLAY_SIZE(node) ((node) ? (node)->size : 0)
+#endif
+
+/* Top-down splay (Sleator and Tarjan). Descend towards the key and hang the nodes
+smaller than it on a left tree and the larger ones on a right tree, rotating at
+every zig-zig step; then reassemble the three parts around the last node reached.
+That node holds the key if the key is present, else its predecessor or successor.
+With `to_max` the key is ignored and the maximum is splayed. No recursion and no
+parent pointers are needed. Return the new root. */
+static treeNode_t* bst_splay(treeNode_t* root, int key, bool to_max) {
+    treeNode_t header = {0};  // header.right/left: the left/right tree
+    treeNode_t *l = &header, *r = &header, *y;
+#if BST_ORDER_STATISTICS
+    unsigned int l_size = 0, r_size = 0;
+#endif
+
+    if (!root)
+        return NULL;
+
+    for (;;) {
+        if (!to_max && key < root->key) {
+            if (!root->left)
+                break;
+            if (key < root->left->key) {  // Zig-zig: rotate right
+                y = root->left;
+                root->left = y->right;
+                y->right = root;
+#if BST_ORDER_STATISTICS
+                root->size = SPLAY_SIZE(root->left) + SPLAY_SIZE(root->right) + BST_COUNT(root);
+#endif
+                root = y;
+                if (!root->left)
+                    break;
+            }
+            r->left = root;  // Link right
+            r = root;
+            root = root->left;
+#if BST_ORDER_STATISTICS
+            r_size += BST_COUNT(r) + SPLAY_SIZE(r->right);
+#endif
+        } else if (to_max || key > root->key) {
+            if (!root->right)
+                break;
+            if (to_max || key > root->right->key) {  // Zag-zag: rotate left
+                y = root->right;
+                root->right = y->left;
+                y->left = root;
+#if BST_ORDER_STATISTICS
+                root->size = SPLAY_SIZE(root->left) + SPLAY_SIZE(root->right) + BST_COUNT(root);
+#endif
+                root = y;
+                if (!root->right)
+                    break;
+            }
+            l->right = root;  // Link left
+            l = root;
+            root = root->right;
+#if BST_ORDER_STATISTICS
+            l_size += BST_COUNT(l) + SPLAY_SIZE(l->left);
+#endif
+        } else {
+            break;
+        }
+    }
+
+#if BST_ORDER_STATISTICS
+    /* The nodes on the right spine of the left tree (and on the left spine of the
+    right tree) lost part of their subtree; walk them top-down fixing the sizes. */
+    l_size += SPLAY_SIZE(root->left);
+    r_size += SPLAY_SIZE(root->right);
+    root->size = l_size + r_size + BST_COUNT(root);
+    l->right = r->left = NULL;
+    for (y = header.right; y; y = y->right) {
+        y->size = l_size;
+        l_size -= BST_COUNT(y) + SPLAY_SIZE(y->left);
+    }
+    for (y = header.left; y; y = y->left) {
+        y->size = r_size;
+        r_size -= BST_COUNT(y) + SPLAY_SIZE(y->right);
+    }
+#endif
+    l->right = root->left;  // Assemble
+    r->left = root->right;
+    root->left = header.right;
+    root->right = header.left;
+
+    return root;
+}
+
 /* Search for the key in the subtree rooted at 1st argument. 
-Return true if the key is found, else false. */
+Return true if the key is found, else false. In BST_SPLAY mode the
+lookup may splay the key (or the last node on its path) to the root. */
 bool bst_is_key_in(BST_t* tree, int key) {
+    if (tree->policy == BST_SPLAY && ++tree->accesses >= tree->splay_every) {
+        tree->accesses = 0;
+        tree->root = bst_splay(tree->root, key, false);
+        return tree->root && tree->root->key == key;
+    }
+
     if (bst_search(tree->root, NULL, key))
         return true;
     return false;
 }
 
-/* Insert a new node in the tree. Equal keys are allowed. */
+/* Look up n keys at once: found[i] is set to true if keys[i] is in the tree.
+Return the number of keys found. Up to BST_BATCH_GROUP lookups are interleaved
+(asynchronous memory access chaining): each step moves one lookup down one 
+level, prefetches the child it will read next and switches to the next lookup,
+so the cache misses of different lookups overlap instead of forming one long
+chain. A finished lookup hands its slot to the next key. The lookups never 
+splay, whatever the policy of the tree. */
+size_t bst_search_batch(BST_t* tree, const int* keys, size_t n, bool* found) {
+    treeNode_t* node[BST_BATCH_GROUP];
+    size_t idx[BST_BATCH_GROUP];
+    size_t next = 0, active = 0, hits = 0;
+
+    for (; active < BST_BATCH_GROUP && next < n; active++) {
+        node[active] = tree->root;
+        idx[active] = next++;
+    }
+    while (active > 0) {
+        for (size_t g = 0; g < active; g++) {
+            treeNode_t* curr = node[g];
+            int key = keys[idx[g]];
+            if (curr && curr->key != key) {
+                curr = (curr->key > key) ? curr->left : curr->right;
+                if (curr)
+                    __builtin_prefetch(curr);
+                node[g] = curr;
+                continue;
+            }
+
+            found[idx[g]] = (curr != NULL);
+            hits += (curr != NULL);
+            if (next < n) {
+                node[g] = tree->root;
+                idx[g] = next++;
+            } else {  // Move the last lookup in flight into this slot
+                active--;
+                node[g] = node[active];
+                idx[g] = idx[active];
+                g--;
+            }
+        }
+    }
+    return hits;
+}
+
+/* Subroutine of bst_insert. Splay the key and split the tree around the root,
+which becomes a child of the new node. In multiset mode a key that reaches
+the root only increments its count. */
+static void bst_splay_insert(BST_t* tree, int key) {
+    treeNode_t* root = bst_splay(tree->root, key, false);
+    treeNode_t* new_node;
+
+#if BST_MULTISET
+    if (tree->multiset && root && root->key == key) {
+        root->count++;
+#if BST_ORDER_STATISTICS
+        root->size++;
+#endif
+        tree->root = root;
+        return;
+    }
+#endif
+    new_node = bst_create_node(key);
+    if (root && root->key > new_node->key) {
+        new_node->left = root->left;
+        new_node->right = root;
+        root->left = NULL;
+    } else if (root) {
+        new_node->right = root->right;
+        new_node->left = root;
+        root->right = NULL;
+    }
+#if BST_ORDER_STATISTICS
+    if (root) {
+        root->size = BST_COUNT(root) + SPLAY_SIZE(root->left) + SPLAY_SIZE(root->right);
+        new_node->size = 1 + SPLAY_SIZE(new_node->left) + SPLAY_SIZE(new_node->right);
+    }
+#endif
+    tree->root = new_node;
+}
+
+/* Insert a new node in the tree. Equal keys are allowed; in multiset mode
+they increment the count of the existing node and nothing is rebalanced. */
 void bst_insert(BST_t* tree, int key) {
     treeNode_t *new_node, *curr, *prev;
-    new_node = bst_create_node(key);
+    bool go_left = false;
+    if (tree->policy == BST_SPLAY) {
+        bst_splay_insert(tree, key);
+        return;
+    }
     curr = tree->root;
     prev = NULL;
 
     while (curr) {
         prev = curr;
+#if BST_ORDER_STATISTICS
+        curr->size++;
+#endif
+#if BST_MULTISET
+        if (tree->multiset && curr->key == key) {
+            curr->count++;
+            return;
+        }
+#endif
         if (curr->key > key)
-            curr = curr->left;
+            go_left = true;
         else if (curr->key < key)
-            curr = curr->right;
+            go_left = false;
         // Randomly choose left or right in case of equal keys
-        else if (rand() % 2)
-            curr = curr->left;
         else
-            curr = curr->right;
+            go_left = rand() % 2;
+        curr = (go_left) ? curr->left : curr->right;
     }
 
+    // Link the new node on the side chosen by the last step of the descent.
+    new_node = bst_create_node(key);
     if (!prev)
         tree->root = new_node;
-    else if (prev->key > key)
+    else if (go_left)
         prev->left = new_node;
     else 
         prev->right = new_node;
@@ -112,41 +346,124 @@ static treeNode_t* bst_minimum(treeNode_t* root, treeNode_t** pprev) {
     return root;  
 }
 
+/* Free a node, unless it belongs to the block of a balanced build. */
+static void bst_free_node(BST_t* tree, treeNode_t* node) {
+    uintptr_t addr = (uintptr_t) node;
+    uintptr_t first = (uintptr_t) tree->block;
+    uintptr_t last = (uintptr_t) (tree->block + tree->block_len);
+
+    if (addr < first || addr >= last)
+        free(node);
+}
+
 /* Link parent to grandchild and free child. */
-static void bst_transplant(treeNode_t* parent, treeNode_t* child, treeNode_t* grandchild) {
+static void bst_transplant(BST_t* tree, treeNode_t* parent, treeNode_t* child, treeNode_t* grandchild) {
     if (parent->left == child) 
         parent->left = grandchild;
     else
         parent->right = grandchild;
 
-    free(child);
+    bst_free_node(tree, child);
+}
+
+#if BST_ORDER_STATISTICS
+/* Subroutine of bst_delete. Decrement the size of the nodes on the path 
+from the root to the target, which was found by searching for the key. */
+static void bst_shrink_path(treeNode_t* root, treeNode_t* target, int key) {
+    while (root != target) {
+        root->size--;
+        root = (root->key > key) ? root->left : root->right;
+    }
 }
+#endif
+
+/* Subroutine of bst_delete. Splay the key; if it reaches the root, replace the
+root by the join of its subtrees: the maximum of the left subtree is splayed
+to its root, which then has no right child and adopts the right subtree. */
+static void bst_splay_delete(BST_t* tree, int key) {
+    treeNode_t* root = bst_splay(tree->root, key, false);
+    treeNode_t* joined;
 
-/* Search for the key in the tree and, if present, remove it. */
+    tree->root = root;
+    if (!root || root->key != key) {
+        printf("Key %d was not found.\n", key);
+        return;
+    }
+#if BST_MULTISET
+    if (root->count > 1) {
+        root->count--;
+#if BST_ORDER_STATISTICS
+        root->size--;
+#endif
+        return;
+    }
+#endif
+
+    if (!root->left) {
+        joined = root->right;
+    } else {
+        joined = bst_splay(root->left, key, true);
+        joined->right = root->right;
+#if BST_ORDER_STATISTICS
+        joined->size += SPLAY_SIZE(root->right);
+#endif
+    }
+    bst_free_node(tree, root);
+    tree->root = joined;
+}
+
+/* Search for the key in the tree and, if present, remove it. A node that 
+stores more than one occurrence of the key only loses one of them. */
 void bst_delete(BST_t* tree, int key) {
     treeNode_t *parent, *child, *grandchild, *succ, *succ_parent;
 
+    if (tree->policy == BST_SPLAY) {
+        bst_splay_delete(tree, key);
+        return;
+    }
+
     // Search the key and assign the node to remove to the variable `child`.
     child = bst_search(tree->root, &parent, key);
 
     if (!child) {
         printf("Key %d was not found.\n", key);
+#if BST_MULTISET
+    } else if (child->count > 1) {
+        child->count--;
+#if BST_ORDER_STATISTICS
+        bst_shrink_path(tree->root, child, key);
+        child->size--;
+#endif
+#endif
     } else if (child->left && child->right) {
         /* Overwrite the child's key with the key of its successor and
         then remove the successor. Successor cannot have left child. */
         succ_parent = child;
         succ = bst_minimum(child->right, &succ_parent);
+#if BST_ORDER_STATISTICS
+        // The nodes below the child lose the successor's occurrences.
+        bst_shrink_path(tree->root, child, key);
+        child->size--;
+        for (treeNode_t* node = child->right; node != succ; node = node->left)
+            node->size -= BST_COUNT(succ);
+#endif
         child->key = succ->key;
-        bst_transplant(succ_parent, succ, succ->right); 
+#if BST_MULTISET
+        child->count = succ->count;
+#endif
+        bst_transplant(tree, succ_parent, succ, succ->right);
     } else {
+#if BST_ORDER_STATISTICS
+        bst_shrink_path(tree->root, child, key);
+#endif
         grandchild = (child->left) ? child->left : child->right;
         if (!parent) {  
             // The node to remove is the root and it has at most one child
-            free(child);
+            bst_free_node(tree, child);
             tree->root = grandchild;
         } else {  
             // The node to remove is either a leaf or it has at most one child
-            bst_transplant(parent, child, grandchild);
+            bst_transplant(tree, parent, child, grandchild);
         }
     }
 
@@ -172,8 +489,14 @@ static treeNode_t* bst_fill_tree(int idx, int* arr, int len) {
     assert(new_node);
     
     new_node->key = arr[idx];
+#if BST_MULTISET
+    new_node->count = 1;
+#endif
     new_node->left = bst_fill_tree(2*idx + 1, arr, len);
     new_node->right = bst_fill_tree(2*idx + 2, arr, len);
+#if BST_ORDER_STATISTICS
+    new_node->size = 1 + bst_size(new_node->left) + bst_size(new_node->right);
+#endif
 
     return new_node;
 }
@@ -193,11 +516,143 @@ BST_t* bst_create_tree_from_arr(int* arr, int len) {
     return tree;
 }
 
-static void free_tree_subroutine(treeNode_t* root) {
-    if (!root) return;
-    free_tree_subroutine(root->left);
-    free_tree_subroutine(root->right);
-    free(root);
+/* Subroutine of bst_build. Compare two integers for qsort. */
+static int cmp_int(const void* p, const void* q) {
+    int a = *(const int*) p, b = *(const int*) q;
+    return (a > b) - (a < b);
+}
+
+/* Subroutine of bst_build. If the keys are already sorted return them, 
+otherwise return a sorted copy that the caller must free. */
+static int* bst_sorted_keys(int* keys, int len) {
+    for (int i = 1; i < len; i++) {
+        if (keys[i - 1] > keys[i]) {
+            int* sorted = malloc(len * sizeof(int));
+            assert(sorted);
+            memcpy(sorted, keys, len * sizeof(int));
+            qsort(sorted, len, sizeof(int), cmp_int);
+            return sorted;
+        }
+    }
+    return keys;
+}
+
+/* Subroutine of bst_build. The median of keys[lo, hi) becomes the root
+and the two halves become its subtrees. The node of keys[i] is block[i]. */
+static treeNode_t* bst_fill_balanced(treeNode_t* block, int* keys, int lo, int hi) {
+    if (lo >= hi)
+        return NULL;
+
+    int mid = lo + (hi - lo) / 2;
+    treeNode_t* node = &block[mid];
+    node->key = keys[mid];
+#if BST_ORDER_STATISTICS
+    node->size = hi - lo;
+#endif
+#if BST_MULTISET
+    node->count = 1;
+#endif
+    node->left = bst_fill_balanced(block, keys, lo, mid);
+    node->right = bst_fill_balanced(block, keys, mid + 1, hi);
+
+    return node;
+}
+
+typedef struct {
+    treeNode_t* block;
+    int* keys;
+    int lo, hi, depth;
+    treeNode_t* root;
+} fill_task_t;
+
+static void* bst_fill_balanced_thread(void* arg) {
+    fill_task_t* task = arg;
+    task->root = bst_fill_balanced_parallel(task->block, task->keys, task->lo, task->hi, task->depth);
+    return NULL;
+}
+
+/* Same as bst_fill_balanced, but the left subtree is built by a new thread while
+the current thread builds the right one. The two subtrees write to disjoint parts
+of the block. Up to 2^depth threads run at the same time. */
+static treeNode_t* bst_fill_balanced_parallel(
+    treeNode_t* block, int* keys, int lo, int hi, int depth
+) {
+    if (depth <= 0 || hi - lo < BST_PARALLEL_CUTOFF)
+        return bst_fill_balanced(block, keys, lo, hi);
+
+    int mid = lo + (hi - lo) / 2;
+    treeNode_t* node = &block[mid];
+    fill_task_t task = {block, keys, lo, mid, depth - 1, NULL};
+    pthread_t thread;
+
+    node->key = keys[mid];
+#if BST_ORDER_STATISTICS
+    node->size = hi - lo;
+#endif
+#if BST_MULTISET
+    node->count = 1;
+#endif
+    if (pthread_create(&thread, NULL, bst_fill_balanced_thread, &task)) {
+        // No more threads available: build both subtrees in the current thread
+        node->left = bst_fill_balanced(block, keys, lo, mid);
+        node->right = bst_fill_balanced(block, keys, mid + 1, hi);
+        return node;
+    }
+    node->right = bst_fill_balanced_parallel(block, keys, mid + 1, hi, depth - 1);
+    pthread_join(thread, NULL);
+    node->left = task.root;
+
+    return node;
+}
+
+/* Subroutine of bst_build_balanced and bst_build_balanced_parallel. */
+static BST_t* bst_build(int* keys, int len, int nthreads) {
+    if (!keys || len < 1)
+        return NULL;
+
+    int* sorted = bst_sorted_keys(keys, len);
+    BST_t* tree = bst_create();
+    tree->block = malloc(len * sizeof(treeNode_t));
+    assert(tree->block);
+    tree->block_len = len;
+
+    int depth = 0;
+    while ((1 << depth) < nthreads)
+        depth++;
+    tree->root = bst_fill_balanced_parallel(tree->block, sorted, 0, len, depth);
+
+    if (sorted != keys)
+        free(sorted);
+    return tree;
+}
+
+/* Build a height-balanced BST in O(n) from sorted keys. Unsorted keys are sorted
+first (the input array is not modified). All the nodes are allocated in one block. */
+BST_t* bst_build_balanced(int* keys, int len) {
+    return bst_build(keys, len, 1);
+}
+
+/* Same as bst_build_balanced, but the subtrees are built by up to `nthreads` threads. */
+BST_t* bst_build_balanced_parallel(int* keys, int len, int nthreads) {
+    return bst_build(keys, len, nthreads);
+}
+
+/* Free the nodes without recursion. Every left child is rotated up until the 
+current node has none; then the node is freed and we move to its right child. */
+static void free_tree_subroutine(BST_t* tree, treeNode_t* root) {
+    treeNode_t* tmp;
+    while (root) {
+        if (root->left) {
+            tmp = root->left;
+            root->left = tmp->right;
+            tmp->right = root;
+            root = tmp;
+        } else {
+            tmp = root->right;
+            bst_free_node(tree, root);
+            root = tmp;
+        }
+    }
 }
 
 /* Free all nodes in the tree. */
@@ -205,24 +660,386 @@ void bst_free_tree(BST_t* tree) {
     if (!tree) {
         puts("The tree does not exist.");
     } else {
-        free_tree_subroutine(tree->root);
+        free_tree_subroutine(tree, tree->root);
         tree->root = NULL;
+        free(tree->block);
+        tree->block = NULL;
+        tree->block_len = 0;
     }
 }
 
-static void traverse_subroutine(treeNode_t* root) {
-    if (!root) return;
-    traverse_subroutine(root->left);
-    printf("%d ", root->key);
-    traverse_subroutine(root->right);
-}
-
 /* Inorder traverse. */
 void bst_traverse(BST_t* tree) {
-    if (!tree)
+    bst_iter_t it;
+    int key;
+
+    if (!tree) {
         puts("The tree does not exist.");
-    else if (!tree->root)
+    } else if (!tree->root) {
         puts("The tree is empty.");
-    else
-        traverse_subroutine(tree->root);
-}
\ No newline at end of file
+    } else {
+        bst_iter_init(&it, tree);
+        while (bst_iter_next(&it, &key))
+            printf("%d ", key);
+        bst_iter_free(&it);
+    }
+}
+
+
+/**
+In-order iterators. An iterator does not own the tree: it must not be used after
+the tree is modified. Call `bst_iter_free` when it is no longer needed.
+*/
+
+static void bst_iter_push(bst_iter_t* it, treeNode_t* node) {
+    if (it->top == it->cap) {
+        it->cap = (it->cap) ? 2 * it->cap : BST_ITER_MIN_STACK;
+        it->stack = realloc(it->stack, it->cap * sizeof(treeNode_t*));
+        assert(it->stack);
+    }
+    it->stack[it->top++] = node;
+}
+
+/* Push the node and its chain of left children. */
+static void bst_iter_push_left(bst_iter_t* it, treeNode_t* node) {
+    while (node) {
+        bst_iter_push(it, node);
+        node = node->left;
+    }
+}
+
+/* Initialize an iterator with an empty stack. */
+static void bst_iter_reset(bst_iter_t* it) {
+    it->stack = NULL;
+    it->top = 0;
+    it->cap = 0;
+    it->rep = 0;
+    it->bounded = false;
+    it->hi = 0;
+}
+
+/* Position the iterator before the smallest key. */
+void bst_iter_init(bst_iter_t* it, BST_t* tree) {
+    bst_iter_reset(it);
+    bst_iter_push_left(it, tree->root);
+}
+
+/* Position the iterator before the first key >= key. Only the nodes 
+where the search turns left are pushed, i.e. the ancestors whose key 
+comes after the searched one in the inorder sequence. */
+void bst_iter_lower_bound(bst_iter_t* it, BST_t* tree, int key) {
+    treeNode_t* node = tree->root;
+    bst_iter_reset(it);
+    while (node) {
+        if (node->key >= key) {
+            bst_iter_push(it, node);
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+}
+
+/* Position the iterator before the first key > key. */
+void bst_iter_upper_bound(bst_iter_t* it, BST_t* tree, int key) {
+    treeNode_t* node = tree->root;
+    bst_iter_reset(it);
+    while (node) {
+        if (node->key > key) {
+            bst_iter_push(it, node);
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+}
+
+/* Store the next key in the output parameter and advance. A key stored with
+a count is returned that many times. Return false when there are no more keys. */
+bool bst_iter_next(bst_iter_t* it, int* key) {
+    if (it->top == 0)
+        return false;
+
+    treeNode_t* node = it->stack[it->top - 1];
+    if (it->bounded && node->key > it->hi) {
+        it->top = 0;
+        return false;
+    }
+    *key = node->key;
+    if (++it->rep < BST_COUNT(node))
+        return true;
+    it->rep = 0;
+    it->top--;
+    bst_iter_push_left(it, node->right);
+    return true;
+}
+
+/* Free the stack of the iterator. */
+void bst_iter_free(bst_iter_t* it) {
+    free(it->stack);
+    it->stack = NULL;
+    it->top = 0;
+    it->cap = 0;
+}
+
+/* Call fn on every key in increasing order. ctx is passed to fn unchanged. */
+void bst_for_each(BST_t* tree, void (*fn)(int key, void* ctx), void* ctx) {
+    bst_iter_t it;
+    int key;
+
+    bst_iter_init(&it, tree);
+    while (bst_iter_next(&it, &key))
+        fn(key, ctx);
+    bst_iter_free(&it);
+}
+
+/* Position the iterator before the first key of the range [lo, hi]. */
+void bst_range_init(bst_iter_t* it, BST_t* tree, int lo, int hi) {
+    bst_iter_lower_bound(it, tree, lo);
+    it->bounded = true;
+    it->hi = hi;
+}
+
+/* Copy to out the next keys of the range, at most cap of them. Return the number
+of copied keys; 0 means that the range is exhausted. Call it in a loop to scan a 
+range of any size with a buffer of fixed size. */
+size_t bst_range(bst_iter_t* it, int* out, size_t cap) {
+    size_t n = 0;
+    while (n < cap && bst_iter_next(it, &out[n]))
+        n++;
+    return n;
+}
+
+#if BST_ORDER_STATISTICS
+/**
+Order statistics. Every node stores the size of its subtree, so the k-th key and
+the rank of a key are found with a single descent from the root. Duplicates 
+stored as counts weigh as many keys as their count.
+*/
+
+static unsigned int bst_size(treeNode_t* node) {
+    return (node) ? node->size : 0;
+}
+
+/* Store in the output parameter the k-th smallest key (k = 0 is the minimum).
+Return false if the tree has k keys or fewer. */
+bool bst_select(BST_t* tree, size_t k, int* key) {
+    treeNode_t* node = tree->root;
+    while (node) {
+        size_t left = bst_size(node->left);
+        if (k < left) {
+            node = node->left;
+        } else if (k < left + BST_COUNT(node)) {
+            *key = node->key;
+            return true;
+        } else {
+            k -= left + BST_COUNT(node);
+            node = node->right;
+        }
+    }
+    return false;
+}
+
+/* Return the number of keys < key, or <= key if inclusive. */
+static size_t bst_count_less(treeNode_t* root, int key, bool inclusive) {
+    size_t count = 0;
+    while (root) {
+        if (root->key < key || (inclusive && root->key == key)) {
+            count += bst_size(root->left) + BST_COUNT(root);
+            root = root->right;
+        } else {
+            root = root->left;
+        }
+    }
+    return count;
+}
+
+/* Return the number of keys smaller than key. */
+size_t bst_rank(BST_t* tree, int key) {
+    return bst_count_less(tree->root, key, false);
+}
+
+/* Return the number of keys in the range [lo, hi]. */
+size_t bst_count_range(BST_t* tree, int lo, int hi) {
+    if (lo > hi)
+        return 0;
+    return bst_count_less(tree->root, hi, true) - bst_count_less(tree->root, lo, false);
+}
+#endif
+
+/* Subroutine of bst_freeze. */
+static size_t bst_count_nodes(BST_t* tree) {
+    bst_iter_t it;
+    size_t n = 0;
+    int key;
+
+    bst_iter_init(&it, tree);
+    while (bst_iter_next(&it, &key))
+        n++;
+    bst_iter_free(&it);
+    return n;
+}
+
+/* Subroutine of bst_freeze. Store the keys in order. */
+static void bst_collect_keys(BST_t* tree, int* keys) {
+    bst_iter_t it;
+    size_t i = 0;
+
+    bst_iter_init(&it, tree);
+    while (bst_iter_next(&it, &keys[i]))
+        i++;
+    bst_iter_free(&it);
+}
+
+/* Build a read-only search index with the keys of the tree. The tree is not 
+modified and the index does not see later changes to the tree. */
+sidx_t* bst_freeze(BST_t* tree, SIDX_LAYOUT layout) {
+    size_t n = bst_count_nodes(tree);
+    int* keys = malloc((n ? n : 1) * sizeof(int));
+    assert(keys);
+
+    bst_collect_keys(tree, keys);
+    sidx_t* index = sidx_build(keys, n, layout);
+
+    free(keys);
+    return index;
+}
+
+/**
+Serialization (see Serialization/serialize.c). The keys are saved in order, one
+record per distinct key with its number of occurrences, so that loading them back
+is a single streaming pass that builds a balanced tree, whatever the shape of the
+saved one.
+*/
+
+/* Subroutine of bst_save. Visit the nodes in order and merge the runs of equal
+keys: outside multiset mode a duplicate has a node of its own. Every run is written
+as a record if there is a writer. Return the number of records and store in *dup
+whether a key occurs more than once. */
+static size_t bst_save_records(BST_t* tree, ser_writer_t* writer, bool* dup) {
+    bst_iter_t it;
+    size_t records = 0;
+    unsigned int count = 0;
+    int key = 0;
+
+    *dup = false;
+    bst_iter_reset(&it);
+    bst_iter_push_left(&it, tree->root);
+    while (it.top) {
+        treeNode_t* node = it.stack[--it.top];
+        bst_iter_push_left(&it, node->right);
+        if (count && node->key == key) {
+            count += BST_COUNT(node);
+            continue;
+        }
+        if (count && writer)
+            ser_write(writer, key, count);
+        *dup = *dup || count > 1;
+        key = node->key;
+        count = BST_COUNT(node);
+        records++;
+    }
+    if (count && writer)
+        ser_write(writer, key, count);
+    *dup = *dup || count > 1;
+    bst_iter_free(&it);
+    return records;
+}
+
+/* Write the keys to the stream in the format of Serialization/. The tree is not
+modified. Return false if the stream could not be written. */
+bool bst_save(BST_t* tree, FILE* out) {
+    ser_writer_t writer;
+    bool dup;
+
+    if (!tree) {
+        puts("The tree does not exist.");
+        return false;
+    }
+    size_t records = bst_save_records(tree, NULL, &dup);
+#if BST_MULTISET
+    dup = dup || tree->multiset;
+#endif
+    if (ser_writer_init(&writer, out, records, dup))
+        bst_save_records(tree, &writer, &dup);
+    return ser_writer_finish(&writer);
+}
+
+/* Subroutine of bst_load. Build a balanced subtree with the next n records of the
+stream: the left half is read first, then the root, then the right half. The nodes
+are taken from the block in order. Return NULL if the stream breaks. */
+static treeNode_t* bst_load_subtree(ser_reader_t* reader, treeNode_t* block, size_t* next, size_t n) {
+    int key;
+    unsigned int count;
+
+    if (!n || !reader->ok)
+        return NULL;
+    treeNode_t* left = bst_load_subtree(reader, block, next, (n - 1) / 2);
+    if (!ser_read(reader, &key, &count))
+        return NULL;
+
+    treeNode_t* node = &block[(*next)++];
+    node->key = key;
+#if BST_MULTISET
+    node->count = count;
+#endif
+    node->left = left;
+    node->right = bst_load_subtree(reader, block, next, n - 1 - (n - 1) / 2);
+#if BST_ORDER_STATISTICS
+    node->size = bst_size(left) + bst_size(node->right) + count;
+#endif
+    return node;
+}
+
+#if !BST_MULTISET
+/* Subroutine of bst_load for a stream with duplicate keys when the nodes have no
+count: the records are expanded into one key per occurrence, which are known only
+once they are all read, and the balanced tree is built from them. */
+static BST_t* bst_load_expanded(ser_reader_t* reader) {
+    size_t n;
+    int* keys = ser_read_keys(reader, &n);
+
+    if (!ser_reader_finish(reader)) {
+        free(keys);
+        return NULL;
+    }
+    BST_t* tree = (n) ? bst_build_balanced(keys, (int) n) : bst_create();
+    free(keys);
+    return tree;
+}
+#endif
+
+/* Read a stream written by bst_save and build a height-balanced tree in O(n), with
+all the nodes in one block. A stream with duplicate keys gives a tree in multiset
+mode; without BST_MULTISET, every occurrence gets a node of its own instead.
+Return NULL if the stream is broken. */
+BST_t* bst_load(FILE* in) {
+    ser_reader_t reader;
+    size_t next = 0;
+
+    if (!ser_reader_init(&reader, in)) {
+        ser_reader_finish(&reader);
+        return NULL;
+    }
+#if !BST_MULTISET
+    if (reader.flags & SER_COUNTS)
+        return bst_load_expanded(&reader);
+#endif
+    BST_t* tree = bst_create();
+#if BST_MULTISET
+    tree->multiset = reader.flags & SER_COUNTS;
+#endif
+    if (reader.n_records) {
+        tree->block = malloc(reader.n_records * sizeof(treeNode_t));
+        assert(tree->block);
+        tree->block_len = reader.n_records;
+        tree->root = bst_load_subtree(&reader, tree->block, &next, reader.n_records);
+    }
+    if (!ser_reader_finish(&reader)) {
+        tree->root = NULL;
+        bst_free_tree(tree);
+        free(tree);
+        return NULL;
+    }
+    return tree;
+}
@@ -2,32 +2,152 @@
 #define BST_H
 
 #include <stdbool.h>
+#include <stddef.h>
+/* bst.c also needs ../Static_Search_Index/static_index.c (bst_freeze) and
+../Serialization/serialize.c (bst_save, bst_load), e.g.
+gcc -pthread bst_test.c bst.c ../Static_Search_Index/static_index.c ../Serialization/serialize.c */
+#include "../Static_Search_Index/static_index.h"
+#include "../Serialization/serialize.h"
 
+#ifndef BST_ORDER_STATISTICS
+#define BST_ORDER_STATISTICS 1  // Set to 0 to drop the subtree sizes
+#endif
+
+#ifndef BST_MULTISET
+#define BST_MULTISET 0  // Set to 1 for the duplicate counts of bst_set_multiset
+#endif
+
+/* With the subtree size, the key and the size share the first word and the node
+is 24 bytes on 64-bit targets. The count of BST_MULTISET pads it to 32, so it is
+off by default. */
 typedef struct treeNode_t {
     int key;
+#if BST_ORDER_STATISTICS
+    unsigned int size;  // Number of keys in the subtree rooted here, duplicates included
+#endif
+#if BST_MULTISET
+    unsigned int count;  // Occurrences of the key stored in this node
+#endif
     struct treeNode_t* left;
     struct treeNode_t* right;
 } treeNode_t;
 
+#if BST_MULTISET
+#define BST_COUNT(node) ((node)->count)
+#else
+#define BST_COUNT(node) 1u
+#endif
+
+#define BST_PARALLEL_CUTOFF 4096  // Smallest subtree built by its own thread
+#define BST_BATCH_GROUP 32  // Lookups in flight in bst_search_batch
+
+typedef enum {
+    BST_PLAIN,  // Ordinary BST: lookups do not modify the tree
+    BST_SPLAY   // Splay tree: accessed keys are moved to the root
+} BST_POLICY;
+
+/* Nodes built by `bst_build_balanced` live in a single block owned by the tree.
+They are released together with the block instead of one by one. In BST_SPLAY
+mode, a lookup splays only every `splay_every`-th time, so that read-mostly 
+workloads do not rewrite the top of the tree on every access. In multiset mode
+a duplicate key increments the count of its node instead of adding a node. */
 typedef struct binary_search_tree {
     treeNode_t* root;
+    treeNode_t* block;
+    size_t block_len;
+    BST_POLICY policy;
+    unsigned int splay_every;
+    unsigned int accesses;  // Lookups since the last splay
+#if BST_MULTISET
+    bool multiset;
+#endif
 } BST_t;
 
+#define BST_ITER_MIN_STACK 32
+
+/* In-order iterator. The stack holds the nodes whose key has not been visited yet
+but whose left subtree has; the next key is the one on top of the stack. The
+stack grows on the heap, so degenerate trees do not overflow the C stack. */
+typedef struct bst_iter {
+    treeNode_t** stack;
+    size_t top;
+    size_t cap;
+    unsigned int rep;  // Occurrences of the key on top already returned
+    bool bounded;  // Stop after the key `hi`
+    int hi;
+} bst_iter_t;
+
 BST_t* bst_create(void);
 bool bst_is_empty(BST_t* tree);
 treeNode_t* bst_create_node(int key);
+void bst_set_policy(BST_t* tree, BST_POLICY policy, unsigned int splay_every);
+#if BST_MULTISET
+void bst_set_multiset(BST_t* tree, bool multiset);
+size_t bst_count(BST_t* tree, int key);
+#endif
 static treeNode_t* bst_search(treeNode_t* root, treeNode_t** pprev, int key);
+static treeNode_t* bst_splay(treeNode_t* root, int key, bool to_max);
 bool bst_is_key_in(BST_t* tree, int key);
+size_t bst_search_batch(BST_t* tree, const int* keys, size_t n, bool* found);
+static void bst_splay_insert(BST_t* tree, int key);
 void bst_insert(BST_t* tree, int key);
 static treeNode_t* bst_minimum(treeNode_t* root, treeNode_t** pprev);
-static void bst_transplant(treeNode_t* parent, treeNode_t* child, treeNode_t* grandchild);
+static void bst_free_node(BST_t* tree, treeNode_t* node);
+#if BST_ORDER_STATISTICS
+static void bst_shrink_path(treeNode_t* root, treeNode_t* target, int key);
+#endif
+static void bst_transplant(BST_t* tree, treeNode_t* parent, treeNode_t* child, treeNode_t* grandchild);
+static void bst_splay_delete(BST_t* tree, int key);
 void bst_delete(BST_t* tree, int key);
 bool bst_is_valid(int* arr, int len);
 static treeNode_t* bst_fill_tree(int idx, int* arr, int len);
 BST_t* bst_create_tree_from_arr(int* arr, int len);
-static void free_tree_subroutine(treeNode_t* root);
+static int cmp_int(const void* p, const void* q);
+static int* bst_sorted_keys(int* keys, int len);
+static treeNode_t* bst_fill_balanced(treeNode_t* block, int* keys, int lo, int hi);
+static void* bst_fill_balanced_thread(void* arg);
+static treeNode_t* bst_fill_balanced_parallel(treeNode_t* block, int* keys, int lo, int hi, int depth);
+static BST_t* bst_build(int* keys, int len, int nthreads);
+BST_t* bst_build_balanced(int* keys, int len);
+BST_t* bst_build_balanced_parallel(int* keys, int len, int nthreads);
+static void free_tree_subroutine(BST_t* tree, treeNode_t* root);
 void bst_free_tree(BST_t* tree);
-static void traverse_subroutine(treeNode_t* root);
 void bst_traverse(BST_t* tree);
 
+/* Iterators and range queries. */
+static void bst_iter_push(bst_iter_t* it, treeNode_t* node);
+static void bst_iter_push_left(bst_iter_t* it, treeNode_t* node);
+static void bst_iter_reset(bst_iter_t* it);
+void bst_iter_init(bst_iter_t* it, BST_t* tree);
+void bst_iter_lower_bound(bst_iter_t* it, BST_t* tree, int key);
+void bst_iter_upper_bound(bst_iter_t* it, BST_t* tree, int key);
+bool bst_iter_next(bst_iter_t* it, int* key);
+void bst_iter_free(bst_iter_t* it);
+void bst_for_each(BST_t* tree, void (*fn)(int key, void* ctx), void* ctx);
+void bst_range_init(bst_iter_t* it, BST_t* tree, int lo, int hi);
+size_t bst_range(bst_iter_t* it, int* out, size_t cap);
+
+#if BST_ORDER_STATISTICS
+/* Order statistics. */
+static unsigned int bst_size(treeNode_t* node);
+bool bst_select(BST_t* tree, size_t k, int* key);
+static size_t bst_count_less(treeNode_t* root, int key, bool inclusive);
+size_t bst_rank(BST_t* tree, int key);
+size_t bst_count_range(BST_t* tree, int lo, int hi);
+#endif
+
+/* Freeze the tree into a read-only search index. */
+static size_t bst_count_nodes(BST_t* tree);
+static void bst_collect_keys(BST_t* tree, int* keys);
+sidx_t* bst_freeze(BST_t* tree, SIDX_LAYOUT layout);
+
+/* Save the keys to a stream and load them back into a balanced tree. */
+static size_t bst_save_records(BST_t* tree, ser_writer_t* writer, bool* dup);
+bool bst_save(BST_t* tree, FILE* out);
+static treeNode_t* bst_load_subtree(ser_reader_t* reader, treeNode_t* block, size_t* next, size_t n);
+#if !BST_MULTISET
+static BST_t* bst_load_expanded(ser_reader_t* reader);
+#endif
+BST_t* bst_load(FILE* in);
+
 #endif
\ No newline at end of file
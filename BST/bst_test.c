@@ -4,10 +4,16 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <string.h>
+#include <time.h>
 #include "bst.h"
 
 #define ARR1_SIZE 5
 #define ARR2_SIZE 11
+#define BIG_SIZE 1000000
+#define SPLAY_SIZE 100000
+#define SPLAY_LOOKUPS 1000000
+#define BIG_TREE 4000000
+#define CHAIN_SIZE 2000
 
 void test_function(char* func) {
     unsigned int pad;
@@ -26,6 +32,64 @@ void print_array(int arr[], int len) {
     puts("");
 }
 
+int height(treeNode_t* root) {
+    if (!root)
+        return 0;
+    int left = height(root->left), right = height(root->right);
+    return 1 + ((left > right) ? left : right);
+}
+
+/* Return the size of the subtree, or -1 if some node stores a wrong size. */
+int check_sizes(treeNode_t* root) {
+    if (!root)
+        return 0;
+    int left = check_sizes(root->left), right = check_sizes(root->right);
+    int size = left + right + (int) BST_COUNT(root);
+    if (left < 0 || right < 0 || root->size != (unsigned) size)
+        return -1;
+    return size;
+}
+
+int count_nodes(treeNode_t* root) {
+    if (!root)
+        return 0;
+    return 1 + count_nodes(root->left) + count_nodes(root->right);
+}
+
+int cmp(const void* p, const void* q) {
+    int a = *(const int*) p, b = *(const int*) q;
+    return (a > b) - (a < b);
+}
+
+/* Number of nodes visited by a plain search for the key. */
+int depth_of(treeNode_t* root, int key) {
+    int depth = 0;
+    while (root) {
+        depth++;
+        if (root->key == key)
+            break;
+        root = (root->key > key) ? root->left : root->right;
+    }
+    return depth;
+}
+
+/* Average depth of a lookup when 99% of the lookups hit 1% of the keys,
+spread over the whole insertion order. */
+double hot_set_depth(BST_t* tree, int* keys, int len) {
+    long total = 0;
+    srand(2);
+    for (int i = 0; i < SPLAY_LOOKUPS; i++) {
+        int key = (rand() % 100) ? keys[rand() % (len / 100) * 100] : keys[rand() % len];
+        total += depth_of(tree->root, key);
+        bst_is_key_in(tree, key);
+    }
+    return (double) total / SPLAY_LOOKUPS;
+}
+
+void sum_keys(int key, void* ctx) {
+    *(long*) ctx += key;
+}
+
 int main() {
     BST_t* tree;
     int arr1[ARR1_SIZE] = {1,2,3,4,5};
@@ -78,4 +142,332 @@ int main() {
     }
 
     free(tree);
+    puts("");
+
+    test_function("bst_build_balanced");
+    int sorted[ARR2_SIZE] = {-3, 0, 1, 2, 5, 6, 7, 8, 10, 20, 30};
+    int unsorted[ARR2_SIZE] = {10, 5, 20, 0, 7, -3, 30, 1, 2, 6, 8};
+
+    printf("%s\n\t", "Build a balanced BST from the sorted array:");
+    print_array(sorted, ARR2_SIZE);
+    tree = bst_build_balanced(sorted, ARR2_SIZE);
+    printf("%s", "Traverse the tree:\n\t");
+    bst_traverse(tree);
+    printf("\nHeight: %d\n", height(tree->root));
+    bst_free_tree(tree);
+    free(tree);
+
+    printf("%s\n\t", "Build a balanced BST from the unsorted array:");
+    print_array(unsorted, ARR2_SIZE);
+    tree = bst_build_balanced(unsorted, ARR2_SIZE);
+    printf("%s", "Traverse the tree:\n\t");
+    bst_traverse(tree);
+    printf("\nHeight: %d\n", height(tree->root));
+
+    puts("Delete the keys 5, 7 and 20 and insert the keys 4 and 9:");
+    bst_delete(tree, 5);
+    bst_delete(tree, 7);
+    bst_delete(tree, 20);
+    bst_insert(tree, 4);
+    bst_insert(tree, 9);
+    printf("%s", "Traverse the tree:\n\t");
+    bst_traverse(tree);
+    puts("");
+    bst_free_tree(tree);
+    free(tree);
+
+    int* big = malloc(BIG_SIZE * sizeof(int));
+    assert(big);
+    for (int i = 0; i < BIG_SIZE; i++)
+        big[i] = 2 * i;
+    tree = bst_build_balanced_parallel(big, BIG_SIZE, 4);
+    printf("Build a balanced BST of %d sorted keys with 4 threads. Height: %d\n", 
+           BIG_SIZE, height(tree->root));
+    printf("Key %d is in the tree: %s\n", 1234, bst_is_key_in(tree, 1234) ? "true" : "false");
+    printf("Key %d is in the tree: %s\n", 1235, bst_is_key_in(tree, 1235) ? "true" : "false");
+    bst_free_tree(tree);
+    free(tree);
+    free(big);
+    puts("");
+
+    test_function("bst_iter");
+    tree = bst_build_balanced(unsorted, ARR2_SIZE);
+    bst_iter_t it;
+    int key;
+    printf("%s", "Keys >= 6:\n\t");
+    bst_iter_lower_bound(&it, tree, 6);
+    while (bst_iter_next(&it, &key))
+        printf("%d ", key);
+    bst_iter_free(&it);
+    printf("%s", "\nKeys > 6:\n\t");
+    bst_iter_upper_bound(&it, tree, 6);
+    while (bst_iter_next(&it, &key))
+        printf("%d ", key);
+    bst_iter_free(&it);
+    long sum = 0;
+    bst_for_each(tree, sum_keys, &sum);
+    printf("\nSum of the keys with bst_for_each: %ld\n", sum);
+
+    int buf[3];
+    size_t n;
+    printf("%s", "Keys in [0, 20] read in batches of 3:\n");
+    bst_range_init(&it, tree, 0, 20);
+    while ((n = bst_range(&it, buf, 3))) {
+        printf("%s", "\t");
+        print_array(buf, n);
+    }
+    bst_iter_free(&it);
+    bst_free_tree(tree);
+    free(tree);
+
+    /* Degenerate tree: a chain of right children */
+    tree = bst_create();
+    treeNode_t* last = NULL;
+    for (int i = 0; i < BIG_SIZE; i++) {
+        treeNode_t* node = bst_create_node(i);
+        if (last)
+            last->right = node;
+        else
+            tree->root = node;
+        last = node;
+    }
+    sum = 0;
+    bst_for_each(tree, sum_keys, &sum);
+    printf("Sum of the keys of a degenerate tree of %d nodes: %ld\n", BIG_SIZE, sum);
+    bst_range_init(&it, tree, BIG_SIZE - 5, BIG_SIZE + 5);
+    n = bst_range(&it, buf, 3);
+    printf("First batch of the keys in [%d, %d]: ", BIG_SIZE - 5, BIG_SIZE + 5);
+    print_array(buf, n);
+    bst_iter_free(&it);
+    bst_free_tree(tree);
+    puts("The degenerate tree was freed without recursion.");
+    free(tree);
+    puts("");
+
+    test_function("bst_select, bst_rank and bst_count_range");
+    int keys[ARR2_SIZE * 20];
+    size_t len = 0;
+    tree = bst_build_balanced(sorted, ARR2_SIZE);
+    for (int i = 0; i < ARR2_SIZE; i++)
+        keys[len++] = sorted[i];
+    for (int i = 0; i < ARR2_SIZE * 19; i++) {  // Random inserts and deletes with duplicates
+        key = rand() % 40;
+        if (rand() % 3) {
+            bst_insert(tree, key);
+            keys[len++] = key;
+        } else if (bst_is_key_in(tree, key)) {
+            bst_delete(tree, key);
+            for (size_t j = 0; j < len; j++) {
+                if (keys[j] == key) {
+                    keys[j] = keys[--len];
+                    break;
+                }
+            }
+        }
+    }
+    qsort(keys, len, sizeof(int), cmp);
+    bool ok = check_sizes(tree->root) == (int) len;
+    for (size_t k = 0; k < len; k++)
+        ok = ok && bst_select(tree, k, &key) && key == keys[k];
+    ok = ok && !bst_select(tree, len, &key);
+    for (int lo = -5; lo <= 45; lo++) {
+        size_t rank = 0;
+        while (rank < len && keys[rank] < lo)
+            rank++;
+        ok = ok && bst_rank(tree, lo) == rank;
+        for (int hi = lo; hi <= 45; hi += 7) {
+            size_t count = 0;
+            for (size_t j = 0; j < len; j++)
+                count += (keys[j] >= lo && keys[j] <= hi);
+            ok = ok && bst_count_range(tree, lo, hi) == count;
+        }
+    }
+    bst_select(tree, len / 2, &key);
+    printf("Keys: %zu, median: %d, rank of 20: %zu, keys in [10, 20]: %zu\n", 
+           len, key, bst_rank(tree, 20), bst_count_range(tree, 10, 20));
+    printf("Subtree sizes, select, rank and count agree with a sorted array: %s\n", ok ? "true" : "false");
+    bst_free_tree(tree);
+    free(tree);
+    puts("");
+
+    test_function("bst_set_policy");
+    int* splay_keys = malloc(SPLAY_SIZE * sizeof(int));
+    tree = bst_create();
+    for (int i = 0; i < SPLAY_SIZE; i++) {  // Distinct keys in pseudo-random order
+        splay_keys[i] = (int) ((unsigned) i * 2654435761u);
+        bst_insert(tree, splay_keys[i]);
+    }
+    printf("99/1 hot set, average depth per lookup:\n");
+    printf("BST_PLAIN:                %6.2f\n", hot_set_depth(tree, splay_keys, SPLAY_SIZE));
+    bst_set_policy(tree, BST_SPLAY, 1);
+    printf("BST_SPLAY:                %6.2f\n", hot_set_depth(tree, splay_keys, SPLAY_SIZE));
+    bst_set_policy(tree, BST_SPLAY, 8);
+    printf("BST_SPLAY, splay every 8: %6.2f\n", hot_set_depth(tree, splay_keys, SPLAY_SIZE));
+    qsort(splay_keys, SPLAY_SIZE, sizeof(int), cmp);
+    ok = check_sizes(tree->root) == SPLAY_SIZE;
+    for (int k = 0; k < SPLAY_SIZE; k += 97)
+        ok = ok && bst_select(tree, k, &key) && key == splay_keys[k];
+    printf("The splayed tree is still a valid BST with correct sizes: %s\n", ok ? "true" : "false");
+    bst_free_tree(tree);
+    free(tree);
+    free(splay_keys);
+
+    len = 0;  // Random inserts and deletes with duplicates, all splayed
+    tree = bst_create();
+    bst_set_policy(tree, BST_SPLAY, 1);
+    for (int i = 0; i < ARR2_SIZE * 20; i++) {
+        key = rand() % 40;
+        if (rand() % 3) {
+            bst_insert(tree, key);
+            keys[len++] = key;
+        } else if (bst_is_key_in(tree, key)) {
+            bst_delete(tree, key);
+            for (size_t j = 0; j < len; j++) {
+                if (keys[j] == key) {
+                    keys[j] = keys[--len];
+                    break;
+                }
+            }
+        }
+    }
+    qsort(keys, len, sizeof(int), cmp);
+    ok = check_sizes(tree->root) == (int) len;
+    for (size_t k = 0; k < len; k++)
+        ok = ok && bst_select(tree, k, &key) && key == keys[k];
+    printf("Splay insertions and deletions agree with a sorted array: %s\n", ok ? "true" : "false");
+    bst_free_tree(tree);
+    free(tree);
+    puts("");
+
+#if BST_MULTISET
+    test_function("bst_set_multiset");
+    for (int policy = BST_PLAIN; policy <= BST_SPLAY; policy++) {
+        int counts[40] = {0};
+        len = 0;
+        tree = bst_create();
+        bst_set_policy(tree, policy, 1);
+        bst_set_multiset(tree, true);
+        for (int i = 0; i < ARR2_SIZE * 20; i++) {
+            key = rand() % 40;
+            if (rand() % 3) {
+                bst_insert(tree, key);
+                counts[key]++;
+                len++;
+            } else if (counts[key]) {
+                bst_delete(tree, key);
+                counts[key]--;
+                len--;
+            }
+        }
+        int distinct = 0;
+        ok = check_sizes(tree->root) == (int) len;
+        for (int k = 0; k < 40; k++) {
+            distinct += (counts[k] > 0);
+            ok = ok && bst_count(tree, k) == (size_t) counts[k];
+        }
+        ok = ok && count_nodes(tree->root) == distinct;
+
+        size_t k = 0;  // The iterator and select see every occurrence
+        bst_iter_init(&it, tree);
+        for (int j = 0; j < 40; j++)
+            for (int c = 0; c < counts[j]; c++, k++)
+                ok = ok && bst_iter_next(&it, &key) && key == j && bst_select(tree, k, &key) && key == j;
+        ok = ok && !bst_iter_next(&it, &key) && k == len && bst_rank(tree, 20) == bst_count_range(tree, 0, 19);
+        bst_iter_free(&it);
+        printf("%s: %zu keys in %d nodes, count of 7: %zu\n",
+               (policy == BST_PLAIN) ? "BST_PLAIN" : "BST_SPLAY", len, count_nodes(tree->root), bst_count(tree, 7));
+        printf("Counts, sizes, iteration and select agree with a reference count: %s\n", ok ? "true" : "false");
+        bst_free_tree(tree);
+        free(tree);
+    }
+    puts("");
+#endif
+
+    test_function("bst_search_batch");
+    tree = bst_create();
+    int* probes = malloc(BIG_TREE * sizeof(int));
+    bool* found = malloc(BIG_TREE * sizeof(bool));
+    for (int i = 0; i < BIG_TREE; i++) {
+        bst_insert(tree, (int) ((unsigned) i * 2654435761u) & ~1);  // Even keys, scattered
+        probes[i] = (int) ((unsigned) (rand() % BIG_TREE) * 2654435761u) & ~1;
+        probes[i] += (i % 4 == 0);  // A quarter of the probes miss
+    }
+    clock_t start = clock();
+    size_t one_hits = 0;
+    for (int i = 0; i < BIG_TREE; i++)
+        one_hits += bst_is_key_in(tree, probes[i]);
+    double one_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    size_t batch_hits = bst_search_batch(tree, probes, BIG_TREE, found);
+    double batch_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    ok = one_hits == batch_hits;
+    for (int i = 0; i < BIG_TREE && ok; i += 101)
+        ok = found[i] == bst_is_key_in(tree, probes[i]);
+    printf("%d lookups in a tree of %d keys, %zu hits\n", BIG_TREE, BIG_TREE, batch_hits);
+    printf("One at a time: %.3f s, batches of %d: %.3f s (%.1fx). Same results: %s\n\n", one_time,
+           BST_BATCH_GROUP, batch_time, one_time / batch_time, ok ? "true" : "false");
+    free(probes);
+    free(found);
+    bst_free_tree(tree);
+    free(tree);
+
+    test_function("bst_save and bst_load");
+    FILE* file = tmpfile();
+    tree = bst_create();
+    for (int i = 0; i < CHAIN_SIZE; i++) {  // Sorted insertions: a degenerate tree
+        bst_insert(tree, i);
+        if (i % 10 == 0)
+            bst_insert(tree, i);  // Duplicates get nodes of their own outside multiset mode
+    }
+    BST_t* loaded = (bst_save(tree, file) && !fseek(file, 0, SEEK_SET)) ? bst_load(file) : NULL;
+    len = CHAIN_SIZE + CHAIN_SIZE / 10;
+#if BST_MULTISET
+    ok = loaded && loaded->multiset && check_sizes(loaded->root) == (int) len &&
+         count_nodes(loaded->root) == CHAIN_SIZE && bst_count(loaded, 20) == 2 && bst_count(loaded, 21) == 1;
+#else
+    ok = loaded && check_sizes(loaded->root) == (int) len && count_nodes(loaded->root) == (int) len;
+#endif
+    for (size_t k = 0; k < len && ok; k++) {
+        int expected;
+        ok = bst_select(tree, k, &expected) && bst_select(loaded, k, &key) && key == expected;
+    }
+    printf("Height of the saved tree: %d, of the loaded one: %d\n", height(tree->root), ok ? height(loaded->root) : 0);
+    printf("Keys and counts survive the round trip: %s\n", ok ? "true" : "false");
+    fclose(file);
+    bst_free_tree(tree);
+    free(tree);
+    if (loaded) {
+        bst_free_tree(loaded);
+        free(loaded);
+    }
+
+    file = tmpfile();
+    tree = bst_create();
+    start = clock();
+    for (int i = 0; i < BIG_TREE; i++)
+        bst_insert(tree, (int) ((unsigned) i * 2654435761u));
+    double insert_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    ok = bst_save(tree, file) && !fseek(file, 0, SEEK_SET);
+    double save_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    loaded = (ok) ? bst_load(file) : NULL;
+    double load_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("%d keys: bst_insert one by one %.3f s, bst_save %.3f s, bst_load %.3f s (%.1fx)\n",
+           BIG_TREE, insert_time, save_time, load_time, insert_time / load_time);
+    ok = loaded && check_sizes(loaded->root) == BIG_TREE && (1 << (height(loaded->root) - 1)) <= BIG_TREE &&
+         BIG_TREE < (1 << height(loaded->root));
+    int prev = INT_MIN;
+    bst_iter_init(&it, loaded);
+    for (size_t i = 0; ok && bst_iter_next(&it, &key); i++) {
+        ok = i == 0 || key > prev;
+        prev = key;
+    }
+    bst_iter_free(&it);
+    printf("Balanced and complete: %s\n", ok ? "true" : "false");
+    fclose(file);
+    bst_free_tree(tree);
+    free(tree);
+    bst_free_tree(loaded);
+    free(loaded);
 }
\ No newline at end of file
@@ -0,0 +1,485 @@
+/*
+* This is a B+ tree with the interface of the red-black tree of Red_Black_Tree/.
+* A red-black tree of n keys is about 2 log2(n) levels deep and every level is a
+* cache miss on a separate allocation. Here a node is four cache lines holding up
+* to 56 keys (leaves) or 21 children (inner nodes), so 100M keys fit in six
+* levels, and the top levels stay in cache. Inside a node, the key is compared
+* against four slots at a time with SSE2 and the matches are summed, which gives
+* the position without any unpredictable branch. The four lines of the next node
+* are prefetched together while the descent continues, instead of missing on them
+* one after the other.
+*
+* All the keys are in the leaves, which are linked in both directions: a range
+* scan reads 56 consecutive keys per node instead of following parent pointers.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "btree.h"
+
+/* Allocate an empty tree. */
+btree_t* btree_create(void) {
+    btree_t* tree = malloc(sizeof(btree_t));
+    assert(tree);
+    tree->root = NULL;
+    tree->len = 0;
+    tree->height = 0;
+    return tree;
+}
+
+/* Return true if the tree does not contain any key, otherwise return false. */
+bool btree_is_empty(btree_t* tree) {
+    return tree->root == NULL;
+}
+
+/* Return the number of keys, duplicates included. */
+size_t btree_len(btree_t* tree) {
+    return tree->len;
+}
+
+/* Allocate a node aligned to a cache line, with all the key slots unused. */
+static btree_node_t* btree_create_node(bool is_leaf) {
+    btree_node_t* node = aligned_alloc(CACHE_LINE, sizeof(btree_node_t));
+    assert(node);
+
+    node->n = 0;
+    node->is_leaf = is_leaf;
+    if (is_leaf) {
+        node->leaf.prev = node->leaf.next = NULL;
+        for (int i = 0; i < BTREE_LEAF_KEYS; i++)
+            node->leaf.keys[i] = INT_MAX;
+    } else {
+        for (int i = 0; i < BTREE_INNER_KEYS; i++)
+            node->inner.keys[i] = INT_MAX;
+        for (int i = 0; i <= BTREE_INNER_KEYS; i++)
+            node->inner.children[i] = NULL;
+    }
+    return node;
+}
+
+/* Return the number of keys among the first n that are smaller than key (or
+smaller or equal if inclusive). The keys are sorted, so that is the position of
+the first key >= key (or > key). The slots past n up to the next multiple of four
+hold INT_MAX, which is never smaller than key. */
+static int btree_rank(const int* keys, int n, int key, bool inclusive) {
+    if (inclusive) {
+        if (key == INT_MAX)
+            return n;
+        key++;  // k <= key is k < key + 1
+    }
+#if defined(__SSE2__)
+    // A lane that compares true is -1: subtracting it counts the match.
+    __m128i x = _mm_set1_epi32(key), count = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 4)
+        count = _mm_sub_epi32(count, _mm_cmpgt_epi32(x, _mm_loadu_si128((const __m128i*) (keys + i))));
+    count = _mm_add_epi32(count, _mm_shuffle_epi32(count, _MM_SHUFFLE(1, 0, 3, 2)));
+    count = _mm_add_epi32(count, _mm_shuffle_epi32(count, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(count);
+#else
+    int count = 0;
+    while (count < n && keys[count] < key)
+        count++;
+    return count;
+#endif
+}
+
+/* Start loading the four cache lines of the node in parallel. */
+static void btree_prefetch(const btree_node_t* node) {
+    for (int i = 0; i < BTREE_NODE_SIZE; i += CACHE_LINE)
+        __builtin_prefetch((const char*) node + i);
+}
+
+/* Subroutine of btree_insert_subtree. Insert the key at position pos of a full
+leaf and move the upper half of the keys to a new leaf linked after it. Return
+the new leaf and store its first key, the separator, in *separator. */
+static btree_node_t* btree_split_leaf(btree_node_t* node, int pos, int key, int* separator) {
+    int keys[BTREE_LEAF_KEYS + 1];
+    memcpy(keys, node->leaf.keys, pos * sizeof(int));
+    keys[pos] = key;
+    memcpy(keys + pos + 1, node->leaf.keys + pos, (BTREE_LEAF_KEYS - pos) * sizeof(int));
+
+    btree_node_t* right = btree_create_node(true);
+    int half = (BTREE_LEAF_KEYS + 1) / 2;
+    right->n = BTREE_LEAF_KEYS + 1 - half;
+    memcpy(right->leaf.keys, keys + half, right->n * sizeof(int));
+    node->n = half;
+    memcpy(node->leaf.keys, keys, half * sizeof(int));
+    for (int i = half; i < BTREE_LEAF_KEYS; i++)
+        node->leaf.keys[i] = INT_MAX;
+
+    right->leaf.prev = node;
+    right->leaf.next = node->leaf.next;
+    if (node->leaf.next)
+        node->leaf.next->leaf.prev = right;
+    node->leaf.next = right;
+
+    *separator = right->leaf.keys[0];
+    return right;
+}
+
+/* Subroutine of btree_insert_subtree. Insert the separator key at position pos
+of a full inner node, with the child on its right, and split the node around its
+middle key. Return the new right node and store the middle key in *separator. */
+static btree_node_t* btree_split_inner(btree_node_t* node, int pos, int key, btree_node_t* child, int* separator) {
+    int keys[BTREE_INNER_KEYS + 1];
+    btree_node_t* children[BTREE_INNER_KEYS + 2];
+    memcpy(keys, node->inner.keys, pos * sizeof(int));
+    keys[pos] = key;
+    memcpy(keys + pos + 1, node->inner.keys + pos, (BTREE_INNER_KEYS - pos) * sizeof(int));
+    memcpy(children, node->inner.children, (pos + 1) * sizeof(btree_node_t*));
+    children[pos + 1] = child;
+    memcpy(children + pos + 2, node->inner.children + pos + 1, (BTREE_INNER_KEYS - pos) * sizeof(btree_node_t*));
+
+    btree_node_t* right = btree_create_node(false);
+    int half = (BTREE_INNER_KEYS + 1) / 2;  // Keys left in node; keys[half] moves up
+    right->n = BTREE_INNER_KEYS - half;
+    memcpy(right->inner.keys, keys + half + 1, right->n * sizeof(int));
+    memcpy(right->inner.children, children + half + 1, (right->n + 1) * sizeof(btree_node_t*));
+    node->n = half;
+    memcpy(node->inner.keys, keys, half * sizeof(int));
+    memcpy(node->inner.children, children, (half + 1) * sizeof(btree_node_t*));
+    for (int i = half; i < BTREE_INNER_KEYS; i++) {
+        node->inner.keys[i] = INT_MAX;
+        node->inner.children[i + 1] = NULL;
+    }
+
+    *separator = keys[half];
+    return right;
+}
+
+/* Insert the key in the subtree, after the keys equal to it. If the node has to
+split, return the new node on its right and store the key separating them in
+*separator; otherwise return NULL. */
+static btree_node_t* btree_insert_subtree(btree_node_t* node, int key, int* separator) {
+    if (node->is_leaf) {
+        int pos = btree_rank(node->leaf.keys, node->n, key, true);
+        if (node->n == BTREE_LEAF_KEYS)
+            return btree_split_leaf(node, pos, key, separator);
+        memmove(node->leaf.keys + pos + 1, node->leaf.keys + pos, (node->n - pos) * sizeof(int));
+        node->leaf.keys[pos] = key;
+        node->n++;
+        return NULL;
+    }
+
+    int i = btree_rank(node->inner.keys, node->n, key, true);
+    btree_prefetch(node->inner.children[i]);
+    int child_separator;
+    btree_node_t* right = btree_insert_subtree(node->inner.children[i], key, &child_separator);
+    if (!right)
+        return NULL;
+
+    if (node->n == BTREE_INNER_KEYS)
+        return btree_split_inner(node, i, child_separator, right, separator);
+    memmove(node->inner.keys + i + 1, node->inner.keys + i, (node->n - i) * sizeof(int));
+    memmove(node->inner.children + i + 2, node->inner.children + i + 1, (node->n - i) * sizeof(btree_node_t*));
+    node->inner.keys[i] = child_separator;
+    node->inner.children[i + 1] = right;
+    node->n++;
+    return NULL;
+}
+
+/* Insert a key. Duplicates are allowed, as in rbt_insert. */
+void btree_insert(btree_t* tree, int key) {
+    if (!tree->root)
+        tree->root = btree_create_node(true);
+
+    int separator;
+    btree_node_t* right = btree_insert_subtree(tree->root, key, &separator);
+    if (right) {  // The root split: the tree grows by one level
+        btree_node_t* root = btree_create_node(false);
+        root->n = 1;
+        root->inner.keys[0] = separator;
+        root->inner.children[0] = tree->root;
+        root->inner.children[1] = right;
+        tree->root = root;
+        tree->height++;
+    }
+    tree->len++;
+}
+
+/* Return the leaf holding the first key >= key (> key if inclusive) and store
+its position in *pos, or return NULL if there is no such key. */
+static btree_node_t* btree_find_leaf(btree_t* tree, int key, bool inclusive, int* pos) {
+    btree_node_t* node = tree->root;
+    if (!node)
+        return NULL;
+
+    while (!node->is_leaf) {
+        node = node->inner.children[btree_rank(node->inner.keys, node->n, key, inclusive)];
+        btree_prefetch(node);
+    }
+    *pos = btree_rank(node->leaf.keys, node->n, key, inclusive);
+    if (*pos == node->n) {  // All the keys of the leaf are smaller: the next one starts there
+        node = node->leaf.next;
+        *pos = 0;
+    }
+    return node;
+}
+
+/* Return true if the key is in the tree, otherwise return false. */
+bool btree_is_key_in(btree_t* tree, int key) {
+    int pos;
+    btree_node_t* leaf = btree_find_leaf(tree, key, false, &pos);
+    return leaf && leaf->leaf.keys[pos] == key;
+}
+
+/* Subroutines of btree_fix_child: children[i] of the parent has one key too few.
+Move one key from its left sibling through the parent. */
+static void btree_borrow_left(btree_node_t* parent, int i) {
+    btree_node_t* node = parent->inner.children[i];
+    btree_node_t* left = parent->inner.children[i - 1];
+
+    if (node->is_leaf) {
+        memmove(node->leaf.keys + 1, node->leaf.keys, node->n * sizeof(int));
+        node->leaf.keys[0] = left->leaf.keys[left->n - 1];
+        left->leaf.keys[left->n - 1] = INT_MAX;
+        parent->inner.keys[i - 1] = node->leaf.keys[0];
+    } else {
+        memmove(node->inner.keys + 1, node->inner.keys, node->n * sizeof(int));
+        memmove(node->inner.children + 1, node->inner.children, (node->n + 1) * sizeof(btree_node_t*));
+        node->inner.keys[0] = parent->inner.keys[i - 1];
+        node->inner.children[0] = left->inner.children[left->n];
+        parent->inner.keys[i - 1] = left->inner.keys[left->n - 1];
+        left->inner.keys[left->n - 1] = INT_MAX;
+        left->inner.children[left->n] = NULL;
+    }
+    node->n++;
+    left->n--;
+}
+
+/* Move one key from the right sibling of children[i] through the parent. */
+static void btree_borrow_right(btree_node_t* parent, int i) {
+    btree_node_t* node = parent->inner.children[i];
+    btree_node_t* right = parent->inner.children[i + 1];
+
+    if (node->is_leaf) {
+        node->leaf.keys[node->n] = right->leaf.keys[0];
+        memmove(right->leaf.keys, right->leaf.keys + 1, (right->n - 1) * sizeof(int));
+        right->leaf.keys[right->n - 1] = INT_MAX;
+        parent->inner.keys[i] = right->leaf.keys[0];
+    } else {
+        node->inner.keys[node->n] = parent->inner.keys[i];
+        node->inner.children[node->n + 1] = right->inner.children[0];
+        parent->inner.keys[i] = right->inner.keys[0];
+        memmove(right->inner.keys, right->inner.keys + 1, (right->n - 1) * sizeof(int));
+        memmove(right->inner.children, right->inner.children + 1, right->n * sizeof(btree_node_t*));
+        right->inner.keys[right->n - 1] = INT_MAX;
+        right->inner.children[right->n] = NULL;
+    }
+    node->n++;
+    right->n--;
+}
+
+/* Merge children[i + 1] of the parent into children[i] and remove the separator
+between them from the parent. */
+static void btree_merge(btree_node_t* parent, int i) {
+    btree_node_t* left = parent->inner.children[i];
+    btree_node_t* right = parent->inner.children[i + 1];
+
+    if (left->is_leaf) {
+        memcpy(left->leaf.keys + left->n, right->leaf.keys, right->n * sizeof(int));
+        left->n += right->n;
+        left->leaf.next = right->leaf.next;
+        if (right->leaf.next)
+            right->leaf.next->leaf.prev = left;
+    } else {
+        left->inner.keys[left->n] = parent->inner.keys[i];
+        memcpy(left->inner.keys + left->n + 1, right->inner.keys, right->n * sizeof(int));
+        memcpy(left->inner.children + left->n + 1, right->inner.children, (right->n + 1) * sizeof(btree_node_t*));
+        left->n += right->n + 1;
+    }
+    free(right);
+
+    memmove(parent->inner.keys + i, parent->inner.keys + i + 1, (parent->n - i - 1) * sizeof(int));
+    memmove(parent->inner.children + i + 1, parent->inner.children + i + 2, (parent->n - i - 1) * sizeof(btree_node_t*));
+    parent->n--;
+    parent->inner.keys[parent->n] = INT_MAX;
+    parent->inner.children[parent->n + 1] = NULL;
+}
+
+/* children[i] of the parent has just dropped below the minimum number of keys.
+Borrow a key from a sibling that can spare one, otherwise merge with a sibling. */
+static void btree_fix_child(btree_node_t* parent, int i) {
+    int min = parent->inner.children[i]->is_leaf ? BTREE_LEAF_MIN : BTREE_INNER_MIN;
+
+    if (i > 0 && parent->inner.children[i - 1]->n > min)
+        btree_borrow_left(parent, i);
+    else if (i < parent->n && parent->inner.children[i + 1]->n > min)
+        btree_borrow_right(parent, i);
+    else if (i > 0)
+        btree_merge(parent, i - 1);
+    else
+        btree_merge(parent, i);
+}
+
+/* Remove one occurrence of the key from the subtree. Return false if the key is
+not there. The node may be left with too few keys: its parent fixes that. */
+static bool btree_delete_subtree(btree_node_t* node, int key) {
+    if (node->is_leaf) {
+        int pos = btree_rank(node->leaf.keys, node->n, key, false);
+        if (pos == node->n || node->leaf.keys[pos] != key)
+            return false;
+        memmove(node->leaf.keys + pos, node->leaf.keys + pos + 1, (node->n - pos - 1) * sizeof(int));
+        node->n--;
+        node->leaf.keys[node->n] = INT_MAX;
+        return true;
+    }
+
+    // Copies of the key can be on both sides of a separator equal to it.
+    for (int i = btree_rank(node->inner.keys, node->n, key, false); i <= node->n; i++) {
+        btree_node_t* child = node->inner.children[i];
+        if (btree_delete_subtree(child, key)) {
+            if (child->n < (child->is_leaf ? BTREE_LEAF_MIN : BTREE_INNER_MIN))
+                btree_fix_child(node, i);
+            return true;
+        }
+        if (i == node->n || node->inner.keys[i] != key)
+            break;
+    }
+    return false;
+}
+
+/* Search for the key in the tree and, if present, remove one occurrence of it. */
+void btree_delete(btree_t* tree, int key) {
+    if (!tree->root || !btree_delete_subtree(tree->root, key)) {
+        printf("Key %d was not found.\n", key);
+        return;
+    }
+    tree->len--;
+
+    btree_node_t* root = tree->root;
+    if (!root->is_leaf && root->n == 0) {  // The last two children merged
+        tree->root = root->inner.children[0];
+        tree->height--;
+        free(root);
+    } else if (root->is_leaf && root->n == 0) {
+        tree->root = NULL;
+        free(root);
+    }
+}
+
+/* Print the keys of a node between brackets. */
+static void btree_print_node(const btree_node_t* node) {
+    const int* keys = node->is_leaf ? node->leaf.keys : node->inner.keys;
+    printf("%s", "[");
+    for (int i = 0; i < node->n; i++)
+        printf((i == 0) ? "%d" : " %d", keys[i]);
+    printf("%s", "] ");
+}
+
+/* Print every node of the subtree before (preorder) or after (postorder) its children. */
+static void btree_traverse_subtree(const btree_node_t* node, bool preorder) {
+    if (preorder)
+        btree_print_node(node);
+    if (!node->is_leaf)
+        for (int i = 0; i <= node->n; i++)
+            btree_traverse_subtree(node->inner.children[i], preorder);
+    if (!preorder)
+        btree_print_node(node);
+}
+
+/* Traverse the tree using a specific order. PREORDER and POSTORDER print the
+nodes, INORDER prints the keys in increasing order by walking the leaves. */
+void btree_traverse(btree_t* tree, TRAVERSE_ORDER order) {
+    if (!tree) {
+        puts("The tree does not exist.");
+    } else if (!tree->root) {
+        puts("The tree is empty.");
+    } else if (order == INORDER) {
+        btree_iter_t it;
+        for (btree_iter_first(&it, tree); btree_iter_valid(&it); btree_iter_next(&it))
+            printf("%d ", btree_iter_key(&it));
+    } else {
+        btree_traverse_subtree(tree->root, order == PREORDER);
+    }
+}
+
+static void btree_free_subtree(btree_node_t* node) {
+    if (!node->is_leaf)
+        for (int i = 0; i <= node->n; i++)
+            btree_free_subtree(node->inner.children[i]);
+    free(node);
+}
+
+/* Free all nodes in the tree. */
+void btree_free_tree(btree_t* tree) {
+    if (!tree) {
+        puts("The tree does not exist.");
+    } else {
+        if (tree->root)
+            btree_free_subtree(tree->root);
+        tree->root = NULL;
+        tree->len = 0;
+        tree->height = 0;
+    }
+}
+
+/**
+Iterators. An iterator is a leaf and a position in it. Moving to the next key
+stays in the same leaf 55 times out of 56; at the end of a leaf it follows the
+link to the next one, so a scan of k keys costs O(log n + k) with k / 56 misses.
+*/
+
+/* Place the iterator on the minimum key. */
+void btree_iter_first(btree_iter_t* it, btree_t* tree) {
+    btree_node_t* node = tree->root;
+    while (node && !node->is_leaf)
+        node = node->inner.children[0];
+    it->leaf = node;
+    it->pos = 0;
+}
+
+/* Place the iterator on the maximum key. */
+void btree_iter_last(btree_iter_t* it, btree_t* tree) {
+    btree_node_t* node = tree->root;
+    while (node && !node->is_leaf)
+        node = node->inner.children[node->n];
+    it->leaf = node;
+    it->pos = (node) ? node->n - 1 : 0;
+}
+
+/* Place the iterator on the first key >= key, or past the end. */
+void btree_iter_lower_bound(btree_iter_t* it, btree_t* tree, int key) {
+    it->pos = 0;
+    it->leaf = btree_find_leaf(tree, key, false, &it->pos);
+}
+
+/* Place the iterator on the first key > key, or past the end. */
+void btree_iter_upper_bound(btree_iter_t* it, btree_t* tree, int key) {
+    it->pos = 0;
+    it->leaf = btree_find_leaf(tree, key, true, &it->pos);
+}
+
+bool btree_iter_valid(btree_iter_t* it) {
+    return it->leaf != NULL;
+}
+
+/* Return the key under a valid iterator. */
+int btree_iter_key(btree_iter_t* it) {
+    return it->leaf->leaf.keys[it->pos];
+}
+
+/* Move a valid iterator to the next key. */
+void btree_iter_next(btree_iter_t* it) {
+    if (++it->pos == it->leaf->n) {
+        it->leaf = it->leaf->leaf.next;
+        it->pos = 0;
+    }
+}
+
+/* Move a valid iterator to the previous key. */
+void btree_iter_prev(btree_iter_t* it) {
+    if (it->pos > 0) {
+        it->pos--;
+    } else {
+        it->leaf = it->leaf->leaf.prev;
+        it->pos = (it->leaf) ? it->leaf->n - 1 : 0;
+    }
+}
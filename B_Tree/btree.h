@@ -0,0 +1,123 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BTREE_NODE_SIZE 256   // Four cache lines
+#define BTREE_LEAF_KEYS 56
+#define BTREE_INNER_KEYS 20   // 21 children
+#define BTREE_LEAF_MIN (BTREE_LEAF_KEYS / 2)    // Fewest keys of a leaf other than the root
+#define BTREE_INNER_MIN (BTREE_INNER_KEYS / 2)  // Fewest keys of an inner node other than the root
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
+#ifndef TRAVERSE_ORDER_DEFINED  // Shared with red_black_tree.h
+#define TRAVERSE_ORDER_DEFINED
+typedef enum {
+    PREORDER, INORDER, POSTORDER
+} TRAVERSE_ORDER;
+#endif
+
+/* Node of a B+ tree. The keys are stored in the leaves, which are linked in key
+order; inner nodes only hold separators. The children of an inner node satisfy
+keys[i - 1] <= every key in children[i] <= keys[i], so duplicates of a separator
+can be on both sides of it. Unused key slots hold INT_MAX: the in-node search
+compares whole groups of four slots and must not count them as smaller keys. */
+typedef struct btree_node {
+    int n;        // Number of keys
+    int is_leaf;
+    union {
+        struct {
+            struct btree_node *prev, *next;
+            int keys[BTREE_LEAF_KEYS];
+        } leaf;
+        struct {
+            int keys[BTREE_INNER_KEYS];
+            struct btree_node* children[BTREE_INNER_KEYS + 1];
+        } inner;
+    };
+} btree_node_t;
+
+_Static_assert(sizeof(btree_node_t) == BTREE_NODE_SIZE, "a node must fill its cache lines exactly");
+_Static_assert(BTREE_LEAF_KEYS % 4 == 0 && BTREE_INNER_KEYS % 4 == 0, "the in-node search reads groups of four keys");
+
+/* Multiset of keys with the operations of rbt_t. All the leaves are at depth
+`height`, and the root is NULL when the tree is empty. */
+typedef struct btree {
+    btree_node_t* root;
+    size_t len;
+    int height;  // Number of inner levels above the leaves
+} btree_t;
+
+/* Bidirectional cursor. `leaf` is NULL once the iterator moves past either end. */
+typedef struct btree_iter {
+    btree_node_t* leaf;
+    int pos;
+} btree_iter_t;
+
+btree_t* btree_create(void);
+bool btree_is_empty(btree_t* tree);
+size_t btree_len(btree_t* tree);
+static btree_node_t* btree_create_node(bool is_leaf);
+static int btree_rank(const int* keys, int n, int key, bool inclusive);
+static void btree_prefetch(const btree_node_t* node);
+
+static btree_node_t* btree_split_leaf(btree_node_t* node, int pos, int key, int* separator);
+static btree_node_t* btree_split_inner(btree_node_t* node, int pos, int key, btree_node_t* child, int* separator);
+static btree_node_t* btree_insert_subtree(btree_node_t* node, int key, int* separator);
+void btree_insert(btree_t* tree, int key);
+
+static btree_node_t* btree_find_leaf(btree_t* tree, int key, bool inclusive, int* pos);
+bool btree_is_key_in(btree_t* tree, int key);
+
+static void btree_borrow_left(btree_node_t* parent, int i);
+static void btree_borrow_right(btree_node_t* parent, int i);
+static void btree_merge(btree_node_t* parent, int i);
+static void btree_fix_child(btree_node_t* parent, int i);
+static bool btree_delete_subtree(btree_node_t* node, int key);
+void btree_delete(btree_t* tree, int key);
+
+static void btree_print_node(const btree_node_t* node);
+static void btree_traverse_subtree(const btree_node_t* node, bool preorder);
+void btree_traverse(btree_t* tree, TRAVERSE_ORDER order);
+
+static void btree_free_subtree(btree_node_t* node);
+void btree_free_tree(btree_t* tree);
+
+/* Iterators. */
+void btree_iter_first(btree_iter_t* it, btree_t* tree);
+void btree_iter_last(btree_iter_t* it, btree_t* tree);
+void btree_iter_lower_bound(btree_iter_t* it, btree_t* tree, int key);
+void btree_iter_upper_bound(btree_iter_t* it, btree_t* tree, int key);
+bool btree_iter_valid(btree_iter_t* it);
+int btree_iter_key(btree_iter_t* it);
+void btree_iter_next(btree_iter_t* it);
+void btree_iter_prev(btree_iter_t* it);
+
+/* Compile a program written against red_black_tree.h with -DBTREE_AS_RBT and
+include this header instead to run it on the B+ tree. Only the operations both
+engines provide are mapped; the order statistics, the set operations and the
+node-level functions of rbt_t have no B+ tree counterpart. */
+#ifdef BTREE_AS_RBT
+#define rbt_t btree_t
+#define rbt_iter_t btree_iter_t
+#define rbt_create btree_create
+#define rbt_is_empty btree_is_empty
+#define rbt_insert btree_insert
+#define rbt_is_key_in btree_is_key_in
+#define rbt_delete btree_delete
+#define rbt_traverse btree_traverse
+#define rbt_free_tree btree_free_tree
+#define rbt_iter_first btree_iter_first
+#define rbt_iter_last btree_iter_last
+#define rbt_iter_lower_bound btree_iter_lower_bound
+#define rbt_iter_upper_bound btree_iter_upper_bound
+#define rbt_iter_valid btree_iter_valid
+#define rbt_iter_key btree_iter_key
+#define rbt_iter_next btree_iter_next
+#define rbt_iter_prev btree_iter_prev
+#endif
+
+#endif
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "btree.h"
+#include "../Red_Black_Tree/red_black_tree.h"
+
+#define RANDOM_OPS 300000
+#define KEY_RANGE 5000
+#define BIG_SIZE 4000000
+#define SCAN_LEN 1000
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+/* Check the subtree: sorted keys within [lo, hi], INT_MAX in the unused slots,
+enough keys in every node but the root, and all the leaves at the same depth.
+The leaves are appended in order to *leaves. Return false on any violation. */
+bool check_subtree(btree_node_t* node, long lo, long hi, int depth, bool root, btree_node_t*** leaves) {
+    const int* keys = node->is_leaf ? node->leaf.keys : node->inner.keys;
+    int slots = node->is_leaf ? BTREE_LEAF_KEYS : BTREE_INNER_KEYS;
+    int min = node->is_leaf ? BTREE_LEAF_MIN : BTREE_INNER_MIN;
+
+    if (node->n > slots || (!root && node->n < min) || (node->is_leaf != (depth == 0)))
+        return false;
+    for (int i = 0; i < slots; i++) {
+        if (i >= node->n && keys[i] != INT_MAX)
+            return false;
+        if (i < node->n && (keys[i] < lo || keys[i] > hi || (i > 0 && keys[i] < keys[i - 1])))
+            return false;
+    }
+    if (node->is_leaf) {
+        *(*leaves)++ = node;
+        return true;
+    }
+    for (int i = 0; i <= node->n; i++) {
+        long child_lo = (i == 0) ? lo : keys[i - 1];
+        long child_hi = (i == node->n) ? hi : keys[i];
+        if (!check_subtree(node->inner.children[i], child_lo, child_hi, depth - 1, false, leaves))
+            return false;
+    }
+    return true;
+}
+
+/* Check the whole tree, including the links between the leaves. */
+bool check_btree(btree_t* tree) {
+    if (!tree->root)
+        return tree->len == 0 && tree->height == 0;
+    btree_node_t** leaves = malloc((tree->len / BTREE_LEAF_MIN + 2) * sizeof(btree_node_t*));
+    btree_node_t** end = leaves;
+    bool ok = check_subtree(tree->root, LONG_MIN, LONG_MAX, tree->height, true, &end);
+    size_t n_leaves = end - leaves, len = 0;
+    for (size_t i = 0; i < n_leaves && ok; i++) {
+        ok = leaves[i]->leaf.prev == ((i > 0) ? leaves[i - 1] : NULL) &&
+             leaves[i]->leaf.next == ((i + 1 < n_leaves) ? leaves[i + 1] : NULL);
+        len += leaves[i]->n;
+    }
+    free(leaves);
+    return ok && len == tree->len;
+}
+
+int cmp(const void* p, const void* q) {
+    int a = *(const int*) p, b = *(const int*) q;
+    return (a > b) - (a < b);
+}
+
+double seconds_since(clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main() {
+    test_function("btree_insert");
+    printf("Node size: %zu bytes, %d keys per leaf, %d children per inner node\n",
+           sizeof(btree_node_t), BTREE_LEAF_KEYS, BTREE_INNER_KEYS + 1);
+    btree_t* tree = btree_create();
+    for (int i = 0; i < 200; i++)
+        btree_insert(tree, (i * 37) % 100);  // Every key twice
+    printf("Insert 0..99 twice in scrambled order. Keys: %zu, height: %d, valid: %s\n",
+           btree_len(tree), tree->height, check_btree(tree) ? "true" : "false");
+    printf("%s", "Preorder: ");
+    btree_traverse(tree, PREORDER);
+    printf("\n50 is in the tree: %s, 100 is in the tree: %s\n\n",
+           btree_is_key_in(tree, 50) ? "true" : "false", btree_is_key_in(tree, 100) ? "true" : "false");
+
+    test_function("btree_delete");
+    for (int i = 0; i < 100; i += 2)
+        btree_delete(tree, i);
+    btree_delete(tree, 1000);
+    printf("%s", "After deleting one copy of each even key: ");
+    btree_traverse(tree, INORDER);
+    printf("\nKeys: %zu, valid: %s\n\n", btree_len(tree), check_btree(tree) ? "true" : "false");
+    btree_free_tree(tree);
+
+    test_function("Random insertions and deletions");
+    int* counts = calloc(KEY_RANGE, sizeof(int));
+    bool ok = true;
+    srand(1);
+    for (int i = 0; i < RANDOM_OPS && ok; i++) {  // Duplicates included
+        int key = rand() % KEY_RANGE;
+        if (rand() % 5 < 3 || !counts[key]) {
+            btree_insert(tree, key);
+            counts[key]++;
+        } else {
+            btree_delete(tree, key);
+            counts[key]--;
+        }
+        if (i % 10000 == 0)
+            ok = check_btree(tree);
+    }
+    btree_iter_t it;
+    btree_iter_first(&it, tree);
+    for (int key = 0; key < KEY_RANGE && ok; key++)
+        for (int c = 0; c < counts[key] && ok; c++, btree_iter_next(&it))
+            ok = btree_iter_valid(&it) && btree_iter_key(&it) == key;
+    ok = ok && !btree_iter_valid(&it) && check_btree(tree);
+    printf("Keys: %zu, height: %d\n", btree_len(tree), tree->height);
+    printf("B+ tree properties hold and the keys agree with a reference count: %s\n", ok ? "true" : "false");
+
+    // Every key with a count goes; the tree must shrink back to nothing.
+    for (int key = 0; key < KEY_RANGE; key++)
+        while (counts[key]-- > 0)
+            btree_delete(tree, key);
+    printf("After deleting everything: empty: %s, valid: %s\n\n",
+           btree_is_empty(tree) ? "true" : "false", check_btree(tree) ? "true" : "false");
+    free(counts);
+
+    test_function("Iterators");
+    for (int i = 0; i < 1000; i++)
+        btree_insert(tree, 2 * (i % 500));  // Even keys 0..998, twice each
+    btree_iter_lower_bound(&it, tree, 501);
+    printf("Lower bound of 501: %d", btree_iter_key(&it));
+    btree_iter_upper_bound(&it, tree, 500);
+    printf(", upper bound of 500: %d", btree_iter_key(&it));
+    btree_iter_prev(&it);
+    btree_iter_prev(&it);
+    printf(", two steps back: %d", btree_iter_key(&it));
+    btree_iter_upper_bound(&it, tree, 998);
+    printf(", upper bound of 998 is past the end: %s\n", btree_iter_valid(&it) ? "false" : "true");
+    btree_iter_last(&it, tree);
+    int steps = 0;
+    for (; btree_iter_valid(&it); btree_iter_prev(&it))
+        steps++;
+    printf("Backward walk from the last key: %d keys\n\n", steps);
+    btree_free_tree(tree);
+    free(tree);
+
+    test_function("B+ tree against red-black tree");
+    int* keys = malloc(BIG_SIZE * sizeof(int));
+    for (int i = 0; i < BIG_SIZE; i++)
+        keys[i] = (int) ((unsigned) i * 2654435761u);  // Distinct and scattered
+    int* probes = malloc(BIG_SIZE * sizeof(int));
+    for (int i = 0; i < BIG_SIZE; i++)
+        probes[i] = keys[rand() % BIG_SIZE];
+
+    clock_t start = clock();
+    tree = btree_create();
+    for (int i = 0; i < BIG_SIZE; i++)
+        btree_insert(tree, keys[i]);
+    double b_insert = seconds_since(start);
+    rbt_t* rbt = rbt_create();
+    start = clock();
+    for (int i = 0; i < BIG_SIZE; i++)
+        rbt_insert(rbt, keys[i]);
+    double r_insert = seconds_since(start);
+
+    size_t b_hits = 0, r_hits = 0;
+    start = clock();
+    for (int i = 0; i < BIG_SIZE; i++)
+        b_hits += btree_is_key_in(tree, probes[i]);
+    double b_search = seconds_since(start);
+    start = clock();
+    for (int i = 0; i < BIG_SIZE; i++)
+        r_hits += rbt_is_key_in(rbt, probes[i]);
+    double r_search = seconds_since(start);
+
+    long long b_sum = 0, r_sum = 0;
+    start = clock();
+    for (int i = 0; i < BIG_SIZE / SCAN_LEN; i++) {
+        btree_iter_lower_bound(&it, tree, probes[i]);
+        for (int j = 0; j < SCAN_LEN && btree_iter_valid(&it); j++, btree_iter_next(&it))
+            b_sum += btree_iter_key(&it);
+    }
+    double b_scan = seconds_since(start);
+    rbt_iter_t rit;
+    start = clock();
+    for (int i = 0; i < BIG_SIZE / SCAN_LEN; i++) {
+        rbt_iter_lower_bound(&rit, rbt, probes[i]);
+        for (int j = 0; j < SCAN_LEN && rbt_iter_valid(&rit); j++, rbt_iter_next(&rit))
+            r_sum += rbt_iter_key(&rit);
+    }
+    double r_scan = seconds_since(start);
+
+    printf("%d keys, height %d. Same results: %s\n", BIG_SIZE, tree->height,
+           (b_hits == r_hits && b_hits == BIG_SIZE && b_sum == r_sum) ? "true" : "false");
+    printf("%-26s %10s %10s %8s\n", "", "B+ tree", "RB tree", "speedup");
+    printf("%-26s %9.3fs %9.3fs %7.1fx\n", "Insertions", b_insert, r_insert, r_insert / b_insert);
+    printf("%-26s %9.3fs %9.3fs %7.1fx\n", "Lookups", b_search, r_search, r_search / b_search);
+    printf("%-26s %9.3fs %9.3fs %7.1fx\n", "Scans of 1000 keys", b_scan, r_scan, r_scan / b_scan);
+
+    btree_free_tree(tree);
+    free(tree);
+    rbt_free_tree(rbt);
+    free(rbt);
+    free(keys);
+    free(probes);
+    return 0;
+}
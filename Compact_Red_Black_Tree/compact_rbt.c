@@ -0,0 +1,372 @@
+/*
+* This is a red-black tree for very large ordered sets. Instead of allocating
+* every node with malloc and linking it with 8-byte pointers (see
+* Red_Black_Tree/), the nodes live in one arena and link to each other with
+* 32-bit indices, so a node takes 16 bytes and four nodes share a cache line.
+* There is no per-node malloc header either. The algorithms are the ones of
+* CLRS, with index 0 playing the role of the black sentinel T.nil. Deletion
+* moves the successor node instead of copying its key, so the index of a node
+* holds the same key for as long as the key is in the tree.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "compact_rbt.h"
+
+static inline uint32_t crbt_parent(const crbt_t* tree, uint32_t i) {
+    return tree->nodes[i].parent_color >> 1;
+}
+
+static inline CRBT_COLOR crbt_color(const crbt_t* tree, uint32_t i) {
+    return (CRBT_COLOR) (tree->nodes[i].parent_color & 1);
+}
+
+static inline void crbt_set_parent(crbt_t* tree, uint32_t i, uint32_t parent) {
+    tree->nodes[i].parent_color = parent << 1 | (tree->nodes[i].parent_color & 1);
+}
+
+static inline void crbt_set_color(crbt_t* tree, uint32_t i, CRBT_COLOR color) {
+    tree->nodes[i].parent_color = (tree->nodes[i].parent_color & ~1u) | color;
+}
+
+/* Allocate a tree able to store `capacity` keys before growing its arena. */
+crbt_t* crbt_create(size_t capacity) {
+    crbt_t* tree = malloc(sizeof(crbt_t));
+    assert(tree);
+
+    if (capacity < CRBT_MIN_CAPACITY)
+        capacity = CRBT_MIN_CAPACITY;
+    if (capacity >= CRBT_MAX_NODES)
+        capacity = CRBT_MAX_NODES - 1;
+
+    tree->cap = capacity + 1;  // One more slot for the sentinel
+    tree->nodes = malloc(tree->cap * sizeof(crbt_node_t));
+    assert(tree->nodes);
+    tree->nodes[CRBT_NIL] = (crbt_node_t) {0, CRBT_NIL, CRBT_NIL, CRBT_NIL << 1 | CRBT_BLACK};
+    tree->root = CRBT_NIL;
+    tree->len = 0;
+    tree->used = 1;
+    tree->free_list = CRBT_NIL;
+    return tree;
+}
+
+/* Free the arena and the tree. */
+void crbt_free(crbt_t* tree) {
+    if (!tree)
+        return;
+    free(tree->nodes);
+    free(tree);
+}
+
+/* Return true if the tree does not contain any key, otherwise return false. */
+bool crbt_is_empty(crbt_t* tree) {
+    return tree->root == CRBT_NIL;
+}
+
+/* Return the number of keys. */
+size_t crbt_len(crbt_t* tree) {
+    return tree->len;
+}
+
+/* Return a free slot, reusing released slots first. The arena may move. */
+static uint32_t crbt_alloc(crbt_t* tree) {
+    uint32_t i = tree->free_list;
+    if (i != CRBT_NIL) {
+        tree->free_list = tree->nodes[i].left;
+        return i;
+    }
+
+    if (tree->used == tree->cap) {
+        if (tree->cap == CRBT_MAX_NODES) {
+            puts("Too many keys for a compact red-black tree.");
+            exit(EXIT_FAILURE);
+        }
+        uint32_t cap = (tree->cap > CRBT_MAX_NODES / 2) ? CRBT_MAX_NODES : 2 * tree->cap;
+        crbt_node_t* nodes = realloc(tree->nodes, (size_t) cap * sizeof(crbt_node_t));
+        assert(nodes);
+        tree->nodes = nodes;
+        tree->cap = cap;
+    }
+    return tree->used++;
+}
+
+/* Put a slot on the free list. */
+static void crbt_release(crbt_t* tree, uint32_t i) {
+    tree->nodes[i].left = tree->free_list;
+    tree->free_list = i;
+}
+
+/* Rotate the subtree rooted in x to the left, around the link to its right child. */
+static void crbt_left_rotate(crbt_t* tree, uint32_t x) {
+    crbt_node_t* nodes = tree->nodes;
+    uint32_t y = nodes[x].right;
+    uint32_t parent = crbt_parent(tree, x);
+
+    nodes[x].right = nodes[y].left;
+    if (nodes[y].left != CRBT_NIL)
+        crbt_set_parent(tree, nodes[y].left, x);
+    crbt_set_parent(tree, y, parent);
+    if (parent == CRBT_NIL)
+        tree->root = y;
+    else if (nodes[parent].left == x)
+        nodes[parent].left = y;
+    else
+        nodes[parent].right = y;
+    nodes[y].left = x;
+    crbt_set_parent(tree, x, y);
+}
+
+/* Rotate the subtree rooted in x to the right, around the link to its left child. */
+static void crbt_right_rotate(crbt_t* tree, uint32_t x) {
+    crbt_node_t* nodes = tree->nodes;
+    uint32_t y = nodes[x].left;
+    uint32_t parent = crbt_parent(tree, x);
+
+    nodes[x].left = nodes[y].right;
+    if (nodes[y].right != CRBT_NIL)
+        crbt_set_parent(tree, nodes[y].right, x);
+    crbt_set_parent(tree, y, parent);
+    if (parent == CRBT_NIL)
+        tree->root = y;
+    else if (nodes[parent].right == x)
+        nodes[parent].right = y;
+    else
+        nodes[parent].left = y;
+    nodes[y].right = x;
+    crbt_set_parent(tree, x, y);
+}
+
+/* Restore the red-black properties after inserting the red node z. */
+static void crbt_insert_fixup(crbt_t* tree, uint32_t z) {
+    crbt_node_t* nodes = tree->nodes;
+
+    while (crbt_color(tree, crbt_parent(tree, z)) == CRBT_RED) {
+        uint32_t parent = crbt_parent(tree, z);
+        uint32_t grandpa = crbt_parent(tree, parent);
+
+        if (parent == nodes[grandpa].left) {
+            uint32_t uncle = nodes[grandpa].right;
+            if (crbt_color(tree, uncle) == CRBT_RED) {
+                crbt_set_color(tree, parent, CRBT_BLACK);
+                crbt_set_color(tree, uncle, CRBT_BLACK);
+                crbt_set_color(tree, grandpa, CRBT_RED);
+                z = grandpa;
+            } else {
+                if (z == nodes[parent].right) {
+                    z = parent;
+                    crbt_left_rotate(tree, z);
+                    parent = crbt_parent(tree, z);
+                }
+                crbt_set_color(tree, parent, CRBT_BLACK);
+                crbt_set_color(tree, grandpa, CRBT_RED);
+                crbt_right_rotate(tree, grandpa);
+            }
+        } else {
+            uint32_t uncle = nodes[grandpa].left;
+            if (crbt_color(tree, uncle) == CRBT_RED) {
+                crbt_set_color(tree, parent, CRBT_BLACK);
+                crbt_set_color(tree, uncle, CRBT_BLACK);
+                crbt_set_color(tree, grandpa, CRBT_RED);
+                z = grandpa;
+            } else {
+                if (z == nodes[parent].left) {
+                    z = parent;
+                    crbt_right_rotate(tree, z);
+                    parent = crbt_parent(tree, z);
+                }
+                crbt_set_color(tree, parent, CRBT_BLACK);
+                crbt_set_color(tree, grandpa, CRBT_RED);
+                crbt_left_rotate(tree, grandpa);
+            }
+        }
+    }
+    crbt_set_color(tree, tree->root, CRBT_BLACK);
+}
+
+/* Insert a new key in the tree. Equal keys are allowed. */
+void crbt_insert(crbt_t* tree, int key) {
+    uint32_t z = crbt_alloc(tree);  // First, since the arena may move
+    crbt_node_t* nodes = tree->nodes;
+    uint32_t parent = CRBT_NIL, curr = tree->root;
+
+    while (curr != CRBT_NIL) {
+        parent = curr;
+        curr = (nodes[curr].key > key) ? nodes[curr].left : nodes[curr].right;
+    }
+
+    nodes[z] = (crbt_node_t) {key, CRBT_NIL, CRBT_NIL, parent << 1 | CRBT_RED};
+    if (parent == CRBT_NIL)
+        tree->root = z;
+    else if (nodes[parent].key > key)
+        nodes[parent].left = z;
+    else
+        nodes[parent].right = z;
+
+    tree->len++;
+    crbt_insert_fixup(tree, z);
+}
+
+/* Return the index of a node storing the key, or CRBT_NIL. */
+static uint32_t crbt_search(crbt_t* tree, int key) {
+    crbt_node_t* nodes = tree->nodes;
+    uint32_t curr = tree->root;
+
+    while (curr != CRBT_NIL && nodes[curr].key != key)
+        curr = (nodes[curr].key > key) ? nodes[curr].left : nodes[curr].right;
+    return curr;
+}
+
+/* Return true if the key is in the tree, else false. */
+bool crbt_is_key_in(crbt_t* tree, int key) {
+    return crbt_search(tree, key) != CRBT_NIL;
+}
+
+/* Return the index of the minimum of the subtree rooted in i. */
+static uint32_t crbt_minimum(crbt_t* tree, uint32_t i) {
+    while (tree->nodes[i].left != CRBT_NIL)
+        i = tree->nodes[i].left;
+    return i;
+}
+
+/* Replace the subtree rooted in u with the subtree rooted in v. The parent of
+the sentinel may be set here: the delete fixup reads it when v is CRBT_NIL. */
+static void crbt_transplant(crbt_t* tree, uint32_t u, uint32_t v) {
+    uint32_t parent = crbt_parent(tree, u);
+
+    if (parent == CRBT_NIL)
+        tree->root = v;
+    else if (tree->nodes[parent].left == u)
+        tree->nodes[parent].left = v;
+    else
+        tree->nodes[parent].right = v;
+    crbt_set_parent(tree, v, parent);
+}
+
+/* Restore the red-black properties when the removed node was black. */
+static void crbt_delete_fixup(crbt_t* tree, uint32_t x) {
+    crbt_node_t* nodes = tree->nodes;
+
+    while (x != tree->root && crbt_color(tree, x) == CRBT_BLACK) {
+        uint32_t parent = crbt_parent(tree, x);
+
+        if (x == nodes[parent].left) {
+            uint32_t sibling = nodes[parent].right;
+            if (crbt_color(tree, sibling) == CRBT_RED) {  // Case 1
+                crbt_set_color(tree, sibling, CRBT_BLACK);
+                crbt_set_color(tree, parent, CRBT_RED);
+                crbt_left_rotate(tree, parent);
+                sibling = nodes[parent].right;
+            }
+            if (crbt_color(tree, nodes[sibling].left) == CRBT_BLACK &&
+                crbt_color(tree, nodes[sibling].right) == CRBT_BLACK) {  // Case 2
+                crbt_set_color(tree, sibling, CRBT_RED);
+                x = parent;
+            } else {
+                if (crbt_color(tree, nodes[sibling].right) == CRBT_BLACK) {  // Case 3
+                    crbt_set_color(tree, nodes[sibling].left, CRBT_BLACK);
+                    crbt_set_color(tree, sibling, CRBT_RED);
+                    crbt_right_rotate(tree, sibling);
+                    sibling = nodes[parent].right;
+                }
+                crbt_set_color(tree, sibling, crbt_color(tree, parent));  // Case 4
+                crbt_set_color(tree, parent, CRBT_BLACK);
+                crbt_set_color(tree, nodes[sibling].right, CRBT_BLACK);
+                crbt_left_rotate(tree, parent);
+                x = tree->root;
+            }
+        } else {
+            uint32_t sibling = nodes[parent].left;
+            if (crbt_color(tree, sibling) == CRBT_RED) {  // Case 1
+                crbt_set_color(tree, sibling, CRBT_BLACK);
+                crbt_set_color(tree, parent, CRBT_RED);
+                crbt_right_rotate(tree, parent);
+                sibling = nodes[parent].left;
+            }
+            if (crbt_color(tree, nodes[sibling].left) == CRBT_BLACK &&
+                crbt_color(tree, nodes[sibling].right) == CRBT_BLACK) {  // Case 2
+                crbt_set_color(tree, sibling, CRBT_RED);
+                x = parent;
+            } else {
+                if (crbt_color(tree, nodes[sibling].left) == CRBT_BLACK) {  // Case 3
+                    crbt_set_color(tree, nodes[sibling].right, CRBT_BLACK);
+                    crbt_set_color(tree, sibling, CRBT_RED);
+                    crbt_left_rotate(tree, sibling);
+                    sibling = nodes[parent].left;
+                }
+                crbt_set_color(tree, sibling, crbt_color(tree, parent));  // Case 4
+                crbt_set_color(tree, parent, CRBT_BLACK);
+                crbt_set_color(tree, nodes[sibling].left, CRBT_BLACK);
+                crbt_right_rotate(tree, parent);
+                x = tree->root;
+            }
+        }
+    }
+    crbt_set_color(tree, x, CRBT_BLACK);
+}
+
+/* Search for the key in the tree and, if present, remove it. */
+void crbt_delete(crbt_t* tree, int key) {
+    crbt_node_t* nodes = tree->nodes;
+    uint32_t z = crbt_search(tree, key);
+    uint32_t x, y;
+
+    if (z == CRBT_NIL) {
+        printf("Key %d was not found.\n", key);
+        return;
+    }
+
+    CRBT_COLOR removed_color = crbt_color(tree, z);
+    if (nodes[z].left == CRBT_NIL) {
+        x = nodes[z].right;
+        crbt_transplant(tree, z, x);
+    } else if (nodes[z].right == CRBT_NIL) {
+        x = nodes[z].left;
+        crbt_transplant(tree, z, x);
+    } else {
+        // The successor y takes the place and the color of z.
+        y = crbt_minimum(tree, nodes[z].right);
+        removed_color = crbt_color(tree, y);
+        x = nodes[y].right;
+        if (crbt_parent(tree, y) == z) {
+            crbt_set_parent(tree, x, y);
+        } else {
+            crbt_transplant(tree, y, x);
+            nodes[y].right = nodes[z].right;
+            crbt_set_parent(tree, nodes[y].right, y);
+        }
+        crbt_transplant(tree, z, y);
+        nodes[y].left = nodes[z].left;
+        crbt_set_parent(tree, nodes[y].left, y);
+        crbt_set_color(tree, y, crbt_color(tree, z));
+    }
+
+    crbt_release(tree, z);
+    tree->len--;
+    if (removed_color == CRBT_BLACK)
+        crbt_delete_fixup(tree, x);
+}
+
+/* Call fn on every key in non-decreasing order. The walk follows the parent
+links, so it needs neither recursion nor a stack. */
+void crbt_for_each(crbt_t* tree, void (*fn)(int key, void* ctx), void* ctx) {
+    crbt_node_t* nodes = tree->nodes;
+    if (tree->root == CRBT_NIL)
+        return;
+
+    uint32_t curr = crbt_minimum(tree, tree->root);
+    while (curr != CRBT_NIL) {
+        fn(nodes[curr].key, ctx);
+        if (nodes[curr].right != CRBT_NIL) {
+            curr = crbt_minimum(tree, nodes[curr].right);
+        } else {
+            uint32_t parent = crbt_parent(tree, curr);
+            while (parent != CRBT_NIL && nodes[parent].right == curr) {
+                curr = parent;
+                parent = crbt_parent(tree, curr);
+            }
+            curr = parent;
+        }
+    }
+}
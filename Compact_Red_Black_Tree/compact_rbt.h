@@ -0,0 +1,58 @@
+#ifndef COMPACT_RBT_H
+#define COMPACT_RBT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRBT_NIL 0  // Index of the sentinel: every missing child or parent links to it
+#define CRBT_MIN_CAPACITY 16
+#define CRBT_MAX_NODES ((uint32_t) 1 << 31)  // The parent index must fit in 31 bits
+
+typedef enum {
+    CRBT_RED, CRBT_BLACK
+} CRBT_COLOR;
+
+/* 16 bytes: the links are 32-bit indices into the arena of the tree and the
+color is packed into bit 0 of the parent index. */
+typedef struct crbt_node {
+    int key;
+    uint32_t left, right;
+    uint32_t parent_color;  // parent << 1 | color
+} crbt_node_t;
+
+/* Red-black tree whose nodes live in a single growable arena. Indices stay valid
+when the arena is reallocated, and slots of deleted nodes are reused through a
+free list linked by `left`. nodes[0] is the black sentinel of CLRS. */
+typedef struct compact_red_black_tree {
+    crbt_node_t* nodes;
+    uint32_t root;
+    uint32_t len;        // Number of keys
+    uint32_t used;       // Slots handed out so far, sentinel included
+    uint32_t cap;
+    uint32_t free_list;
+} crbt_t;
+
+static inline uint32_t crbt_parent(const crbt_t* tree, uint32_t i);
+static inline CRBT_COLOR crbt_color(const crbt_t* tree, uint32_t i);
+static inline void crbt_set_parent(crbt_t* tree, uint32_t i, uint32_t parent);
+static inline void crbt_set_color(crbt_t* tree, uint32_t i, CRBT_COLOR color);
+crbt_t* crbt_create(size_t capacity);
+void crbt_free(crbt_t* tree);
+bool crbt_is_empty(crbt_t* tree);
+size_t crbt_len(crbt_t* tree);
+static uint32_t crbt_alloc(crbt_t* tree);
+static void crbt_release(crbt_t* tree, uint32_t i);
+static void crbt_left_rotate(crbt_t* tree, uint32_t x);
+static void crbt_right_rotate(crbt_t* tree, uint32_t x);
+static void crbt_insert_fixup(crbt_t* tree, uint32_t z);
+void crbt_insert(crbt_t* tree, int key);
+static uint32_t crbt_search(crbt_t* tree, int key);
+bool crbt_is_key_in(crbt_t* tree, int key);
+static uint32_t crbt_minimum(crbt_t* tree, uint32_t i);
+static void crbt_transplant(crbt_t* tree, uint32_t u, uint32_t v);
+static void crbt_delete_fixup(crbt_t* tree, uint32_t x);
+void crbt_delete(crbt_t* tree, int key);
+void crbt_for_each(crbt_t* tree, void (*fn)(int key, void* ctx), void* ctx);
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "compact_rbt.h"
+
+#define SIZE 8
+#define RANDOM_OPS 200000
+#define KEY_RANGE 5000
+#define BIG_SIZE 1000000
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+void print_key(int key, void* ctx) {
+    (void) ctx;
+    printf("%d ", key);
+}
+
+/* Append the key to an array of keys; ctx points to the next free slot. */
+void collect_key(int key, void* ctx) {
+    int** next = ctx;
+    *(*next)++ = key;
+}
+
+/* Return the black height of the subtree rooted in i, or -1 if a red-black or
+BST property, or a parent link, is violated. */
+int check_subtree(crbt_t* tree, uint32_t i, long lo, long hi) {
+    if (i == CRBT_NIL)
+        return 0;
+    crbt_node_t* node = &tree->nodes[i];
+    uint32_t left = node->left, right = node->right;
+    bool red = (node->parent_color & 1) == CRBT_RED;
+
+    if (node->key < lo || node->key > hi)
+        return -1;
+    if (left != CRBT_NIL && tree->nodes[left].parent_color >> 1 != i)
+        return -1;
+    if (right != CRBT_NIL && tree->nodes[right].parent_color >> 1 != i)
+        return -1;
+    if (red && ((left != CRBT_NIL && !(tree->nodes[left].parent_color & 1)) ||
+                (right != CRBT_NIL && !(tree->nodes[right].parent_color & 1))))
+        return -1;
+
+    int bh_left = check_subtree(tree, left, lo, node->key);
+    int bh_right = check_subtree(tree, right, node->key, hi);
+    if (bh_left < 0 || bh_left != bh_right)
+        return -1;
+    return bh_left + !red;
+}
+
+int cmp(const void* p, const void* q) {
+    int a = *(const int*) p, b = *(const int*) q;
+    return (a > b) - (a < b);
+}
+
+int main() {
+    int arr[SIZE] = {11, 2, 14, 1, 7, 15, 5, 8};
+
+    test_function("crbt_insert");
+    printf("Node size: %zu bytes\n", sizeof(crbt_node_t));
+    crbt_t* tree = crbt_create(0);
+    for (int i = 0; i < SIZE; i++)
+        crbt_insert(tree, arr[i]);
+    printf("%s", "Insert 11, 2, 14, 1, 7, 15, 5, 8. In order: ");
+    crbt_for_each(tree, print_key, NULL);
+    printf("\nKeys: %zu, root: %d, 5 is in the tree: %s, 6 is in the tree: %s\n\n",
+           crbt_len(tree), tree->nodes[tree->root].key,
+           crbt_is_key_in(tree, 5) ? "true" : "false", crbt_is_key_in(tree, 6) ? "true" : "false");
+
+    test_function("crbt_delete");
+    crbt_delete(tree, 7);  // Black root
+    crbt_delete(tree, 1);
+    crbt_delete(tree, 6);
+    printf("%s", "After deleting 7 and 1: ");
+    crbt_for_each(tree, print_key, NULL);
+    printf("\nThe tree is valid: %s\n\n", check_subtree(tree, tree->root, INT32_MIN, INT32_MAX) >= 0 ? "true" : "false");
+    crbt_free(tree);
+
+    test_function("Random insertions and deletions");
+    int* counts = calloc(KEY_RANGE, sizeof(int));
+    srand(1);
+    tree = crbt_create(0);
+    for (int i = 0; i < RANDOM_OPS; i++) {  // Duplicates included
+        int key = rand() % KEY_RANGE;
+        if (rand() % 3 || !counts[key]) {
+            crbt_insert(tree, key);
+            counts[key]++;
+        } else {
+            crbt_delete(tree, key);
+            counts[key]--;
+        }
+    }
+    int* keys = malloc(crbt_len(tree) * sizeof(int));
+    int* next = keys;
+    crbt_for_each(tree, collect_key, &next);
+    bool ok = check_subtree(tree, tree->root, INT32_MIN, INT32_MAX) >= 0 && next == keys + crbt_len(tree);
+    for (int key = 0, j = 0; key < KEY_RANGE && ok; key++)
+        for (int c = 0; c < counts[key]; c++)
+            ok = ok && keys[j++] == key;
+    printf("Keys: %zu, arena slots: %u\n", crbt_len(tree), tree->used - 1);
+    printf("Red-black properties hold and the keys agree with a reference count: %s\n\n",
+           ok ? "true" : "false");
+    free(keys);
+    free(counts);
+    crbt_free(tree);
+
+    test_function("1M keys");
+    clock_t start = clock();
+    tree = crbt_create(BIG_SIZE);
+    for (int i = 0; i < BIG_SIZE; i++)
+        crbt_insert(tree, (int) ((unsigned) i * 2654435761u));
+    size_t hits = 0;
+    for (int i = 0; i < BIG_SIZE; i++)
+        hits += crbt_is_key_in(tree, (int) ((unsigned) (2 * i) * 2654435761u));
+    printf("%zu hits, %.1f MB of nodes, %.3f s\n", hits,
+           (double) tree->cap * sizeof(crbt_node_t) / (1 << 20),
+           (double) (clock() - start) / CLOCKS_PER_SEC);
+    crbt_free(tree);
+    return 0;
+}
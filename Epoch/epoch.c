@@ -0,0 +1,150 @@
+/*
+* This is epoch-based memory reclamation for the lock-free structures of the
+* repository. A thread that reads shared nodes brackets the reads with
+* `epoch_enter` and `epoch_exit`. A thread that unlinks a node does not free it,
+* but hands it to `epoch_retire` together with the function that frees it; the
+* function is called once no reader can hold a reference to the node anymore.
+* Entering and exiting cost two stores and a fence, and readers never wait.
+* A reader that stays inside a critical section delays reclamation, not the
+* writers.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "epoch.h"
+
+/* Allocate a domain. Threads sharing the same structures use the same domain. */
+epoch_domain_t* epoch_create(void) {
+    epoch_domain_t* domain = aligned_alloc(CACHE_LINE, sizeof(epoch_domain_t));
+    assert(domain);
+
+    atomic_init(&domain->epoch, 0);
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+        epoch_record_t* record = &domain->records[i];
+        atomic_init(&record->epoch, 0);
+        atomic_init(&record->active, false);
+        atomic_init(&record->in_use, false);
+        record->nesting = 0;
+        record->domain = domain;
+        for (int j = 0; j < EPOCH_GENERATIONS; j++) {
+            record->limbo[j] = NULL;
+            record->limbo_epoch[j] = 0;
+        }
+        record->n_retired = 0;
+    }
+    return domain;
+}
+
+/* Reclaim every retired object and free the domain. No thread may be using it. */
+void epoch_destroy(epoch_domain_t* domain) {
+    if (!domain)
+        return;
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++)
+        for (int j = 0; j < EPOCH_GENERATIONS; j++)
+            epoch_free_list(domain->records[i].limbo[j]);
+    free(domain);
+}
+
+/* Claim a record for the calling thread. Exit the program if all are taken. */
+epoch_record_t* epoch_register(epoch_domain_t* domain) {
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&domain->records[i].in_use, &expected, true))
+            return &domain->records[i];
+    }
+    puts("Too many threads registered with the epoch domain.");
+    exit(EXIT_FAILURE);
+}
+
+/* Give the record back. Objects still in its limbo lists are reclaimed by the
+next thread that claims the record, or by epoch_destroy. */
+void epoch_unregister(epoch_record_t* record) {
+    assert(record->nesting == 0);
+    epoch_reclaim(record);
+    atomic_store(&record->in_use, false);
+}
+
+/* Start a critical section. Critical sections can be nested. */
+void epoch_enter(epoch_record_t* record) {
+    if (record->nesting++ > 0)
+        return;
+    atomic_store(&record->active, true);
+    atomic_store(&record->epoch, atomic_load(&record->domain->epoch));
+    atomic_thread_fence(memory_order_seq_cst);  // Announce before reading any node
+}
+
+/* End a critical section: the nodes read inside it must not be used anymore. */
+void epoch_exit(epoch_record_t* record) {
+    assert(record->nesting > 0);
+    if (--record->nesting > 0)
+        return;
+    atomic_store_explicit(&record->active, false, memory_order_release);
+}
+
+/* Move the global epoch forward if every active reader has announced it. */
+static bool epoch_try_advance(epoch_domain_t* domain) {
+    unsigned long epoch = atomic_load(&domain->epoch);
+
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+        epoch_record_t* record = &domain->records[i];
+        if (atomic_load(&record->in_use) && atomic_load(&record->active) &&
+            atomic_load(&record->epoch) != epoch)
+            return false;
+    }
+    return atomic_compare_exchange_strong(&domain->epoch, &epoch, epoch + 1);
+}
+
+static void epoch_free_list(epoch_retired_t* list) {
+    while (list) {
+        epoch_retired_t* next = list->next;
+        list->reclaim(list->ptr);
+        free(list);
+        list = next;
+    }
+}
+
+/* Try to advance the epoch and reclaim the objects of this record that no
+reader can see anymore, i.e. those retired two or more epochs ago. */
+void epoch_reclaim(epoch_record_t* record) {
+    epoch_try_advance(record->domain);
+    unsigned long epoch = atomic_load(&record->domain->epoch);
+
+    for (int i = 0; i < EPOCH_GENERATIONS; i++) {
+        if (record->limbo[i] && record->limbo_epoch[i] + 2 <= epoch) {
+            epoch_free_list(record->limbo[i]);
+            record->limbo[i] = NULL;
+        }
+    }
+}
+
+/* Call reclaim(ptr) once every reader that may hold ptr has left its critical
+section. The object must already be unreachable for new readers. The fence orders
+the unlink before the epoch is read: callers unlink with a release store only
+(prbt_publish, RBT_STORE_LINK in rbtc_delete), which a later load of the epoch
+could otherwise pass. A reader that enters after that epoch then cannot find ptr. */
+void epoch_retire(epoch_record_t* record, void* ptr, void (*reclaim)(void* ptr)) {
+    atomic_thread_fence(memory_order_seq_cst);
+    unsigned long epoch = atomic_load(&record->domain->epoch);
+    int i = epoch % EPOCH_GENERATIONS;
+
+    if (record->limbo_epoch[i] != epoch) {
+        // The list was filled three or more epochs ago: it is safe to reclaim.
+        epoch_free_list(record->limbo[i]);
+        record->limbo[i] = NULL;
+        record->limbo_epoch[i] = epoch;
+    }
+
+    epoch_retired_t* retired = malloc(sizeof(epoch_retired_t));
+    assert(retired);
+    retired->ptr = ptr;
+    retired->reclaim = reclaim;
+    retired->next = record->limbo[i];
+    record->limbo[i] = retired;
+
+    if (++record->n_retired >= EPOCH_RETIRE_BATCH) {
+        record->n_retired = 0;
+        epoch_reclaim(record);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define EPOCH_MAX_THREADS 64   // Records per domain
+#define EPOCH_GENERATIONS 3    // Limbo lists per record: epochs e, e - 1, e - 2
+#define EPOCH_RETIRE_BATCH 64  // Retirements between two attempts to advance the epoch
+#define CACHE_LINE 64
+
+/* An object waiting for the readers that may still see it. */
+typedef struct epoch_retired {
+    void* ptr;
+    void (*reclaim)(void* ptr);
+    struct epoch_retired* next;
+} epoch_retired_t;
+
+/* Per-thread state. `epoch` and `active` are written by the owner thread and
+read by the threads trying to advance the global epoch. The limbo lists are
+private to the owner: limbo[i] holds the objects retired during limbo_epoch[i]. */
+typedef struct epoch_record {
+    _Alignas(CACHE_LINE) _Atomic unsigned long epoch;
+    _Atomic bool active;
+    _Atomic bool in_use;
+    unsigned int nesting;
+    struct epoch_domain* domain;
+    epoch_retired_t* limbo[EPOCH_GENERATIONS];
+    unsigned long limbo_epoch[EPOCH_GENERATIONS];
+    size_t n_retired;  // Since the last attempt to advance
+} epoch_record_t;
+
+/* Epoch-based reclamation (Fraser, "Practical lock-freedom", 2004). Readers
+announce the global epoch when they enter a critical section. The global epoch
+moves from e to e + 1 only when every active reader has announced e, so an
+object retired during epoch e can be reclaimed once the global epoch is e + 2. */
+typedef struct epoch_domain {
+    _Alignas(CACHE_LINE) _Atomic unsigned long epoch;
+    epoch_record_t records[EPOCH_MAX_THREADS];
+} epoch_domain_t;
+
+epoch_domain_t* epoch_create(void);
+void epoch_destroy(epoch_domain_t* domain);
+epoch_record_t* epoch_register(epoch_domain_t* domain);
+void epoch_unregister(epoch_record_t* record);
+void epoch_enter(epoch_record_t* record);
+void epoch_exit(epoch_record_t* record);
+static bool epoch_try_advance(epoch_domain_t* domain);
+static void epoch_free_list(epoch_retired_t* list);
+void epoch_reclaim(epoch_record_t* record);
+void epoch_retire(epoch_record_t* record, void* ptr, void (*reclaim)(void* ptr));
+
+#endif
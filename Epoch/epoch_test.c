@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "epoch.h"
+
+#define READERS 4
+#define UPDATES 1000000
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+static _Atomic long reclaimed;
+
+void count_free(void* ptr) {
+    free(ptr);
+    atomic_fetch_add(&reclaimed, 1);
+}
+
+/* A shared value that a writer replaces while readers dereference it. A value
+freed too early is overwritten by the allocator, or flagged by AddressSanitizer. */
+typedef struct value {
+    long a, b;  // Always a == -b
+} value_t;
+
+typedef struct reader_arg {
+    epoch_domain_t* domain;
+    _Atomic(value_t*)* shared;
+    atomic_bool* done;
+    long reads, errors;
+} reader_arg_t;
+
+void* reader(void* p) {
+    reader_arg_t* arg = p;
+    epoch_record_t* record = epoch_register(arg->domain);
+
+    while (!atomic_load(arg->done)) {
+        epoch_enter(record);
+        value_t* value = atomic_load_explicit(arg->shared, memory_order_acquire);
+        if (value->a != -value->b)
+            arg->errors++;
+        epoch_exit(record);
+        arg->reads++;
+    }
+    epoch_unregister(record);
+    return NULL;
+}
+
+int main() {
+    test_function("epoch_retire");
+    epoch_domain_t* domain = epoch_create();
+    epoch_record_t* record = epoch_register(domain);
+    epoch_record_t* other = epoch_register(domain);
+
+    epoch_enter(other);  // A reader that never leaves blocks the reclamation
+    for (int i = 0; i < 3 * EPOCH_RETIRE_BATCH; i++)
+        epoch_retire(record, malloc(16), count_free);
+    printf("Retired %d objects while a reader is inside: %ld reclaimed\n",
+           3 * EPOCH_RETIRE_BATCH, atomic_load(&reclaimed));
+    epoch_exit(other);
+    epoch_reclaim(record);
+    epoch_reclaim(record);
+    printf("After the reader leaves: %ld reclaimed\n\n", atomic_load(&reclaimed));
+
+    test_function("epoch_enter");
+    epoch_enter(other);
+    epoch_enter(other);  // Nested
+    epoch_exit(other);
+    printf("Nesting level inside two sections after one exit: %u\n\n", other->nesting);
+    epoch_exit(other);
+    epoch_unregister(other);
+
+    test_function("Concurrent readers");
+    _Atomic(value_t*) shared;
+    atomic_bool done = false;
+    value_t* first = malloc(sizeof(value_t));
+    *first = (value_t) {0, 0};
+    atomic_init(&shared, first);
+    atomic_store(&reclaimed, 0);
+
+    pthread_t threads[READERS];
+    reader_arg_t args[READERS];
+    for (int i = 0; i < READERS; i++) {
+        args[i] = (reader_arg_t) {domain, &shared, &done, 0, 0};
+        pthread_create(&threads[i], NULL, reader, &args[i]);
+    }
+    for (long i = 1; i <= UPDATES; i++) {
+        value_t* value = malloc(sizeof(value_t));
+        *value = (value_t) {i, -i};
+        value_t* old = atomic_exchange_explicit(&shared, value, memory_order_acq_rel);
+        epoch_retire(record, old, count_free);
+    }
+    atomic_store(&done, true);
+    long reads = 0, errors = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(threads[i], NULL);
+        reads += args[i].reads;
+        errors += args[i].errors;
+    }
+    printf("%d readers, %ld reads, %ld errors, %ld of %d values reclaimed while running\n",
+           READERS, reads, errors, atomic_load(&reclaimed), UPDATES);
+
+    free(atomic_load(&shared));
+    epoch_unregister(record);
+    epoch_destroy(domain);
+    return 0;
+}
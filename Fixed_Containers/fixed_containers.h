@@ -0,0 +1,158 @@
+#ifndef FIXED_CONTAINERS_H
+#define FIXED_CONTAINERS_H
+
+/*
+* Fixed-capacity variants of the stack, the ring queue and the heap. Each macro
+* generates a struct that keeps its storage inline and a set of `static inline`
+* functions prefixed by `name`. The structs can live on the stack or inside
+* another struct and never allocate. Overflow and underflow are checked with
+* `assert`, so the checks disappear when NDEBUG is defined.
+*
+* Example:
+*     FIXED_STACK(char_stack, char, 100)
+*     char_stack_t stack;
+*     char_stack_init(&stack);
+*     char_stack_push(&stack, 'a');
+*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/* Orderings for FIXED_HEAP. The first argument goes to the top of the heap. */
+#define FIXED_LESS(a, b) ((a) < (b))     // Min heap
+#define FIXED_GREATER(a, b) ((a) > (b))  // Max heap
+
+/* LIFO stack of at most `capacity` items. */
+#define FIXED_STACK(name, type, capacity)                                       \
+typedef struct {                                                                \
+    size_t len;                                                                 \
+    type items[capacity];                                                       \
+} name##_t;                                                                     \
+                                                                                \
+static inline void name##_init(name##_t* stack) {                               \
+    stack->len = 0;                                                             \
+}                                                                               \
+                                                                                \
+static inline bool name##_is_empty(const name##_t* stack) {                     \
+    return stack->len == 0;                                                     \
+}                                                                               \
+                                                                                \
+static inline bool name##_is_full(const name##_t* stack) {                      \
+    return stack->len == (capacity);                                            \
+}                                                                               \
+                                                                                \
+static inline void name##_push(name##_t* stack, type item) {                    \
+    assert(stack->len < (capacity));                                            \
+    stack->items[stack->len++] = item;                                          \
+}                                                                               \
+                                                                                \
+static inline type name##_pop(name##_t* stack) {                                \
+    assert(stack->len > 0);                                                     \
+    return stack->items[--stack->len];                                          \
+}                                                                               \
+                                                                                \
+static inline type name##_peek(const name##_t* stack) {                         \
+    assert(stack->len > 0);                                                     \
+    return stack->items[stack->len - 1];                                        \
+}
+
+/* FIFO ring queue of at most `capacity` items. The capacity must be a power of
+two, so that the slot of a free-running index is found by masking. */
+#define FIXED_QUEUE(name, type, capacity)                                       \
+_Static_assert((capacity) > 0 && ((capacity) & ((capacity) - 1)) == 0,          \
+               #name ": the capacity must be a power of two");                  \
+                                                                                \
+typedef struct {                                                                \
+    size_t head;                                                                \
+    size_t tail;                                                                \
+    type items[capacity];                                                       \
+} name##_t;                                                                     \
+                                                                                \
+static inline void name##_init(name##_t* queue) {                               \
+    queue->head = 0;                                                            \
+    queue->tail = 0;                                                            \
+}                                                                               \
+                                                                                \
+static inline size_t name##_len(const name##_t* queue) {                        \
+    return queue->tail - queue->head;                                           \
+}                                                                               \
+                                                                                \
+static inline bool name##_is_empty(const name##_t* queue) {                     \
+    return queue->tail == queue->head;                                          \
+}                                                                               \
+                                                                                \
+static inline bool name##_is_full(const name##_t* queue) {                      \
+    return queue->tail - queue->head == (capacity);                             \
+}                                                                               \
+                                                                                \
+static inline void name##_enqueue(name##_t* queue, type item) {                 \
+    assert(!name##_is_full(queue));                                             \
+    queue->items[queue->tail++ & ((capacity) - 1)] = item;                      \
+}                                                                               \
+                                                                                \
+static inline type name##_dequeue(name##_t* queue) {                            \
+    assert(!name##_is_empty(queue));                                            \
+    return queue->items[queue->head++ & ((capacity) - 1)];                      \
+}                                                                               \
+                                                                                \
+static inline type name##_peek(const name##_t* queue) {                         \
+    assert(!name##_is_empty(queue));                                            \
+    return queue->items[queue->head & ((capacity) - 1)];                        \
+}
+
+/* Binary heap of at most `capacity` items. `before(a, b)` is true when a must be
+closer to the top than b, e.g. FIXED_LESS for a min heap and FIXED_GREATER for a
+max heap. The comparison is expanded inline. */
+#define FIXED_HEAP(name, type, capacity, before)                                \
+typedef struct {                                                                \
+    size_t len;                                                                 \
+    type items[capacity];                                                       \
+} name##_t;                                                                     \
+                                                                                \
+static inline void name##_init(name##_t* heap) {                                \
+    heap->len = 0;                                                              \
+}                                                                               \
+                                                                                \
+static inline bool name##_is_empty(const name##_t* heap) {                      \
+    return heap->len == 0;                                                      \
+}                                                                               \
+                                                                                \
+static inline bool name##_is_full(const name##_t* heap) {                       \
+    return heap->len == (capacity);                                             \
+}                                                                               \
+                                                                                \
+static inline void name##_push(name##_t* heap, type item) {                     \
+    assert(heap->len < (capacity));                                             \
+    size_t i = heap->len++;                                                     \
+    while (i > 0 && before(item, heap->items[(i - 1) / 2])) {                   \
+        heap->items[i] = heap->items[(i - 1) / 2];                              \
+        i = (i - 1) / 2;                                                        \
+    }                                                                           \
+    heap->items[i] = item;                                                      \
+}                                                                               \
+                                                                                \
+static inline type name##_pop(name##_t* heap) {                                 \
+    assert(heap->len > 0);                                                      \
+    type top = heap->items[0];                                                  \
+    type last = heap->items[--heap->len];                                       \
+    size_t i = 0, child;                                                        \
+    while ((child = 2*i + 1) < heap->len) {                                     \
+        if (child + 1 < heap->len &&                                            \
+            before(heap->items[child + 1], heap->items[child]))                 \
+            child++;                                                            \
+        if (!before(heap->items[child], last))                                  \
+            break;                                                              \
+        heap->items[i] = heap->items[child];                                    \
+        i = child;                                                              \
+    }                                                                           \
+    heap->items[i] = last;                                                      \
+    return top;                                                                 \
+}                                                                               \
+                                                                                \
+static inline type name##_peek(const name##_t* heap) {                          \
+    assert(heap->len > 0);                                                      \
+    return heap->items[0];                                                      \
+}
+
+#endif
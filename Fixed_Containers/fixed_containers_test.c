@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include "fixed_containers.h"
+
+#define SIZE 100
+
+FIXED_STACK(char_stack, char, SIZE)
+FIXED_QUEUE(char_queue, char, 32)
+FIXED_HEAP(min_heap, int, SIZE, FIXED_LESS)
+FIXED_HEAP(max_heap, int, SIZE, FIXED_GREATER)
+
+/* The containers can be embedded in other structs without any allocation. */
+typedef struct {
+    char_stack_t undo;
+    char_queue_t pending;
+} scratch_t;
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+int main() {
+    int arr[SIZE];
+    for (int i = 0; i < SIZE; i++)
+        arr[i] = rand() % 1000;
+
+    test_function("FIXED_STACK");
+    char_stack_t stack;
+    char_stack_init(&stack);
+    for (char ch = 'a'; ch <= 'z'; ch++)
+        char_stack_push(&stack, ch);
+    printf("Peek: %c\n", char_stack_peek(&stack));
+    printf("%s", "Pop until empty: ");
+    while (!char_stack_is_empty(&stack))
+        printf("%c ", char_stack_pop(&stack));
+    puts("\n");
+
+    test_function("FIXED_QUEUE");
+    char_queue_t queue;
+    char_queue_init(&queue);
+    for (int round = 0; round < 3; round++) {  // Wrap around the end of the storage
+        for (char ch = 'a'; ch < 'a' + 20; ch++)
+            char_queue_enqueue(&queue, ch);
+        printf("Round %d, dequeue %zu items: ", round, char_queue_len(&queue));
+        while (!char_queue_is_empty(&queue))
+            printf("%c", char_queue_dequeue(&queue));
+        puts("");
+    }
+    for (int i = 0; !char_queue_is_full(&queue); i++)
+        char_queue_enqueue(&queue, '0' + i % 10);
+    printf("Items in a full queue: %zu\n\n", char_queue_len(&queue));
+
+    test_function("FIXED_HEAP");
+    min_heap_t min_heap;
+    max_heap_t max_heap;
+    min_heap_init(&min_heap);
+    max_heap_init(&max_heap);
+    for (int i = 0; i < SIZE; i++) {
+        min_heap_push(&min_heap, arr[i]);
+        max_heap_push(&max_heap, arr[i]);
+    }
+    printf("%s", "Pop the first 10 keys from the min heap: ");
+    for (int i = 0; i < 10; i++)
+        printf("%d ", min_heap_pop(&min_heap));
+    printf("%s", "\nPop the first 10 keys from the max heap: ");
+    for (int i = 0; i < 10; i++)
+        printf("%d ", max_heap_pop(&max_heap));
+    puts("");
+
+    bool sorted = true;
+    int prev = min_heap_pop(&min_heap);
+    while (!min_heap_is_empty(&min_heap)) {
+        int key = min_heap_pop(&min_heap);
+        if (key < prev)
+            sorted = false;
+        prev = key;
+    }
+    printf("The remaining keys of the min heap are popped in increasing order: %s\n\n",
+           sorted ? "true" : "false");
+
+    test_function("Embedded containers");
+    scratch_t scratch;
+    char_stack_init(&scratch.undo);
+    char_queue_init(&scratch.pending);
+    char_stack_push(&scratch.undo, 'u');
+    char_queue_enqueue(&scratch.pending, 'p');
+    printf("sizeof(scratch_t) = %zu bytes, no heap allocation\n", sizeof(scratch_t));
+    printf("Undo: %c, pending: %c\n", char_stack_pop(&scratch.undo), char_queue_dequeue(&scratch.pending));
+
+    return 0;
+}
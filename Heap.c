@@ -1,18 +1,9 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include "Heap.h"
 // #include "Utilities.c"
 
-typedef struct {
-    int* arr;
-    size_t arr_len;
-    size_t heap_len; 
-} heap_t;
-
-typedef enum {
-    INCREASING, DECREASING
-} ORDER;
-
 // Index of the left child
 int _left(int i) {
     return 2*i + 1;
@@ -60,7 +51,7 @@ void min_heapify(heap_t* heap, int i) {
 // Build a max heap from an array
 void max_heap(heap_t* heap) {
     int i = heap->arr_len / 2 - 1;
-    for (i; i >= 0; i--) {
+    for (; i >= 0; i--) {
         max_heapify(heap, i);
     }
 }
@@ -68,7 +59,7 @@ void max_heap(heap_t* heap) {
 // Build a min heap from an array
 void min_heap(heap_t* heap) {
     int i = heap->arr_len / 2 - 1;
-    for (i; i >= 0; i--) {
+    for (; i >= 0; i--) {
         min_heapify(heap, i);
     }
 }
@@ -144,6 +135,47 @@ void heapsort(int* arr, size_t len, ORDER order) {
     }
 }
 
+// Check if the index a goes before the index b
+bool _index_less(index_heap_t* heap, int a, int b) {
+    return heap->keys[a] < heap->keys[b] || (heap->keys[a] == heap->keys[b] && a < b);
+}
+
+// Fix the node i. The min heap property must hold for the i's children.
+void index_min_heapify(index_heap_t* heap, int i) {
+    size_t left = _left(i);
+    size_t right = _right(i);
+    int smallest = i;
+    if (left < heap->heap_len && _index_less(heap, heap->arr[left], heap->arr[smallest]))
+        smallest = left;
+    if (right < heap->heap_len && _index_less(heap, heap->arr[right], heap->arr[smallest]))
+        smallest = right;
+    if (smallest != i) {
+        int tmp = heap->arr[i];
+        heap->arr[i] = heap->arr[smallest];
+        heap->arr[smallest] = tmp;
+        index_min_heapify(heap, smallest);
+    }
+}
+
+// Build an index heap from the first heap_len indexes of the array
+void index_min_heap(index_heap_t* heap) {
+    for (int i = (int) heap->heap_len / 2 - 1; i >= 0; i--)
+        index_min_heapify(heap, i);
+}
+
+// Pop the index of the smallest key
+int extract_index(index_heap_t* heap) {
+    if (heap->heap_len == 0) {
+        printf("The size of the heap is 0.");
+        exit(EXIT_FAILURE);
+    }
+    int min = heap->arr[0];
+    heap->arr[0] = heap->arr[heap->heap_len - 1];
+    heap->heap_len -= 1;
+    index_min_heapify(heap, 0);
+    return min;
+}
+
 /*
 int main() {
     int* arr = rand_arr(40, -100, 100);
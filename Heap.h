@@ -0,0 +1,48 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    int* arr;
+    size_t arr_len;
+    size_t heap_len;
+} heap_t;
+
+typedef enum {
+    INCREASING, DECREASING
+} ORDER;
+
+/*
+Min heap of indexes ordered by the keys they refer to: the root is the index i with
+the smallest keys[i], and ties go to the smallest index. It drives k-way merges:
+index i stands for the i-th input and keys[i] for its current head. After the root
+is consumed, either store the next key of its input in keys[root] and fix the root
+with index_min_heapify(heap, 0), or remove it with extract_index when the input is
+exhausted. The keys can change only through the root.
+*/
+typedef struct {
+    int* arr;  // Indexes into keys
+    size_t heap_len;
+    const int* keys;
+} index_heap_t;
+
+int _left(int i);
+int _right(int i);
+void max_heapify(heap_t* heap, int i);
+void min_heapify(heap_t* heap, int i);
+void max_heap(heap_t* heap);
+void min_heap(heap_t* heap);
+bool is_max_heap(heap_t* heap);
+bool is_min_heap(heap_t* heap);
+int extract_max(heap_t* heap);
+int extract_min(heap_t* heap);
+void heapsort(int* arr, size_t len, ORDER order);
+
+bool _index_less(index_heap_t* heap, int a, int b);
+void index_min_heapify(index_heap_t* heap, int i);
+void index_min_heap(index_heap_t* heap);
+int extract_index(index_heap_t* heap);
+
+#endif
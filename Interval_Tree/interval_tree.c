@@ -0,0 +1,360 @@
+/*
+* This is an interval tree: the red-black tree of Red_Black_Tree/ with closed
+* intervals instead of keys, ordered by their low endpoint, and every node
+* augmented with the largest high endpoint of its subtree (CLRS, section 14.3).
+* The max of a node depends only on its children, so it is fixed on the path of
+* an insertion or a deletion and by every rotation, and stays valid through the
+* rebalancing at no extra asymptotic cost.
+*
+* A query for the intervals overlapping [lo, hi] skips every subtree whose max is
+* below lo, and everything to the right of a node whose low endpoint is above hi.
+* Each reported interval costs at most O(log n), instead of the O(n) of a scan.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "interval_tree.h"
+
+/* Allocate an empty tree. */
+itree_t* itree_create(void) {
+    itree_t* tree = malloc(sizeof(itree_t));
+    assert(tree);
+    tree->root = NULL;
+    tree->len = 0;
+    return tree;
+}
+
+/* Return true if the tree does not contain any interval, otherwise return false. */
+bool itree_is_empty(itree_t* tree) {
+    return tree->root == NULL;
+}
+
+/* Return the number of intervals, duplicates included. */
+size_t itree_len(itree_t* tree) {
+    return tree->len;
+}
+
+static itree_node_t* itree_create_node(int lo, int hi) {
+    itree_node_t* node = malloc(sizeof(itree_node_t));
+    assert(node);
+    node->interval.lo = lo;
+    node->interval.hi = hi;
+    node->max = hi;
+    node->left = node->right = NULL;
+    node->parent_color = ITREE_RED;
+    return node;
+}
+
+/* Recompute the max of the node from its interval and its children. */
+static void itree_update_max(itree_node_t* node) {
+    int max = node->interval.hi;
+    if (node->left && node->left->max > max)
+        max = node->left->max;
+    if (node->right && node->right->max > max)
+        max = node->right->max;
+    node->max = max;
+}
+
+/* Rotate the subtree rooted in the input node to the left. The subtree keeps
+its max, which moves to the new root; the old root loses tmp's right subtree. */
+static void itree_left_rotate(itree_t* tree, itree_node_t* root) {
+    itree_node_t* tmp = root->right;
+
+    root->right = tmp->left;
+    if (tmp->left)
+        itree_set_parent(tmp->left, root);
+    tmp->left = root;
+    itree_set_parent(tmp, itree_parent(root));
+    itree_set_parent(root, tmp);
+
+    if (!itree_parent(tmp))
+        tree->root = tmp;
+    else if (itree_parent(tmp)->left == root)
+        itree_parent(tmp)->left = tmp;
+    else
+        itree_parent(tmp)->right = tmp;
+
+    tmp->max = root->max;
+    itree_update_max(root);
+}
+
+/* Rotate the subtree rooted in the input node to the right. */
+static void itree_right_rotate(itree_t* tree, itree_node_t* root) {
+    itree_node_t* tmp = root->left;
+
+    root->left = tmp->right;
+    if (tmp->right)
+        itree_set_parent(tmp->right, root);
+    tmp->right = root;
+    itree_set_parent(tmp, itree_parent(root));
+    itree_set_parent(root, tmp);
+
+    if (!itree_parent(tmp))
+        tree->root = tmp;
+    else if (itree_parent(tmp)->left == root)
+        itree_parent(tmp)->left = tmp;
+    else
+        itree_parent(tmp)->right = tmp;
+
+    tmp->max = root->max;
+    itree_update_max(root);
+}
+
+/* Restore the red-black properties after an insertion. Only the rotations
+change the shape of the tree, and they keep the max values right. */
+static void itree_insert_fixup(itree_t* tree, itree_node_t* ptr) {
+    itree_node_t *parent, *uncle, *grandpa;
+
+    while ((parent = itree_parent(ptr)) && itree_color(parent) == ITREE_RED) {
+        grandpa = itree_parent(parent);
+        if (parent == grandpa->left) {
+            uncle = grandpa->right;
+            if (itree_is_red(uncle)) {
+                itree_set_color(parent, ITREE_BLACK);
+                itree_set_color(uncle, ITREE_BLACK);
+                itree_set_color(grandpa, ITREE_RED);
+                ptr = grandpa;
+            } else {
+                if (ptr == parent->right) {
+                    ptr = parent;
+                    itree_left_rotate(tree, ptr);
+                    parent = itree_parent(ptr);
+                }
+                itree_set_color(parent, ITREE_BLACK);
+                itree_set_color(grandpa, ITREE_RED);
+                itree_right_rotate(tree, grandpa);
+            }
+        } else {
+            uncle = grandpa->left;
+            if (itree_is_red(uncle)) {
+                itree_set_color(parent, ITREE_BLACK);
+                itree_set_color(uncle, ITREE_BLACK);
+                itree_set_color(grandpa, ITREE_RED);
+                ptr = grandpa;
+            } else {
+                if (ptr == parent->left) {
+                    ptr = parent;
+                    itree_right_rotate(tree, ptr);
+                    parent = itree_parent(ptr);
+                }
+                itree_set_color(parent, ITREE_BLACK);
+                itree_set_color(grandpa, ITREE_RED);
+                itree_left_rotate(tree, grandpa);
+            }
+        }
+    }
+    itree_set_color(tree->root, ITREE_BLACK);
+}
+
+/* Insert the interval [lo, hi]. Equal intervals are allowed. The max of every
+node on the way down is raised to hi before the new leaf is linked. */
+void itree_insert(itree_t* tree, int lo, int hi) {
+    if (lo > hi) {
+        printf("Invalid interval [%d, %d].\n", lo, hi);
+        return;
+    }
+
+    itree_node_t* node = itree_create_node(lo, hi);
+    itree_node_t *curr = tree->root, *prev = NULL;
+    while (curr) {
+        prev = curr;
+        if (curr->max < hi)
+            curr->max = hi;
+        curr = itree_less(node->interval, curr->interval) ? curr->left : curr->right;
+    }
+
+    itree_set_parent(node, prev);
+    if (!prev)
+        tree->root = node;
+    else if (itree_less(node->interval, prev->interval))
+        prev->left = node;
+    else
+        prev->right = node;
+
+    itree_insert_fixup(tree, node);
+    tree->len++;
+}
+
+/* Return a node holding exactly [lo, hi], or NULL. */
+static itree_node_t* itree_search(itree_t* tree, int lo, int hi) {
+    itree_interval_t interval = {lo, hi};
+    itree_node_t* curr = tree->root;
+
+    while (curr && (curr->interval.lo != lo || curr->interval.hi != hi))
+        curr = itree_less(interval, curr->interval) ? curr->left : curr->right;
+    return curr;
+}
+
+static itree_node_t* itree_minimum(itree_node_t* root) {
+    while (root->left)
+        root = root->left;
+    return root;
+}
+
+/* Replace the subtree rooted at old with the one rooted at new (can be NULL). */
+static void itree_replace_child(itree_t* tree, itree_node_t* parent, itree_node_t* old, itree_node_t* new) {
+    if (!parent)
+        tree->root = new;
+    else if (parent->left == old)
+        parent->left = new;
+    else
+        parent->right = new;
+    if (new)
+        itree_set_parent(new, parent);
+}
+
+/* Restore the red-black properties when the removed node is black. */
+static void itree_delete_fixup(itree_t* tree, itree_node_t* to_be_fixed, itree_node_t* parent) {
+    itree_node_t* sibling;
+
+    while (to_be_fixed != tree->root && !itree_is_red(to_be_fixed)) {
+        if (to_be_fixed == parent->left) {
+            sibling = parent->right;  // Cannot be NULL
+            if (itree_is_red(sibling)) {  // Case 1
+                itree_set_color(sibling, ITREE_BLACK);
+                itree_set_color(parent, ITREE_RED);
+                itree_left_rotate(tree, parent);
+                sibling = parent->right;
+            }
+            if (!itree_is_red(sibling->left) && !itree_is_red(sibling->right)) {  // Case 2
+                itree_set_color(sibling, ITREE_RED);
+                to_be_fixed = parent;
+                parent = itree_parent(to_be_fixed);
+            } else {
+                if (!itree_is_red(sibling->right)) {  // Case 3
+                    itree_set_color(sibling->left, ITREE_BLACK);
+                    itree_set_color(sibling, ITREE_RED);
+                    itree_right_rotate(tree, sibling);
+                    sibling = parent->right;
+                }
+                itree_set_color(sibling, itree_color(parent));  // Case 4
+                itree_set_color(parent, ITREE_BLACK);
+                itree_set_color(sibling->right, ITREE_BLACK);
+                itree_left_rotate(tree, parent);
+                to_be_fixed = tree->root;
+            }
+        } else {
+            sibling = parent->left;  // Cannot be NULL
+            if (itree_is_red(sibling)) {  // Case 1
+                itree_set_color(sibling, ITREE_BLACK);
+                itree_set_color(parent, ITREE_RED);
+                itree_right_rotate(tree, parent);
+                sibling = parent->left;
+            }
+            if (!itree_is_red(sibling->left) && !itree_is_red(sibling->right)) {  // Case 2
+                itree_set_color(sibling, ITREE_RED);
+                to_be_fixed = parent;
+                parent = itree_parent(to_be_fixed);
+            } else {
+                if (!itree_is_red(sibling->left)) {  // Case 3
+                    itree_set_color(sibling->right, ITREE_BLACK);
+                    itree_set_color(sibling, ITREE_RED);
+                    itree_left_rotate(tree, sibling);
+                    sibling = parent->left;
+                }
+                itree_set_color(sibling, itree_color(parent));  // Case 4
+                itree_set_color(parent, ITREE_BLACK);
+                itree_set_color(sibling->left, ITREE_BLACK);
+                itree_right_rotate(tree, parent);
+                to_be_fixed = tree->root;
+            }
+        }
+    }
+    if (to_be_fixed)
+        itree_set_color(to_be_fixed, ITREE_BLACK);
+}
+
+/* Search for the interval [lo, hi] and, if present, remove one copy of it. A node
+with two children is replaced by its successor node. The max values are fixed
+from the lowest node whose subtree changed up to the root before rebalancing. */
+void itree_delete(itree_t* tree, int lo, int hi) {
+    itree_node_t *node = itree_search(tree, lo, hi), *child, *parent;
+    ITREE_COLOR removed_color;
+
+    if (!node) {
+        printf("Interval [%d, %d] was not found.\n", lo, hi);
+        return;
+    }
+
+    if (!node->left || !node->right) {
+        child = (node->left) ? node->left : node->right;
+        parent = itree_parent(node);
+        removed_color = itree_color(node);
+        itree_replace_child(tree, parent, node, child);
+    } else {
+        itree_node_t* succ = itree_minimum(node->right);
+        child = succ->right;
+        removed_color = itree_color(succ);
+        if (itree_parent(succ) == node) {
+            parent = succ;
+        } else {
+            parent = itree_parent(succ);
+            itree_replace_child(tree, parent, succ, child);
+            succ->right = node->right;
+            itree_set_parent(succ->right, succ);
+        }
+        succ->left = node->left;
+        itree_set_parent(succ->left, succ);
+        itree_replace_child(tree, itree_parent(node), node, succ);
+        itree_set_color(succ, itree_color(node));
+    }
+
+    for (itree_node_t* curr = parent; curr; curr = itree_parent(curr))
+        itree_update_max(curr);
+    if (removed_color == ITREE_BLACK)
+        itree_delete_fixup(tree, child, parent);
+    free(node);
+    tree->len--;
+}
+
+/* Subroutine of itree_overlap: in-order visit of the subtree that skips the
+subtrees that cannot hold an interval overlapping [lo, hi]. */
+static void itree_collect(
+    const itree_node_t* node, int lo, int hi, itree_interval_t* out, size_t cap, size_t* count
+) {
+    while (node && node->max >= lo) {
+        itree_collect(node->left, lo, hi, out, cap, count);
+        if (node->interval.lo > hi)  // So are the intervals on the right
+            return;
+        if (node->interval.hi >= lo) {
+            if (*count < cap)
+                out[*count] = node->interval;
+            (*count)++;
+        }
+        node = node->right;
+    }
+}
+
+/* Write the intervals overlapping [lo, hi] to out, in increasing order, and
+return how many they are. Only the first cap are written: if the result is
+larger than cap, the caller can retry with a buffer of that size. */
+size_t itree_overlap(itree_t* tree, int lo, int hi, itree_interval_t* out, size_t cap) {
+    size_t count = 0;
+    itree_collect(tree->root, lo, hi, out, cap, &count);
+    return count;
+}
+
+/* Write the intervals containing the point to out, as itree_overlap. */
+size_t itree_stab(itree_t* tree, int point, itree_interval_t* out, size_t cap) {
+    return itree_overlap(tree, point, point, out, cap);
+}
+
+static void itree_free_subtree(itree_node_t* root) {
+    if (!root) return;
+    itree_free_subtree(root->left);
+    itree_free_subtree(root->right);
+    free(root);
+}
+
+/* Free all nodes in the tree. */
+void itree_free_tree(itree_t* tree) {
+    if (!tree) {
+        puts("The tree does not exist.");
+    } else {
+        itree_free_subtree(tree->root);
+        tree->root = NULL;
+        tree->len = 0;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef INTERVAL_TREE_H
+#define INTERVAL_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    ITREE_RED, ITREE_BLACK
+} ITREE_COLOR;
+
+/* Closed interval [lo, hi], lo <= hi. */
+typedef struct itree_interval {
+    int lo, hi;
+} itree_interval_t;
+
+/* Red-black node ordered by (lo, hi). `max` is the largest hi in the subtree
+rooted here: a subtree whose max is below a query cannot overlap it. The color
+is packed into bit 0 of the parent pointer, as in rbt_node_t. */
+typedef struct itree_node {
+    uintptr_t parent_color;
+    struct itree_node *left, *right;
+    itree_interval_t interval;
+    int max;
+} itree_node_t;
+
+static inline itree_node_t* itree_parent(const itree_node_t* node) {
+    return (itree_node_t*) (node->parent_color & ~(uintptr_t) 1);
+}
+
+static inline ITREE_COLOR itree_color(const itree_node_t* node) {
+    return (ITREE_COLOR) (node->parent_color & 1);
+}
+
+static inline void itree_set_parent(itree_node_t* node, itree_node_t* parent) {
+    node->parent_color = (uintptr_t) parent | (node->parent_color & 1);
+}
+
+static inline void itree_set_color(itree_node_t* node, ITREE_COLOR color) {
+    node->parent_color = (node->parent_color & ~(uintptr_t) 1) | color;
+}
+
+/* NULL children are black. */
+static inline bool itree_is_red(const itree_node_t* node) {
+    return node && itree_color(node) == ITREE_RED;
+}
+
+/* Order of the nodes: by low endpoint, then by high endpoint. */
+static inline bool itree_less(itree_interval_t a, itree_interval_t b) {
+    return a.lo < b.lo || (a.lo == b.lo && a.hi < b.hi);
+}
+
+typedef struct interval_tree {
+    itree_node_t* root;
+    size_t len;
+} itree_t;
+
+itree_t* itree_create(void);
+bool itree_is_empty(itree_t* tree);
+size_t itree_len(itree_t* tree);
+static itree_node_t* itree_create_node(int lo, int hi);
+static void itree_update_max(itree_node_t* node);
+static void itree_left_rotate(itree_t* tree, itree_node_t* root);
+static void itree_right_rotate(itree_t* tree, itree_node_t* root);
+
+static void itree_insert_fixup(itree_t* tree, itree_node_t* ptr);
+void itree_insert(itree_t* tree, int lo, int hi);
+
+static itree_node_t* itree_search(itree_t* tree, int lo, int hi);
+static itree_node_t* itree_minimum(itree_node_t* root);
+static void itree_replace_child(itree_t* tree, itree_node_t* parent, itree_node_t* old, itree_node_t* new);
+static void itree_delete_fixup(itree_t* tree, itree_node_t* to_be_fixed, itree_node_t* parent);
+void itree_delete(itree_t* tree, int lo, int hi);
+
+static void itree_collect(const itree_node_t* node, int lo, int hi, itree_interval_t* out, size_t cap, size_t* count);
+size_t itree_overlap(itree_t* tree, int lo, int hi, itree_interval_t* out, size_t cap);
+size_t itree_stab(itree_t* tree, int point, itree_interval_t* out, size_t cap);
+
+static void itree_free_subtree(itree_node_t* root);
+void itree_free_tree(itree_t* tree);
+
+#endif
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "interval_tree.h"
+
+#define SIZE 8
+#define RANDOM_OPS 20000
+#define POINT_RANGE 100000
+#define MAX_LEN 2000
+#define BIG_SIZE 1000000
+#define QUERIES 10000
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+void print_intervals(const itree_interval_t* intervals, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        printf("[%d, %d] ", intervals[i].lo, intervals[i].hi);
+    puts("");
+}
+
+/* Return the black height of the subtree, or -1 if a red-black property, a
+parent link or a max value is wrong. */
+int check_subtree(const itree_node_t* node, const itree_node_t* parent) {
+    if (!node)
+        return 0;
+    if (itree_parent(node) != parent)
+        return -1;
+    int max = node->interval.hi;
+    if (node->left && node->left->max > max)
+        max = node->left->max;
+    if (node->right && node->right->max > max)
+        max = node->right->max;
+    if (node->max != max)
+        return -1;
+    bool red = itree_color(node) == ITREE_RED;
+    if (red && (itree_is_red(node->left) || itree_is_red(node->right)))
+        return -1;
+
+    int bh_left = check_subtree(node->left, node);
+    int bh_right = check_subtree(node->right, node);
+    if (bh_left < 0 || bh_left != bh_right)
+        return -1;
+    return bh_left + !red;
+}
+
+int cmp_interval(const void* p, const void* q) {
+    const itree_interval_t *a = p, *b = q;
+    if (a->lo != b->lo)
+        return (a->lo > b->lo) - (a->lo < b->lo);
+    return (a->hi > b->hi) - (a->hi < b->hi);
+}
+
+/* Reference: scan all the intervals. */
+size_t scan_overlap(const itree_interval_t* all, size_t n, int lo, int hi, itree_interval_t* out) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+        if (all[i].lo <= hi && all[i].hi >= lo)
+            out[count++] = all[i];
+    return count;
+}
+
+itree_interval_t random_interval(void) {
+    int lo = rand() % POINT_RANGE;
+    return (itree_interval_t) {lo, lo + rand() % MAX_LEN};
+}
+
+int main() {
+    itree_interval_t arr[SIZE] = {{16, 21}, {8, 9}, {25, 30}, {5, 8}, {15, 23}, {17, 19}, {26, 26}, {0, 3}};
+    itree_interval_t out[RANDOM_OPS], expected[RANDOM_OPS];
+
+    test_function("itree_insert");
+    itree_t* tree = itree_create();
+    for (int i = 0; i < SIZE; i++)
+        itree_insert(tree, arr[i].lo, arr[i].hi);
+    itree_insert(tree, 4, 2);
+    printf("Intervals: %zu, root: [%d, %d] with max %d, valid: %s\n\n", itree_len(tree),
+           tree->root->interval.lo, tree->root->interval.hi, tree->root->max,
+           check_subtree(tree->root, NULL) >= 0 ? "true" : "false");
+
+    test_function("itree_overlap");
+    size_t n = itree_overlap(tree, 22, 25, out, RANDOM_OPS);
+    printf("Overlapping [22, 25]: ");
+    print_intervals(out, n);
+    n = itree_stab(tree, 8, out, RANDOM_OPS);
+    printf("Containing 8: ");
+    print_intervals(out, n);
+    n = itree_overlap(tree, 0, 100, out, 3);
+    printf("Overlapping [0, 100], buffer of 3: %zu found, written: ", n);
+    print_intervals(out, 3);
+    puts("");
+
+    test_function("itree_delete");
+    itree_delete(tree, 16, 21);  // Root
+    itree_delete(tree, 8, 9);
+    itree_delete(tree, 8, 10);
+    n = itree_overlap(tree, 0, 100, out, RANDOM_OPS);
+    printf("After deleting [16, 21] and [8, 9]: ");
+    print_intervals(out, n);
+    printf("Valid: %s\n\n", check_subtree(tree->root, NULL) >= 0 ? "true" : "false");
+    itree_free_tree(tree);
+
+    test_function("Random insertions, deletions and queries");
+    itree_interval_t* all = malloc(RANDOM_OPS * sizeof(itree_interval_t));
+    size_t len = 0;
+    bool ok = true;
+    srand(1);
+    for (int i = 0; i < RANDOM_OPS && ok; i++) {
+        if (len == 0 || rand() % 3) {
+            all[len] = random_interval();
+            itree_insert(tree, all[len].lo, all[len].hi);
+            len++;
+        } else {
+            size_t j = rand() % len;
+            itree_delete(tree, all[j].lo, all[j].hi);
+            all[j] = all[--len];
+        }
+        if (i % 100 == 0) {
+            itree_interval_t query = random_interval();
+            size_t found = itree_overlap(tree, query.lo, query.hi, out, RANDOM_OPS);
+            size_t want = scan_overlap(all, len, query.lo, query.hi, expected);
+            qsort(expected, want, sizeof(itree_interval_t), cmp_interval);
+            ok = found == want && !memcmp(out, expected, found * sizeof(itree_interval_t)) &&
+                 check_subtree(tree->root, NULL) >= 0 && itree_len(tree) == len;
+        }
+    }
+    printf("Intervals: %zu\n", len);
+    printf("Red-black properties and max values hold, queries agree with a scan: %s\n\n",
+           ok ? "true" : "false");
+    itree_free_tree(tree);
+    free(all);
+
+    test_function("Interval tree against scan");
+    all = malloc(BIG_SIZE * sizeof(itree_interval_t));
+    for (int i = 0; i < BIG_SIZE; i++) {
+        int lo = (int) ((unsigned) rand() * 2654435761u % (unsigned) (1000 * BIG_SIZE));
+        all[i] = (itree_interval_t) {lo, lo + rand() % 1000};
+        itree_insert(tree, all[i].lo, all[i].hi);
+    }
+    itree_interval_t* big_out = malloc(BIG_SIZE * sizeof(itree_interval_t));
+    size_t tree_found = 0, scan_found = 0;
+    clock_t start = clock();
+    for (int i = 0; i < QUERIES; i++)
+        tree_found += itree_stab(tree, (int) ((unsigned) i * 2654435761u % (unsigned) (1000 * BIG_SIZE)), big_out, BIG_SIZE);
+    double tree_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (int i = 0; i < QUERIES / 100; i++) {
+        int point = (int) ((unsigned) i * 2654435761u % (unsigned) (1000 * BIG_SIZE));
+        scan_found += scan_overlap(all, BIG_SIZE, point, point, big_out);
+    }
+    double scan_time = (double) (clock() - start) / CLOCKS_PER_SEC * 100;
+    printf("%d intervals, %d stabbing queries, %zu hits\n", BIG_SIZE, QUERIES, tree_found);
+    printf("Tree: %.4f s, scan (extrapolated from %d queries): %.2f s\n", tree_time, QUERIES / 100, scan_time);
+    itree_free_tree(tree);
+    free(tree);
+    free(all);
+    free(big_out);
+    return 0;
+}
@@ -0,0 +1,585 @@
+/*
+* This is a small log-structured merge engine: an ordered map of int to int
+* whose writes cost an insertion into a red-black tree, while most of the data
+* lives in immutable sorted files on disk.
+*
+* - Memtables. Writes and deletions go to an rbt_map (see rbt_map.h); a deletion
+*   stores a tombstone. When the active memtable reaches its size limit it is
+*   frozen: the flusher thread streams it, in key order, to a new run, while the
+*   writes go to a fresh memtable. A writer waits only if the next memtable fills
+*   up before the previous one is on disk.
+* - Runs. A run is a file of 4 KiB blocks: the first one is a header, each of the
+*   others holds a record count, a CRC-32C of its records (see Serialization/)
+*   and up to LSM_BLOCK_RECORDS records (key, value, tombstone flag) sorted by
+*   key. The first key of every block, its fence, stays in memory in a static
+*   search index (see Static_Search_Index/), so a lookup reads a single block.
+*   The files use the byte order of the host: they do not outlive the engine.
+* - Compaction. The runs are kept from the newest to the oldest, and a newer
+*   version of a key hides the older ones. A flushed run has level 0; as soon as
+*   LSM_FANOUT runs have the same level, the compactor thread merges the oldest
+*   LSM_FANOUT of them into one run of the next level, with a k-way merge on the
+*   index heap of Heap.h. The merged run takes the place of its inputs in the
+*   list, so the order of the versions is preserved. Every key is rewritten about
+*   once per level, i.e. O(log n) times. Tombstones are dropped by the merges that
+*   include the oldest run: there is nothing left for them to hide.
+*
+* Link with ../Heap.c, ../Red_Black_Tree/red_black_tree.c,
+* ../Static_Search_Index/static_index.c and ../Serialization/serialize.c.
+*
+* Readers and writers share one mutex, which is never held during file I/O. A
+* reader takes a reference to the runs it is going to search, so a compaction
+* can replace them in the meantime; whoever drops the last reference closes the
+* run and deletes the file, after releasing the mutex.
+*
+* Durability is out of scope: there is no write-ahead log, and the files are
+* deleted by lsm_destroy.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "lsm.h"
+#include "../Heap.h"
+
+#define LSM_MAGIC "LSMR"
+
+/* Allocate an empty engine that keeps its runs in the directory, which must
+exist. The memtables hold up to memtable_limit keys. */
+lsm_t* lsm_create(const char* dir, size_t memtable_limit) {
+    if (!dir || !memtable_limit) {
+        puts("The engine needs a directory and a memtable size.");
+        return NULL;
+    }
+    lsm_t* db = malloc(sizeof(lsm_t));
+    assert(db);
+    pthread_mutex_init(&db->lock, NULL);
+    pthread_cond_init(&db->changed, NULL);
+    db->active = malloc(sizeof(lsm_memtable_t));
+    assert(db->active);
+    lsm_memtable_init(db->active);
+    db->immutable = NULL;
+    db->runs = NULL;
+    db->n_runs = 0;
+    db->memtable_limit = memtable_limit;
+    db->dir = strdup(dir);
+    assert(db->dir);
+    db->next_file = 0;
+    db->compacting = false;
+    db->stop = false;
+    db->flushes = db->compactions = db->records_written = 0;
+    if (pthread_create(&db->flusher, NULL, lsm_flusher, db) ||
+        pthread_create(&db->compactor, NULL, lsm_compactor, db)) {
+        puts("Cannot start the background threads. The program will be terminated.");
+        exit(EXIT_FAILURE);
+    }
+    return db;
+}
+
+/* Stop the background threads, free the engine and delete its files. A merge in
+progress is completed first. No other thread may be using the engine. */
+void lsm_destroy(lsm_t* db) {
+    if (!db)
+        return;
+    pthread_mutex_lock(&db->lock);
+    db->stop = true;
+    pthread_cond_broadcast(&db->changed);
+    pthread_mutex_unlock(&db->lock);
+    pthread_join(db->flusher, NULL);
+    pthread_join(db->compactor, NULL);
+
+    lsm_memtable_clear(db->active);
+    free(db->active);
+    if (db->immutable) {
+        lsm_memtable_clear(db->immutable);
+        free(db->immutable);
+    }
+    while (db->runs) {
+        lsm_run_t* next = db->runs->next;
+        lsm_run_close(lsm_run_release(db->runs));
+        db->runs = next;
+    }
+    pthread_cond_destroy(&db->changed);
+    pthread_mutex_destroy(&db->lock);
+    free(db->dir);
+    free(db);
+}
+
+/* Map the key to the value. */
+void lsm_put(lsm_t* db, int key, int value) {
+    lsm_add_memtable(db, key, (lsm_entry_t) {value, false});
+}
+
+/* Remove the key, if present. */
+void lsm_delete(lsm_t* db, int key) {
+    lsm_add_memtable(db, key, (lsm_entry_t) {0, true});
+}
+
+/* Store the value of the key in the output parameter. Return false if the key
+is not in the map. */
+bool lsm_get(lsm_t* db, int key, int* value) {
+    lsm_run_t* runs[LSM_MAX_RUNS];
+    lsm_entry_t entry = {0, false};
+    size_t n = 0;
+    bool found = false;
+
+    pthread_mutex_lock(&db->lock);
+    lsm_entry_t* in_memory = lsm_memtable_find(db->active, key);
+    if (!in_memory && db->immutable)
+        in_memory = lsm_memtable_find(db->immutable, key);
+    if (in_memory) {
+        entry = *in_memory;
+        found = true;
+    } else {
+        for (lsm_run_t* run = db->runs; run; run = run->next) {
+            if (key >= run->fences[0] && key <= run->max_key) {
+                run->refs++;
+                runs[n++] = run;
+            }
+        }
+    }
+    pthread_mutex_unlock(&db->lock);
+
+    for (size_t i = 0; i < n && !found; i++)
+        found = lsm_run_get(runs[i], key, &entry);
+    if (n) {
+        pthread_mutex_lock(&db->lock);
+        for (size_t i = 0; i < n; i++)
+            runs[i] = lsm_run_release(runs[i]);
+        pthread_mutex_unlock(&db->lock);
+        for (size_t i = 0; i < n; i++)
+            lsm_run_close(runs[i]);
+    }
+
+    if (found && !entry.tombstone)
+        *value = entry.value;
+    return found && !entry.tombstone;
+}
+
+/* Freeze the active memtable, if it is not empty, and wait until it is on disk
+and the runs need no more merging. */
+void lsm_flush(lsm_t* db) {
+    lsm_run_t* group[LSM_FANOUT];
+
+    pthread_mutex_lock(&db->lock);
+    while (db->immutable)
+        pthread_cond_wait(&db->changed, &db->lock);
+    if (lsm_memtable_len(db->active))
+        lsm_freeze_memtable(db);
+    while (db->immutable || db->compacting || lsm_pick_group(db, group))
+        pthread_cond_wait(&db->changed, &db->lock);
+    pthread_mutex_unlock(&db->lock);
+}
+
+
+/**
+Runs. A writer builds a run from records in increasing key order. The runs are
+read through `pread`, so many threads can read the same file at the same time.
+I/O errors and corrupted blocks terminate the program: the engine has no other
+copy of the data.
+*/
+
+static void lsm_fail(const char* what, const char* path) {
+    printf("%s %s. The program will be terminated.\n", what, path);
+    exit(EXIT_FAILURE);
+}
+
+/* Create the file of a new run. The writer takes ownership of the path. */
+static void lsm_writer_init(lsm_run_writer_t* w, char* path) {
+    w->path = path;
+    w->out = fopen(path, "w+b");
+    if (!w->out)
+        lsm_fail("Cannot create", path);
+    setvbuf(w->out, NULL, _IOFBF, LSM_WRITE_BUFFER);
+    memset(w->block, 0, LSM_BLOCK_SIZE);
+    if (fwrite(w->block, 1, LSM_BLOCK_SIZE, w->out) != LSM_BLOCK_SIZE)  // The header is written last
+        lsm_fail("Cannot write", path);
+    w->fill = 0;
+    w->n_records = 0;
+    w->n_blocks = 0;
+    w->fences = NULL;
+    w->fences_cap = 0;
+    w->last_key = 0;
+}
+
+/* Write the current block, if it holds any record, as a whole page. */
+static void lsm_writer_flush_block(lsm_run_writer_t* w) {
+    if (!w->fill)
+        return;
+    size_t len = w->fill * LSM_RECORD_SIZE;
+    uint32_t crc = ser_crc32c(0, w->block + LSM_BLOCK_HEADER_SIZE, len);
+    memcpy(w->block, &w->fill, 4);
+    memcpy(w->block + 4, &crc, 4);
+    memset(w->block + LSM_BLOCK_HEADER_SIZE + len, 0, LSM_BLOCK_SIZE - LSM_BLOCK_HEADER_SIZE - len);
+    if (fwrite(w->block, 1, LSM_BLOCK_SIZE, w->out) != LSM_BLOCK_SIZE)
+        lsm_fail("Cannot write", w->path);
+    w->n_blocks++;
+    w->fill = 0;
+}
+
+/* Append a record. The key must be greater than the previous one. */
+static void lsm_writer_add(lsm_run_writer_t* w, int key, lsm_entry_t entry) {
+    assert(!w->n_records || key > w->last_key);
+    if (!w->fill) {  // The first key of a block is its fence
+        if (w->n_blocks == w->fences_cap) {
+            w->fences_cap = (w->fences_cap) ? 2 * w->fences_cap : 16;
+            w->fences = realloc(w->fences, w->fences_cap * sizeof(int));
+            assert(w->fences);
+        }
+        w->fences[w->n_blocks] = key;
+    }
+    unsigned char* p = w->block + LSM_BLOCK_HEADER_SIZE + w->fill * LSM_RECORD_SIZE;
+    memcpy(p, &key, 4);
+    memcpy(p + 4, &entry.value, 4);
+    p[8] = entry.tombstone;
+    w->last_key = key;
+    w->n_records++;
+    if (++w->fill == LSM_BLOCK_RECORDS)
+        lsm_writer_flush_block(w);
+}
+
+/* Write the last block and the header, and open the run for reading. Return NULL,
+and delete the file, if the run has no record. */
+static lsm_run_t* lsm_writer_finish(lsm_run_writer_t* w, int level) {
+    unsigned char header[32] = {0};
+
+    lsm_writer_flush_block(w);
+    if (!w->n_records) {
+        fclose(w->out);
+        remove(w->path);
+        free(w->path);
+        free(w->fences);
+        return NULL;
+    }
+    uint32_t block_records = LSM_BLOCK_RECORDS;
+    uint64_t n_records = w->n_records, n_blocks = w->n_blocks;
+    memcpy(header, LSM_MAGIC, 4);
+    memcpy(header + 4, &block_records, 4);
+    memcpy(header + 8, &n_records, 8);
+    memcpy(header + 16, &n_blocks, 8);
+    uint32_t crc = ser_crc32c(0, header, 24);
+    memcpy(header + 24, &crc, 4);
+    if (fseek(w->out, 0, SEEK_SET) || fwrite(header, 1, sizeof(header), w->out) != sizeof(header) ||
+        fclose(w->out))
+        lsm_fail("Cannot write", w->path);
+
+    lsm_run_t* run = malloc(sizeof(lsm_run_t));
+    assert(run);
+    run->next = NULL;
+    run->path = w->path;
+    run->fd = open(w->path, O_RDONLY);
+    if (run->fd < 0)
+        lsm_fail("Cannot open", w->path);
+    run->level = level;
+    run->n_records = w->n_records;
+    run->n_blocks = w->n_blocks;
+    run->max_key = w->last_key;
+    run->fences = w->fences;
+    run->fence_index = sidx_build(w->fences, w->n_blocks, SIDX_EYTZINGER);
+    run->refs = 1;
+    return run;
+}
+
+/* Drop a reference, under the engine lock. Return the run if that was the last
+reference, else NULL: the caller then passes it to lsm_run_close once it has
+released the lock. */
+static lsm_run_t* lsm_run_release(lsm_run_t* run) {
+    return (--run->refs) ? NULL : run;
+}
+
+/* Close a run nobody references anymore, delete its file and free it. Does
+nothing on NULL. */
+static void lsm_run_close(lsm_run_t* run) {
+    if (!run)
+        return;
+    close(run->fd);
+    remove(run->path);
+    free(run->path);
+    free(run->fences);
+    sidx_free(run->fence_index);
+    free(run);
+}
+
+/* Return the number of records of the block, after checking its checksum. */
+static uint32_t lsm_check_block(lsm_run_t* run, const unsigned char* block) {
+    uint32_t len, crc;
+    memcpy(&len, block, 4);
+    memcpy(&crc, block + 4, 4);
+    if (!len || len > LSM_BLOCK_RECORDS ||
+        ser_crc32c(0, block + LSM_BLOCK_HEADER_SIZE, len * LSM_RECORD_SIZE) != crc)
+        lsm_fail("Corrupted block in", run->path);
+    return len;
+}
+
+/* Look for the key in the run. If it is there, store its entry (possibly a
+tombstone) in the output parameter and return true. */
+static bool lsm_run_get(lsm_run_t* run, int key, lsm_entry_t* entry) {
+    unsigned char block[LSM_BLOCK_SIZE];
+    int found;
+
+    if (key < run->fences[0] || key > run->max_key)
+        return false;
+    // The last block whose fence is <= key
+    size_t b = ((key == INT_MAX) ? run->n_blocks : sidx_rank(run->fence_index, key + 1)) - 1;
+    if (pread(run->fd, block, LSM_BLOCK_SIZE, (off_t) (b + 1) * LSM_BLOCK_SIZE) != LSM_BLOCK_SIZE)
+        lsm_fail("Cannot read", run->path);
+
+    uint32_t len = lsm_check_block(run, block), lo = 0, hi = len;
+    const unsigned char* records = block + LSM_BLOCK_HEADER_SIZE;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        memcpy(&found, records + mid * LSM_RECORD_SIZE, 4);
+        if (found < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == len)
+        return false;
+    memcpy(&found, records + lo * LSM_RECORD_SIZE, 4);
+    if (found != key)
+        return false;
+    memcpy(&entry->value, records + lo * LSM_RECORD_SIZE + 4, 4);
+    entry->tombstone = records[lo * LSM_RECORD_SIZE + 8];
+    return true;
+}
+
+static void lsm_cursor_init(lsm_cursor_t* c, lsm_run_t* run) {
+    c->run = run;
+    c->buf = malloc(LSM_CURSOR_BLOCKS * LSM_BLOCK_SIZE);
+    assert(c->buf);
+    c->next_block = 0;
+    c->blocks = 0;
+    c->block = 0;
+    c->pos = 0;
+    c->len = 0;
+}
+
+/* Store the next record in the output parameters. Return false at the end of the
+run. The blocks are read LSM_CURSOR_BLOCKS at a time. */
+static bool lsm_cursor_next(lsm_cursor_t* c, int* key, lsm_entry_t* entry) {
+    if (c->pos == c->len) {
+        if (++c->block >= c->blocks) {
+            if (c->next_block == c->run->n_blocks)
+                return false;
+            size_t n = c->run->n_blocks - c->next_block;
+            n = (n < LSM_CURSOR_BLOCKS) ? n : LSM_CURSOR_BLOCKS;
+            if (pread(c->run->fd, c->buf, n * LSM_BLOCK_SIZE, (off_t) (c->next_block + 1) * LSM_BLOCK_SIZE) !=
+                (ssize_t) (n * LSM_BLOCK_SIZE))
+                lsm_fail("Cannot read", c->run->path);
+            c->next_block += n;
+            c->blocks = n;
+            c->block = 0;
+        }
+        c->len = lsm_check_block(c->run, c->buf + c->block * LSM_BLOCK_SIZE);
+        c->pos = 0;
+    }
+    const unsigned char* p = c->buf + c->block * LSM_BLOCK_SIZE + LSM_BLOCK_HEADER_SIZE + c->pos * LSM_RECORD_SIZE;
+    memcpy(key, p, 4);
+    memcpy(&entry->value, p + 4, 4);
+    entry->tombstone = p[8];
+    c->pos++;
+    return true;
+}
+
+
+/**
+Background work. Both threads sleep on `changed` until there is something to do
+or the engine stops.
+*/
+
+/* Return the path of a new run file, under the engine lock. */
+static char* lsm_new_path(lsm_t* db) {
+    size_t len = strlen(db->dir) + 32;
+    char* path = malloc(len);
+    assert(path);
+    snprintf(path, len, "%s/run-%06lu.lsm", db->dir, db->next_file++);
+    return path;
+}
+
+/* Hand the active memtable to the flusher and start a new one, under the lock. */
+static void lsm_freeze_memtable(lsm_t* db) {
+    db->immutable = db->active;
+    db->active = malloc(sizeof(lsm_memtable_t));
+    assert(db->active);
+    lsm_memtable_init(db->active);
+    pthread_cond_broadcast(&db->changed);
+}
+
+/* Subroutine of lsm_put and lsm_delete. A full memtable is frozen, unless the
+previous one is still being flushed: then the writer waits for it. */
+static void lsm_add_memtable(lsm_t* db, int key, lsm_entry_t entry) {
+    pthread_mutex_lock(&db->lock);
+    lsm_memtable_insert(db->active, key, entry);
+    while (lsm_memtable_len(db->active) >= db->memtable_limit) {
+        if (!db->immutable) {
+            lsm_freeze_memtable(db);
+            break;
+        }
+        pthread_cond_wait(&db->changed, &db->lock);
+    }
+    pthread_mutex_unlock(&db->lock);
+}
+
+/* Write every frozen memtable to a new run of level 0, at the front of the list.
+The memtable is only read, so lookups keep searching it until the run replaces it.
+If there is no run yet, the tombstones have nothing to hide and are dropped. */
+static void* lsm_flusher(void* arg) {
+    lsm_t* db = arg;
+    lsm_run_writer_t* w = malloc(sizeof(lsm_run_writer_t));
+    rbt_iter_t it;
+    assert(w);
+
+    pthread_mutex_lock(&db->lock);
+    while (true) {
+        while (!db->stop && (!db->immutable || db->n_runs >= LSM_MAX_RUNS))
+            pthread_cond_wait(&db->changed, &db->lock);
+        if (db->stop)
+            break;
+        lsm_memtable_t* memtable = db->immutable;
+        bool drop_tombstones = !db->runs;
+        char* path = lsm_new_path(db);
+        pthread_mutex_unlock(&db->lock);
+
+        lsm_writer_init(w, path);
+        for (rbt_iter_first(&it, &memtable->tree); rbt_iter_valid(&it); rbt_iter_next(&it)) {
+            lsm_memtable_node_t* node = lsm_memtable_entry(it.node);
+            if (!drop_tombstones || !node->value.tombstone)
+                lsm_writer_add(w, node->key, node->value);
+        }
+        lsm_run_t* run = lsm_writer_finish(w, 0);
+
+        pthread_mutex_lock(&db->lock);
+        if (run) {
+            run->next = db->runs;
+            db->runs = run;
+            db->n_runs++;
+            db->records_written += run->n_records;
+        }
+        db->immutable = NULL;  // From now on no lookup can be inside the memtable
+        db->flushes++;
+        pthread_cond_broadcast(&db->changed);
+        pthread_mutex_unlock(&db->lock);
+        lsm_memtable_clear(memtable);
+        free(memtable);
+        pthread_mutex_lock(&db->lock);
+    }
+    pthread_mutex_unlock(&db->lock);
+    free(w);
+    return NULL;
+}
+
+/* Merge k runs, from the newest to the oldest, into a new run of the level. When
+several inputs hold a key, the heap returns the newest first and the others are
+skipped. */
+static lsm_run_t* lsm_merge(char* path, lsm_run_t** inputs, int k, int level, bool drop_tombstones) {
+    lsm_run_writer_t* w = malloc(sizeof(lsm_run_writer_t));
+    lsm_cursor_t cursors[LSM_FANOUT];
+    lsm_entry_t entries[LSM_FANOUT];
+    int keys[LSM_FANOUT], indexes[LSM_FANOUT];
+    index_heap_t heap = {indexes, 0, keys};
+    assert(w && k <= LSM_FANOUT);
+
+    lsm_writer_init(w, path);
+    for (int i = 0; i < k; i++) {
+        lsm_cursor_init(&cursors[i], inputs[i]);
+        if (lsm_cursor_next(&cursors[i], &keys[i], &entries[i]))
+            indexes[heap.heap_len++] = i;
+    }
+    index_min_heap(&heap);
+
+    while (heap.heap_len) {
+        int newest = heap.arr[0], key = keys[newest];
+        if (!drop_tombstones || !entries[newest].tombstone)
+            lsm_writer_add(w, key, entries[newest]);
+        while (heap.heap_len && keys[heap.arr[0]] == key) {
+            int i = heap.arr[0];
+            if (lsm_cursor_next(&cursors[i], &keys[i], &entries[i]))
+                index_min_heapify(&heap, 0);
+            else
+                extract_index(&heap);
+        }
+    }
+
+    for (int i = 0; i < k; i++)
+        free(cursors[i].buf);
+    lsm_run_t* run = lsm_writer_finish(w, level);
+    free(w);
+    return run;
+}
+
+/* Under the lock. Store in `group` the oldest LSM_FANOUT runs of the lowest level
+that has at least LSM_FANOUT runs, from the newest to the oldest. The runs of a
+level are contiguous in the list. Return false if no level is full. */
+static bool lsm_pick_group(lsm_t* db, lsm_run_t** group) {
+    lsm_run_t* run = db->runs;
+    while (run) {
+        lsm_run_t* first = run;
+        size_t len = 0;
+        for (; run && run->level == first->level; run = run->next)
+            len++;
+        if (len >= LSM_FANOUT) {
+            for (size_t i = 0; i < len - LSM_FANOUT; i++)
+                first = first->next;
+            for (int i = 0; i < LSM_FANOUT; i++, first = first->next)
+                group[i] = first;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Merge the full levels. While a merge runs, flushes can only add runs in front
+of the list, so its inputs are still contiguous when the result replaces them. */
+static void* lsm_compactor(void* arg) {
+    lsm_t* db = arg;
+    lsm_run_t* group[LSM_FANOUT];
+
+    pthread_mutex_lock(&db->lock);
+    while (true) {
+        while (!db->stop && !lsm_pick_group(db, group))
+            pthread_cond_wait(&db->changed, &db->lock);
+        if (db->stop)
+            break;
+        for (int i = 0; i < LSM_FANOUT; i++)
+            group[i]->refs++;
+        bool drop_tombstones = !group[LSM_FANOUT - 1]->next;  // The group ends with the oldest run
+        char* path = lsm_new_path(db);
+        db->compacting = true;
+        pthread_mutex_unlock(&db->lock);
+
+        lsm_run_t* merged = lsm_merge(path, group, LSM_FANOUT, group[0]->level + 1, drop_tombstones);
+
+        pthread_mutex_lock(&db->lock);
+        lsm_run_t** link = &db->runs;
+        while (*link != group[0])
+            link = &(*link)->next;
+        if (merged) {
+            merged->next = group[LSM_FANOUT - 1]->next;
+            *link = merged;
+            db->records_written += merged->n_records;
+        } else {
+            *link = group[LSM_FANOUT - 1]->next;
+        }
+        db->n_runs -= LSM_FANOUT - (merged != NULL);
+        for (int i = 0; i < LSM_FANOUT; i++) {
+            group[i]->refs--;  // The reference of the list; ours is still there
+            group[i] = lsm_run_release(group[i]);
+        }
+        db->compactions++;
+        db->compacting = false;
+        pthread_cond_broadcast(&db->changed);
+        pthread_mutex_unlock(&db->lock);
+        for (int i = 0; i < LSM_FANOUT; i++)
+            lsm_run_close(group[i]);
+        pthread_mutex_lock(&db->lock);
+    }
+    pthread_mutex_unlock(&db->lock);
+    return NULL;
+}
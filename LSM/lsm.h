@@ -0,0 +1,128 @@
+#ifndef LSM_H
+#define LSM_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "../Red_Black_Tree/rbt_map.h"
+#include "../Static_Search_Index/static_index.h"
+#include "../Serialization/serialize.h"
+
+#define LSM_BLOCK_SIZE 4096  // Runs are read and written in pages
+#define LSM_BLOCK_HEADER_SIZE 8
+#define LSM_RECORD_SIZE 9  // Key, value, tombstone flag
+#define LSM_BLOCK_RECORDS ((LSM_BLOCK_SIZE - LSM_BLOCK_HEADER_SIZE) / LSM_RECORD_SIZE)
+#define LSM_CURSOR_BLOCKS 64  // Blocks read at once by a merge
+#define LSM_WRITE_BUFFER (1 << 20)
+#define LSM_FANOUT 4  // Runs of one level merged into one run of the next level
+#define LSM_MAX_RUNS 64  // Flushes wait for compaction beyond this
+
+/* The value of a key in the memtable or in a run. A deletion is recorded as a
+tombstone, which hides the older values of the key until a compaction that
+reaches the oldest run drops them all. */
+typedef struct lsm_entry {
+    int value;
+    bool tombstone;
+} lsm_entry_t;
+
+RBT_MAP_DEFINE(lsm_memtable, int, lsm_entry_t, RBT_LESS)
+
+/* Immutable sorted file. `fences` holds the first key of every block; a lookup
+finds its block through the fence index and reads that block only. The runs of
+level L + 1 come from merging LSM_FANOUT runs of level L (level 0: flushed
+memtables). A run stays alive while a reader or a merge uses it, even after a
+compaction replaced it: the last user closes it and deletes the file, outside
+the engine lock. */
+typedef struct lsm_run {
+    struct lsm_run* next;  // Next older run
+    char* path;
+    int fd;
+    int level;
+    size_t n_records;
+    size_t n_blocks;
+    int max_key;
+    int* fences;
+    sidx_t* fence_index;
+    int refs;  // The list holds one reference; changed under the engine lock
+} lsm_run_t;
+
+/* Writer of a run: the records are packed into pages and handed to a FILE with
+a large buffer, so the file is written in large sequential chunks. */
+typedef struct lsm_run_writer {
+    FILE* out;
+    char* path;
+    unsigned char block[LSM_BLOCK_SIZE];
+    uint32_t fill;  // Records in the current block
+    size_t n_records;
+    size_t n_blocks;
+    int* fences;
+    size_t fences_cap;
+    int last_key;
+} lsm_run_writer_t;
+
+/* Sequential reader of a run, for the merges. */
+typedef struct lsm_cursor {
+    lsm_run_t* run;
+    unsigned char* buf;  // LSM_CURSOR_BLOCKS blocks
+    size_t next_block;   // First block not read yet
+    size_t blocks;       // Blocks in buf
+    size_t block;        // Current block in buf
+    uint32_t pos, len;   // Next record and records of the current block
+} lsm_cursor_t;
+
+/* Ordered map of int to int that can outgrow the memory. Writes go to the active
+memtable, an rbt_map. When it reaches `memtable_limit` keys it becomes immutable
+and a background thread streams it to a new run of level 0, while a new active
+memtable takes the writes. Another background thread merges the runs. Lookups
+check the active memtable, then the immutable one, then the runs from the newest
+to the oldest. One mutex protects the memtables and the list of runs; the files
+are read and written outside of it. */
+typedef struct lsm {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;  // Broadcast on every change of the state below
+    lsm_memtable_t* active;
+    lsm_memtable_t* immutable;  // Being flushed, or NULL
+    lsm_run_t* runs;  // Newest first; the levels never decrease along the list
+    size_t n_runs;
+    size_t memtable_limit;
+    char* dir;
+    unsigned long next_file;
+    bool compacting;
+    bool stop;
+    pthread_t flusher, compactor;
+    size_t flushes, compactions;
+    size_t records_written;  // By flushes and compactions
+} lsm_t;
+
+lsm_t* lsm_create(const char* dir, size_t memtable_limit);
+void lsm_destroy(lsm_t* db);
+void lsm_put(lsm_t* db, int key, int value);
+void lsm_delete(lsm_t* db, int key);
+bool lsm_get(lsm_t* db, int key, int* value);
+void lsm_flush(lsm_t* db);
+
+/* Runs. */
+static void lsm_fail(const char* what, const char* path);
+static void lsm_writer_init(lsm_run_writer_t* w, char* path);
+static void lsm_writer_flush_block(lsm_run_writer_t* w);
+static void lsm_writer_add(lsm_run_writer_t* w, int key, lsm_entry_t entry);
+static lsm_run_t* lsm_writer_finish(lsm_run_writer_t* w, int level);
+static lsm_run_t* lsm_run_release(lsm_run_t* run);
+static void lsm_run_close(lsm_run_t* run);
+static uint32_t lsm_check_block(lsm_run_t* run, const unsigned char* block);
+static bool lsm_run_get(lsm_run_t* run, int key, lsm_entry_t* entry);
+static void lsm_cursor_init(lsm_cursor_t* c, lsm_run_t* run);
+static bool lsm_cursor_next(lsm_cursor_t* c, int* key, lsm_entry_t* entry);
+
+/* Background work. */
+static char* lsm_new_path(lsm_t* db);
+static void lsm_freeze_memtable(lsm_t* db);
+static void lsm_add_memtable(lsm_t* db, int key, lsm_entry_t entry);
+static void* lsm_flusher(void* arg);
+static lsm_run_t* lsm_merge(char* path, lsm_run_t** inputs, int k, int level, bool drop_tombstones);
+static bool lsm_pick_group(lsm_t* db, lsm_run_t** group);
+static void* lsm_compactor(void* arg);
+
+#endif
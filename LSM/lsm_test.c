@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "lsm.h"
+
+#define SIZE 10
+#define RANDOM_OPS 300000
+#define KEY_RANGE 20000
+#define MEMTABLE 1000
+#define READERS 3
+#define STABLE_KEYS 50000
+#define CHURN_OPS 200000
+#define BENCH_KEYS 1000000
+#define BENCH_MEMTABLE 65536
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Return the number of keys in 0..range - 1 whose lookup disagrees with the
+reference: present[k] tells whether k is in the map, with value values[k]. */
+size_t count_errors(lsm_t* db, const bool* present, const int* values, int range) {
+    size_t errors = 0;
+    for (int key = 0; key < range; key++) {
+        int value;
+        bool found = lsm_get(db, key, &value);
+        if (found != present[key] || (found && value != values[key]))
+            errors++;
+    }
+    return errors;
+}
+
+void print_state(lsm_t* db) {
+    pthread_mutex_lock(&db->lock);
+    printf("Runs (newest first):");
+    for (lsm_run_t* run = db->runs; run; run = run->next)
+        printf(" L%d:%zu", run->level, run->n_records);
+    printf("\nFlushes: %zu, compactions: %zu, records written: %zu\n",
+           db->flushes, db->compactions, db->records_written);
+    pthread_mutex_unlock(&db->lock);
+}
+
+typedef struct reader_arg {
+    lsm_t* db;
+    int id;
+    atomic_bool* done;
+    size_t lookups, errors;
+} reader_arg_t;
+
+/* The keys 0..STABLE_KEYS - 1 are never changed while the readers run: key k
+maps to 3k. The writer churns the keys above them. */
+void* reader(void* p) {
+    reader_arg_t* arg = p;
+    unsigned int seed = arg->id + 1;
+    while (!atomic_load(arg->done)) {
+        int key = rand_r(&seed) % STABLE_KEYS, value;
+        if (!lsm_get(arg->db, key, &value) || value != 3 * key)
+            arg->errors++;
+        arg->lookups++;
+    }
+    return NULL;
+}
+
+int main() {
+    char dir[] = "/tmp/lsm_testXXXXXX";
+    if (!mkdtemp(dir)) {
+        puts("Cannot create a temporary directory.");
+        return EXIT_FAILURE;
+    }
+
+    test_function("lsm_put, lsm_delete and lsm_get");
+    lsm_t* db = lsm_create(dir, 4);
+    for (int i = 0; i < SIZE; i++)
+        lsm_put(db, i, i * i);
+    lsm_delete(db, 3);
+    lsm_put(db, 5, -5);
+    lsm_delete(db, 42);
+    for (int flushed = 0; flushed <= 1; flushed++) {
+        printf("%s", (flushed) ? "After lsm_flush:  " : "Before lsm_flush: ");
+        for (int i = 0; i < SIZE; i++) {
+            int value;
+            if (lsm_get(db, i, &value))
+                printf("%d:%d ", i, value);
+            else
+                printf("%d:- ", i);
+        }
+        puts("");
+        lsm_flush(db);
+    }
+    print_state(db);
+    lsm_destroy(db);
+    puts("");
+
+    test_function("Random operations");
+    bool* present = calloc(KEY_RANGE, sizeof(bool));
+    int* values = calloc(KEY_RANGE, sizeof(int));
+    db = lsm_create(dir, MEMTABLE);
+    srand(1);
+    for (int i = 0; i < RANDOM_OPS; i++) {
+        int key = rand() % KEY_RANGE;
+        if (rand() % 4) {
+            values[key] = rand();
+            present[key] = true;
+            lsm_put(db, key, values[key]);
+        } else {
+            present[key] = false;
+            lsm_delete(db, key);
+        }
+    }
+    printf("%d operations on %d keys, wrong lookups while compacting: %zu\n",
+           RANDOM_OPS, KEY_RANGE, count_errors(db, present, values, KEY_RANGE));
+    lsm_flush(db);
+    printf("Wrong lookups after lsm_flush: %zu\n", count_errors(db, present, values, KEY_RANGE));
+    print_state(db);
+    lsm_destroy(db);
+    free(present);
+    free(values);
+    puts("");
+
+    test_function("Concurrent lookups");
+    db = lsm_create(dir, MEMTABLE);
+    for (int key = 0; key < STABLE_KEYS; key++)
+        lsm_put(db, key, 3 * key);
+    pthread_t threads[READERS];
+    reader_arg_t args[READERS];
+    atomic_bool done = false;
+    for (int i = 0; i < READERS; i++) {
+        args[i] = (reader_arg_t) {db, i, &done, 0, 0};
+        pthread_create(&threads[i], NULL, reader, &args[i]);
+    }
+    srand(2);
+    for (int i = 0; i < CHURN_OPS; i++) {
+        int key = STABLE_KEYS + rand() % STABLE_KEYS;
+        if (rand() % 3)
+            lsm_put(db, key, i);
+        else
+            lsm_delete(db, key);
+    }
+    lsm_flush(db);
+    atomic_store(&done, true);
+    size_t lookups = 0, errors = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(threads[i], NULL);
+        lookups += args[i].lookups;
+        errors += args[i].errors;
+    }
+    printf("%d readers, %d writes: %zu lookups, %zu wrong answers\n", READERS, CHURN_OPS, lookups, errors);
+    print_state(db);
+    lsm_destroy(db);
+    puts("");
+
+    test_function("Throughput and write amplification");
+    int* keys = malloc(BENCH_KEYS * sizeof(int));
+    for (int i = 0; i < BENCH_KEYS; i++)
+        keys[i] = i;
+    srand(3);
+    for (int i = BENCH_KEYS - 1; i > 0; i--) {
+        int j = rand() % (i + 1), tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+    db = lsm_create(dir, BENCH_MEMTABLE);
+    double start = seconds();
+    for (int i = 0; i < BENCH_KEYS; i++)
+        lsm_put(db, keys[i], i);
+    lsm_flush(db);
+    double elapsed = seconds() - start;
+    printf("%d random puts: %.2f s (%.0f puts/s), including the final flush\n",
+           BENCH_KEYS, elapsed, BENCH_KEYS / elapsed);
+    printf("Write amplification: %.2f records written per put\n", (double) db->records_written / BENCH_KEYS);
+    start = seconds();
+    errors = 0;
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        int value;
+        if (!lsm_get(db, keys[i], &value) || value != i)
+            errors++;
+    }
+    elapsed = seconds() - start;
+    printf("%d random gets: %.2f s (%.0f gets/s), wrong answers: %zu\n",
+           BENCH_KEYS, elapsed, BENCH_KEYS / elapsed, errors);
+    print_state(db);
+    lsm_destroy(db);
+    free(keys);
+
+    if (rmdir(dir))
+        puts("The temporary directory is not empty.");
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+* This is a free-list allocator for the nodes of the linked data structures
+* (stack, queue, lists). Every push or enqueue would otherwise call `malloc`
+* and every pop or dequeue `free`. With a pool, the steady state only moves
+* nodes between the structure and the free list of the pool.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include "node_pool.h"
+
+#define SLAB_HEADER_SIZE \
+    ((sizeof(pool_slab_t) + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1))
+
+#define SLAB_OF(obj) ((pool_slab_t*) ((uintptr_t) (obj) & ~((uintptr_t) POOL_SLAB_SIZE - 1)))
+
+/* One pool per size class for each thread. */
+static _Thread_local pool_t tls_pools[POOL_TLS_CLASSES];
+
+/* Initialize an empty pool for objects of `obj_size` bytes. No memory is allocated. */
+void pool_init(pool_t* pool, size_t obj_size) {
+    size_t align = _Alignof(max_align_t);
+    if (obj_size < sizeof(pool_object_t))
+        obj_size = sizeof(pool_object_t);
+    obj_size = (obj_size + align - 1) & ~(align - 1);
+
+    if (obj_size > POOL_SLAB_SIZE - SLAB_HEADER_SIZE) {
+        printf("Objects of %zu bytes do not fit in a slab.\n", obj_size);
+        exit(EXIT_FAILURE);
+    }
+
+    pool->obj_size = obj_size;
+    pool->objs_per_slab = (POOL_SLAB_SIZE - SLAB_HEADER_SIZE) / obj_size;
+    pool->free_list = NULL;
+    pool->n_free = 0;
+    pool->slabs = NULL;
+    pool->n_slabs = 0;
+}
+
+/* Allocate memory for a pool. Return the pool instance. */
+pool_t* pool_create(size_t obj_size) {
+    pool_t* pool = malloc(sizeof(pool_t));
+    assert(pool);
+    pool_init(pool, obj_size);
+    return pool;
+}
+
+/* Allocate a new slab and push all its objects on the free list. */
+static void pool_refill(pool_t* pool) {
+    pool_slab_t* slab = aligned_alloc(POOL_SLAB_SIZE, POOL_SLAB_SIZE);
+    assert(slab);
+
+    slab->owner = pool;
+    slab->in_use = 0;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->n_slabs++;
+
+    /* Push the objects in reverse order, so they are handed out by increasing address. */
+    char* first = (char*) slab + SLAB_HEADER_SIZE;
+    for (size_t i = pool->objs_per_slab; i > 0; i--) {
+        pool_object_t* obj = (pool_object_t*) (first + (i - 1) * pool->obj_size);
+        obj->next = pool->free_list;
+        pool->free_list = obj;
+    }
+    pool->n_free += pool->objs_per_slab;
+}
+
+/* Return an object from the pool. The content of the object is undefined. */
+void* pool_alloc(pool_t* pool) {
+    if (!pool->free_list)
+        pool_refill(pool);
+
+    pool_object_t* obj = pool->free_list;
+    pool->free_list = obj->next;
+    pool->n_free--;
+    SLAB_OF(obj)->in_use++;
+
+    return obj;
+}
+
+/* Give an object back to the pool it was allocated from. */
+void pool_release(pool_t* pool, void* obj) {
+    if (!obj)
+        return;
+
+    pool_slab_t* slab = SLAB_OF(obj);
+    assert(slab->owner == pool);
+    slab->in_use--;
+
+    pool_object_t* free_obj = obj;
+    free_obj->next = pool->free_list;
+    pool->free_list = free_obj;
+    pool->n_free++;
+}
+
+/* Give back to the system the slabs whose objects are all free.
+Return the number of released bytes. */
+size_t pool_trim(pool_t* pool) {
+    pool_object_t **link, *obj;
+    pool_slab_t **slab_link, *slab;
+    size_t released = 0;
+
+    // Unlink from the free list the objects that belong to empty slabs.
+    link = &pool->free_list;
+    while ((obj = *link)) {
+        if (SLAB_OF(obj)->in_use == 0) {
+            *link = obj->next;
+            pool->n_free--;
+        } else {
+            link = &obj->next;
+        }
+    }
+
+    slab_link = &pool->slabs;
+    while ((slab = *slab_link)) {
+        if (slab->in_use == 0) {
+            *slab_link = slab->next;
+            pool->n_slabs--;
+            free(slab);
+            released += POOL_SLAB_SIZE;
+        } else {
+            slab_link = &slab->next;
+        }
+    }
+
+    return released;
+}
+
+/* Free all the slabs of the pool, including the objects still in use. */
+void pool_destroy(pool_t* pool) {
+    pool_slab_t* slab = pool->slabs;
+    while (slab) {
+        pool_slab_t* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    pool->slabs = NULL;
+    pool->n_slabs = 0;
+    pool->free_list = NULL;
+    pool->n_free = 0;
+}
+
+/* Return the pool of the calling thread for objects of `obj_size` bytes. Objects
+taken from a thread-local pool must be released by the same thread. */
+pool_t* pool_thread_local(size_t obj_size) {
+    size_t cls = (obj_size + POOL_TLS_GRANULE - 1) / POOL_TLS_GRANULE;
+    if (cls == 0)
+        cls = 1;
+    if (cls > POOL_TLS_CLASSES) {
+        printf("Objects of %zu bytes have no thread-local pool.\n", obj_size);
+        exit(EXIT_FAILURE);
+    }
+
+    pool_t* pool = &tls_pools[cls - 1];
+    if (pool->obj_size == 0)
+        pool_init(pool, cls * POOL_TLS_GRANULE);
+    return pool;
+}
+
+/* Free the thread-local pools of the calling thread. Call it before the thread exits. */
+void pool_thread_local_destroy(void) {
+    for (int i = 0; i < POOL_TLS_CLASSES; i++) {
+        if (tls_pools[i].obj_size)
+            pool_destroy(&tls_pools[i]);
+        tls_pools[i].obj_size = 0;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <stddef.h>
+
+#define POOL_SLAB_SIZE (64 * 1024)  // Slabs are aligned to their size
+#define POOL_TLS_CLASSES 16         // Size classes of the thread-local pools
+#define POOL_TLS_GRANULE 16         // Thread-local size classes are multiples of this
+
+/* Header at the beginning of every slab. The slab of an object is found by
+clearing the low bits of its address, so the header is reached in O(1). */
+typedef struct pool_slab {
+    struct pool_slab* next;
+    struct pool* owner;
+    size_t in_use;  // Objects of this slab currently handed out
+} pool_slab_t;
+
+/* A free object stores the link to the next free object in its own memory. */
+typedef struct pool_object {
+    struct pool_object* next;
+} pool_object_t;
+
+/* Pool of equally sized objects. Released objects go to a free list and are
+handed out again by the next allocation; when the free list is empty, a whole
+slab is carved into objects at once. Memory goes back to the system only
+through `pool_trim` or `pool_destroy`. A pool is not thread safe. */
+typedef struct pool {
+    size_t obj_size;
+    size_t objs_per_slab;
+    pool_object_t* free_list;
+    size_t n_free;
+    pool_slab_t* slabs;
+    size_t n_slabs;
+} pool_t;
+
+void pool_init(pool_t* pool, size_t obj_size);
+pool_t* pool_create(size_t obj_size);
+static void pool_refill(pool_t* pool);
+void* pool_alloc(pool_t* pool);
+void pool_release(pool_t* pool, void* obj);
+size_t pool_trim(pool_t* pool);
+void pool_destroy(pool_t* pool);
+pool_t* pool_thread_local(size_t obj_size);
+void pool_thread_local_destroy(void);
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include "node_pool.h"
+#include "../stack.c"
+
+#define SIZE 100
+#define ROUNDS 200000
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+void print_pool(pool_t* pool) {
+    printf("Object size: %zu, slabs: %zu, free objects: %zu\n",
+           pool->obj_size, pool->n_slabs, pool->n_free);
+}
+
+double seconds_since(clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main() {
+    node_t* head = NULL;
+    pool_t* pool = pool_create(sizeof(node_t));
+
+    test_function("push_pooled and pop_pooled");
+    print_pool(pool);
+    for (int i = 0; i < 26; i++)
+        push_pooled(pool, &head, 'a' + i);
+    printf("%s", "Pop 26 items: ");
+    while (head)
+        printf("%c ", pop_pooled(pool, &head));
+    puts("");
+    print_pool(pool);
+    puts("");
+
+    test_function("Steady state");
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < SIZE; i++)
+            push_pooled(pool, &head, 'a' + i % 26);
+        for (int i = 0; i < SIZE; i++)
+            pop_pooled(pool, &head);
+    }
+    printf("After %d rounds of %d pushes and %d pops:\n", ROUNDS, SIZE, SIZE);
+    print_pool(pool);
+
+    clock_t start = clock();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < SIZE; i++)
+            push(&head, 'a' + i % 26);
+        for (int i = 0; i < SIZE; i++)
+            pop(&head);
+    }
+    printf("push/pop with malloc/free: %.3f s\n", seconds_since(start));
+    start = clock();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < SIZE; i++)
+            push_pooled(pool, &head, 'a' + i % 26);
+        for (int i = 0; i < SIZE; i++)
+            pop_pooled(pool, &head);
+    }
+    printf("push/pop with the pool:    %.3f s\n", seconds_since(start));
+    puts("");
+
+    test_function("pool_trim");
+    int n = 3 * (int) pool->objs_per_slab;
+    for (int i = 0; i < n; i++)
+        push_pooled(pool, &head, 'x');
+    printf("After %d pushes:\n", n);
+    print_pool(pool);
+    printf("Trim releases %zu bytes\n", pool_trim(pool));
+    for (int i = 0; i < n; i++)
+        pop_pooled(pool, &head);
+    printf("After %d pops:\n", n);
+    print_pool(pool);
+    printf("Trim releases %zu bytes\n", pool_trim(pool));
+    print_pool(pool);
+    puts("");
+
+    test_function("pool_thread_local");
+    pool_t* tls = pool_thread_local(sizeof(node_t));
+    assert(tls == pool_thread_local(sizeof(node_t)));
+    for (int i = 0; i < 5; i++)
+        push_pooled(tls, &head, '0' + i);
+    printf("%s", "Pop 5 items: ");
+    while (head)
+        printf("%c ", pop_pooled(tls, &head));
+    puts("");
+    print_pool(tls);
+    pool_thread_local_destroy();
+
+    pool_destroy(pool);
+    free(pool);
+    return 0;
+}
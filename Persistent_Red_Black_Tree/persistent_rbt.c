@@ -0,0 +1,356 @@
+/*
+* This is a persistent (path-copying) red-black set for workloads where many
+* readers need a consistent view of the data while writers keep updating it.
+* A reader takes a snapshot, which is just the root of the current version,
+* and walks it without locks: the nodes of a published version are never
+* modified. An update copies the O(log n) nodes on its path, links them to the
+* untouched subtrees of the previous version and publishes the new root with
+* a single atomic store. The nodes that only the old versions reach are
+* retired with epoch-based reclamation (see Epoch/) and freed once no reader
+* can be walking them.
+*
+* Without parent pointers, rebalancing is done on the way back from the
+* recursion, as in the functional red-black trees of Okasaki (insertion) and
+* Kahrs (deletion). Every rebuilt node passes through prbt_make, which modifies
+* the node in place if this update created it and copies it otherwise, so each
+* update allocates only the nodes of the new version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "persistent_rbt.h"
+
+/* Allocate an empty set whose old nodes are reclaimed through the domain. */
+prbt_t* prbt_create(epoch_domain_t* domain) {
+    prbt_t* tree = malloc(sizeof(prbt_t));
+    assert(tree);
+    atomic_init(&tree->root, NULL);
+    pthread_mutex_init(&tree->writer, NULL);
+    tree->domain = domain;
+    tree->retired = NULL;
+    tree->n_retired = tree->cap_retired = 0;
+    return tree;
+}
+
+static void prbt_free_subtree(prbt_node_t* root) {
+    if (!root) return;
+    prbt_free_subtree(root->left);
+    prbt_free_subtree(root->right);
+    free(root);
+}
+
+/* Free the current version. No thread may be using the set; the nodes of older
+versions are released by the epoch domain. */
+void prbt_free(prbt_t* tree) {
+    if (!tree)
+        return;
+    prbt_free_subtree(atomic_load_explicit(&tree->root, memory_order_relaxed));
+    pthread_mutex_destroy(&tree->writer);
+    free(tree->retired);
+    free(tree);
+}
+
+/* Set the node aside until the update is published. Retiring it right away would
+be wrong: it is still reachable from the current root, and the epoch may move
+on before the new root replaces it. */
+static void prbt_retire(prbt_t* tree, prbt_node_t* node) {
+    if (tree->n_retired == tree->cap_retired) {
+        tree->cap_retired = (tree->cap_retired) ? 2 * tree->cap_retired : 64;
+        tree->retired = realloc(tree->retired, tree->cap_retired * sizeof(prbt_node_t*));
+        assert(tree->retired);
+    }
+    tree->retired[tree->n_retired++] = node;
+}
+
+/* Return a node with the given fields. If `reuse` was created by the current
+update it is overwritten; if it is published, it is copied and retired, since
+readers of older versions may still reach it. */
+static prbt_node_t* prbt_make(
+    prbt_t* tree, prbt_node_t* reuse, PRBT_COLOR color,
+    prbt_node_t* left, int key, prbt_node_t* right
+) {
+    prbt_node_t* node = reuse;
+
+    if (!reuse || reuse->published) {
+        node = malloc(sizeof(prbt_node_t));
+        assert(node);
+        node->published = false;
+        if (reuse)
+            prbt_retire(tree, reuse);
+    }
+    node->key = key;
+    node->color = color;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+/* Dispose of a node that is not part of the new version. */
+static void prbt_drop(prbt_t* tree, prbt_node_t* node) {
+    if (node->published)
+        prbt_retire(tree, node);
+    else
+        free(node);
+}
+
+static bool prbt_is_red(const prbt_node_t* node) {
+    return node && node->color == PRBT_RED;
+}
+
+/* Build the black node (a, key, b), where a or b may have a red child below a
+red root, and resolve the red-red violation with the four cases of Okasaki. */
+static prbt_node_t* prbt_balance(
+    prbt_t* tree, prbt_node_t* reuse, prbt_node_t* a, int key, prbt_node_t* b
+) {
+    prbt_node_t *x, *y, *z, *t1, *t2, *t3, *t4, *l, *r;
+    int kx, ky, kz;
+
+    if (prbt_is_red(a) && prbt_is_red(b)) {
+        l = prbt_make(tree, a, PRBT_BLACK, a->left, a->key, a->right);
+        r = prbt_make(tree, b, PRBT_BLACK, b->left, b->key, b->right);
+        return prbt_make(tree, reuse, PRBT_RED, l, key, r);
+    }
+
+    // Name the three nodes x < y < z and the four subtrees t1..t4 in order.
+    if (prbt_is_red(a) && prbt_is_red(a->left)) {
+        x = a->left; y = a; z = reuse;
+        t1 = x->left; t2 = x->right; t3 = a->right; t4 = b;
+        kx = x->key; ky = a->key; kz = key;
+    } else if (prbt_is_red(a) && prbt_is_red(a->right)) {
+        x = a; y = a->right; z = reuse;
+        t1 = a->left; t2 = y->left; t3 = y->right; t4 = b;
+        kx = a->key; ky = y->key; kz = key;
+    } else if (prbt_is_red(b) && prbt_is_red(b->left)) {
+        x = reuse; y = b->left; z = b;
+        t1 = a; t2 = y->left; t3 = y->right; t4 = b->right;
+        kx = key; ky = y->key; kz = b->key;
+    } else if (prbt_is_red(b) && prbt_is_red(b->right)) {
+        x = reuse; y = b; z = b->right;
+        t1 = a; t2 = b->left; t3 = z->left; t4 = z->right;
+        kx = key; ky = b->key; kz = z->key;
+    } else {
+        return prbt_make(tree, reuse, PRBT_BLACK, a, key, b);
+    }
+
+    l = prbt_make(tree, x, PRBT_BLACK, t1, kx, t2);
+    r = prbt_make(tree, z, PRBT_BLACK, t3, kz, t4);
+    return prbt_make(tree, y, PRBT_RED, l, ky, r);
+}
+
+/* Insert the key below the node. Return the node itself if the key is already
+there, else the root of the new subtree, which may be red with a red child. */
+static prbt_node_t* prbt_ins(prbt_t* tree, prbt_node_t* node, int key) {
+    if (!node)
+        return prbt_make(tree, NULL, PRBT_RED, NULL, key, NULL);
+    if (key == node->key)
+        return node;
+
+    if (key < node->key) {
+        prbt_node_t* left = prbt_ins(tree, node->left, key);
+        if (left == node->left)
+            return node;
+        if (node->color == PRBT_BLACK)
+            return prbt_balance(tree, node, left, node->key, node->right);
+        return prbt_make(tree, node, PRBT_RED, left, node->key, node->right);
+    } else {
+        prbt_node_t* right = prbt_ins(tree, node->right, key);
+        if (right == node->right)
+            return node;
+        if (node->color == PRBT_BLACK)
+            return prbt_balance(tree, node, node->left, node->key, right);
+        return prbt_make(tree, node, PRBT_RED, node->left, node->key, right);
+    }
+}
+
+/* Build (left, key, right) when the black height of left is one less than the
+one of right, because a black node was removed from it. */
+static prbt_node_t* prbt_balance_left(
+    prbt_t* tree, prbt_node_t* reuse, prbt_node_t* left, int key, prbt_node_t* right
+) {
+    if (prbt_is_red(left)) {
+        left = prbt_make(tree, left, PRBT_BLACK, left->left, left->key, left->right);
+        return prbt_make(tree, reuse, PRBT_RED, left, key, right);
+    }
+    if (!prbt_is_red(right)) {
+        right = prbt_make(tree, right, PRBT_RED, right->left, right->key, right->right);
+        return prbt_balance(tree, reuse, left, key, right);
+    }
+
+    // Red right with a black left child y: y becomes the root.
+    prbt_node_t *y = right->left, *c = right->right;
+    int ky = y->key, kz = right->key;
+    prbt_node_t *t2 = y->left, *t3 = y->right;
+    assert(c && c->color == PRBT_BLACK);
+
+    c = prbt_make(tree, c, PRBT_RED, c->left, c->key, c->right);
+    prbt_node_t* l = prbt_make(tree, reuse, PRBT_BLACK, left, key, t2);
+    prbt_node_t* r = prbt_balance(tree, right, t3, kz, c);
+    return prbt_make(tree, y, PRBT_RED, l, ky, r);
+}
+
+/* Mirror of prbt_balance_left: the black height of right is one less. */
+static prbt_node_t* prbt_balance_right(
+    prbt_t* tree, prbt_node_t* reuse, prbt_node_t* left, int key, prbt_node_t* right
+) {
+    if (prbt_is_red(right)) {
+        right = prbt_make(tree, right, PRBT_BLACK, right->left, right->key, right->right);
+        return prbt_make(tree, reuse, PRBT_RED, left, key, right);
+    }
+    if (!prbt_is_red(left)) {
+        left = prbt_make(tree, left, PRBT_RED, left->left, left->key, left->right);
+        return prbt_balance(tree, reuse, left, key, right);
+    }
+
+    // Red left with a black right child y: y becomes the root.
+    prbt_node_t *y = left->right, *a = left->left;
+    int ky = y->key, kx = left->key;
+    prbt_node_t *t2 = y->left, *t3 = y->right;
+    assert(a && a->color == PRBT_BLACK);
+
+    a = prbt_make(tree, a, PRBT_RED, a->left, a->key, a->right);
+    prbt_node_t* l = prbt_balance(tree, left, a, kx, t2);
+    prbt_node_t* r = prbt_make(tree, reuse, PRBT_BLACK, t3, key, right);
+    return prbt_make(tree, y, PRBT_RED, l, ky, r);
+}
+
+/* Merge two trees of equal black height, all keys of a before those of b. */
+static prbt_node_t* prbt_fuse(prbt_t* tree, prbt_node_t* a, prbt_node_t* b) {
+    if (!a)
+        return b;
+    if (!b)
+        return a;
+
+    prbt_node_t *al = a->left, *ar = a->right, *bl = b->left, *br = b->right;
+    int ka = a->key, kb = b->key;
+
+    if (prbt_is_red(a) != prbt_is_red(b)) {  // Descend through the red one
+        if (prbt_is_red(b))
+            return prbt_make(tree, b, PRBT_RED, prbt_fuse(tree, a, bl), kb, br);
+        return prbt_make(tree, a, PRBT_RED, al, ka, prbt_fuse(tree, ar, b));
+    }
+
+    PRBT_COLOR color = a->color;
+    prbt_node_t* mid = prbt_fuse(tree, ar, bl);
+    if (prbt_is_red(mid)) {
+        prbt_node_t *ml = mid->left, *mr = mid->right;
+        int km = mid->key;
+        prbt_node_t* l = prbt_make(tree, a, color, al, ka, ml);
+        prbt_node_t* r = prbt_make(tree, b, color, mr, kb, br);
+        return prbt_make(tree, mid, PRBT_RED, l, km, r);
+    }
+    if (color == PRBT_RED)
+        return prbt_make(tree, a, PRBT_RED, al, ka, prbt_make(tree, b, PRBT_RED, mid, kb, br));
+    return prbt_balance_left(tree, a, al, ka, prbt_make(tree, b, PRBT_BLACK, mid, kb, br));
+}
+
+/* Remove the key, which must be in the subtree. The result may have a red root;
+if the node was black, its black height is one less. */
+static prbt_node_t* prbt_del(prbt_t* tree, prbt_node_t* node, int key) {
+    prbt_node_t *left = node->left, *right = node->right;
+    int node_key = node->key;
+
+    if (key < node_key) {
+        bool black = left && left->color == PRBT_BLACK;
+        left = prbt_del(tree, left, key);
+        if (black)
+            return prbt_balance_left(tree, node, left, node_key, right);
+        return prbt_make(tree, node, PRBT_RED, left, node_key, right);
+    }
+    if (key > node_key) {
+        bool black = right && right->color == PRBT_BLACK;
+        right = prbt_del(tree, right, key);
+        if (black)
+            return prbt_balance_right(tree, node, left, node_key, right);
+        return prbt_make(tree, node, PRBT_RED, left, node_key, right);
+    }
+
+    prbt_node_t* fused = prbt_fuse(tree, left, right);
+    prbt_drop(tree, node);
+    return fused;
+}
+
+/* The nodes created by an update form a subtree hanging from the new root,
+since published nodes never point to newer ones. */
+static void prbt_mark_published(prbt_node_t* node) {
+    if (!node || node->published)
+        return;
+    node->published = true;
+    prbt_mark_published(node->left);
+    prbt_mark_published(node->right);
+}
+
+/* Make the new version visible to the readers, then retire the nodes it
+replaced. After a deletion the new root can be a red node of the old version,
+which is copied rather than recolored. */
+static void prbt_publish(prbt_t* tree, epoch_record_t* record, prbt_node_t* root) {
+    if (prbt_is_red(root))
+        root = prbt_make(tree, root, PRBT_BLACK, root->left, root->key, root->right);
+    prbt_mark_published(root);
+    atomic_store_explicit(&tree->root, root, memory_order_release);
+
+    for (size_t i = 0; i < tree->n_retired; i++)
+        epoch_retire(record, tree->retired[i], free);
+    tree->n_retired = 0;
+}
+
+static bool prbt_search(const prbt_node_t* root, int key) {
+    while (root && root->key != key)
+        root = (root->key > key) ? root->left : root->right;
+    return root != NULL;
+}
+
+/* Add the key to the set. Return false if it was already there. The calling
+thread's epoch record receives the nodes of the old version. */
+bool prbt_insert(prbt_t* tree, epoch_record_t* record, int key) {
+    pthread_mutex_lock(&tree->writer);
+    prbt_node_t* old_root = atomic_load_explicit(&tree->root, memory_order_relaxed);
+    prbt_node_t* root = prbt_ins(tree, old_root, key);
+    bool inserted = (root != old_root);
+    if (inserted)
+        prbt_publish(tree, record, root);
+    pthread_mutex_unlock(&tree->writer);
+    return inserted;
+}
+
+/* Remove the key from the set. Return false if it was not there. */
+bool prbt_delete(prbt_t* tree, epoch_record_t* record, int key) {
+    pthread_mutex_lock(&tree->writer);
+    prbt_node_t* root = atomic_load_explicit(&tree->root, memory_order_relaxed);
+    bool found = prbt_search(root, key);
+    if (found)
+        prbt_publish(tree, record, prbt_del(tree, root, key));
+    pthread_mutex_unlock(&tree->writer);
+    return found;
+}
+
+/* Pin the current version. Until the snapshot is released, its nodes stay valid
+and unchanged whatever the writers do. Take one snapshot per record at a time. */
+void prbt_snapshot_take(prbt_t* tree, epoch_record_t* record, prbt_snapshot_t* snapshot) {
+    epoch_enter(record);
+    snapshot->record = record;
+    snapshot->root = atomic_load_explicit(&tree->root, memory_order_acquire);
+}
+
+void prbt_snapshot_release(prbt_snapshot_t* snapshot) {
+    snapshot->root = NULL;
+    epoch_exit(snapshot->record);
+}
+
+/* Return true if the key is in the version of the snapshot. */
+bool prbt_snapshot_contains(const prbt_snapshot_t* snapshot, int key) {
+    return prbt_search(snapshot->root, key);
+}
+
+static void prbt_for_each_subtree(const prbt_node_t* root, void (*fn)(int key, void* ctx), void* ctx) {
+    if (!root) return;
+    prbt_for_each_subtree(root->left, fn, ctx);
+    fn(root->key, ctx);
+    prbt_for_each_subtree(root->right, fn, ctx);
+}
+
+/* Call fn on every key of the snapshot in increasing order. */
+void prbt_snapshot_for_each(const prbt_snapshot_t* snapshot, void (*fn)(int key, void* ctx), void* ctx) {
+    prbt_for_each_subtree(snapshot->root, fn, ctx);
+}
@@ -0,0 +1,66 @@
+#ifndef PERSISTENT_RBT_H
+#define PERSISTENT_RBT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "../Epoch/epoch.h"
+
+typedef enum {
+    PRBT_RED, PRBT_BLACK
+} PRBT_COLOR;
+
+/* No parent pointer: a node is shared by every version that did not change
+its subtree, so it has no single parent. `published` is set when the node
+becomes reachable by readers; from then on the node is never modified. */
+typedef struct prbt_node {
+    int key;
+    unsigned char color;
+    bool published;
+    struct prbt_node *left, *right;
+} prbt_node_t;
+
+/* Persistent red-black set. Every update builds a new version that shares all
+the unchanged subtrees with the previous one and publishes it by swapping the
+root. Writers are serialized by `writer`; readers take no lock. `retired`
+holds the nodes replaced by the update in progress. */
+typedef struct persistent_rbt {
+    _Atomic(prbt_node_t*) root;
+    pthread_mutex_t writer;
+    epoch_domain_t* domain;
+    prbt_node_t** retired;
+    size_t n_retired, cap_retired;
+} prbt_t;
+
+/* A reader's consistent view: the version that was current when it was taken. */
+typedef struct prbt_snapshot {
+    const prbt_node_t* root;
+    epoch_record_t* record;
+} prbt_snapshot_t;
+
+prbt_t* prbt_create(epoch_domain_t* domain);
+static void prbt_free_subtree(prbt_node_t* root);
+void prbt_free(prbt_t* tree);
+static void prbt_retire(prbt_t* tree, prbt_node_t* node);
+static prbt_node_t* prbt_make(prbt_t* tree, prbt_node_t* reuse, PRBT_COLOR color, prbt_node_t* left, int key, prbt_node_t* right);
+static void prbt_drop(prbt_t* tree, prbt_node_t* node);
+static bool prbt_is_red(const prbt_node_t* node);
+static prbt_node_t* prbt_balance(prbt_t* tree, prbt_node_t* reuse, prbt_node_t* a, int key, prbt_node_t* b);
+static prbt_node_t* prbt_ins(prbt_t* tree, prbt_node_t* node, int key);
+static prbt_node_t* prbt_balance_left(prbt_t* tree, prbt_node_t* reuse, prbt_node_t* left, int key, prbt_node_t* right);
+static prbt_node_t* prbt_balance_right(prbt_t* tree, prbt_node_t* reuse, prbt_node_t* left, int key, prbt_node_t* right);
+static prbt_node_t* prbt_fuse(prbt_t* tree, prbt_node_t* a, prbt_node_t* b);
+static prbt_node_t* prbt_del(prbt_t* tree, prbt_node_t* node, int key);
+static void prbt_mark_published(prbt_node_t* node);
+static void prbt_publish(prbt_t* tree, epoch_record_t* record, prbt_node_t* root);
+static bool prbt_search(const prbt_node_t* root, int key);
+bool prbt_insert(prbt_t* tree, epoch_record_t* record, int key);
+bool prbt_delete(prbt_t* tree, epoch_record_t* record, int key);
+void prbt_snapshot_take(prbt_t* tree, epoch_record_t* record, prbt_snapshot_t* snapshot);
+void prbt_snapshot_release(prbt_snapshot_t* snapshot);
+bool prbt_snapshot_contains(const prbt_snapshot_t* snapshot, int key);
+static void prbt_for_each_subtree(const prbt_node_t* root, void (*fn)(int key, void* ctx), void* ctx);
+void prbt_snapshot_for_each(const prbt_snapshot_t* snapshot, void (*fn)(int key, void* ctx), void* ctx);
+
+#endif
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "persistent_rbt.h"
+
+#define SIZE 8
+#define RANDOM_OPS 200000
+#define KEY_RANGE 2000
+#define READERS 4
+#define WRITER_OPS 200000
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+void print_key(int key, void* ctx) {
+    (void) ctx;
+    printf("%d ", key);
+}
+
+/* Append the key to an array of keys; ctx points to the next free slot. */
+void collect_key(int key, void* ctx) {
+    int** next = ctx;
+    *(*next)++ = key;
+}
+
+/* Return the black height of the subtree, or -1 if a red-black or BST property
+is violated. */
+int check_subtree(const prbt_node_t* node, long lo, long hi) {
+    if (!node)
+        return 0;
+    if (node->key <= lo || node->key >= hi || !node->published)
+        return -1;
+    bool red = node->color == PRBT_RED;
+    if (red && ((node->left && node->left->color == PRBT_RED) ||
+                (node->right && node->right->color == PRBT_RED)))
+        return -1;
+
+    int bh_left = check_subtree(node->left, lo, node->key);
+    int bh_right = check_subtree(node->right, node->key, hi);
+    if (bh_left < 0 || bh_left != bh_right)
+        return -1;
+    return bh_left + !red;
+}
+
+bool check_prbt(prbt_t* tree) {
+    const prbt_node_t* root = atomic_load(&tree->root);
+    return (!root || root->color == PRBT_BLACK) && check_subtree(root, LONG_MIN, LONG_MAX) >= 0;
+}
+
+typedef struct reader_arg {
+    prbt_t* tree;
+    epoch_domain_t* domain;
+    atomic_bool* done;
+    size_t snapshots, errors;
+} reader_arg_t;
+
+/* The writer moves a key k to k + KEY_RANGE or back, inserting before deleting,
+so every version holds KEY_RANGE or KEY_RANGE + 1 keys. A snapshot must be a
+valid red-black tree and must not change while it is walked. */
+void* reader(void* p) {
+    reader_arg_t* arg = p;
+    epoch_record_t* record = epoch_register(arg->domain);
+    int* keys = malloc(2 * (KEY_RANGE + 1) * sizeof(int));
+
+    while (!atomic_load(arg->done)) {
+        prbt_snapshot_t snapshot;
+        prbt_snapshot_take(arg->tree, record, &snapshot);
+        int* next = keys;
+        prbt_snapshot_for_each(&snapshot, collect_key, &next);
+        long len = next - keys;
+        if (len != KEY_RANGE && len != KEY_RANGE + 1)
+            arg->errors++;
+        if (check_subtree(snapshot.root, LONG_MIN, LONG_MAX) < 0)
+            arg->errors++;
+        prbt_snapshot_for_each(&snapshot, collect_key, &next);
+        if (next - keys != 2 * len || memcmp(keys, keys + len, len * sizeof(int)))
+            arg->errors++;
+        prbt_snapshot_release(&snapshot);
+        arg->snapshots++;
+    }
+    free(keys);
+    epoch_unregister(record);
+    return NULL;
+}
+
+int main() {
+    int arr[SIZE] = {11, 2, 14, 1, 7, 15, 5, 8};
+    epoch_domain_t* domain = epoch_create();
+    epoch_record_t* record = epoch_register(domain);
+
+    test_function("prbt_insert");
+    prbt_t* tree = prbt_create(domain);
+    for (int i = 0; i < SIZE; i++)
+        prbt_insert(tree, record, arr[i]);
+    prbt_snapshot_t snapshot;
+    prbt_snapshot_take(tree, record, &snapshot);
+    printf("%s", "Insert 11, 2, 14, 1, 7, 15, 5, 8. In order: ");
+    prbt_snapshot_for_each(&snapshot, print_key, NULL);
+    printf("\n5 is in the tree: %s, 6 is in the tree: %s, inserting 5 again: %s\n\n",
+           prbt_snapshot_contains(&snapshot, 5) ? "true" : "false",
+           prbt_snapshot_contains(&snapshot, 6) ? "true" : "false",
+           prbt_insert(tree, record, 5) ? "inserted" : "already there");
+
+    test_function("prbt_delete");
+    prbt_delete(tree, record, 7);
+    prbt_delete(tree, record, 1);
+    prbt_insert(tree, record, 20);
+    printf("%s", "After deleting 7 and 1 and inserting 20: ");
+    prbt_snapshot_t after;
+    prbt_snapshot_take(tree, record, &after);
+    prbt_snapshot_for_each(&after, print_key, NULL);
+    prbt_snapshot_release(&after);
+    printf("\nThe snapshot taken before still holds: ");
+    prbt_snapshot_for_each(&snapshot, print_key, NULL);
+    prbt_snapshot_release(&snapshot);
+    printf("\nThe tree is valid: %s\n\n", check_prbt(tree) ? "true" : "false");
+    prbt_free(tree);
+
+    test_function("Random insertions and deletions");
+    bool* in_set = calloc(KEY_RANGE, sizeof(bool));
+    size_t len = 0;
+    bool ok = true;
+    srand(1);
+    tree = prbt_create(domain);
+    for (int i = 0; i < RANDOM_OPS && ok; i++) {
+        int key = rand() % KEY_RANGE;
+        bool changed = (rand() % 2) ? prbt_insert(tree, record, key) : prbt_delete(tree, record, key);
+        if (changed) {
+            len += in_set[key] ? -1 : 1;
+            in_set[key] = !in_set[key];
+        }
+        if (i % 1000 == 0)
+            ok = check_prbt(tree);
+    }
+    int* keys = malloc(KEY_RANGE * sizeof(int));
+    int* next = keys;
+    prbt_snapshot_take(tree, record, &snapshot);
+    prbt_snapshot_for_each(&snapshot, collect_key, &next);
+    prbt_snapshot_release(&snapshot);
+    ok = ok && check_prbt(tree) && next == keys + len;
+    for (int key = 0, j = 0; key < KEY_RANGE && ok; key++)
+        if (in_set[key])
+            ok = keys[j++] == key;
+    printf("Keys: %zu\n", len);
+    printf("Red-black properties hold and the keys agree with a reference set: %s\n\n",
+           ok ? "true" : "false");
+    free(keys);
+    free(in_set);
+    prbt_free(tree);
+
+    test_function("Concurrent snapshots");
+    atomic_bool done = false;
+    pthread_t threads[READERS];
+    reader_arg_t args[READERS];
+    tree = prbt_create(domain);
+    for (int k = 0; k < KEY_RANGE; k++)
+        prbt_insert(tree, record, k);
+    for (int i = 0; i < READERS; i++) {
+        args[i] = (reader_arg_t) {tree, domain, &done, 0, 0};
+        pthread_create(&threads[i], NULL, reader, &args[i]);
+    }
+    for (int i = 0; i < WRITER_OPS; i++) {
+        int k = rand() % KEY_RANGE;
+        prbt_snapshot_take(tree, record, &snapshot);
+        bool low = prbt_snapshot_contains(&snapshot, k);
+        prbt_snapshot_release(&snapshot);
+        prbt_insert(tree, record, low ? k + KEY_RANGE : k);
+        prbt_delete(tree, record, low ? k : k + KEY_RANGE);
+    }
+    atomic_store(&done, true);
+    size_t snapshots = 0, errors = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(threads[i], NULL);
+        snapshots += args[i].snapshots;
+        errors += args[i].errors;
+    }
+    printf("%d readers took %zu snapshots, inconsistent ones: %zu\n", READERS, snapshots, errors);
+    printf("The tree is valid: %s\n", check_prbt(tree) ? "true" : "false");
+    prbt_free(tree);
+
+    epoch_unregister(record);
+    epoch_destroy(domain);
+    return 0;
+}
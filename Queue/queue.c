@@ -0,0 +1,565 @@
+/*
+* This file contains two implementations of the FIFO queue. The first one is a
+* linked list that allocates a node for every enqueued character. The second one
+* stores the characters in a ring buffer that grows when it is full, so enqueue
+* and dequeue do not touch the allocator in the steady state.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <sched.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+#include "queue.h"
+
+#define MPMC_SPIN 128  // Failed attempts before a blocking call goes to sleep
+
+void enqueue(queue_t** head, queue_t** tail, char ch) {
+    queue_t* new_node = malloc(sizeof(queue_t));
+    new_node->ch = ch;
+    new_node->prev = NULL;
+    if (!(*head))
+        *head = new_node;
+    else
+        (*tail)->prev = new_node;
+    *tail = new_node;
+    return;
+}
+
+void dequeue(queue_t** head, queue_t** tail) {
+    if (!(*head))
+        return;
+    queue_t* tmp = *head;
+    *head = (*head)->prev;
+    free(tmp);
+    if (!(*head))
+        *tail = NULL;
+}
+
+void print_queue(queue_t* head) {
+    printf("%s ", "Head ->");
+    while (head) {
+        printf("%c ", head->ch);
+        head = head->prev;
+    }
+    printf("%s", "<- Tail");
+    puts("");
+}
+
+/* Same as `enqueue`, but the node is taken from the pool instead of `malloc`. */
+void enqueue_pooled(pool_t* pool, queue_t** head, queue_t** tail, char ch) {
+    queue_t* new_node = pool_alloc(pool);
+    new_node->ch = ch;
+    new_node->prev = NULL;
+    if (!(*head))
+        *head = new_node;
+    else
+        (*tail)->prev = new_node;
+    *tail = new_node;
+}
+
+/* Same as `dequeue`, but the node is given back to the pool instead of `free`. */
+void dequeue_pooled(pool_t* pool, queue_t** head, queue_t** tail) {
+    if (!(*head))
+        return;
+    queue_t* tmp = *head;
+    *head = (*head)->prev;
+    pool_release(pool, tmp);
+    if (!(*head))
+        *tail = NULL;
+}
+
+
+/**
+Ring buffer queue.
+*/
+
+/* Round n up to the next power of two. */
+static size_t next_pow2(size_t n) {
+    size_t pow = 1;
+    while (pow < n)
+        pow <<= 1;
+    return pow;
+}
+
+/* Allocate a queue able to store at least `capacity` items before growing. */
+rqueue_t* rqueue_create(size_t capacity) {
+    rqueue_t* queue = malloc(sizeof(rqueue_t));
+    assert(queue);
+
+    if (capacity < RQUEUE_MIN_CAPACITY)
+        capacity = RQUEUE_MIN_CAPACITY;
+    capacity = next_pow2(capacity);
+
+    queue->buf = malloc(capacity);
+    assert(queue->buf);
+    queue->mask = capacity - 1;
+    queue->head = 0;
+    queue->tail = 0;
+
+    return queue;
+}
+
+/* Free the buffer and the queue itself. */
+void rqueue_free(rqueue_t* queue) {
+    if (!queue)
+        return;
+    free(queue->buf);
+    free(queue);
+}
+
+/* Return true if the queue does not contain any item, otherwise return false. */
+bool rqueue_is_empty(rqueue_t* queue) {
+    return queue->head == queue->tail;
+}
+
+/* Return the number of items in the queue. */
+size_t rqueue_len(rqueue_t* queue) {
+    return queue->tail - queue->head;
+}
+
+/* Return the number of items the queue can store before growing. */
+size_t rqueue_capacity(rqueue_t* queue) {
+    return queue->mask + 1;
+}
+
+/* Move the items to a buffer of at least `min_capacity` slots. The items
+are copied to the beginning of the new buffer, so the head is reset to 0. */
+static void rqueue_grow(rqueue_t* queue, size_t min_capacity) {
+    size_t len = rqueue_len(queue);
+    size_t capacity = next_pow2(min_capacity);
+    char* buf = malloc(capacity);
+    assert(buf);
+
+    rqueue_dequeue_bulk(queue, buf, len);
+    free(queue->buf);
+    queue->buf = buf;
+    queue->mask = capacity - 1;
+    queue->head = 0;
+    queue->tail = len;
+}
+
+/* Insert a character at the tail of the queue. */
+void rqueue_enqueue(rqueue_t* queue, char ch) {
+    if (rqueue_len(queue) == rqueue_capacity(queue))
+        rqueue_grow(queue, 2 * rqueue_capacity(queue));
+    queue->buf[queue->tail & queue->mask] = ch;
+    queue->tail++;
+}
+
+/* Remove the character at the head of the queue and store it in the output
+parameter, if different from NULL. Return false if the queue is empty. */
+bool rqueue_dequeue(rqueue_t* queue, char* ch) {
+    if (rqueue_is_empty(queue))
+        return false;
+    if (ch)
+        *ch = queue->buf[queue->head & queue->mask];
+    queue->head++;
+    return true;
+}
+
+/* Insert n characters at the tail of the queue. The copy is split
+in at most two `memcpy` calls at the end of the buffer. */
+void rqueue_enqueue_bulk(rqueue_t* queue, const char* src, size_t n) {
+    if (rqueue_len(queue) + n > rqueue_capacity(queue))
+        rqueue_grow(queue, rqueue_len(queue) + n);
+
+    size_t start = queue->tail & queue->mask;
+    size_t first = rqueue_capacity(queue) - start;
+    if (first > n)
+        first = n;
+    memcpy(queue->buf + start, src, first);
+    memcpy(queue->buf, src + first, n - first);
+    queue->tail += n;
+}
+
+/* Remove up to n characters from the head of the queue and copy
+them to dst. Return the number of characters removed. */
+size_t rqueue_dequeue_bulk(rqueue_t* queue, char* dst, size_t n) {
+    if (n > rqueue_len(queue))
+        n = rqueue_len(queue);
+
+    size_t start = queue->head & queue->mask;
+    size_t first = rqueue_capacity(queue) - start;
+    if (first > n)
+        first = n;
+    memcpy(dst, queue->buf + start, first);
+    memcpy(dst + first, queue->buf, n - first);
+    queue->head += n;
+    return n;
+}
+
+/* Expose the items without copying them. The items are stored in at most two
+contiguous spans: `first` starts at the head and `second` holds the items that
+wrapped around the end of the buffer (its length is 0 if there is none). The
+spans stay valid until the next enqueue. Return the number of items in the queue. */
+size_t rqueue_peek(rqueue_t* queue, const char** first, size_t* first_len,
+                   const char** second, size_t* second_len) {
+    size_t len = rqueue_len(queue);
+    size_t start = queue->head & queue->mask;
+    size_t n = rqueue_capacity(queue) - start;
+    if (n > len)
+        n = len;
+
+    *first = queue->buf + start;
+    *first_len = n;
+    *second = queue->buf;
+    *second_len = len - n;
+    return len;
+}
+
+/* Drop up to n items from the head of the queue. Use it after `rqueue_peek`. */
+void rqueue_consume(rqueue_t* queue, size_t n) {
+    if (n > rqueue_len(queue))
+        n = rqueue_len(queue);
+    queue->head += n;
+}
+
+void rqueue_print(rqueue_t* queue) {
+    printf("%s ", "Head ->");
+    for (size_t i = queue->head; i != queue->tail; i++)
+        printf("%c ", queue->buf[i & queue->mask]);
+    printf("%s", "<- Tail");
+    puts("");
+}
+
+
+/**
+Single-producer/single-consumer queue. Only the producer may call the enqueue functions
+and only the consumer may call the dequeue functions. The capacity is fixed at creation.
+*/
+
+/* Allocate a queue able to store `capacity` items, rounded up to a power of two. */
+spsc_queue_t* spsc_create(size_t capacity) {
+    spsc_queue_t* queue = aligned_alloc(CACHE_LINE, sizeof(spsc_queue_t));
+    assert(queue);
+
+    if (capacity < RQUEUE_MIN_CAPACITY)
+        capacity = RQUEUE_MIN_CAPACITY;
+    capacity = next_pow2(capacity);
+
+    queue->buf = malloc(capacity);
+    assert(queue->buf);
+    queue->mask = capacity - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    queue->cached_head = 0;
+    queue->cached_tail = 0;
+
+    return queue;
+}
+
+/* Free the queue. No thread may be using it. */
+void spsc_free(spsc_queue_t* queue) {
+    if (!queue)
+        return;
+    free(queue->buf);
+    free(queue);
+}
+
+size_t spsc_capacity(spsc_queue_t* queue) {
+    return queue->mask + 1;
+}
+
+/* Return the number of items in the queue. The value is exact only
+when called from one of the two sides while the other one is idle. */
+size_t spsc_len(spsc_queue_t* queue) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    return tail - head;
+}
+
+/* Producer side. Insert a character at the tail. Return false if the queue is full. */
+bool spsc_try_enqueue(spsc_queue_t* queue, char ch) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    if (tail - queue->cached_head == spsc_capacity(queue)) {
+        queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        if (tail - queue->cached_head == spsc_capacity(queue))
+            return false;
+    }
+    queue->buf[tail & queue->mask] = ch;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/* Consumer side. Remove the character at the head and store it in the
+output parameter, if different from NULL. Return false if the queue is empty. */
+bool spsc_try_dequeue(spsc_queue_t* queue, char* ch) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    if (head == queue->cached_tail) {
+        queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (head == queue->cached_tail)
+            return false;
+    }
+    if (ch)
+        *ch = queue->buf[head & queue->mask];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+/* Producer side. Claim up to n free slots at the tail. The slots are contiguous and
+start at `*slots`; fewer than n are returned when the queue is almost full or the
+slots would wrap around the end of the buffer. Fill them and then call
+`spsc_enqueue_publish`. Return the number of claimed slots. */
+size_t spsc_enqueue_claim(spsc_queue_t* queue, size_t n, char** slots) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t free_slots = spsc_capacity(queue) - (tail - queue->cached_head);
+
+    if (free_slots < n) {
+        queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        free_slots = spsc_capacity(queue) - (tail - queue->cached_head);
+    }
+    size_t contiguous = spsc_capacity(queue) - (tail & queue->mask);
+    if (n > free_slots)
+        n = free_slots;
+    if (n > contiguous)
+        n = contiguous;
+
+    *slots = queue->buf + (tail & queue->mask);
+    return n;
+}
+
+/* Producer side. Make the first n claimed slots visible to the consumer. */
+void spsc_enqueue_publish(spsc_queue_t* queue, size_t n) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    atomic_store_explicit(&queue->tail, tail + n, memory_order_release);
+}
+
+/* Consumer side. Claim up to n items at the head without copying them. The items
+are contiguous and start at `*slots`. Read them and then call `spsc_dequeue_release`.
+Return the number of claimed items. */
+size_t spsc_dequeue_claim(spsc_queue_t* queue, size_t n, const char** slots) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t available = queue->cached_tail - head;
+
+    if (available < n) {
+        queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        available = queue->cached_tail - head;
+    }
+    size_t contiguous = spsc_capacity(queue) - (head & queue->mask);
+    if (n > available)
+        n = available;
+    if (n > contiguous)
+        n = contiguous;
+
+    *slots = queue->buf + (head & queue->mask);
+    return n;
+}
+
+/* Consumer side. Give the first n claimed slots back to the producer. */
+void spsc_dequeue_release(spsc_queue_t* queue, size_t n) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    atomic_store_explicit(&queue->head, head + n, memory_order_release);
+}
+
+
+/**
+Multi-producer/multi-consumer queue. Every slot carries a sequence number: slot i is
+free for the producer that claims position p when seq == p, and it holds an item for
+the consumer that claims position p when seq == p + 1. After the item is consumed the
+sequence number moves to p + capacity, i.e. the position of the next lap.
+*/
+
+/* Allocate a queue able to store `capacity` items, rounded up to a power of two. */
+mpmc_queue_t* mpmc_create(size_t capacity) {
+    mpmc_queue_t* queue = aligned_alloc(CACHE_LINE, sizeof(mpmc_queue_t));
+    assert(queue);
+
+    if (capacity < RQUEUE_MIN_CAPACITY)
+        capacity = RQUEUE_MIN_CAPACITY;
+    capacity = next_pow2(capacity);
+
+    queue->cells = malloc(capacity * sizeof(mpmc_cell_t));
+    assert(queue->cells);
+    for (size_t i = 0; i < capacity; i++)
+        atomic_init(&queue->cells[i].seq, i);
+    queue->mask = capacity - 1;
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    atomic_init(&queue->items_event, 0);
+    atomic_init(&queue->slots_event, 0);
+    atomic_init(&queue->item_waiters, 0);
+    atomic_init(&queue->slot_waiters, 0);
+
+    return queue;
+}
+
+/* Free the queue. No thread may be using it. */
+void mpmc_free(mpmc_queue_t* queue) {
+    if (!queue)
+        return;
+    free(queue->cells);
+    free(queue);
+}
+
+size_t mpmc_capacity(mpmc_queue_t* queue) {
+    return queue->mask + 1;
+}
+
+/* Insert a character. Return false if the queue is full. */
+bool mpmc_try_enqueue(mpmc_queue_t* queue, char ch) {
+    return mpmc_try_enqueue_bulk(queue, &ch, 1) == 1;
+}
+
+/* Remove a character and store it in the output parameter, if
+different from NULL. Return false if the queue is empty. */
+bool mpmc_try_dequeue(mpmc_queue_t* queue, char* ch) {
+    char tmp;
+    if (!mpmc_try_dequeue_bulk(queue, &tmp, 1))
+        return false;
+    if (ch)
+        *ch = tmp;
+    return true;
+}
+
+/* Insert up to n characters. The free slots at the current position are claimed
+with a single CAS, so a batch costs as much contention as a single item. The items
+of a batch are consecutive in the queue. Return the number of inserted characters. */
+size_t mpmc_try_enqueue_bulk(mpmc_queue_t* queue, const char* src, size_t n) {
+    size_t pos, k;
+    mpmc_cell_t* cell;
+
+    if (n == 0)
+        return 0;
+
+    pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        for (k = 0; k < n; k++) {
+            cell = &queue->cells[(pos + k) & queue->mask];
+            if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + k)
+                break;
+        }
+        if (k == 0) {
+            cell = &queue->cells[pos & queue->mask];
+            intptr_t diff = (intptr_t) atomic_load_explicit(&cell->seq, memory_order_acquire) - (intptr_t) pos;
+            if (diff < 0)
+                return 0;  // The slot still holds the item of the previous lap: full
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        } else if (atomic_compare_exchange_weak_explicit(
+                   &queue->enqueue_pos, &pos, pos + k,
+                   memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < k; i++) {
+        cell = &queue->cells[(pos + i) & queue->mask];
+        cell->ch = src[i];
+        atomic_store_explicit(&cell->seq, pos + i + 1, memory_order_release);
+    }
+    mpmc_notify(&queue->items_event, &queue->item_waiters);
+    return k;
+}
+
+/* Remove up to n characters and copy them to dst. Return the number of removed characters. */
+size_t mpmc_try_dequeue_bulk(mpmc_queue_t* queue, char* dst, size_t n) {
+    size_t pos, k;
+    mpmc_cell_t* cell;
+
+    if (n == 0)
+        return 0;
+
+    pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        for (k = 0; k < n; k++) {
+            cell = &queue->cells[(pos + k) & queue->mask];
+            if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + k + 1)
+                break;
+        }
+        if (k == 0) {
+            cell = &queue->cells[pos & queue->mask];
+            intptr_t diff = (intptr_t) atomic_load_explicit(&cell->seq, memory_order_acquire) - (intptr_t) (pos + 1);
+            if (diff < 0)
+                return 0;  // The slot has not been filled yet: empty
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        } else if (atomic_compare_exchange_weak_explicit(
+                   &queue->dequeue_pos, &pos, pos + k,
+                   memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < k; i++) {
+        cell = &queue->cells[(pos + i) & queue->mask];
+        dst[i] = cell->ch;
+        atomic_store_explicit(&cell->seq, pos + i + mpmc_capacity(queue), memory_order_release);
+    }
+    mpmc_notify(&queue->slots_event, &queue->slot_waiters);
+    return k;
+}
+
+/* Sleep until the value at addr differs from val. On systems without futexes just yield. */
+static void futex_wait(_Atomic uint32_t* addr, uint32_t val) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*) addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+    (void) addr;
+    (void) val;
+    sched_yield();
+#endif
+}
+
+/* Wake all threads sleeping on addr. */
+static void futex_wake(_Atomic uint32_t* addr) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*) addr, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+#else
+    (void) addr;
+#endif
+}
+
+/* Wake the sleeping threads, if any. The fence pairs with the one in the waiting
+functions: either the waiter sees the new state of the queue or we see the waiter. */
+static void mpmc_notify(_Atomic uint32_t* event, _Atomic int* waiters) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add_explicit(event, 1, memory_order_release);
+        futex_wake(event);
+    }
+}
+
+/* Insert a character, sleeping while the queue is full. */
+void mpmc_enqueue_wait(mpmc_queue_t* queue, char ch) {
+    for (int i = 0; i < MPMC_SPIN; i++)
+        if (mpmc_try_enqueue(queue, ch))
+            return;
+
+    for (;;) {
+        uint32_t event = atomic_load_explicit(&queue->slots_event, memory_order_acquire);
+        atomic_fetch_add_explicit(&queue->slot_waiters, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        bool done = mpmc_try_enqueue(queue, ch);
+        if (!done)
+            futex_wait(&queue->slots_event, event);
+        atomic_fetch_sub_explicit(&queue->slot_waiters, 1, memory_order_relaxed);
+        if (done)
+            return;
+    }
+}
+
+/* Remove a character, sleeping while the queue is empty. */
+void mpmc_dequeue_wait(mpmc_queue_t* queue, char* ch) {
+    for (int i = 0; i < MPMC_SPIN; i++)
+        if (mpmc_try_dequeue(queue, ch))
+            return;
+
+    for (;;) {
+        uint32_t event = atomic_load_explicit(&queue->items_event, memory_order_acquire);
+        atomic_fetch_add_explicit(&queue->item_waiters, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        bool done = mpmc_try_dequeue(queue, ch);
+        if (!done)
+            futex_wait(&queue->items_event, event);
+        atomic_fetch_sub_explicit(&queue->item_waiters, 1, memory_order_relaxed);
+        if (done)
+            return;
+    }
+}
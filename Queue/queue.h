@@ -0,0 +1,110 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "../Node_Pool/node_pool.h"
+
+#define RQUEUE_MIN_CAPACITY 16
+#define CACHE_LINE 64
+
+/* Node of the linked queue. Every node is allocated on enqueue and freed on dequeue. */
+typedef struct queue {
+    char ch;
+    struct queue* prev;
+} queue_t;
+
+/* Queue backed by a ring buffer whose capacity is always a power of two, so that
+a slot is found with `idx & mask` instead of `idx % capacity`. The head and the tail
+are free-running counters: their difference is the number of stored items. */
+typedef struct ring_queue {
+    char* buf;
+    size_t mask;  // capacity - 1
+    size_t head;  // Next item to dequeue
+    size_t tail;  // Next free slot
+} rqueue_t;
+
+/* Bounded lock-free queue for exactly one producer thread and one consumer thread.
+The head is written only by the consumer and the tail only by the producer, so they
+live on separate cache lines. Each side keeps a private copy of the other side's
+index and reloads it only when the queue looks full (or empty). */
+typedef struct spsc_queue {
+    _Alignas(CACHE_LINE) _Atomic size_t head;
+    size_t cached_tail;  // Consumer's copy of the tail
+    _Alignas(CACHE_LINE) _Atomic size_t tail;
+    size_t cached_head;  // Producer's copy of the head
+    _Alignas(CACHE_LINE) char* buf;
+    size_t mask;
+} spsc_queue_t;
+
+/* Slot of the multi-producer/multi-consumer queue. The sequence number tells
+which lap of the ring the slot belongs to and whether it is full or empty. */
+typedef struct mpmc_cell {
+    _Atomic size_t seq;
+    char ch;
+} mpmc_cell_t;
+
+/* Bounded lock-free queue for any number of producers and consumers (Vyukov's
+algorithm). Producers and consumers contend only on their own position counter
+and on the slot they claim. The futex words are bumped only when some thread is
+sleeping in `mpmc_enqueue_wait` or `mpmc_dequeue_wait`. */
+typedef struct mpmc_queue {
+    _Alignas(CACHE_LINE) _Atomic size_t enqueue_pos;
+    _Alignas(CACHE_LINE) _Atomic size_t dequeue_pos;
+    _Alignas(CACHE_LINE) _Atomic uint32_t items_event;  // Bumped when items are added
+    _Atomic uint32_t slots_event;                       // Bumped when slots are freed
+    _Atomic int item_waiters;
+    _Atomic int slot_waiters;
+    _Alignas(CACHE_LINE) mpmc_cell_t* cells;
+    size_t mask;
+} mpmc_queue_t;
+
+void enqueue(queue_t** head, queue_t** tail, char ch);
+void dequeue(queue_t** head, queue_t** tail);
+void print_queue(queue_t* head);
+void enqueue_pooled(pool_t* pool, queue_t** head, queue_t** tail, char ch);
+void dequeue_pooled(pool_t* pool, queue_t** head, queue_t** tail);
+
+static size_t next_pow2(size_t n);
+rqueue_t* rqueue_create(size_t capacity);
+void rqueue_free(rqueue_t* queue);
+bool rqueue_is_empty(rqueue_t* queue);
+size_t rqueue_len(rqueue_t* queue);
+size_t rqueue_capacity(rqueue_t* queue);
+static void rqueue_grow(rqueue_t* queue, size_t min_capacity);
+void rqueue_enqueue(rqueue_t* queue, char ch);
+bool rqueue_dequeue(rqueue_t* queue, char* ch);
+void rqueue_enqueue_bulk(rqueue_t* queue, const char* src, size_t n);
+size_t rqueue_dequeue_bulk(rqueue_t* queue, char* dst, size_t n);
+size_t rqueue_peek(rqueue_t* queue, const char** first, size_t* first_len,
+                   const char** second, size_t* second_len);
+void rqueue_consume(rqueue_t* queue, size_t n);
+void rqueue_print(rqueue_t* queue);
+
+spsc_queue_t* spsc_create(size_t capacity);
+void spsc_free(spsc_queue_t* queue);
+size_t spsc_capacity(spsc_queue_t* queue);
+size_t spsc_len(spsc_queue_t* queue);
+bool spsc_try_enqueue(spsc_queue_t* queue, char ch);
+bool spsc_try_dequeue(spsc_queue_t* queue, char* ch);
+size_t spsc_enqueue_claim(spsc_queue_t* queue, size_t n, char** slots);
+void spsc_enqueue_publish(spsc_queue_t* queue, size_t n);
+size_t spsc_dequeue_claim(spsc_queue_t* queue, size_t n, const char** slots);
+void spsc_dequeue_release(spsc_queue_t* queue, size_t n);
+
+mpmc_queue_t* mpmc_create(size_t capacity);
+void mpmc_free(mpmc_queue_t* queue);
+size_t mpmc_capacity(mpmc_queue_t* queue);
+bool mpmc_try_enqueue(mpmc_queue_t* queue, char ch);
+bool mpmc_try_dequeue(mpmc_queue_t* queue, char* ch);
+size_t mpmc_try_enqueue_bulk(mpmc_queue_t* queue, const char* src, size_t n);
+size_t mpmc_try_dequeue_bulk(mpmc_queue_t* queue, char* dst, size_t n);
+static void futex_wait(_Atomic uint32_t* addr, uint32_t val);
+static void futex_wake(_Atomic uint32_t* addr);
+static void mpmc_notify(_Atomic uint32_t* event, _Atomic int* waiters);
+void mpmc_enqueue_wait(mpmc_queue_t* queue, char ch);
+void mpmc_dequeue_wait(mpmc_queue_t* queue, char* ch);
+
+#endif
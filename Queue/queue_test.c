@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sched.h>
+#include "queue.h"
+
+#define PIPELINE_ITEMS 20000000
+#define BATCH 64
+#define MPMC_THREADS 4
+#define MPMC_ITEMS 1000000  // Per producer
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+void print_span(const char* span, size_t len) {
+    for (size_t i = 0; i < len; i++)
+        printf("%c ", span[i]);
+    puts("");
+}
+
+double seconds_since(struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Producer of the SPSC pipeline. It enqueues the sequence 0, 1, ..., 127, 0, 1, ... */
+void* spsc_producer(void* arg) {
+    spsc_queue_t* queue = arg;
+    char* slots;
+    size_t sent = 0;
+    while (sent < PIPELINE_ITEMS) {
+        size_t n = spsc_enqueue_claim(queue, BATCH, &slots);
+        if (n > PIPELINE_ITEMS - sent)
+            n = PIPELINE_ITEMS - sent;
+        if (!n)
+            sched_yield();  // The queue is full
+        for (size_t i = 0; i < n; i++)
+            slots[i] = (sent + i) & 0x7f;
+        spsc_enqueue_publish(queue, n);
+        sent += n;
+    }
+    return NULL;
+}
+
+/* Consumer of the SPSC pipeline. It checks that the items arrive in order. */
+void* spsc_consumer(void* arg) {
+    spsc_queue_t* queue = arg;
+    const char* slots;
+    size_t received = 0;
+    while (received < PIPELINE_ITEMS) {
+        size_t n = spsc_dequeue_claim(queue, BATCH, &slots);
+        if (!n)
+            sched_yield();  // The queue is empty
+        for (size_t i = 0; i < n; i++)
+            assert(slots[i] == (char) ((received + i) & 0x7f));
+        spsc_dequeue_release(queue, n);
+        received += n;
+    }
+    return NULL;
+}
+
+/* Producer of the MPMC test. Half of the items are sent in batches. */
+void* mpmc_producer(void* arg) {
+    mpmc_queue_t* queue = arg;
+    char batch[BATCH];
+    size_t i = 0;
+    while (i < MPMC_ITEMS / 2) {
+        mpmc_enqueue_wait(queue, i & 0x7f);
+        i++;
+    }
+    while (i < MPMC_ITEMS) {
+        size_t n = (MPMC_ITEMS - i < BATCH) ? MPMC_ITEMS - i : BATCH;
+        for (size_t j = 0; j < n; j++)
+            batch[j] = (i + j) & 0x7f;
+        size_t sent = 0;
+        while (sent < n) {
+            size_t k = mpmc_try_enqueue_bulk(queue, batch + sent, n - sent);
+            if (!k)
+                sched_yield();
+            sent += k;
+        }
+        i += n;
+    }
+    return NULL;
+}
+
+/* Consumer of the MPMC test. It counts how many times it receives each value. */
+void* mpmc_consumer(void* arg) {
+    mpmc_queue_t* queue = arg;
+    size_t* histogram = calloc(128, sizeof(size_t));
+    char ch;
+    for (size_t i = 0; i < MPMC_ITEMS; i++) {
+        mpmc_dequeue_wait(queue, &ch);
+        histogram[(int) ch]++;
+    }
+    return histogram;
+}
+
+int main(void) {
+    /* Linked queue */
+    test_function("Linked queue");
+    queue_t *head = NULL, *tail = NULL;
+    for (char i = 'a'; i < 'z'; i++)
+        enqueue(&head, &tail, i);
+    print_queue(head);
+    for (int i = 0; i < 5; i++)
+        dequeue(&head, &tail);
+    print_queue(head);
+    while (head)
+        dequeue(&head, &tail);
+    puts("");
+
+    /* Linked queue with pooled nodes */
+    test_function("enqueue_pooled and dequeue_pooled");
+    pool_t* pool = pool_create(sizeof(queue_t));
+    for (char i = 'a'; i < 'z'; i++)
+        enqueue_pooled(pool, &head, &tail, i);
+    print_queue(head);
+    for (int i = 0; i < 5; i++)
+        dequeue_pooled(pool, &head, &tail);
+    print_queue(head);
+    while (head)
+        dequeue_pooled(pool, &head, &tail);
+    printf("Slabs: %zu, free nodes: %zu\n", pool->n_slabs, pool->n_free);
+    pool_destroy(pool);
+    free(pool);
+    puts("");
+
+    /* Ring queue */
+    test_function("Ring queue");
+    rqueue_t* queue = rqueue_create(10);
+    printf("Capacity of a queue created for 10 items: %zu\n", rqueue_capacity(queue));
+    for (char i = 'a'; i < 'z'; i++)
+        rqueue_enqueue(queue, i);
+    printf("Capacity after enqueuing %zu items: %zu\n", rqueue_len(queue), rqueue_capacity(queue));
+    rqueue_print(queue);
+
+    char ch;
+    printf("%s", "Dequeue 5 items: ");
+    for (int i = 0; i < 5; i++) {
+        rqueue_dequeue(queue, &ch);
+        printf("%c ", ch);
+    }
+    puts("");
+    rqueue_print(queue);
+    puts("");
+
+    /* Bulk operations across the end of the buffer */
+    test_function("Bulk enqueue and dequeue");
+    char out[32] = {'\0'};
+    size_t n = rqueue_dequeue_bulk(queue, out, 15);
+    printf("Dequeue %zu items: %s\n", n, out);
+    rqueue_enqueue_bulk(queue, "0123456789", 10);  // Wraps around the end of the buffer
+    rqueue_print(queue);
+
+    const char *first, *second;
+    size_t first_len, second_len;
+    rqueue_peek(queue, &first, &first_len, &second, &second_len);
+    printf("First span (%zu items): ", first_len);
+    print_span(first, first_len);
+    printf("Second span (%zu items): ", second_len);
+    print_span(second, second_len);
+    rqueue_consume(queue, first_len);
+    rqueue_print(queue);
+
+    rqueue_enqueue_bulk(queue, "ABCDEFGHIJKLMNOPQRSTUVWXYZ", 26);  // Grows the buffer
+    printf("Capacity after a bulk enqueue of 26 items: %zu\n", rqueue_capacity(queue));
+    rqueue_print(queue);
+
+    memset(out, 0, sizeof out);
+    n = rqueue_dequeue_bulk(queue, out, sizeof out - 1);
+    printf("Dequeue %zu items: %s\n", n, out);
+    printf("The queue is %s\n", rqueue_is_empty(queue) ? "empty" : "not empty");
+    assert(!rqueue_dequeue(queue, &ch));
+
+    rqueue_free(queue);
+    puts("");
+
+    /* Single-producer/single-consumer queue */
+    test_function("SPSC queue");
+    spsc_queue_t* spsc = spsc_create(4);
+    printf("Capacity of a queue created for 4 items: %zu\n", spsc_capacity(spsc));
+    int sent = 0;
+    while (spsc_try_enqueue(spsc, 'a' + sent))
+        sent++;
+    printf("Enqueue until full: %d items\n", sent);
+    printf("%s", "Dequeue until empty: ");
+    while (spsc_try_dequeue(spsc, &ch))
+        printf("%c ", ch);
+    puts("");
+    spsc_free(spsc);
+
+    pthread_t producer, consumer;
+    struct timespec start;
+    spsc = spsc_create(1 << 14);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&producer, NULL, spsc_producer, spsc);
+    pthread_create(&consumer, NULL, spsc_consumer, spsc);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    double elapsed = seconds_since(&start);
+    printf("Move %d items between two threads in batches of %d: %.0f M items/s\n",
+           PIPELINE_ITEMS, BATCH, PIPELINE_ITEMS / elapsed / 1e6);
+    printf("The queue is %s\n", spsc_len(spsc) ? "not empty" : "empty");
+    spsc_free(spsc);
+    puts("");
+
+    /* Multi-producer/multi-consumer queue */
+    test_function("MPMC queue");
+    mpmc_queue_t* mpmc = mpmc_create(16);
+    n = mpmc_try_enqueue_bulk(mpmc, "abcdefghijklmnopqrstuvwxyz", 26);
+    printf("Bulk enqueue of 26 items in a queue of capacity %zu: %zu items\n", mpmc_capacity(mpmc), n);
+    memset(out, 0, sizeof out);
+    n = mpmc_try_dequeue_bulk(mpmc, out, 10);
+    printf("Bulk dequeue of %zu items: %s\n", n, out);
+    printf("Bulk enqueue and dequeue of 0 items: %zu, %zu\n", mpmc_try_enqueue_bulk(mpmc, "x", 0),
+           mpmc_try_dequeue_bulk(mpmc, out, 0));
+    printf("%s", "Dequeue until empty: ");
+    while (mpmc_try_dequeue(mpmc, &ch))
+        printf("%c ", ch);
+    puts("");
+    mpmc_free(mpmc);
+
+    pthread_t producers[MPMC_THREADS], consumers[MPMC_THREADS];
+    size_t expected[128] = {0}, received[128] = {0};
+    mpmc = mpmc_create(1024);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < MPMC_THREADS; i++) {
+        pthread_create(&producers[i], NULL, mpmc_producer, mpmc);
+        pthread_create(&consumers[i], NULL, mpmc_consumer, mpmc);
+    }
+    for (int i = 0; i < MPMC_THREADS; i++) {
+        size_t* histogram;
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], (void**) &histogram);
+        for (int j = 0; j < 128; j++)
+            received[j] += histogram[j];
+        free(histogram);
+    }
+    elapsed = seconds_since(&start);
+    for (size_t i = 0; i < MPMC_ITEMS; i++)
+        expected[i & 0x7f] += MPMC_THREADS;
+    printf("%d producers and %d consumers move %d items: %.0f M items/s\n",
+           MPMC_THREADS, MPMC_THREADS, MPMC_THREADS * MPMC_ITEMS,
+           MPMC_THREADS * MPMC_ITEMS / elapsed / 1e6);
+    printf("Every item was received exactly once: %s\n",
+           memcmp(expected, received, sizeof expected) ? "false" : "true");
+    mpmc_free(mpmc);
+
+    return 0;
+}
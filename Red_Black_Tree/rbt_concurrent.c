@@ -0,0 +1,159 @@
+/*
+* This is a red-black set for read-mostly workloads shared by many threads. It
+* is an rbt_t plus a sequence lock: lookups never take a lock and never write
+* shared memory, so they do not bounce a lock cache line between the cores.
+*
+* A writer makes the sequence number odd before it relinks any node and even
+* again afterwards. A reader loads the sequence number, walks the tree with
+* atomic loads of the child links (red_black_tree.c writes them with release
+* stores) and loads the sequence number again: if it changed, a rotation or an
+* unlink may have moved the key off the path that was walked, and the walk is
+* retried. A writer that only hangs a new leaf under a black parent moves no
+* node, so it does not disturb the readers at all. A walk that crosses a
+* rotation may even go around in circles; it is cut after RBTC_MAX_DEPTH steps.
+*
+* A reader can still be walking a node that a writer has just unlinked, so the
+* removed nodes are retired through an epoch domain (see Epoch/) instead of
+* being freed, and every lookup runs inside an epoch critical section.
+*
+* Writers are serialized by a mutex. Rebalancing can recolor and rotate nodes
+* all the way up to the root, so per-node locks would have to be taken along
+* the whole path and would serialize the writers at the root anyway; with a
+* few writers the single lock costs nothing to the readers, which never touch it.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "rbt_concurrent.h"
+
+/* Allocate an empty set whose removed nodes are reclaimed through the domain. */
+rbtc_t* rbtc_create(epoch_domain_t* domain) {
+    rbtc_t* tree = aligned_alloc(CACHE_LINE, sizeof(rbtc_t));
+    assert(tree);
+    atomic_init(&tree->seq, 0);
+    tree->tree = (rbt_t) {0};
+    pthread_mutex_init(&tree->writer, NULL);
+    tree->domain = domain;
+    return tree;
+}
+
+/* Free the set. No thread may be using it; the retired nodes are released by
+the epoch domain. */
+void rbtc_free(rbtc_t* tree) {
+    if (!tree)
+        return;
+    rbt_free_tree(&tree->tree);
+    pthread_mutex_destroy(&tree->writer);
+    free(tree);
+}
+
+/* Make the sequence number odd. The fence keeps the stores that follow from
+becoming visible before it. */
+static void rbtc_write_begin(rbtc_t* tree) {
+    unsigned long seq = atomic_load_explicit(&tree->seq, memory_order_relaxed);
+    atomic_store_explicit(&tree->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+/* Make the sequence number even again, after all the stores of the update. */
+static void rbtc_write_end(rbtc_t* tree) {
+    unsigned long seq = atomic_load_explicit(&tree->seq, memory_order_relaxed);
+    atomic_store_explicit(&tree->seq, seq + 1, memory_order_release);
+}
+
+/* Search for the key while holding the writer lock. If the key is missing, the
+output parameter receives the node under which it would be linked. */
+static rbt_node_t* rbtc_search_locked(rbtc_t* tree, int key, rbt_node_t** parent) {
+    rbt_node_t* node = tree->tree.root;
+    *parent = NULL;
+    while (node && node->key != key) {
+        *parent = node;
+        node = (node->key > key) ? node->left : node->right;
+    }
+    return node;
+}
+
+/* Add the key to the set. Return false if it was already there. */
+bool rbtc_insert(rbtc_t* tree, int key) {
+    rbt_node_t *parent, *node;
+
+    pthread_mutex_lock(&tree->writer);
+    if (rbtc_search_locked(tree, key, &parent)) {
+        pthread_mutex_unlock(&tree->writer);
+        return false;
+    }
+    node = malloc(sizeof(rbt_node_t));
+    assert(node);
+    node->key = key;
+
+    // Under a black parent (or in an empty tree) the insertion does not rebalance.
+    bool moves_nodes = parent && rbt_color(parent) == RED;
+    if (moves_nodes)
+        rbtc_write_begin(tree);
+    rbt_link_node(&tree->tree, parent, node, parent && parent->key > key);
+    if (moves_nodes)
+        rbtc_write_end(tree);
+    pthread_mutex_unlock(&tree->writer);
+    return true;
+}
+
+/* Remove the key from the set. Return false if it was not there. The calling
+thread's epoch record receives the removed node. */
+bool rbtc_delete(rbtc_t* tree, epoch_record_t* record, int key) {
+    rbt_node_t* parent;
+
+    pthread_mutex_lock(&tree->writer);
+    rbt_node_t* node = rbtc_search_locked(tree, key, &parent);
+    if (node) {
+        rbtc_write_begin(tree);
+        rbt_erase_node(&tree->tree, node);
+        rbtc_write_end(tree);
+    }
+    pthread_mutex_unlock(&tree->writer);
+
+    if (node)
+        epoch_retire(record, node, free);
+    return node != NULL;
+}
+
+/* Lock-free walk from the node. Return 1 if the key was found, 0 if the walk
+fell off the tree, -1 if it went on for too long. */
+static int rbtc_walk(rbt_node_t* node, int key) {
+    for (int depth = 0; node; depth++) {
+        if (depth == RBTC_MAX_DEPTH)
+            return -1;
+        if (node->key == key)
+            return 1;
+        node = __atomic_load_n((node->key > key) ? &node->left : &node->right, __ATOMIC_ACQUIRE);
+    }
+    return 0;
+}
+
+/* Return true if the key is in the set. The lookup is retried while writers
+keep moving nodes under it; after RBTC_OPTIMISTIC_TRIES attempts it takes the
+writer lock, so that a steady stream of updates cannot starve it. */
+bool rbtc_contains(rbtc_t* tree, epoch_record_t* record, int key) {
+    rbt_node_t* parent;
+    int found = -1;
+
+    epoch_enter(record);
+    for (int tries = 0; found < 0 && tries < RBTC_OPTIMISTIC_TRIES; tries++) {
+        unsigned long seq = atomic_load_explicit(&tree->seq, memory_order_acquire);
+        if (seq & 1)
+            continue;  // A writer is relinking nodes
+        found = rbtc_walk(__atomic_load_n(&tree->tree.root, __ATOMIC_ACQUIRE), key);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&tree->seq, memory_order_relaxed) != seq)
+            found = -1;
+    }
+    epoch_exit(record);
+
+    if (found < 0) {
+        pthread_mutex_lock(&tree->writer);
+        found = rbtc_search_locked(tree, key, &parent) != NULL;
+        pthread_mutex_unlock(&tree->writer);
+    }
+    return found;
+}
@@ -0,0 +1,35 @@
+#ifndef RBT_CONCURRENT_H
+#define RBT_CONCURRENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "red_black_tree.h"
+#include "../Epoch/epoch.h"
+
+#define RBTC_MAX_DEPTH 128       // A longer walk crossed a rotation: give up and retry
+#define RBTC_OPTIMISTIC_TRIES 16  // Failed validations before a reader takes the lock
+
+/* Red-black set shared by many readers and a few writers. `seq` is odd while
+a writer relinks nodes. Readers take no lock and write no shared memory: they
+walk the tree and validate the walk against `seq`. Writers are serialized by
+`writer` and retire the removed nodes through the epoch domain. */
+typedef struct rbt_concurrent {
+    _Alignas(CACHE_LINE) _Atomic unsigned long seq;
+    rbt_t tree;
+    pthread_mutex_t writer;
+    epoch_domain_t* domain;
+} rbtc_t;
+
+rbtc_t* rbtc_create(epoch_domain_t* domain);
+void rbtc_free(rbtc_t* tree);
+static void rbtc_write_begin(rbtc_t* tree);
+static void rbtc_write_end(rbtc_t* tree);
+static rbt_node_t* rbtc_search_locked(rbtc_t* tree, int key, rbt_node_t** parent);
+bool rbtc_insert(rbtc_t* tree, int key);
+bool rbtc_delete(rbtc_t* tree, epoch_record_t* record, int key);
+static int rbtc_walk(rbt_node_t* node, int key);
+bool rbtc_contains(rbtc_t* tree, epoch_record_t* record, int key);
+
+#endif
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include "rbt_concurrent.h"
+
+#define SIZE 8
+#define STABLE_KEYS 20000
+#define WRITERS 2
+#define READERS 4
+#define WRITER_OPS 200000
+#define BIG_SIZE 1000000
+#define LOOKUPS 2000000
+#define MAX_THREADS 8
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+/* Return the black height of the subtree, or -1 if a red-black or BST property,
+a parent link or a subtree size is wrong. The number of nodes is added to *n. */
+int check_subtree(rbt_node_t* node, rbt_node_t* parent, long lo, long hi, size_t* n) {
+    if (!node)
+        return 0;
+    if (rbt_parent(node) != parent || node->key <= lo || node->key >= hi)
+        return -1;
+    bool red = rbt_color(node) == RED;
+    if (red && ((node->left && rbt_color(node->left) == RED) ||
+                (node->right && rbt_color(node->right) == RED)))
+        return -1;
+    size_t before = *n;
+    int bh_left = check_subtree(node->left, node, lo, node->key, n);
+    int bh_right = check_subtree(node->right, node, node->key, hi, n);
+    (*n)++;
+    if (bh_left < 0 || bh_left != bh_right || node->size != *n - before)
+        return -1;
+    return bh_left + !red;
+}
+
+bool check_rbtc(rbtc_t* tree, size_t* n) {
+    rbt_node_t* root = tree->tree.root;
+    *n = 0;
+    return (!root || rbt_color(root) == BLACK) && check_subtree(root, NULL, LONG_MIN, LONG_MAX, n) >= 0 &&
+           !(atomic_load(&tree->seq) & 1);
+}
+
+double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct thread_arg {
+    rbtc_t* tree;
+    epoch_domain_t* domain;
+    atomic_bool* done;
+    int id;
+    bool* in;  // Writers: the odd keys currently in the tree
+    size_t ops, errors;
+} thread_arg_t;
+
+/* Writer `id` inserts and deletes the odd keys 2k + 1 with k % WRITERS == id. */
+void* writer(void* p) {
+    thread_arg_t* arg = p;
+    epoch_record_t* record = epoch_register(arg->domain);
+    unsigned int seed = arg->id + 1;
+
+    for (int i = 0; i < WRITER_OPS; i++) {
+        int k = (rand_r(&seed) % (STABLE_KEYS / WRITERS)) * WRITERS + arg->id;
+        bool changed = (arg->in[k]) ? rbtc_delete(arg->tree, record, 2 * k + 1) : rbtc_insert(arg->tree, 2 * k + 1);
+        arg->errors += !changed;
+        arg->in[k] = !arg->in[k];
+    }
+    epoch_unregister(record);
+    return NULL;
+}
+
+/* The even keys stay in the tree and the negative keys never enter it, whatever
+the writers do: every lookup of such a key must give the same answer. */
+void* reader(void* p) {
+    thread_arg_t* arg = p;
+    epoch_record_t* record = epoch_register(arg->domain);
+    unsigned int seed = arg->id + 100;
+
+    while (!atomic_load(arg->done)) {
+        int k = rand_r(&seed) % STABLE_KEYS;
+        arg->errors += !rbtc_contains(arg->tree, record, 2 * k);
+        arg->errors += rbtc_contains(arg->tree, record, -2 * k - 1);
+        rbtc_contains(arg->tree, record, 2 * k + 1);
+        arg->ops += 3;
+    }
+    epoch_unregister(record);
+    return NULL;
+}
+
+typedef struct bench_arg {
+    rbtc_t* tree;
+    epoch_domain_t* domain;
+    pthread_rwlock_t* lock;  // NULL: lock-free lookups
+    int id, nthreads;
+    size_t hits;
+} bench_arg_t;
+
+void* bench_reader(void* p) {
+    bench_arg_t* arg = p;
+    epoch_record_t* record = epoch_register(arg->domain);
+    unsigned int seed = arg->id + 1;
+
+    for (int i = 0; i < LOOKUPS / arg->nthreads; i++) {
+        int key = rand_r(&seed) % (2 * BIG_SIZE);
+        if (arg->lock) {
+            pthread_rwlock_rdlock(arg->lock);
+            arg->hits += rbt_is_key_in(&arg->tree->tree, key);
+            pthread_rwlock_unlock(arg->lock);
+        } else {
+            arg->hits += rbtc_contains(arg->tree, record, key);
+        }
+    }
+    epoch_unregister(record);
+    return NULL;
+}
+
+/* Return the lookups per second of nthreads readers. */
+double read_throughput(rbtc_t* tree, epoch_domain_t* domain, pthread_rwlock_t* lock, int nthreads, size_t* hits) {
+    pthread_t threads[MAX_THREADS];
+    bench_arg_t args[MAX_THREADS];
+    double start = seconds();
+    for (int i = 0; i < nthreads; i++) {
+        args[i] = (bench_arg_t) {tree, domain, lock, i, nthreads, 0};
+        pthread_create(&threads[i], NULL, bench_reader, &args[i]);
+    }
+    *hits = 0;
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+        *hits += args[i].hits;
+    }
+    return (LOOKUPS / nthreads) * nthreads / (seconds() - start);
+}
+
+int main() {
+    int arr[SIZE] = {11, 2, 14, 1, 7, 15, 5, 8};
+    epoch_domain_t* domain = epoch_create();
+    epoch_record_t* record = epoch_register(domain);
+    size_t n;
+
+    test_function("rbtc_insert and rbtc_delete");
+    rbtc_t* tree = rbtc_create(domain);
+    for (int i = 0; i < SIZE; i++)
+        rbtc_insert(tree, arr[i]);
+    printf("Insert 7 again: %s\n", rbtc_insert(tree, 7) ? "inserted" : "already there");
+    rbtc_delete(tree, record, 11);
+    rbtc_delete(tree, record, 2);
+    printf("Delete 2 again: %s\n", rbtc_delete(tree, record, 2) ? "deleted" : "not there");
+    printf("%s", "After deleting 11 and 2, inorder: ");
+    rbt_traverse(&tree->tree, INORDER);
+    printf("\n14 is in the tree: %s, 11 is in the tree: %s\n",
+           rbtc_contains(tree, record, 14) ? "true" : "false", rbtc_contains(tree, record, 11) ? "true" : "false");
+    bool ok = check_rbtc(tree, &n) && n == SIZE - 2;
+    printf("Valid: %s\n\n", ok ? "true" : "false");
+    rbtc_free(tree);
+
+    test_function("Concurrent readers and writers");
+    tree = rbtc_create(domain);
+    for (int k = 0; k < STABLE_KEYS; k++)
+        rbtc_insert(tree, 2 * k);
+    atomic_bool done = false;
+    pthread_t writers[WRITERS], readers[READERS];
+    thread_arg_t writer_args[WRITERS], reader_args[READERS];
+    bool* in = calloc(STABLE_KEYS, sizeof(bool));
+    for (int i = 0; i < READERS; i++) {
+        reader_args[i] = (thread_arg_t) {tree, domain, &done, i, NULL, 0, 0};
+        pthread_create(&readers[i], NULL, reader, &reader_args[i]);
+    }
+    for (int i = 0; i < WRITERS; i++) {
+        writer_args[i] = (thread_arg_t) {tree, domain, &done, i, in, 0, 0};
+        pthread_create(&writers[i], NULL, writer, &writer_args[i]);
+    }
+    for (int i = 0; i < WRITERS; i++)
+        pthread_join(writers[i], NULL);
+    atomic_store(&done, true);
+
+    size_t lookups = 0, errors = 0, odd = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(readers[i], NULL);
+        lookups += reader_args[i].ops;
+        errors += reader_args[i].errors;
+    }
+    for (int i = 0; i < WRITERS; i++)
+        errors += writer_args[i].errors;
+    ok = check_rbtc(tree, &n);
+    for (int k = 0; k < STABLE_KEYS; k++) {
+        odd += in[k];
+        ok = ok && rbtc_contains(tree, record, 2 * k) && rbtc_contains(tree, record, 2 * k + 1) == in[k];
+    }
+    printf("%d writers, %d readers: %d updates, %zu lookups, %zu wrong answers\n",
+           WRITERS, READERS, WRITERS * WRITER_OPS, lookups, errors);
+    printf("Keys: %zu. The tree is valid and agrees with the writers: %s\n\n",
+           n, (ok && n == STABLE_KEYS + odd) ? "true" : "false");
+    rbtc_free(tree);
+    free(in);
+
+    test_function("Read throughput");
+    tree = rbtc_create(domain);
+    for (int i = 0; i < BIG_SIZE; i++)
+        rbtc_insert(tree, (int) ((unsigned) i * 2654435761u % (2 * BIG_SIZE)));
+    pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+    size_t free_hits, locked_hits;
+    read_throughput(tree, domain, NULL, 1, &free_hits);  // Warm up the caches
+    printf("%d lookups in %d keys, millions of lookups per second:\n", LOOKUPS, BIG_SIZE);
+    printf("%8s %12s %12s\n", "threads", "seqlock", "rwlock");
+    for (int nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+        double lock_free = read_throughput(tree, domain, NULL, nthreads, &free_hits);
+        double locked = read_throughput(tree, domain, &lock, nthreads, &locked_hits);
+        printf("%8d %12.2f %12.2f%s\n", nthreads, lock_free / 1e6, locked / 1e6,
+               (free_hits == locked_hits) ? "" : " (different results)");
+    }
+    rbtc_free(tree);
+
+    epoch_unregister(record);
+    epoch_destroy(domain);
+    return 0;
+}
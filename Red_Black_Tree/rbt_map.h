@@ -0,0 +1,139 @@
+#ifndef RBT_MAP_H
+#define RBT_MAP_H
+
+/*
+* Ordered maps with arbitrary key and value types. RBT_MAP_DEFINE generates a
+* node type, a map type and a set of `static inline` functions prefixed by
+* `name`. The comparison is a macro or an inline function expanded inside the
+* generated descents, so a lookup does not go through any function pointer. The
+* rebalancing is the one of red_black_tree.c: every map node starts with an
+* rbt_node_t, which is linked with rbt_link_node and unlinked with rbt_erase_node.
+* The `key` field of that embedded node is not used. Keys are unique: inserting
+* an existing key assigns its value.
+*
+* Example:
+*     RBT_MAP_DEFINE(str_map, const char*, int, RBT_STR_LESS)
+*     str_map_t map;
+*     str_map_init(&map);
+*     *str_map_insert(&map, "apples", 0) += 3;
+*
+* The maps can be walked with the rbt_iter_* functions on `&map->tree`; the
+* node under an iterator is `name##_entry(it.node)`.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include "red_black_tree.h"
+
+/* Orderings for RBT_MAP_DEFINE: true when the first key goes before the second. */
+#define RBT_LESS(a, b) ((a) < (b))
+#define RBT_STR_LESS(a, b) (strcmp((a), (b)) < 0)
+
+#define RBT_MAP_DEFINE(name, key_type, value_type, less)                        \
+typedef struct name##_node {                                                    \
+    rbt_node_t link;  /* Must be the first member */                            \
+    key_type key;                                                               \
+    value_type value;                                                           \
+} name##_node_t;                                                                \
+                                                                                \
+typedef struct name {                                                           \
+    rbt_t tree;                                                                 \
+    size_t len;                                                                 \
+} name##_t;                                                                     \
+                                                                                \
+static inline void name##_init(name##_t* map) {                                 \
+    map->tree = (rbt_t) {0};                                                    \
+    map->len = 0;                                                               \
+}                                                                               \
+                                                                                \
+static inline size_t name##_len(const name##_t* map) {                          \
+    return map->len;                                                            \
+}                                                                               \
+                                                                                \
+static inline name##_node_t* name##_entry(rbt_node_t* link) {                   \
+    return (name##_node_t*) link;                                               \
+}                                                                               \
+                                                                                \
+static inline name##_node_t* name##_find_node(name##_t* map, key_type key) {    \
+    rbt_node_t* curr = map->tree.root;                                          \
+    while (curr) {                                                              \
+        name##_node_t* node = name##_entry(curr);                               \
+        if (less(key, node->key))                                               \
+            curr = curr->left;                                                  \
+        else if (less(node->key, key))                                          \
+            curr = curr->right;                                                 \
+        else                                                                    \
+            return node;                                                        \
+    }                                                                           \
+    return NULL;                                                                \
+}                                                                               \
+                                                                                \
+/* Return a pointer to the value of the key, or NULL. */                        \
+static inline value_type* name##_find(name##_t* map, key_type key) {            \
+    name##_node_t* node = name##_find_node(map, key);                           \
+    return (node) ? &node->value : NULL;                                        \
+}                                                                               \
+                                                                                \
+/* Insert the key with the value, or assign the value if the key is already   \
+in the map. Return a pointer to the stored value. */                            \
+static inline value_type* name##_insert(name##_t* map, key_type key,            \
+                                        value_type value) {                     \
+    rbt_node_t *curr = map->tree.root, *parent = NULL;                          \
+    bool left = false;                                                          \
+    while (curr) {                                                              \
+        name##_node_t* node = name##_entry(curr);                               \
+        parent = curr;                                                          \
+        if ((left = less(key, node->key))) {                                    \
+            curr = curr->left;                                                  \
+        } else if (less(node->key, key)) {                                      \
+            curr = curr->right;                                                 \
+        } else {                                                                \
+            node->value = value;                                                \
+            return &node->value;                                                \
+        }                                                                       \
+    }                                                                           \
+    name##_node_t* node = malloc(sizeof(name##_node_t));                        \
+    assert(node);                                                               \
+    node->key = key;                                                            \
+    node->value = value;                                                        \
+    rbt_link_node(&map->tree, parent, &node->link, left);                       \
+    map->len++;                                                                 \
+    return &node->value;                                                        \
+}                                                                               \
+                                                                                \
+/* Remove the key. If the output parameter is not NULL, the value is stored    \
+there. Return false if the key is not in the map. */                            \
+static inline bool name##_erase(name##_t* map, key_type key, value_type* value) { \
+    name##_node_t* node = name##_find_node(map, key);                           \
+    if (!node)                                                                  \
+        return false;                                                           \
+    if (value)                                                                  \
+        *value = node->value;                                                   \
+    rbt_erase_node(&map->tree, &node->link);                                    \
+    free(node);                                                                 \
+    map->len--;                                                                 \
+    return true;                                                                \
+}                                                                               \
+                                                                                \
+/* Free every node. Left children are rotated up until the current node has   \
+none, so the walk needs neither recursion nor a stack. */                       \
+static inline void name##_clear(name##_t* map) {                                \
+    rbt_node_t* curr = map->tree.root;                                          \
+    while (curr) {                                                              \
+        if (curr->left) {  /* Rotate the left child up */                       \
+            rbt_node_t* left = curr->left;                                      \
+            curr->left = left->right;                                           \
+            left->right = curr;                                                 \
+            curr = left;                                                        \
+        } else {                                                                \
+            rbt_node_t* right = curr->right;                                    \
+            free(name##_entry(curr));                                           \
+            curr = right;                                                       \
+        }                                                                       \
+    }                                                                           \
+    name##_init(map);                                                           \
+}
+
+#endif
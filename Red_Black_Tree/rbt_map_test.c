@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <string.h>
+#include "rbt_map.h"
+
+#define KEY_RANGE 2000
+#define RANDOM_OPS 100000
+
+RBT_MAP_DEFINE(int_map, int, long, RBT_LESS)
+RBT_MAP_DEFINE(word_map, const char*, int, RBT_STR_LESS)
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+/* Return the black height of the subtree, or -1 if a red-black property,
+a parent link or a subtree size is wrong. Keys are compared by the map. */
+int check_links(rbt_node_t* root, rbt_node_t* parent) {
+    if (!root)
+        return 0;
+    if (rbt_parent(root) != parent)
+        return -1;
+    if (rbt_color(root) == RED && ((root->left && rbt_color(root->left) == RED) ||
+                                   (root->right && rbt_color(root->right) == RED)))
+        return -1;
+    int left = check_links(root->left, root), right = check_links(root->right, root);
+    if (left < 0 || left != right)
+        return -1;
+#if RBT_ORDER_STATISTICS
+    if (root->size != 1 + (root->left ? root->left->size : 0) + (root->right ? root->right->size : 0))
+        return -1;
+#endif
+    return left + (rbt_color(root) == BLACK);
+}
+
+int main() {
+    test_function("word_map");
+    char* words[] = {"pear", "apple", "fig", "apple", "kiwi", "pear", "apple", "plum"};
+    word_map_t words_seen;
+    word_map_init(&words_seen);
+    for (int i = 0; i < 8; i++) {
+        int* count = word_map_find(&words_seen, words[i]);
+        if (count)
+            (*count)++;
+        else
+            word_map_insert(&words_seen, words[i], 1);
+    }
+    rbt_iter_t it;
+    printf("%zu distinct words: ", word_map_len(&words_seen));
+    for (rbt_iter_first(&it, &words_seen.tree); rbt_iter_valid(&it); rbt_iter_next(&it)) {
+        word_map_node_t* node = word_map_entry(it.node);
+        printf("%s=%d ", node->key, node->value);
+    }
+    int removed;
+    if (word_map_erase(&words_seen, "apple", &removed))
+        printf("\nErase apple (count %d). ", removed);
+    else
+        printf("%s", "\nErase apple: not found. ");
+    printf("Find apple: %s, find fig: %d\n\n",
+           word_map_find(&words_seen, "apple") ? "found" : "NULL", *word_map_find(&words_seen, "fig"));
+    word_map_clear(&words_seen);
+
+    test_function("int_map");
+    long reference[KEY_RANGE];
+    bool present[KEY_RANGE] = {false};
+    int_map_t map;
+    int_map_init(&map);
+    srand(1);
+    bool ok = true;
+    for (int i = 0; i < RANDOM_OPS; i++) {
+        int key = rand() % KEY_RANGE;
+        long value = rand();
+        if (rand() % 3) {
+            ok = ok && *int_map_insert(&map, key, value) == value;
+            reference[key] = value;
+            present[key] = true;
+        } else {
+            long old;
+            ok = ok && int_map_erase(&map, key, &old) == present[key];
+            ok = ok && (!present[key] || old == reference[key]);
+            present[key] = false;
+        }
+    }
+    size_t len = 0;
+    for (int key = 0; key < KEY_RANGE; key++) {
+        long* value = int_map_find(&map, key);
+        ok = ok && (value != NULL) == present[key] && (!value || *value == reference[key]);
+        len += present[key];
+    }
+    int prev_key = INT_MIN;
+    for (rbt_iter_first(&it, &map.tree); rbt_iter_valid(&it); rbt_iter_next(&it)) {
+        ok = ok && int_map_entry(it.node)->key > prev_key;
+        prev_key = int_map_entry(it.node)->key;
+    }
+    ok = ok && int_map_len(&map) == len && check_links(map.tree.root, NULL) >= 0;
+    printf("Keys: %zu. Insert-or-assign, find, erase and iteration agree with an array: %s\n",
+           int_map_len(&map), ok ? "true" : "false");
+    int_map_clear(&map);
+    return 0;
+}
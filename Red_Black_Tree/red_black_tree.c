@@ -4,13 +4,23 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 #include "red_black_tree.h"
 
+/* The insertion and deletion paths write the child links and the root with 
+release stores: the optimistic readers of rbt_concurrent.c load them without
+locks while a writer relinks nodes, and must find the key and the links of a 
+node initialized once they reach it. On x86 this is an ordinary store. */
+#define RBT_STORE_LINK(link, value) __atomic_store_n(&(link), (value), __ATOMIC_RELEASE)
+
 /* Allocate memory for a binary search tree. Return the tree instance. */
 rbt_t* rbt_create(void) {
     rbt_t* tree = malloc(sizeof(rbt_t));
     assert(tree);
     tree->root = NULL;
+#if RBT_MULTISET
+    tree->multiset = false;
+#endif
     return tree;
 }
 
@@ -21,6 +31,22 @@ bool rbt_is_empty(rbt_t* tree) {
     return false;
 }
 
+#if RBT_MULTISET
+/* In multiset mode, inserting a key that is already in the tree increments the
+count of its node without any rebalancing, and deleting it decrements the count;
+the node is unlinked with the last occurrence. Otherwise every insertion adds a
+node. The mode can be changed at any time: counts above 1 stay as they are. */
+void rbt_set_multiset(rbt_t* tree, bool multiset) {
+    tree->multiset = multiset;
+}
+
+/* Return the number of occurrences of the key in a multiset tree. */
+size_t rbt_count(rbt_t* tree, int key) {
+    rbt_node_t* node = rbt_search(tree->root, key);
+    return (node) ? node->count : 0;
+}
+#endif
+
 /* Allocate memory for a new node and initialize 
 its attributes. Eventually, return the new node. */
 static rbt_node_t* rbt_create_node(int key) {
@@ -30,8 +56,13 @@ static rbt_node_t* rbt_create_node(int key) {
     new_node->key = key;
     new_node->left = NULL;
     new_node->right = NULL;
-    new_node->p = NULL;
-    new_node->color = RED;
+    rbt_set_parent_color(new_node, NULL, RED);
+#if RBT_ORDER_STATISTICS
+    new_node->size = 1;
+#endif
+#if RBT_MULTISET
+    new_node->count = 1;
+#endif
 
     return new_node;
 }
@@ -43,19 +74,25 @@ static void left_rotate(rbt_t* tree, rbt_node_t* root) {
         return;
 
     rbt_node_t* tmp = root->right;
-	root->right = tmp->left;
+#if RBT_ORDER_STATISTICS
+    // The subtree keeps its size; root loses tmp and gains tmp's left subtree.
+    unsigned int tmp_size = tmp->size;
+    tmp->size = root->size;
+    root->size -= tmp_size - rbt_size(tmp->left);
+#endif
+	RBT_STORE_LINK(root->right, tmp->left);
 	if (tmp->left)
-		tmp->left->p = root;
-	tmp->left = root;
-    tmp->p = root->p;
-	root->p = tmp;
-
-    if (!tmp->p) {
-        tree->root = tmp;
-    } else if (tmp->p->left == root) {
-        tmp->p->left = tmp;
+		rbt_set_parent(tmp->left, root);
+	RBT_STORE_LINK(tmp->left, root);
+    rbt_set_parent(tmp, rbt_parent(root));
+	rbt_set_parent(root, tmp);
+
+    if (!rbt_parent(tmp)) {
+        RBT_STORE_LINK(tree->root, tmp);
+    } else if (rbt_parent(tmp)->left == root) {
+        RBT_STORE_LINK(rbt_parent(tmp)->left, tmp);
     } else {
-		tmp->p->right = tmp;
+		RBT_STORE_LINK(rbt_parent(tmp)->right, tmp);
     }
 }
 
@@ -66,107 +103,127 @@ static void right_rotate(rbt_t* tree, rbt_node_t* root) {
         return;
 
     rbt_node_t* tmp = root->left;
-    root->left = root->left->right;
+#if RBT_ORDER_STATISTICS
+    // The subtree keeps its size; root loses tmp and gains tmp's right subtree.
+    unsigned int tmp_size = tmp->size;
+    tmp->size = root->size;
+    root->size -= tmp_size - rbt_size(tmp->right);
+#endif
+    RBT_STORE_LINK(root->left, root->left->right);
     if (root->left)
-        root->left->p = root;
-    tmp->right = root;
-    tmp->p = root->p;
-    root->p = tmp;
-
-    if (!tmp->p) {
-        tree->root = tmp;
-    } else if (tmp->p->left == root) {
-        tmp->p->left = tmp;
+        rbt_set_parent(root->left, root);
+    RBT_STORE_LINK(tmp->right, root);
+    rbt_set_parent(tmp, rbt_parent(root));
+    rbt_set_parent(root, tmp);
+
+    if (!rbt_parent(tmp)) {
+        RBT_STORE_LINK(tree->root, tmp);
+    } else if (rbt_parent(tmp)->left == root) {
+        RBT_STORE_LINK(rbt_parent(tmp)->left, tmp);
     } else {
-        tmp->p->right = tmp;
+        RBT_STORE_LINK(rbt_parent(tmp)->right, tmp);
     }
 }
 
-/* Insert a new node in the tree observing 
-the BST property. Equal keys are allowed. */
+/* Insert a new node in the tree observing the BST property. Equal keys are 
+allowed. In multiset mode a duplicate increments the count of its node and 
+NULL is returned: there is nothing to rebalance. */
 static rbt_node_t* rbt_insert_subroutine(rbt_t* tree, int key) {
     rbt_node_t *new_node, *curr, *prev;
-    new_node = rbt_create_node(key);
     curr = tree->root;
     prev = NULL;
 
     while (curr) {
         prev = curr;
+#if RBT_ORDER_STATISTICS
+        curr->size++;
+#endif
+#if RBT_MULTISET
+        if (tree->multiset && curr->key == key) {
+            curr->count++;
+            return NULL;
+        }
+#endif
         if (curr->key > key)
             curr = curr->left;
         else
             curr = curr->right;
     }
 
+    new_node = rbt_create_node(key);
+
     if (!prev) {
-        tree->root = new_node;
+        RBT_STORE_LINK(tree->root, new_node);
     } else {
-        new_node->p = prev;
+        rbt_set_parent(new_node, prev);
         if (prev->key > key)
-            prev->left = new_node;
+            RBT_STORE_LINK(prev->left, new_node);
         else
-            prev->right = new_node;
+            RBT_STORE_LINK(prev->right, new_node);
     }
     
     return new_node;
 }
 
-/* Insert subroutine. It preserves the red-black 
-properties after a new key is inserted. */
-static void insert_fixup(rbt_t* tree, rbt_node_t* ptr) {
+/* Insert subroutine. It preserves the red-black properties after a new key 
+is inserted. Return true if the black height of the tree grew by one. */
+static bool insert_fixup(rbt_t* tree, rbt_node_t* ptr) {
 	rbt_node_t *parent, *uncle, *grandpa;
-    parent = ptr->p;
-	while (parent && parent->color == RED) {
-		grandpa = parent->p;
+    parent = rbt_parent(ptr);
+	while (parent && rbt_color(parent) == RED) {
+		grandpa = rbt_parent(parent);
 		if (parent == grandpa->left) {
 			uncle = grandpa->right;
-			if (uncle && uncle->color == RED) {
-				parent->color = BLACK;
-				uncle->color = BLACK;
-				grandpa->color = RED;
+			if (uncle && rbt_color(uncle) == RED) {
+				rbt_set_color(parent, BLACK);
+				rbt_set_color(uncle, BLACK);
+				rbt_set_color(grandpa, RED);
 				ptr = grandpa;
-				parent = ptr->p;
+				parent = rbt_parent(ptr);
 			} else {
 				if (ptr == parent->right) {
 					ptr = parent;
 					left_rotate(tree, ptr);
-					parent = ptr->p;
-					// grandpa = parent->p;	
+					parent = rbt_parent(ptr);
+					// grandpa = rbt_parent(parent);	
 				}
-				parent->color = BLACK;
-				grandpa->color = RED;
+				rbt_set_color(parent, BLACK);
+				rbt_set_color(grandpa, RED);
 				right_rotate(tree, grandpa);
 			}
 		} else {
 			uncle = grandpa->left;
-			if (uncle && uncle->color == RED) {
-				parent->color = BLACK;
-				uncle->color = BLACK;
-				grandpa->color = RED;
+			if (uncle && rbt_color(uncle) == RED) {
+				rbt_set_color(parent, BLACK);
+				rbt_set_color(uncle, BLACK);
+				rbt_set_color(grandpa, RED);
 				ptr = grandpa;
-				parent = ptr->p;
+				parent = rbt_parent(ptr);
 			} else {
 				if (ptr == parent->left) {
 					ptr = parent;
 					right_rotate(tree, ptr);
-					parent = ptr->p;
-					// grandpa = parent->p;
+					parent = rbt_parent(ptr);
+					// grandpa = rbt_parent(parent);
 				} 
-                parent->color = BLACK;
-                grandpa->color = RED;
+                rbt_set_color(parent, BLACK);
+                rbt_set_color(grandpa, RED);
                 left_rotate(tree, grandpa);
 			}
 		}
 	}
-    if (tree->root->p)
-        tree->root = (!parent) ? ptr : parent;
-    tree->root->color = BLACK;
+    if (rbt_parent(tree->root))
+        RBT_STORE_LINK(tree->root, (!parent) ? ptr : parent);
+    bool grew = rbt_color(tree->root) == RED;
+    rbt_set_color(tree->root, BLACK);
+    return grew;
 }
 
 /* Insert a new key in the tree. */
 void rbt_insert(rbt_t* tree, int key) {
     rbt_node_t* new_node = rbt_insert_subroutine(tree, key);
-    insert_fixup(tree, new_node);
+    if (new_node)
+        insert_fixup(tree, new_node);
 }
 
 /* Search for the key is in the subtree rooted at the input node. If the key 
@@ -180,6 +237,54 @@ static rbt_node_t* rbt_search(rbt_node_t* root, int key) {
     return root;
 }
 
+/* Return true if the key is in the tree, otherwise return false. */
+bool rbt_is_key_in(rbt_t* tree, int key) {
+    return rbt_search(tree->root, key) != NULL;
+}
+
+/* Look up n keys at once: found[i] is set to true if keys[i] is in the tree.
+Return the number of keys found. A lookup is a chain of dependent cache misses,
+so up to RBT_BATCH_GROUP lookups are interleaved (asynchronous memory access
+chaining): each step moves one lookup down one level, prefetches the child it
+will read next and switches to the next lookup, which by then is likely to
+find its own node in cache. A finished lookup hands its slot to the next key. */
+size_t rbt_search_batch(rbt_t* tree, const int* keys, size_t n, bool* found) {
+    rbt_node_t* node[RBT_BATCH_GROUP];
+    size_t idx[RBT_BATCH_GROUP];
+    size_t next = 0, active = 0, hits = 0;
+
+    for (; active < RBT_BATCH_GROUP && next < n; active++) {
+        node[active] = tree->root;
+        idx[active] = next++;
+    }
+    while (active > 0) {
+        for (size_t g = 0; g < active; g++) {
+            rbt_node_t* curr = node[g];
+            int key = keys[idx[g]];
+            if (curr && curr->key != key) {
+                curr = (curr->key > key) ? curr->left : curr->right;
+                if (curr)
+                    __builtin_prefetch(curr);
+                node[g] = curr;
+                continue;
+            }
+
+            found[idx[g]] = (curr != NULL);
+            hits += (curr != NULL);
+            if (next < n) {
+                node[g] = tree->root;
+                idx[g] = next++;
+            } else {  // Move the last lookup in flight into this slot
+                active--;
+                node[g] = node[active];
+                idx[g] = idx[active];
+                g--;
+            }
+        }
+    }
+    return hits;
+}
+
 /* Search for the minimum key in the subtree rooted at the 
 input node and return a pointer to the node storing that key. */
 static rbt_node_t* rbt_minimum(rbt_node_t* root) {
@@ -188,51 +293,86 @@ static rbt_node_t* rbt_minimum(rbt_node_t* root) {
     return root;  
 }
 
-/* Link the child's parent to the child's child. */
-static void rbt_transplant(rbt_t* tree, rbt_node_t* child, rbt_node_t* grandchild) {
-    if (!child->p)
-        tree->root = grandchild;
-    else if (child->p->left == child) 
-        child->p->left = grandchild;
+/* Link the node, whose key has already been compared down to the NULL slot on
+the `left` side of parent, and rebalance. Used by rbt_insert-like descents that
+must not touch the tree unless the key is new (see rbt_map.h). */
+void rbt_link_node(rbt_t* tree, rbt_node_t* parent, rbt_node_t* node, bool left) {
+    node->left = node->right = NULL;
+    rbt_set_parent_color(node, parent, RED);
+#if RBT_ORDER_STATISTICS
+    node->size = 1;
+    for (rbt_node_t* curr = parent; curr; curr = rbt_parent(curr))
+        curr->size++;
+#endif
+#if RBT_MULTISET
+    node->count = 1;
+#endif
+    if (!parent)
+        RBT_STORE_LINK(tree->root, node);
+    else if (left)
+        RBT_STORE_LINK(parent->left, node);
     else
-        child->p->right = grandchild;
-
-    if (grandchild)
-        grandchild->p = child->p;
+        RBT_STORE_LINK(parent->right, node);
+    insert_fixup(tree, node);
+}
 
-    free(child);
+/* Replace the subtree rooted at old with the one rooted at new (can be NULL). */
+static void rbt_replace_child(rbt_t* tree, rbt_node_t* parent, rbt_node_t* old, rbt_node_t* new) {
+    if (!parent)
+        RBT_STORE_LINK(tree->root, new);
+    else if (parent->left == old)
+        RBT_STORE_LINK(parent->left, new);
+    else
+        RBT_STORE_LINK(parent->right, new);
+    if (new)
+        rbt_set_parent(new, parent);
 }
 
-/* Search for the key in the tree and, if present, remove it. */
-static rbt_node_t* rbt_delete_subroutine(
-    rbt_t* tree, int key, COLOR* removed_color, rbt_node_t** parent
-) {
-    rbt_node_t *child, *grandchild, *succ;
-    rbt_node_t* to_be_fixed = NULL;  // child of the node we are about to delete.
+/* Unlink the node from the tree and rebalance, without freeing it. A node with
+two children is replaced by its successor node (the key is not copied), so the
+other nodes keep their keys and any payload stored around them. All the 
+occurrences of a key stored with a count go away with the node. */
+void rbt_erase_node(rbt_t* tree, rbt_node_t* node) {
+    rbt_node_t *child, *parent, *succ;
+    COLOR removed_color;
 
-    // Search for the key and assign the node to remove to the variable `child`.
-    child = rbt_search(tree->root, key);
+    if (!node->left || !node->right) {
+        child = (node->left) ? node->left : node->right;
+        parent = rbt_parent(node);
+        removed_color = rbt_color(node);
+#if RBT_ORDER_STATISTICS
+        for (rbt_node_t* curr = parent; curr; curr = rbt_parent(curr))
+            curr->size -= RBT_COUNT(node);
+#endif
+        rbt_replace_child(tree, parent, node, child);
+    } else {
+        succ = rbt_minimum(node->right);
+        child = succ->right;
+        removed_color = rbt_color(succ);
+#if RBT_ORDER_STATISTICS
+        // The successor moves up to the node: the nodes in between lose it.
+        for (rbt_node_t* curr = rbt_parent(succ); curr != node; curr = rbt_parent(curr))
+            curr->size -= RBT_COUNT(succ);
+        for (rbt_node_t* curr = rbt_parent(node); curr; curr = rbt_parent(curr))
+            curr->size -= RBT_COUNT(node);
+        succ->size = node->size - RBT_COUNT(node);
+#endif
+        if (rbt_parent(succ) == node) {
+            parent = succ;
+        } else {
+            parent = rbt_parent(succ);
+            rbt_replace_child(tree, parent, succ, child);
+            RBT_STORE_LINK(succ->right, node->right);
+            rbt_set_parent(succ->right, succ);
+        }
+        RBT_STORE_LINK(succ->left, node->left);
+        rbt_set_parent(succ->left, succ);
+        rbt_replace_child(tree, rbt_parent(node), node, succ);
+        rbt_set_color(succ, rbt_color(node));
+    }
 
-    if (!child) {
-        printf("Key %d was not found.\n", key);
-    } else if (child->left && child->right) {
-        /* Overwrite the child's key with the key of its successor and
-        then remove the successor. Successor cannot have left child. */
-        succ = rbt_minimum(child->right);
-        child->key = succ->key;
-        to_be_fixed = succ->right;
-        *removed_color = succ->color;
-        *parent = succ->p;
-        rbt_transplant(tree, succ, succ->right);
-    } else { // The node to remove has at most one child.
-        grandchild = (child->left) ? child->left : child->right;
-        to_be_fixed = grandchild;
-        *removed_color = child->color;
-        *parent = child->p;
-        rbt_transplant(tree, child, grandchild);
-    }
-
-    return to_be_fixed;  // Can be NULL
+    if (removed_color == BLACK)
+        rbt_delete_fixup(tree, child, parent);
 }
 
 /* Restore the red-black tree properties when the removed node is BLACK. */
@@ -242,39 +382,39 @@ static void rbt_delete_fixup(
     rbt_node_t* sibling;  // to_be_fixed's sibling
 
     while (tree->root != to_be_fixed && 
-          (!to_be_fixed || to_be_fixed->color == BLACK)) {
+          (!to_be_fixed || rbt_color(to_be_fixed) == BLACK)) {
         
         // The node to be fixed is the left child of its parent.
         if (to_be_fixed == parent->left) {
             sibling = parent->right;  // Cannot be NULL
 
             // Case 1: sibling is RED
-            if (sibling->color == RED) {
-                sibling->color = BLACK;
-                parent->color = RED;
+            if (rbt_color(sibling) == RED) {
+                rbt_set_color(sibling, BLACK);
+                rbt_set_color(parent, RED);
                 left_rotate(tree, parent);
                 sibling = parent->right;
             }
             // Case 2: sibling is BLACK and both its children are BLACK
-            if ((!sibling->left || sibling->left->color == BLACK) && 
-                (!sibling->right || sibling->right->color == BLACK)) {
-                    sibling->color = RED;
+            if ((!sibling->left || rbt_color(sibling->left) == BLACK) && 
+                (!sibling->right || rbt_color(sibling->right) == BLACK)) {
+                    rbt_set_color(sibling, RED);
                     to_be_fixed = parent;
-                    parent = to_be_fixed->p;
+                    parent = rbt_parent(to_be_fixed);
 
             // Cases 3 and 4
             } else { 
                 // Case 3: sibling is BLACK, left child is RED, right child is BLACK
-                if (!sibling->right || sibling->right->color == BLACK) {
-                    sibling->left->color = BLACK;
-                    sibling->color = RED;
+                if (!sibling->right || rbt_color(sibling->right) == BLACK) {
+                    rbt_set_color(sibling->left, BLACK);
+                    rbt_set_color(sibling, RED);
                     right_rotate(tree, sibling);
                     sibling = parent->right;
                 }
                 // Case 4: sibling is BLACK, right child is RED
-                sibling->color = parent->color;
-                parent->color = BLACK;
-                sibling->right->color = BLACK;
+                rbt_set_color(sibling, rbt_color(parent));
+                rbt_set_color(parent, BLACK);
+                rbt_set_color(sibling->right, BLACK);
                 left_rotate(tree, parent);
                 to_be_fixed = tree->root;
             }
@@ -283,32 +423,32 @@ static void rbt_delete_fixup(
             sibling = parent->left; // Cannot be NULL
 
             // Case 1: sibling is RED
-            if (sibling->color == RED) {
-                sibling->color = BLACK;
-                parent->color = RED;
+            if (rbt_color(sibling) == RED) {
+                rbt_set_color(sibling, BLACK);
+                rbt_set_color(parent, RED);
                 right_rotate(tree, parent);
                 sibling = parent->left;
             }
             // Case 2: sibling is BLACK and both its children are BLACK
-            if ((!sibling->left || sibling->left->color == BLACK) && 
-                (!sibling->right || sibling->right->color == BLACK)) {
-                    sibling->color = RED;
+            if ((!sibling->left || rbt_color(sibling->left) == BLACK) && 
+                (!sibling->right || rbt_color(sibling->right) == BLACK)) {
+                    rbt_set_color(sibling, RED);
                     to_be_fixed = parent;
-                    parent = to_be_fixed->p;
+                    parent = rbt_parent(to_be_fixed);
 
             // Cases 3 and 4
             } else {
                 // Case 3: sibling is BLACK, left child is BLACK, right child is RED
-                if (!sibling->left || sibling->left->color == BLACK) {
-                    sibling->right->color = BLACK;
-                    sibling->color = RED;
+                if (!sibling->left || rbt_color(sibling->left) == BLACK) {
+                    rbt_set_color(sibling->right, BLACK);
+                    rbt_set_color(sibling, RED);
                     left_rotate(tree, sibling);
                     sibling = parent->left;
                 }
                 // Case 4: sibling is BLACK, left child is RED
-                sibling->color = parent->color;
-                parent->color = BLACK;
-                sibling->left->color = BLACK;
+                rbt_set_color(sibling, rbt_color(parent));
+                rbt_set_color(parent, BLACK);
+                rbt_set_color(sibling->left, BLACK);
                 right_rotate(tree, parent);
                 to_be_fixed = tree->root;
             }       
@@ -317,18 +457,38 @@ static void rbt_delete_fixup(
     }
 
     if (to_be_fixed)
-        to_be_fixed->color = BLACK;
+        rbt_set_color(to_be_fixed, BLACK);
 }
 
+/* Search for the key in the tree and, if present, remove it. A node that 
+stores more than one occurrence of the key only loses one of them. */
 void rbt_delete(rbt_t* tree, int key) {
-    COLOR removed_color;  // Color of the node to delete.
-    rbt_node_t* to_be_fixed;  // Child of the node to delete. Can be NULL.
-    rbt_node_t* parent;  // Parent of the node to delete. Needed when to_be_fixed is NULL.
+    rbt_node_t* node = rbt_search(tree->root, key);
 
-    to_be_fixed = rbt_delete_subroutine(tree, key, &removed_color, &parent);
-    if (removed_color == BLACK) {
-        rbt_delete_fixup(tree, to_be_fixed, parent);
+    if (!node) {
+        printf("Key %d was not found.\n", key);
+        return;
     }
+#if RBT_MULTISET
+    if (node->count > 1) {
+        node->count--;
+#if RBT_ORDER_STATISTICS
+        for (rbt_node_t* curr = node; curr; curr = rbt_parent(curr))
+            curr->size--;
+#endif
+        return;
+    }
+#endif
+    rbt_erase_node(tree, node);
+    free(node);
+}
+
+/* Print the key, its count if above 1, and the color. */
+static void rbt_print_node(rbt_node_t* node) {
+    if (RBT_COUNT(node) > 1)
+        printf("%dx%u(%c) ", node->key, RBT_COUNT(node), (rbt_color(node) == RED) ? 'R' : 'B');
+    else
+        printf("%d(%c) ", node->key, (rbt_color(node) == RED) ? 'R' : 'B');
 }
 
 /* Preorder traverse. */
@@ -336,7 +496,7 @@ static void preorder_traverse(rbt_node_t* root) {
     if (!root)
          printf("%s ", "null");
     else {
-        printf("%d(%c) ", root->key, (root->color == RED) ? 'R' : 'B');
+        rbt_print_node(root);
         preorder_traverse(root->left);
         preorder_traverse(root->right);
     }
@@ -348,7 +508,7 @@ static void inorder_traverse(rbt_node_t* root) {
          printf("%s ", "null");
     else {
         inorder_traverse(root->left);
-        printf("%d(%c) ", root->key, (root->color == RED) ? 'R' : 'B');
+        rbt_print_node(root);
         inorder_traverse(root->right);
     }
 }
@@ -356,11 +516,11 @@ static void inorder_traverse(rbt_node_t* root) {
 /* Postorder traverse. */
 static void postorder_traverse(rbt_node_t* root) {
     if (!root)
-         printf("%s(B) ", "null");
+         printf("%s ", "null");
     else {
         postorder_traverse(root->left);
         postorder_traverse(root->right);
-        printf("%d(%c) ", root->key, (root->color == RED) ? 'R' : 'B');
+        rbt_print_node(root);
     }
 }
 
@@ -396,6 +556,661 @@ void rbt_free_tree(rbt_t* tree) {
 }
 
 
+#if RBT_ORDER_STATISTICS
+/**
+Order statistics. Every node stores the size of its subtree. The sizes are kept up
+to date by the insertion and deletion descents and by the two rotations, so the 
+k-th key and the rank of a key are found with a single descent in O(log n). 
+Duplicates stored as counts weigh as many keys as their count.
+*/
+
+static unsigned int rbt_size(rbt_node_t* node) {
+    return (node) ? node->size : 0;
+}
+
+/* Store in the output parameter the k-th smallest key (k = 0 is the minimum).
+Return false if the tree has k keys or fewer. */
+bool rbt_select(rbt_t* tree, size_t k, int* key) {
+    rbt_node_t* node = tree->root;
+    while (node) {
+        size_t left = rbt_size(node->left);
+        if (k < left) {
+            node = node->left;
+        } else if (k < left + RBT_COUNT(node)) {
+            *key = node->key;
+            return true;
+        } else {
+            k -= left + RBT_COUNT(node);
+            node = node->right;
+        }
+    }
+    return false;
+}
+
+/* Return the number of keys < key, or <= key if inclusive. */
+static size_t rbt_count_less(rbt_node_t* root, int key, bool inclusive) {
+    size_t count = 0;
+    while (root) {
+        if (root->key < key || (inclusive && root->key == key)) {
+            count += rbt_size(root->left) + RBT_COUNT(root);
+            root = root->right;
+        } else {
+            root = root->left;
+        }
+    }
+    return count;
+}
+
+/* Return the number of keys smaller than key. */
+size_t rbt_rank(rbt_t* tree, int key) {
+    return rbt_count_less(tree->root, key, false);
+}
+
+/* Return the number of keys in the range [lo, hi]. */
+size_t rbt_count_range(rbt_t* tree, int lo, int hi) {
+    if (lo > hi)
+        return 0;
+    return rbt_count_less(tree->root, hi, true) - rbt_count_less(tree->root, lo, false);
+}
+#endif
+
+/**
+Join-based set operations (Blelloch, Ferizovic and Sun, "Just Join for Parallel
+Ordered Sets", SPAA 2016). Everything is built on join(L, k, R), which links two
+trees and a middle node whose key lies between them in O(|bh(L) - bh(R)| + 1):
+the middle node is hung red on the spine of the taller tree at the first black
+node with the black height of the shorter one, and insert_fixup repairs the
+rest. Split and the divide-and-conquer set operations then cost O(log n) and
+O(m log(n/m + 1)), where m <= n are the sizes of the inputs. Subtrees handled
+here always have a black root and no parent; their black height (the number
+of black nodes on any path from the root down to NULL) is passed along so that
+it never needs to be recomputed. The set operations are meant for trees of
+distinct keys and consume their inputs: nodes are moved, never copied. On 
+multiset trees they act on the distinct keys: a node kept from the first tree
+keeps its count, whatever the count of the same key in the second one.
+*/
+
+/* Number of black nodes on the path from the root to the leftmost NULL. */
+static int rbt_black_height(rbt_node_t* root) {
+    int bh = 0;
+    for (; root; root = root->left)
+        bh += (rbt_color(root) == BLACK);
+    return bh;
+}
+
+/* Cut the subtree from its parent and make its root black. The black height
+must be the one of the subtree as a child; it grows by one if the root was red. */
+static rbt_node_t* rbt_expose(rbt_node_t* root, int* bh) {
+    if (root) {
+        rbt_set_parent(root, NULL);
+        if (rbt_color(root) == RED) {
+            rbt_set_color(root, BLACK);
+            (*bh)++;
+        }
+    }
+    return root;
+}
+
+/* Link the trees with the middle node: keys(left) <= mid->key <= keys(right).
+Return the root of the result and store its black height in the output parameter. */
+static rbt_node_t* rbt_join_subtrees(
+    rbt_node_t* left, int lbh, rbt_node_t* mid, rbt_node_t* right, int rbh, int* bh
+) {
+    rbt_node_t *parent = NULL, *curr;
+    rbt_t tmp;
+    int h;
+
+    if (lbh == rbh) {
+        mid->left = left;
+        mid->right = right;
+        if (left)
+            rbt_set_parent(left, mid);
+        if (right)
+            rbt_set_parent(right, mid);
+        rbt_set_parent_color(mid, NULL, BLACK);
+#if RBT_ORDER_STATISTICS
+        mid->size = RBT_COUNT(mid) + rbt_size(left) + rbt_size(right);
+#endif
+        *bh = lbh + 1;
+        return mid;
+    }
+
+    if (lbh > rbh) {  // Descend the right spine of the left tree
+#if RBT_ORDER_STATISTICS
+        unsigned int added = RBT_COUNT(mid) + rbt_size(right);
+#endif
+        curr = left;
+        h = lbh;
+        while (h > rbh || (curr && rbt_color(curr) == RED)) {
+            h -= (rbt_color(curr) == BLACK);
+#if RBT_ORDER_STATISTICS
+            curr->size += added;
+#endif
+            parent = curr;
+            curr = curr->right;
+        }
+        mid->left = curr;
+        mid->right = right;
+        parent->right = mid;
+        tmp.root = left;
+    } else {  // Descend the left spine of the right tree
+#if RBT_ORDER_STATISTICS
+        unsigned int added = RBT_COUNT(mid) + rbt_size(left);
+#endif
+        curr = right;
+        h = rbh;
+        while (h > lbh || (curr && rbt_color(curr) == RED)) {
+            h -= (rbt_color(curr) == BLACK);
+#if RBT_ORDER_STATISTICS
+            curr->size += added;
+#endif
+            parent = curr;
+            curr = curr->left;
+        }
+        mid->left = left;
+        mid->right = curr;
+        parent->left = mid;
+        tmp.root = right;
+    }
+
+    rbt_set_parent_color(mid, parent, RED);
+    if (mid->left)
+        rbt_set_parent(mid->left, mid);
+    if (mid->right)
+        rbt_set_parent(mid->right, mid);
+#if RBT_ORDER_STATISTICS
+    mid->size = RBT_COUNT(mid) + rbt_size(mid->left) + rbt_size(mid->right);
+#endif
+    *bh = ((lbh > rbh) ? lbh : rbh) + insert_fixup(&tmp, mid);
+    return tmp.root;
+}
+
+/* Split the tree into the keys smaller than key (smaller or equal if inclusive)
+and the others. The black heights of the two parts are stored with them. */
+static void rbt_split_subtree(
+    rbt_node_t* root, int bh, int key, bool inclusive,
+    rbt_node_t** left, int* lbh, rbt_node_t** right, int* rbh
+) {
+    if (!root) {
+        *left = *right = NULL;
+        *lbh = *rbh = 0;
+        return;
+    }
+
+    int l_bh = bh - (rbt_color(root) == BLACK), r_bh = l_bh;
+    rbt_node_t* l = rbt_expose(root->left, &l_bh);
+    rbt_node_t* r = rbt_expose(root->right, &r_bh);
+    rbt_node_t* middle;
+    int middle_bh;
+
+    if (root->key < key || (inclusive && root->key == key)) {
+        rbt_split_subtree(r, r_bh, key, inclusive, &middle, &middle_bh, right, rbh);
+        *left = rbt_join_subtrees(l, l_bh, root, middle, middle_bh, lbh);
+    } else {
+        rbt_split_subtree(l, l_bh, key, inclusive, left, lbh, &middle, &middle_bh);
+        *right = rbt_join_subtrees(middle, middle_bh, root, r, r_bh, rbh);
+    }
+}
+
+/* Detach the node with the maximum key and return it. The remaining tree and
+its black height are stored in the output parameters. */
+static rbt_node_t* rbt_split_last(rbt_node_t* root, int bh, rbt_node_t** rest, int* rest_bh) {
+    int l_bh = bh - (rbt_color(root) == BLACK), r_bh = l_bh;
+    rbt_node_t* l = rbt_expose(root->left, &l_bh);
+    rbt_node_t* r = rbt_expose(root->right, &r_bh);
+
+    if (!r) {
+        *rest = l;
+        *rest_bh = l_bh;
+        return root;
+    }
+    rbt_node_t* r_rest;
+    int r_rest_bh;
+    rbt_node_t* last = rbt_split_last(r, r_bh, &r_rest, &r_rest_bh);
+    *rest = rbt_join_subtrees(l, l_bh, root, r_rest, r_rest_bh, rest_bh);
+    return last;
+}
+
+/* Join without a middle key: the maximum of the left tree takes its place. */
+static rbt_node_t* rbt_join2(rbt_node_t* left, int lbh, rbt_node_t* right, int rbh, int* bh) {
+    if (!left) {
+        *bh = rbh;
+        return right;
+    }
+    rbt_node_t* rest;
+    int rest_bh;
+    rbt_node_t* last = rbt_split_last(left, lbh, &rest, &rest_bh);
+    return rbt_join_subtrees(rest, rest_bh, last, right, rbh, bh);
+}
+
+typedef struct {
+    RBT_SET_OP op;
+    rbt_node_t *a, *b;
+    int abh, bbh, bh, depth;
+    rbt_node_t* root;
+} set_task_t;
+
+static void* rbt_set_op_thread(void* arg) {
+    set_task_t* task = arg;
+    task->root = rbt_set_op(task->op, task->a, task->abh, task->b, task->bbh, &task->bh, task->depth);
+    return NULL;
+}
+
+/* Union, intersection or difference (a minus b) of two trees. The root of a
+splits b into the keys smaller than, equal to and greater than its key; the
+two sides are combined recursively and joined back. Up to 2^depth threads
+run at the same time: the left side is handed to a new thread. */
+static rbt_node_t* rbt_set_op(
+    RBT_SET_OP op, rbt_node_t* a, int abh, rbt_node_t* b, int bbh, int* bh, int depth
+) {
+    if (!a || !b) {
+        if (op == RBT_UNION || (op == RBT_DIFFERENCE && a)) {
+            *bh = (a) ? abh : bbh;
+            return (a) ? a : b;
+        }
+        free_tree_subroutine(a);
+        free_tree_subroutine(b);
+        *bh = 0;
+        return NULL;
+    }
+
+    int l_bh = abh - (rbt_color(a) == BLACK), r_bh = l_bh;
+    rbt_node_t* l = rbt_expose(a->left, &l_bh);
+    rbt_node_t* r = rbt_expose(a->right, &r_bh);
+    rbt_node_t *b_less, *b_rest, *b_equal, *b_greater;
+    int b_less_bh, b_rest_bh, b_equal_bh, b_greater_bh;
+
+    rbt_split_subtree(b, bbh, a->key, false, &b_less, &b_less_bh, &b_rest, &b_rest_bh);
+    rbt_split_subtree(b_rest, b_rest_bh, a->key, true, &b_equal, &b_equal_bh, &b_greater, &b_greater_bh);
+    bool in_b = (b_equal != NULL);
+    free_tree_subroutine(b_equal);
+
+    set_task_t task = {op, l, b_less, l_bh, b_less_bh, 0, depth - 1, NULL};
+    pthread_t thread;
+    bool forked = depth > 0;
+#if RBT_ORDER_STATISTICS
+    forked = forked && a->size + rbt_size(b_less) + rbt_size(b_greater) >= RBT_PARALLEL_CUTOFF;
+#endif
+    if (forked)
+        forked = !pthread_create(&thread, NULL, rbt_set_op_thread, &task);
+    if (!forked)
+        rbt_set_op_thread(&task);
+
+    int right_bh;
+    rbt_node_t* right = rbt_set_op(op, r, r_bh, b_greater, b_greater_bh, &right_bh, depth - 1);
+    if (forked)
+        pthread_join(thread, NULL);
+
+    bool keep = (op == RBT_UNION) || (op == RBT_INTERSECTION && in_b) || (op == RBT_DIFFERENCE && !in_b);
+    if (keep)
+        return rbt_join_subtrees(task.root, task.bh, a, right, right_bh, bh);
+    free(a);
+    return rbt_join2(task.root, task.bh, right, right_bh, bh);
+}
+
+/* Append the key and then all the keys of `right` to the tree, in O(log n).
+Every key of the tree must be <= key <= every key of `right`. `right` is left empty. */
+void rbt_join(rbt_t* tree, int key, rbt_t* right) {
+    rbt_node_t *max = tree->root, *min = right->root;
+    while (max && max->right)
+        max = max->right;
+    while (min && min->left)
+        min = min->left;
+    if ((max && max->key > key) || (min && min->key < key)) {
+        puts("Cannot join: the keys of the trees are not ordered.");
+        return;
+    }
+
+    int bh;
+    tree->root = rbt_join_subtrees(
+        tree->root, rbt_black_height(tree->root), rbt_create_node(key),
+        right->root, rbt_black_height(right->root), &bh);
+    right->root = NULL;
+}
+
+/* Move the keys >= key to the empty tree `right`, in O(log n). */
+void rbt_split(rbt_t* tree, int key, rbt_t* right) {
+    if (right->root) {
+        puts("Cannot split: the destination tree is not empty.");
+        return;
+    }
+    int lbh, rbh;
+    rbt_split_subtree(tree->root, rbt_black_height(tree->root), key, false,
+                      &tree->root, &lbh, &right->root, &rbh);
+}
+
+/* Subroutine of rbt_union, rbt_intersection and rbt_difference. */
+static void rbt_set_op_trees(RBT_SET_OP op, rbt_t* dst, rbt_t* src, int nthreads) {
+    int depth = 0, bh;
+    while ((1 << depth) < nthreads)
+        depth++;
+    dst->root = rbt_set_op(op, dst->root, rbt_black_height(dst->root),
+                           src->root, rbt_black_height(src->root), &bh, depth);
+    src->root = NULL;
+}
+
+/* Store in dst the keys of dst or src. src is left empty: its nodes are moved
+into dst or freed. Up to nthreads threads share the work (nthreads <= 1: none). */
+void rbt_union(rbt_t* dst, rbt_t* src, int nthreads) {
+    rbt_set_op_trees(RBT_UNION, dst, src, nthreads);
+}
+
+/* Store in dst the keys of both dst and src. src is left empty. */
+void rbt_intersection(rbt_t* dst, rbt_t* src, int nthreads) {
+    rbt_set_op_trees(RBT_INTERSECTION, dst, src, nthreads);
+}
+
+/* Remove from dst the keys of src. src is left empty. */
+void rbt_difference(rbt_t* dst, rbt_t* src, int nthreads) {
+    rbt_set_op_trees(RBT_DIFFERENCE, dst, src, nthreads);
+}
+
+/**
+Iterators. An iterator is a cursor on a node; the parent pointers lead to the
+successor and the predecessor without a stack and without allocations, in O(1)
+amortized time (O(log n) worst case). Any insertion or deletion invalidates the
+iterators of the tree.
+*/
+
+/* Return the node with the maximum key of the subtree. */
+static rbt_node_t* rbt_maximum(rbt_node_t* root) {
+    while (root->right)
+        root = root->right;
+    return root;
+}
+
+/* Return the node that follows the input node in order, or NULL. */
+static rbt_node_t* rbt_successor(rbt_node_t* node) {
+    if (node->right)
+        return rbt_minimum(node->right);
+    rbt_node_t* parent = rbt_parent(node);
+    while (parent && node == parent->right) {
+        node = parent;
+        parent = rbt_parent(node);
+    }
+    return parent;
+}
+
+/* Return the node that precedes the input node in order, or NULL. */
+static rbt_node_t* rbt_predecessor(rbt_node_t* node) {
+    if (node->left)
+        return rbt_maximum(node->left);
+    rbt_node_t* parent = rbt_parent(node);
+    while (parent && node == parent->left) {
+        node = parent;
+        parent = rbt_parent(node);
+    }
+    return parent;
+}
+
+/* Place the iterator on the minimum key. */
+void rbt_iter_first(rbt_iter_t* it, rbt_t* tree) {
+    it->node = (tree->root) ? rbt_minimum(tree->root) : NULL;
+    it->rep = 0;
+}
+
+/* Place the iterator on the last occurrence of the maximum key. */
+void rbt_iter_last(rbt_iter_t* it, rbt_t* tree) {
+    it->node = (tree->root) ? rbt_maximum(tree->root) : NULL;
+    it->rep = (it->node) ? RBT_COUNT(it->node) - 1 : 0;
+}
+
+/* Place the iterator on the first key >= key (> key if strict). */
+static void rbt_iter_seek(rbt_iter_t* it, rbt_t* tree, int key, bool strict) {
+    rbt_node_t* curr = tree->root;
+    it->node = NULL;
+    it->rep = 0;
+    while (curr) {
+        if (curr->key > key || (!strict && curr->key == key)) {
+            it->node = curr;
+            curr = curr->left;
+        } else {
+            curr = curr->right;
+        }
+    }
+}
+
+/* Place the iterator on the first key >= key. */
+void rbt_iter_lower_bound(rbt_iter_t* it, rbt_t* tree, int key) {
+    rbt_iter_seek(it, tree, key, false);
+}
+
+/* Place the iterator on the first key > key. */
+void rbt_iter_upper_bound(rbt_iter_t* it, rbt_t* tree, int key) {
+    rbt_iter_seek(it, tree, key, true);
+}
+
+/* Return false once the iterator has moved past either end. */
+bool rbt_iter_valid(rbt_iter_t* it) {
+    return it->node != NULL;
+}
+
+/* Return the key under a valid iterator. */
+int rbt_iter_key(rbt_iter_t* it) {
+    return it->node->key;
+}
+
+/* Move a valid iterator to the next key. */
+void rbt_iter_next(rbt_iter_t* it) {
+    if (++it->rep < RBT_COUNT(it->node))
+        return;
+    it->node = rbt_successor(it->node);
+    it->rep = 0;
+}
+
+/* Move a valid iterator to the previous key. */
+void rbt_iter_prev(rbt_iter_t* it) {
+    if (it->rep > 0) {
+        it->rep--;
+        return;
+    }
+    it->node = rbt_predecessor(it->node);
+    it->rep = (it->node) ? RBT_COUNT(it->node) - 1 : 0;
+}
+
+/* Remove all the keys in [lo, hi] and return how many they were. The range is
+cut out with two splits and the rest is joined back, so removing k keys costs
+O(k + log n) instead of O(k log n) for k calls to rbt_delete. */
+size_t rbt_delete_range(rbt_t* tree, int lo, int hi) {
+    if (lo > hi)
+        return 0;
+
+    rbt_node_t *left, *rest, *middle, *right;
+    int lbh, rest_bh, middle_bh, rbh;
+    rbt_split_subtree(tree->root, rbt_black_height(tree->root), lo, false, &left, &lbh, &rest, &rest_bh);
+    rbt_split_subtree(rest, rest_bh, hi, true, &middle, &middle_bh, &right, &rbh);
+
+    size_t removed = rbt_count_nodes(middle);
+    free_tree_subroutine(middle);
+    tree->root = rbt_join2(left, lbh, right, rbh, &lbh);
+    return removed;
+}
+
+/* Subroutine of rbt_freeze. Count the keys, duplicates included. */
+static size_t rbt_count_nodes(rbt_node_t* root) {
+    if (!root) return 0;
+    return RBT_COUNT(root) + rbt_count_nodes(root->left) + rbt_count_nodes(root->right);
+}
+
+/* Subroutine of rbt_freeze. Store the keys in order starting 
+at keys[i] and return the index after the last stored key. */
+static size_t rbt_collect_keys(rbt_node_t* root, int* keys, size_t i) {
+    if (!root) return i;
+    i = rbt_collect_keys(root->left, keys, i);
+    for (unsigned int c = 0; c < RBT_COUNT(root); c++)
+        keys[i++] = root->key;
+    return rbt_collect_keys(root->right, keys, i);
+}
+
+/* Build a read-only search index with the keys of the tree. The tree is not 
+modified and the index does not see later changes to the tree. */
+sidx_t* rbt_freeze(rbt_t* tree, SIDX_LAYOUT layout) {
+    size_t n = rbt_count_nodes(tree->root);
+    int* keys = malloc((n ? n : 1) * sizeof(int));
+    assert(keys);
+
+    rbt_collect_keys(tree->root, keys, 0);
+    sidx_t* index = sidx_build(keys, n, layout);
+
+    free(keys);
+    return index;
+}
+
+
+/**
+Serialization (see Serialization/serialize.c). The keys are saved in order, one
+record per distinct key with its number of occurrences. Loading them back is a
+single streaming pass that builds a balanced tree and colors it directly, with
+no rotation and no fixup.
+*/
+
+/* Subroutine of rbt_save. Visit the subtree in order and merge the runs of equal
+keys: outside multiset mode a duplicate has a node of its own. The run in progress
+is (*key, *count); every run that ends is written as a record if there is a writer,
+and *dup tells whether one was longer than 1. Return the number of runs started.
+The recursion is much faster than following rbt_successor, which climbs back
+through parents that have long left the cache. */
+static size_t rbt_save_subtree(rbt_node_t* root, ser_writer_t* writer, int* key, unsigned int* count, bool* dup) {
+    if (!root)
+        return 0;
+    size_t records = rbt_save_subtree(root->left, writer, key, count, dup);
+    if (*count && root->key == *key) {
+        *count += RBT_COUNT(root);
+    } else {
+        if (*count && writer)
+            ser_write(writer, *key, *count);
+        *dup = *dup || *count > 1;
+        *key = root->key;
+        *count = RBT_COUNT(root);
+        records++;
+    }
+    return records + rbt_save_subtree(root->right, writer, key, count, dup);
+}
+
+/* Subroutine of rbt_save. Return the number of records and store in *dup whether
+a key occurs more than once. Write the records if there is a writer. */
+static size_t rbt_save_records(rbt_t* tree, ser_writer_t* writer, bool* dup) {
+    unsigned int count = 0;
+    int key = 0;
+
+    *dup = false;
+    size_t records = rbt_save_subtree(tree->root, writer, &key, &count, dup);
+    if (count && writer)
+        ser_write(writer, key, count);
+    *dup = *dup || count > 1;
+    return records;
+}
+
+/* Write the keys to the stream in the format of Serialization/. The tree is not
+modified. Return false if the stream could not be written. */
+bool rbt_save(rbt_t* tree, FILE* out) {
+    ser_writer_t writer;
+    bool dup;
+
+    if (!tree) {
+        puts("The tree does not exist.");
+        return false;
+    }
+    size_t records = rbt_save_records(tree, NULL, &dup);
+#if RBT_MULTISET
+    dup = dup || tree->multiset;
+#endif
+    if (ser_writer_init(&writer, out, records, dup))
+        rbt_save_records(tree, &writer, &dup);
+    return ser_writer_finish(&writer);
+}
+
+/* Subroutine of rbt_load. Build a subtree with the next n records of the stream:
+the left half is read first, then the root, then the right half. Halving the
+records at every level fills all the levels but the deepest one, so coloring
+the nodes of depth `red_depth` red and all the others black gives the same black
+height to every path. Return NULL if the stream breaks. */
+static rbt_node_t* rbt_load_subtree(ser_reader_t* reader, size_t n, int depth, int red_depth) {
+    int key;
+    unsigned int count;
+
+    if (!n || !reader->ok)
+        return NULL;
+    rbt_node_t* left = rbt_load_subtree(reader, (n - 1) / 2, depth + 1, red_depth);
+    if (!ser_read(reader, &key, &count)) {
+        free_tree_subroutine(left);
+        return NULL;
+    }
+
+    rbt_node_t* node = rbt_create_node(key);
+#if RBT_MULTISET
+    node->count = count;
+#endif
+    rbt_set_color(node, (depth == red_depth && depth > 0) ? RED : BLACK);
+    node->left = left;
+    node->right = rbt_load_subtree(reader, n - 1 - (n - 1) / 2, depth + 1, red_depth);
+    if (!reader->ok) {
+        free_tree_subroutine(node);
+        return NULL;
+    }
+    if (node->left)
+        rbt_set_parent(node->left, node);
+    if (node->right)
+        rbt_set_parent(node->right, node);
+#if RBT_ORDER_STATISTICS
+    node->size = rbt_size(node->left) + rbt_size(node->right) + count;
+#endif
+    return node;
+}
+
+#if !RBT_MULTISET
+/* Subroutine of rbt_load for a stream with duplicate keys when the nodes have no
+count. The occurrences of a key cannot be split among the levels of the balanced
+shape before they are all known, so they are read first and inserted in order. */
+static rbt_t* rbt_load_expanded(ser_reader_t* reader) {
+    size_t n;
+    int* keys = ser_read_keys(reader, &n);
+
+    if (!ser_reader_finish(reader)) {
+        free(keys);
+        return NULL;
+    }
+    rbt_t* tree = rbt_create();
+    for (size_t i = 0; i < n; i++)
+        rbt_insert(tree, keys[i]);
+    free(keys);
+    return tree;
+}
+#endif
+
+/* Read a stream written by rbt_save and build a balanced red-black tree in O(n).
+A stream with duplicate keys gives a tree in multiset mode; without RBT_MULTISET,
+every occurrence is inserted as a node of its own instead, in O(n log n). Return
+NULL if the stream is broken. */
+rbt_t* rbt_load(FILE* in) {
+    ser_reader_t reader;
+    int red_depth = 0;
+
+    if (!ser_reader_init(&reader, in)) {
+        ser_reader_finish(&reader);
+        return NULL;
+    }
+#if !RBT_MULTISET
+    if (reader.flags & SER_COUNTS)
+        return rbt_load_expanded(&reader);
+#endif
+    while ((reader.n_records >> red_depth) > 1)  // red_depth = floor(log2(n))
+        red_depth++;
+
+    rbt_t* tree = rbt_create();
+#if RBT_MULTISET
+    tree->multiset = reader.flags & SER_COUNTS;
+#endif
+    tree->root = rbt_load_subtree(&reader, reader.n_records, 0, red_depth);
+    if (!ser_reader_finish(&reader)) {
+        rbt_free_tree(tree);
+        free(tree);
+        return NULL;
+    }
+    return tree;
+}
+
+
 /**
 Auxiliary functions to build an arbitrary red-black tree. It is not possible to build
 all valid red-black binary search trees by simply using insertion and deletion sequences.
@@ -466,15 +1281,22 @@ static rbt_node_t* rbt_fill_tree(
     assert(new_node);
     
     new_node->key = keys[idx];
-    new_node->color = (colors[idx] == 'R') ? RED : BLACK;
+    rbt_set_parent_color(new_node, NULL, (colors[idx] == 'R') ? RED : BLACK);
+#if RBT_MULTISET
+    new_node->count = 1;
+#endif
 
     new_node->left = rbt_fill_tree(2*idx + 1, keys, colors, len);
     if (new_node->left)
-        new_node->left->p = new_node;
+        rbt_set_parent(new_node->left, new_node);
 
     new_node->right = rbt_fill_tree(2*idx + 2, keys, colors, len);
     if (new_node->right)
-        new_node->right->p = new_node;    
+        rbt_set_parent(new_node->right, new_node);    
+
+#if RBT_ORDER_STATISTICS
+    new_node->size = 1 + rbt_size(new_node->left) + rbt_size(new_node->right);
+#endif
 
     return new_node;
 }
@@ -489,7 +1311,10 @@ rbt_t* build_rbt_from_arr(unsigned int len, int* keys, char* colors) {
     assert(tree);
 
     tree->root = rbt_fill_tree(0, keys, colors, len);
-    tree->root->p = NULL;
+#if RBT_MULTISET
+    tree->multiset = false;
+#endif
+    rbt_set_parent(tree->root, NULL);
 
     return tree;
 }
\ No newline at end of file
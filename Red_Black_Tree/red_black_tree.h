@@ -2,43 +2,128 @@
 #define RED_BLACK_TREE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/* red_black_tree.c also needs ../Static_Search_Index/static_index.c (rbt_freeze) and
+../Serialization/serialize.c (rbt_save, rbt_load), e.g.
+gcc -pthread red_black_tree_test.c red_black_tree.c ../Static_Search_Index/static_index.c ../Serialization/serialize.c */
+#include "../Static_Search_Index/static_index.h"
+#include "../Serialization/serialize.h"
 
 typedef enum {
     RED, BLACK
 } COLOR;
 
+#ifndef TRAVERSE_ORDER_DEFINED  // Shared with btree.h
+#define TRAVERSE_ORDER_DEFINED
 typedef enum {
     PREORDER, INORDER, POSTORDER
 } TRAVERSE_ORDER;
+#endif
 
+#ifndef RBT_ORDER_STATISTICS
+#define RBT_ORDER_STATISTICS 1  // Set to 0 to drop the subtree sizes
+#endif
+
+#ifndef RBT_MULTISET
+#define RBT_MULTISET 0  // Set to 1 for the duplicate counts of rbt_set_multiset
+#endif
+
+/* The color is packed into bit 0 of the parent pointer, which is always zero
+because nodes are at least word aligned. Without the duplicate counts the node
+is 32 bytes on 64-bit targets (the key and the size share the last word) instead
+of 40 with a separate color. The count of RBT_MULTISET brings it back to 40, so
+it is off by default. Always go through the accessors below to read or write the
+parent and the color. */
 typedef struct rbt_node_t {
+    uintptr_t parent_color;
+	struct rbt_node_t *left, *right;
 	int key;
-    COLOR color: 1;  // Bit field
-	struct rbt_node_t *p, *left, *right;
+#if RBT_ORDER_STATISTICS
+    unsigned int size;  // Number of keys in the subtree rooted here, duplicates included
+#endif
+#if RBT_MULTISET
+    unsigned int count;  // Occurrences of the key stored in this node
+#endif
 } rbt_node_t;
 
+#if RBT_MULTISET
+#define RBT_COUNT(node) ((node)->count)
+#else
+#define RBT_COUNT(node) 1u
+#endif
+
+_Static_assert(_Alignof(rbt_node_t) >= 2, "bit 0 of a node address must be free");
+
+static inline rbt_node_t* rbt_parent(const rbt_node_t* node) {
+    return (rbt_node_t*) (node->parent_color & ~(uintptr_t) 1);
+}
+
+static inline COLOR rbt_color(const rbt_node_t* node) {
+    return (COLOR) (node->parent_color & 1);
+}
+
+static inline void rbt_set_parent(rbt_node_t* node, rbt_node_t* parent) {
+    node->parent_color = (uintptr_t) parent | (node->parent_color & 1);
+}
+
+static inline void rbt_set_color(rbt_node_t* node, COLOR color) {
+    node->parent_color = (node->parent_color & ~(uintptr_t) 1) | color;
+}
+
+static inline void rbt_set_parent_color(rbt_node_t* node, rbt_node_t* parent, COLOR color) {
+    node->parent_color = (uintptr_t) parent | color;
+}
+
+/* In multiset mode a duplicate key increments the count of its node instead
+of adding a node. A zero-initialized rbt_t is an empty tree in set mode. */
 typedef struct red_black_tree {
     rbt_node_t* root;
+#if RBT_MULTISET
+    bool multiset;
+#endif
 } rbt_t;
 
+typedef enum {
+    RBT_UNION, RBT_INTERSECTION, RBT_DIFFERENCE
+} RBT_SET_OP;
+
+/* Bidirectional cursor. `node` is NULL once the iterator moves past either end.
+A key stored with a count is visited that many times; `rep` is the occurrence. */
+typedef struct rbt_iter {
+    rbt_node_t* node;
+    unsigned int rep;
+} rbt_iter_t;
+
+#define RBT_PARALLEL_CUTOFF 4096  // Smallest set operation handed to its own thread
+#define RBT_BATCH_GROUP 32  // Lookups in flight in rbt_search_batch
+
 rbt_t* rbt_create(void);
 bool rbt_is_empty(rbt_t* tree);
+#if RBT_MULTISET
+void rbt_set_multiset(rbt_t* tree, bool multiset);
+size_t rbt_count(rbt_t* tree, int key);
+#endif
 static rbt_node_t* rbt_create_node(int key);
 static void left_rotate(rbt_t* tree, rbt_node_t* root);
 static void right_rotate(rbt_t* tree, rbt_node_t* root);
 
 static rbt_node_t* rbt_insert_subroutine(rbt_t* tree, int key);
-static void insert_fixup(rbt_t* tree, rbt_node_t* ptr);
+static bool insert_fixup(rbt_t* tree, rbt_node_t* ptr);
 void rbt_insert(rbt_t* tree, int key);
 
 static rbt_node_t* rbt_search(rbt_node_t* root, int key);
+bool rbt_is_key_in(rbt_t* tree, int key);
+size_t rbt_search_batch(rbt_t* tree, const int* keys, size_t n, bool* found);
 static rbt_node_t* rbt_minimum(rbt_node_t* root);
 
-static void rbt_transplant(rbt_t* tree, rbt_node_t* child, rbt_node_t* grandchild);
-static rbt_node_t* rbt_delete_subroutine(rbt_t* tree, int key, COLOR* removed_color, rbt_node_t** parent);
+void rbt_link_node(rbt_t* tree, rbt_node_t* parent, rbt_node_t* node, bool left);
+static void rbt_replace_child(rbt_t* tree, rbt_node_t* parent, rbt_node_t* old, rbt_node_t* new);
+void rbt_erase_node(rbt_t* tree, rbt_node_t* node);
 static void rbt_delete_fixup(rbt_t* tree, rbt_node_t* to_be_fixed, rbt_node_t* parent);
 void rbt_delete(rbt_t* tree, int key);
 
+static void rbt_print_node(rbt_node_t* node);
 static void preorder_traverse(rbt_node_t* root);
 static void inorder_traverse(rbt_node_t* root);
 static void postorder_traverse(rbt_node_t* root);
@@ -47,6 +132,61 @@ void rbt_traverse(rbt_t* tree, TRAVERSE_ORDER order);
 static void free_tree_subroutine(rbt_node_t* root);
 void rbt_free_tree(rbt_t* tree);
 
+#if RBT_ORDER_STATISTICS
+/* Order statistics. */
+static unsigned int rbt_size(rbt_node_t* node);
+bool rbt_select(rbt_t* tree, size_t k, int* key);
+static size_t rbt_count_less(rbt_node_t* root, int key, bool inclusive);
+size_t rbt_rank(rbt_t* tree, int key);
+size_t rbt_count_range(rbt_t* tree, int lo, int hi);
+#endif
+
+/* Join-based split, join and set operations. */
+static int rbt_black_height(rbt_node_t* root);
+static rbt_node_t* rbt_expose(rbt_node_t* root, int* bh);
+static rbt_node_t* rbt_join_subtrees(rbt_node_t* left, int lbh, rbt_node_t* mid, rbt_node_t* right, int rbh, int* bh);
+static void rbt_split_subtree(rbt_node_t* root, int bh, int key, bool inclusive, rbt_node_t** left, int* lbh, rbt_node_t** right, int* rbh);
+static rbt_node_t* rbt_split_last(rbt_node_t* root, int bh, rbt_node_t** rest, int* rest_bh);
+static rbt_node_t* rbt_join2(rbt_node_t* left, int lbh, rbt_node_t* right, int rbh, int* bh);
+static void* rbt_set_op_thread(void* arg);
+static rbt_node_t* rbt_set_op(RBT_SET_OP op, rbt_node_t* a, int abh, rbt_node_t* b, int bbh, int* bh, int depth);
+void rbt_join(rbt_t* tree, int key, rbt_t* right);
+void rbt_split(rbt_t* tree, int key, rbt_t* right);
+static void rbt_set_op_trees(RBT_SET_OP op, rbt_t* dst, rbt_t* src, int nthreads);
+void rbt_union(rbt_t* dst, rbt_t* src, int nthreads);
+void rbt_intersection(rbt_t* dst, rbt_t* src, int nthreads);
+void rbt_difference(rbt_t* dst, rbt_t* src, int nthreads);
+
+/* Iterators and range deletion. */
+static rbt_node_t* rbt_maximum(rbt_node_t* root);
+static rbt_node_t* rbt_successor(rbt_node_t* node);
+static rbt_node_t* rbt_predecessor(rbt_node_t* node);
+void rbt_iter_first(rbt_iter_t* it, rbt_t* tree);
+void rbt_iter_last(rbt_iter_t* it, rbt_t* tree);
+static void rbt_iter_seek(rbt_iter_t* it, rbt_t* tree, int key, bool strict);
+void rbt_iter_lower_bound(rbt_iter_t* it, rbt_t* tree, int key);
+void rbt_iter_upper_bound(rbt_iter_t* it, rbt_t* tree, int key);
+bool rbt_iter_valid(rbt_iter_t* it);
+int rbt_iter_key(rbt_iter_t* it);
+void rbt_iter_next(rbt_iter_t* it);
+void rbt_iter_prev(rbt_iter_t* it);
+size_t rbt_delete_range(rbt_t* tree, int lo, int hi);
+
+/* Freeze the tree into a read-only search index. */
+static size_t rbt_count_nodes(rbt_node_t* root);
+static size_t rbt_collect_keys(rbt_node_t* root, int* keys, size_t i);
+sidx_t* rbt_freeze(rbt_t* tree, SIDX_LAYOUT layout);
+
+/* Save the keys to a stream and load them back into a balanced tree. */
+static size_t rbt_save_subtree(rbt_node_t* root, ser_writer_t* writer, int* key, unsigned int* count, bool* dup);
+static size_t rbt_save_records(rbt_t* tree, ser_writer_t* writer, bool* dup);
+bool rbt_save(rbt_t* tree, FILE* out);
+static rbt_node_t* rbt_load_subtree(ser_reader_t* reader, size_t n, int depth, int red_depth);
+#if !RBT_MULTISET
+static rbt_t* rbt_load_expanded(ser_reader_t* reader);
+#endif
+rbt_t* rbt_load(FILE* in);
+
 /* Create RB tree from an array of keys and another of colors. */
 static int rbt_check_properties(unsigned int idx, int* keys, char* colors, int len);
 static void rbt_is_valid(unsigned int len, int* keys, char* colors);
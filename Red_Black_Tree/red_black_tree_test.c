@@ -4,10 +4,16 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <string.h>
+#include <time.h>
 #include "red_black_tree.h"
 
 #define SIZE 8
 #define SIZE1 15
+#define RANDOM_OPS 400
+#define SET_RANGE 3000
+#define BIG_SET 1000000
+#define SMALL_SET 10000
+#define BIG_TREE 4000000
 
 void test_function(char* func) {
     unsigned int pad;
@@ -20,6 +26,69 @@ void test_function(char* func) {
     puts("");
 }
 
+/* Return the size of the subtree, or -1 if some node stores a wrong size. */
+int check_sizes(rbt_node_t* root) {
+    if (!root)
+        return 0;
+    int left = check_sizes(root->left), right = check_sizes(root->right);
+    int size = left + right + (int) RBT_COUNT(root);
+    if (left < 0 || right < 0 || root->size != (unsigned) size)
+        return -1;
+    return size;
+}
+
+int count_nodes(rbt_node_t* root) {
+    if (!root)
+        return 0;
+    return 1 + count_nodes(root->left) + count_nodes(root->right);
+}
+
+int cmp(const void* p, const void* q) {
+    return *(const int*) p - *(const int*) q;
+}
+
+/* Return the black height of the subtree, or -1 if a red-black or BST property,
+a parent link or a subtree size is wrong. */
+int check_rbt(rbt_node_t* root, rbt_node_t* parent, long lo, long hi) {
+    if (!root)
+        return 0;
+    if (rbt_parent(root) != parent || root->key < lo || root->key > hi)
+        return -1;
+    if (rbt_color(root) == RED && ((root->left && rbt_color(root->left) == RED) ||
+                                   (root->right && rbt_color(root->right) == RED)))
+        return -1;
+    int left = check_rbt(root->left, root, lo, root->key);
+    int right = check_rbt(root->right, root, root->key, hi);
+    if (left < 0 || left != right)
+        return -1;
+    return left + (rbt_color(root) == BLACK);
+}
+
+/* Return true if the tree is a valid red-black tree with exactly the keys k
+such that in[k] is true, for 0 <= k < SET_RANGE. */
+bool same_set(rbt_t* tree, bool* in) {
+    if (check_rbt(tree->root, NULL, INT_MIN, INT_MAX) < 0 || (tree->root && rbt_color(tree->root) == RED))
+        return false;
+    size_t n = 0;
+    int found;
+    for (int key = 0; key < SET_RANGE; key++) {
+        if (in[key] && (!rbt_select(tree, n++, &found) || found != key))
+            return false;
+    }
+    return check_sizes(tree->root) == (int) n;
+}
+
+/* Insert each key of [0, SET_RANGE) with probability 1/every. */
+rbt_t* random_set(bool* in, int every) {
+    rbt_t* tree = rbt_create();
+    for (int key = 0; key < SET_RANGE; key++) {
+        in[key] = rand() % every == 0;
+        if (in[key])
+            rbt_insert(tree, key);
+    }
+    return tree;
+}
+
 void print_arrays(int keys[], char* colors, int len) {
     puts("Build a RB tree from the following array:");
     for (int i = 0; i < len; i++) 
@@ -121,6 +190,378 @@ int main() {
     free(tree);
     tree = NULL;
 
+    /* Test rbt_freeze */
+    test_function("rbt_freeze");
+    tree = rbt_create();
+    for (int i = 0; i < SIZE; i++)
+        rbt_insert(tree, arr[i]);
+    sidx_t* index = rbt_freeze(tree, SIDX_EYTZINGER);
+    int key;
+    sidx_lower_bound(index, 9, &key);
+    printf("Freeze the keys 11, 2, 14, 1, 7, 15, 5, 8. Lower bound of 9: %d, rank of 9: %zu\n",
+           key, sidx_rank(index, 9));
+    printf("Key 14 is in the index: %s\n", sidx_contains(index, 14) ? "true" : "false");
+    printf("Key 13 is in the index: %s\n\n", sidx_contains(index, 13) ? "true" : "false");
+    sidx_free(index);
+    rbt_free_tree(tree);
+    free(tree);
+    tree = NULL;
+
+    /* Test rbt_select, rbt_rank and rbt_count_range */
+    test_function("rbt_select, rbt_rank and rbt_count_range");
+    int all_keys[RANDOM_OPS];
+    size_t len = 0;
+    srand(1);
+    tree = rbt_create();
+    for (int i = 0; i < RANDOM_OPS; i++) {  // Random inserts and deletes with duplicates
+        key = rand() % 40;
+        size_t j = 0;
+        while (j < len && all_keys[j] != key)
+            j++;
+        if (rand() % 3 || j == len) {
+            rbt_insert(tree, key);
+            all_keys[len++] = key;
+        } else {
+            rbt_delete(tree, key);
+            all_keys[j] = all_keys[--len];
+        }
+    }
+    qsort(all_keys, len, sizeof(int), cmp);
+    bool ok = check_sizes(tree->root) == (int) len;
+    for (size_t k = 0; k < len; k++)
+        ok = ok && rbt_select(tree, k, &key) && key == all_keys[k];
+    ok = ok && !rbt_select(tree, len, &key);
+    for (int lo = -5; lo <= 45; lo++) {
+        size_t rank = 0;
+        while (rank < len && all_keys[rank] < lo)
+            rank++;
+        ok = ok && rbt_rank(tree, lo) == rank;
+        for (int hi = lo; hi <= 45; hi += 7) {
+            size_t count = 0;
+            for (size_t j = 0; j < len; j++)
+                count += (all_keys[j] >= lo && all_keys[j] <= hi);
+            ok = ok && rbt_count_range(tree, lo, hi) == count;
+        }
+    }
+    rbt_select(tree, len / 2, &key);
+    printf("Keys: %zu, median: %d, rank of 20: %zu, keys in [10, 20]: %zu\n",
+           len, key, rbt_rank(tree, 20), rbt_count_range(tree, 10, 20));
+    printf("Subtree sizes, select, rank and count agree with a sorted array: %s\n\n", ok ? "true" : "false");
+    rbt_free_tree(tree);
+    free(tree);
+    tree = NULL;
+
+    rbt_iter_t it;
+#if RBT_MULTISET
+    /* Test rbt_set_multiset */
+    test_function("rbt_set_multiset");
+    int counts[40] = {0};
+    len = 0;
+    tree = rbt_create();
+    rbt_set_multiset(tree, true);
+    for (int i = 0; i < 6; i++)
+        rbt_insert(tree, (i % 2) ? 7 : 3 * i);
+    printf("%s", "Insert 0, 7, 6, 7, 12, 7. Inorder: ");
+    rbt_traverse(tree, INORDER);
+    printf("\nNodes: %d, count of 7: %zu, rank of 12: %zu\n", count_nodes(tree->root), rbt_count(tree, 7), rbt_rank(tree, 12));
+    rbt_free_tree(tree);
+
+    for (int i = 0; i < RANDOM_OPS; i++) {
+        key = rand() % 40;
+        if (rand() % 3 || !counts[key]) {
+            rbt_insert(tree, key);
+            counts[key]++;
+            len++;
+        } else {
+            rbt_delete(tree, key);
+            counts[key]--;
+            len--;
+        }
+    }
+    int distinct = 0;
+    ok = check_rbt(tree->root, NULL, INT_MIN, INT_MAX) >= 0 && check_sizes(tree->root) == (int) len;
+    for (int k = 0; k < 40; k++) {
+        distinct += (counts[k] > 0);
+        ok = ok && rbt_count(tree, k) == (size_t) counts[k];
+    }
+    ok = ok && count_nodes(tree->root) == distinct;
+    size_t k = 0;  // Forward, select and then backward: every occurrence once
+    rbt_iter_first(&it, tree);
+    for (int j = 0; j < 40; j++)
+        for (int c = 0; c < counts[j]; c++, k++, rbt_iter_next(&it))
+            ok = ok && rbt_iter_valid(&it) && rbt_iter_key(&it) == j && rbt_select(tree, k, &key) && key == j;
+    ok = ok && !rbt_iter_valid(&it);
+    rbt_iter_last(&it, tree);
+    for (int j = 39; j >= 0; j--)
+        for (int c = 0; c < counts[j]; c++, k--, rbt_iter_prev(&it))
+            ok = ok && rbt_iter_valid(&it) && rbt_iter_key(&it) == j;
+    ok = ok && !rbt_iter_valid(&it) && k == 0;
+    size_t expected_removed = 0;
+    for (int j = 10; j <= 19; j++)
+        expected_removed += counts[j];
+    ok = ok && rbt_delete_range(tree, 10, 19) == expected_removed && check_sizes(tree->root) == (int) (len - expected_removed);
+    printf("Keys: %zu in %d nodes\n", len, distinct);
+    printf("Counts, sizes, iterators, select and range deletion agree with a reference count: %s\n\n", ok ? "true" : "false");
+    rbt_free_tree(tree);
+    free(tree);
+    tree = NULL;
+#endif
+
+    /* Test rbt_split, rbt_join, rbt_union, rbt_intersection and rbt_difference */
+    test_function("Join-based set operations");
+    bool in_a[SET_RANGE], in_b[SET_RANGE], expected[SET_RANGE];
+    char* op_names[] = {"rbt_union", "rbt_intersection", "rbt_difference"};
+    int densities[][2] = {{2, 2}, {1, 50}, {50, 1}, {3, 1000000}, {1000000, 3}};
+    for (int op = RBT_UNION; op <= RBT_DIFFERENCE; op++) {
+        ok = true;
+        for (int d = 0; d < 5; d++) {
+            for (int nthreads = 1; nthreads <= 4; nthreads *= 4) {
+                rbt_t* a = random_set(in_a, densities[d][0]);
+                rbt_t* b = random_set(in_b, densities[d][1]);
+                for (int k = 0; k < SET_RANGE; k++) {
+                    if (op == RBT_UNION)
+                        expected[k] = in_a[k] || in_b[k];
+                    else if (op == RBT_INTERSECTION)
+                        expected[k] = in_a[k] && in_b[k];
+                    else
+                        expected[k] = in_a[k] && !in_b[k];
+                }
+                if (op == RBT_UNION)
+                    rbt_union(a, b, nthreads);
+                else if (op == RBT_INTERSECTION)
+                    rbt_intersection(a, b, nthreads);
+                else
+                    rbt_difference(a, b, nthreads);
+                ok = ok && same_set(a, expected) && rbt_is_empty(b);
+                rbt_free_tree(a);
+                free(a);
+                free(b);
+            }
+        }
+        printf("%s agrees with a reference set: %s\n", op_names[op], ok ? "true" : "false");
+    }
+
+    ok = true;
+    for (int at = -1; at <= SET_RANGE; at += 97) {
+        rbt_t* a = random_set(in_a, 2);
+        rbt_t* b = rbt_create();
+        rbt_split(a, at, b);
+        for (int k = 0; k < SET_RANGE; k++)
+            expected[k] = in_a[k] && k < at;
+        ok = ok && same_set(a, expected);
+        for (int k = 0; k < SET_RANGE; k++)
+            expected[k] = in_a[k] && k >= at;
+        ok = ok && same_set(b, expected);
+        if (at >= 0 && at < SET_RANGE && !in_a[at]) {  // Join back around the split key
+            rbt_join(a, at, b);
+            in_a[at] = true;
+            ok = ok && same_set(a, in_a) && rbt_is_empty(b);
+        }
+        rbt_free_tree(a);
+        rbt_free_tree(b);
+        free(a);
+        free(b);
+    }
+    printf("rbt_split and rbt_join agree with a reference set: %s\n", ok ? "true" : "false");
+
+    rbt_t* big = rbt_create();
+    rbt_t* small = rbt_create();
+    for (int i = 0; i < BIG_SET; i++)
+        rbt_insert(big, 2 * i);
+    for (int i = 0; i < SMALL_SET; i++)
+        rbt_insert(small, 2 * (int) ((unsigned) i * 2654435761u % BIG_SET) + 1);
+    clock_t start = clock();
+    rbt_union(big, small, 4);
+    printf("Union of %d and %d keys with 4 threads: %zu keys in %.4f s, valid: %s\n\n", BIG_SET, SMALL_SET,
+           rbt_count_range(big, INT_MIN, INT_MAX), (double) (clock() - start) / CLOCKS_PER_SEC,
+           check_rbt(big->root, NULL, INT_MIN, INT_MAX) >= 0 && check_sizes(big->root) >= 0 ? "true" : "false");
+    rbt_free_tree(big);
+    free(big);
+    free(small);
+
+    /* Test the iterators and rbt_delete_range */
+    test_function("Iterators and rbt_delete_range");
+    tree = random_set(in_a, 3);
+    printf("%s", "First keys: ");
+    rbt_iter_first(&it, tree);
+    for (int i = 0; i < 5 && rbt_iter_valid(&it); i++, rbt_iter_next(&it))
+        printf("%d ", rbt_iter_key(&it));
+    printf("%s", "\nLast keys: ");
+    rbt_iter_last(&it, tree);
+    for (int i = 0; i < 5 && rbt_iter_valid(&it); i++, rbt_iter_prev(&it))
+        printf("%d ", rbt_iter_key(&it));
+    puts("");
+
+    ok = true;
+    int prev_key = -1;  // Forward and backward walks visit the reference keys
+    for (rbt_iter_first(&it, tree); rbt_iter_valid(&it); rbt_iter_next(&it)) {
+        for (int k = prev_key + 1; k < rbt_iter_key(&it); k++)
+            ok = ok && !in_a[k];
+        ok = ok && in_a[rbt_iter_key(&it)];
+        prev_key = rbt_iter_key(&it);
+    }
+    for (rbt_iter_last(&it, tree); rbt_iter_valid(&it); rbt_iter_prev(&it)) {
+        ok = ok && in_a[prev_key] && rbt_iter_key(&it) == prev_key;
+        do prev_key--; while (prev_key >= 0 && !in_a[prev_key]);
+    }
+    ok = ok && prev_key < 0;
+    for (int key = -2; key <= SET_RANGE + 1; key++) {  // Bounds against a linear scan
+        int lower = (key < 0) ? 0 : key, upper = (key < 0) ? 0 : key + 1;
+        while (lower < SET_RANGE && !in_a[lower])
+            lower++;
+        while (upper < SET_RANGE && !in_a[upper])
+            upper++;
+        rbt_iter_lower_bound(&it, tree, key);
+        ok = ok && ((lower >= SET_RANGE) ? !rbt_iter_valid(&it) : rbt_iter_key(&it) == lower);
+        rbt_iter_upper_bound(&it, tree, key);
+        ok = ok && ((upper >= SET_RANGE) ? !rbt_iter_valid(&it) : rbt_iter_key(&it) == upper);
+    }
+    printf("next, prev, lower_bound and upper_bound agree with a linear scan: %s\n", ok ? "true" : "false");
+
+    ok = true;
+    for (int i = 0; i < 50; i++) {
+        int lo = rand() % SET_RANGE - 10, hi = lo + rand() % 300;
+        size_t expected_removed = 0;
+        for (int k = (lo < 0) ? 0 : lo; k <= hi && k < SET_RANGE; k++) {
+            expected_removed += in_a[k];
+            in_a[k] = false;
+        }
+        ok = ok && rbt_delete_range(tree, lo, hi) == expected_removed && same_set(tree, in_a);
+    }
+    printf("rbt_delete_range agrees with a reference set: %s\n", ok ? "true" : "false");
+    rbt_free_tree(tree);
+    free(tree);
+
+    tree = rbt_create();
+    for (int i = 0; i < BIG_SET; i++)
+        rbt_insert(tree, i);
+    start = clock();
+    size_t removed = rbt_delete_range(tree, BIG_SET / 4, 3 * BIG_SET / 4 - 1);
+    printf("Removed %zu contiguous keys out of %d in %.4f s\n\n", removed, BIG_SET,
+           (double) (clock() - start) / CLOCKS_PER_SEC);
+    rbt_free_tree(tree);
+    free(tree);
+    tree = NULL;
+
+    /* Test rbt_search_batch */
+    test_function("rbt_search_batch");
+    tree = rbt_create();
+    int* probes = malloc(BIG_TREE * sizeof(int));
+    bool* found = malloc(BIG_TREE * sizeof(bool));
+    for (int i = 0; i < BIG_TREE; i++) {
+        rbt_insert(tree, (int) ((unsigned) i * 2654435761u) & ~1);  // Even keys, scattered
+        probes[i] = (int) ((unsigned) (rand() % BIG_TREE) * 2654435761u) & ~1;
+        probes[i] += (i % 4 == 0);  // A quarter of the probes miss
+    }
+    start = clock();
+    size_t one_hits = 0;
+    for (int i = 0; i < BIG_TREE; i++)
+        one_hits += rbt_is_key_in(tree, probes[i]);
+    double one_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    size_t batch_hits = rbt_search_batch(tree, probes, BIG_TREE, found);
+    double batch_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    ok = one_hits == batch_hits;
+    for (int i = 0; i < BIG_TREE && ok; i += 101)
+        ok = found[i] == rbt_is_key_in(tree, probes[i]);
+    printf("%d lookups in a tree of %d keys, %zu hits\n", BIG_TREE, BIG_TREE, batch_hits);
+    printf("One at a time: %.3f s, batches of %d: %.3f s (%.1fx). Same results: %s\n\n", one_time,
+           RBT_BATCH_GROUP, batch_time, one_time / batch_time, ok ? "true" : "false");
+    free(probes);
+    free(found);
+    rbt_free_tree(tree);
+    free(tree);
+    tree = NULL;
+
+    /* Test rbt_save and rbt_load */
+    test_function("rbt_save and rbt_load");
+    ok = true;
+    for (int n = 0; n <= 300 && ok; n++) {  // Every shape of the last level up to 8 levels
+        FILE* file = tmpfile();
+        tree = rbt_create();
+        for (int i = 0; i < n; i++)
+            rbt_insert(tree, (i * 307) % n - n / 2);
+        rbt_t* loaded = (rbt_save(tree, file) && !fseek(file, 0, SEEK_SET)) ? rbt_load(file) : NULL;
+        ok = loaded && check_rbt(loaded->root, NULL, INT_MIN, INT_MAX) >= 0 &&
+             (!loaded->root || rbt_color(loaded->root) == BLACK) && check_sizes(loaded->root) == n;
+        for (int i = 0; i < n && ok; i++)
+            ok = rbt_select(loaded, i, &key) && key == i - n / 2;
+        fclose(file);
+        rbt_free_tree(tree);
+        free(tree);
+        if (loaded) {
+            rbt_free_tree(loaded);
+            free(loaded);
+        }
+    }
+    printf("Sets of 0 to 300 keys come back as valid red-black trees: %s\n", ok ? "true" : "false");
+
+    FILE* file = tmpfile();
+    tree = rbt_create();
+    for (int i = 0; i < SIZE; i++) {  // Duplicates get nodes of their own outside multiset mode
+        rbt_insert(tree, arr[i]);
+        rbt_insert(tree, arr[i] % 3);
+    }
+    rbt_t* loaded = (rbt_save(tree, file) && !fseek(file, 0, SEEK_SET)) ? rbt_load(file) : NULL;
+    ok = loaded && check_rbt(loaded->root, NULL, INT_MIN, INT_MAX) >= 0 && check_sizes(loaded->root) == 2 * SIZE;
+    for (int i = 0; i < 2 * SIZE && ok; i++) {
+        int expected;
+        ok = rbt_select(tree, i, &expected) && rbt_select(loaded, i, &key) && key == expected;
+    }
+    printf("Duplicate keys come back with all their occurrences: %s\n", ok ? "true" : "false");
+    fclose(file);
+    rbt_free_tree(tree);
+    free(tree);
+    if (loaded) {
+        rbt_free_tree(loaded);
+        free(loaded);
+    }
+
+#if RBT_MULTISET
+    file = tmpfile();
+    tree = rbt_create();
+    rbt_set_multiset(tree, true);
+    for (int i = 0; i < SIZE; i++) {
+        rbt_insert(tree, arr[i]);
+        rbt_insert(tree, arr[i] % 3);
+    }
+    loaded = (rbt_save(tree, file) && !fseek(file, 0, SEEK_SET)) ? rbt_load(file) : NULL;
+    printf("%s", "Multiset, inorder: ");
+    rbt_traverse(loaded, INORDER);
+    ok = loaded && loaded->multiset && check_sizes(loaded->root) == 2 * SIZE;
+    for (int k = 0; k < 16 && ok; k++)
+        ok = rbt_count(loaded, k) == rbt_count(tree, k);
+    printf("\nSame counts: %s\n", ok ? "true" : "false");
+    fclose(file);
+    rbt_free_tree(tree);
+    free(tree);
+    rbt_free_tree(loaded);
+    free(loaded);
+#endif
+
+    file = tmpfile();
+    tree = rbt_create();
+    start = clock();
+    for (int i = 0; i < BIG_TREE; i++)
+        rbt_insert(tree, (int) ((unsigned) i * 2654435761u));
+    double insert_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    ok = rbt_save(tree, file) && !fseek(file, 0, SEEK_SET);
+    double save_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    loaded = (ok) ? rbt_load(file) : NULL;
+    double load_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("%d keys: rbt_insert one by one %.3f s, rbt_save %.3f s, rbt_load %.3f s (%.1fx)\n",
+           BIG_TREE, insert_time, save_time, load_time, insert_time / load_time);
+    ok = loaded && check_rbt(loaded->root, NULL, INT_MIN, INT_MAX) >= 0 && check_sizes(loaded->root) == BIG_TREE;
+    printf("Valid and complete: %s\n\n", ok ? "true" : "false");
+    fclose(file);
+    rbt_free_tree(tree);
+    free(tree);
+    rbt_free_tree(loaded);
+    free(loaded);
+    tree = NULL;
+
     /* Test build_rbt_from_arr */
     test_function("Build RBT from array"); 
     int keys[SIZE1] = {10, 5, 15, -5, 7, 13, 20, -10, -3, 6, 8, 11, 16, 18, 25};
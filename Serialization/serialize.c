@@ -0,0 +1,315 @@
+/*
+* This is a binary format for ordered sets and multisets of int, e.g. the keys
+* of a BST or a red-black tree (see `bst_save`/`bst_load` and `rbt_save`/
+* `rbt_load`). The records are written in strictly increasing key order, so a
+* loader can rebuild a balanced tree in O(n) as the keys stream in, without
+* sorting and without rebalancing.
+*
+* All the integers are little-endian. The stream is a 32-byte header followed by
+* blocks of records:
+*
+*   header: "OMAP" | version u32 | flags u32 | block_records u32 |
+*           n_records u64 | reserved u32 | CRC of the previous 28 bytes u32
+*   block:  records u32 | CRC of the records u32 | records
+*   record: key i32, followed by count u32 if the flags hold SER_COUNTS
+*
+* Every block but the last holds exactly `block_records` records, so a truncated
+* stream is detected even when it is cut at a block boundary. The checksums are
+* CRC-32C: with SSE4.2 the CPU computes 8 bytes per instruction, otherwise a
+* slicing-by-8 table lookup does.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#if defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+#include "serialize.h"
+
+#define SER_MAGIC "OMAP"
+#define CRC32C_POLY 0x82F63B78u  // Reflected Castagnoli polynomial
+
+#if !(defined(__SSE4_2__) && defined(__x86_64__))  // Tables for the portable ser_crc32c
+static uint32_t crc32c_table[8][256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+/* crc32c_table[0] advances the CRC by one byte; crc32c_table[k] by one byte
+followed by k zero bytes, so eight lookups advance it by eight bytes. */
+static void ser_crc32c_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crc32c_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+        for (int k = 1; k < 8; k++)
+            crc32c_table[k][i] = (crc32c_table[k - 1][i] >> 8) ^ crc32c_table[0][crc32c_table[k - 1][i] & 0xff];
+}
+#endif
+
+/* Extend the CRC-32C of the previous bytes (0 for none) with len more bytes. */
+uint32_t ser_crc32c(uint32_t crc, const void* data, size_t len) {
+    const unsigned char* p = data;
+    crc = ~crc;
+#if defined(__SSE4_2__) && defined(__x86_64__)
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc = (uint32_t) _mm_crc32_u64(crc, word);
+    }
+    for (; len; p++, len--)
+        crc = _mm_crc32_u8(crc, *p);
+#else
+    pthread_once(&crc32c_once, ser_crc32c_init);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; len >= 8; p += 8, len -= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+              crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+              crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff] ^
+              crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+    }
+#endif
+    for (; len; p++, len--)
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p) & 0xff];
+#endif
+    return ~crc;
+}
+
+static void ser_put_u32(unsigned char* p, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (unsigned char) (value >> (8 * i));
+}
+
+static void ser_put_u64(unsigned char* p, uint64_t value) {
+    ser_put_u32(p, (uint32_t) value);
+    ser_put_u32(p + 4, (uint32_t) (value >> 32));
+}
+
+static uint32_t ser_get_u32(const unsigned char* p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint64_t ser_get_u64(const unsigned char* p) {
+    return (uint64_t) ser_get_u32(p) | (uint64_t) ser_get_u32(p + 4) << 32;
+}
+
+static size_t ser_record_size(uint32_t flags) {
+    return (flags & SER_COUNTS) ? 8 : 4;
+}
+
+
+/**
+Writing. The caller announces the number of records, then writes them in strictly
+increasing key order and calls `ser_writer_finish`, which reports whether the whole
+stream reached the FILE. Without SER_COUNTS every count must be 1.
+*/
+
+/* Write the header. Return false if it could not be written. */
+bool ser_writer_init(ser_writer_t* w, FILE* out, uint64_t n_records, bool counts) {
+    unsigned char header[SER_HEADER_SIZE] = {0};
+
+    w->out = out;
+    w->flags = (counts) ? SER_COUNTS : 0;
+    w->n_records = n_records;
+    w->written = 0;
+    w->fill = 0;
+    w->last_key = 0;
+    w->buf = malloc(SER_BLOCK_HEADER_SIZE + SER_BLOCK_RECORDS * ser_record_size(w->flags));
+    assert(w->buf);
+
+    memcpy(header, SER_MAGIC, 4);
+    ser_put_u32(header + 4, SER_VERSION);
+    ser_put_u32(header + 8, w->flags);
+    ser_put_u32(header + 12, SER_BLOCK_RECORDS);
+    ser_put_u64(header + 16, n_records);
+    ser_put_u32(header + 28, ser_crc32c(0, header, 28));
+    w->ok = out && fwrite(header, 1, SER_HEADER_SIZE, out) == SER_HEADER_SIZE;
+    if (!w->ok)
+        puts("Cannot write the stream header.");
+    return w->ok;
+}
+
+/* Write the records of the current block, if any, with the block header. */
+static bool ser_flush_block(ser_writer_t* w) {
+    if (!w->ok || !w->fill)
+        return w->ok;
+
+    size_t len = w->fill * ser_record_size(w->flags);
+    ser_put_u32(w->buf, w->fill);
+    ser_put_u32(w->buf + 4, ser_crc32c(0, w->buf + SER_BLOCK_HEADER_SIZE, len));
+    if (fwrite(w->buf, 1, SER_BLOCK_HEADER_SIZE + len, w->out) != SER_BLOCK_HEADER_SIZE + len) {
+        puts("Cannot write a block of the stream.");
+        w->ok = false;
+    }
+    w->fill = 0;
+    return w->ok;
+}
+
+/* Append a record. Return false if the stream is already broken, or if the record
+would break it: too many records, a key out of order or a wrong count. */
+bool ser_write(ser_writer_t* w, int key, unsigned int count) {
+    if (!w->ok)
+        return false;
+    if (w->written == w->n_records || (w->written && key <= w->last_key) ||
+        !count || (!(w->flags & SER_COUNTS) && count != 1)) {
+        puts("The record does not fit the stream.");
+        w->ok = false;
+        return false;
+    }
+
+    unsigned char* p = w->buf + SER_BLOCK_HEADER_SIZE + w->fill * ser_record_size(w->flags);
+    ser_put_u32(p, (uint32_t) key);
+    if (w->flags & SER_COUNTS)
+        ser_put_u32(p + 4, count);
+    w->last_key = key;
+    w->written++;
+    if (++w->fill == SER_BLOCK_RECORDS)
+        return ser_flush_block(w);
+    return true;
+}
+
+/* Flush the last block and release the buffer. The FILE stays open. Return true
+if all the announced records were written. */
+bool ser_writer_finish(ser_writer_t* w) {
+    ser_flush_block(w);
+    if (w->ok && w->written != w->n_records) {
+        puts("The stream holds fewer records than announced.");
+        w->ok = false;
+    }
+    if (w->ok && fflush(w->out)) {
+        puts("Cannot flush the stream.");
+        w->ok = false;
+    }
+    free(w->buf);
+    w->buf = NULL;
+    return w->ok;
+}
+
+
+/**
+Reading. `ser_read` returns the records one by one and false after the last one or
+on the first error; `ser_reader_finish` tells the two cases apart. The reader holds
+one block in memory, whatever the size of the stream.
+*/
+
+/* Read and check the header. Return false if it is not a valid header. */
+bool ser_reader_init(ser_reader_t* r, FILE* in) {
+    unsigned char header[SER_HEADER_SIZE];
+
+    r->in = in;
+    r->buf = NULL;
+    r->read = 0;
+    r->block_len = 0;
+    r->pos = 0;
+    r->last_key = 0;
+    r->ok = true;
+    if (!in || fread(header, 1, SER_HEADER_SIZE, in) != SER_HEADER_SIZE)
+        return ser_fail(r, "Cannot read the stream header.");
+    if (memcmp(header, SER_MAGIC, 4) || ser_get_u32(header + 28) != ser_crc32c(0, header, 28))
+        return ser_fail(r, "The stream header is corrupted.");
+
+    r->flags = ser_get_u32(header + 8);
+    r->block_records = ser_get_u32(header + 12);
+    r->n_records = ser_get_u64(header + 16);
+    if (ser_get_u32(header + 4) != SER_VERSION || (r->flags & ~SER_COUNTS) ||
+        !r->block_records || r->block_records > SER_MAX_BLOCK_RECORDS)
+        return ser_fail(r, "The stream version is not supported.");
+
+    r->buf = malloc(r->block_records * ser_record_size(r->flags));
+    assert(r->buf);
+    return true;
+}
+
+static bool ser_fail(ser_reader_t* r, const char* msg) {
+    puts(msg);
+    r->ok = false;
+    return false;
+}
+
+/* Read the next block and check its length and its checksum. */
+static bool ser_load_block(ser_reader_t* r) {
+    unsigned char header[SER_BLOCK_HEADER_SIZE];
+    uint64_t left = r->n_records - r->read;
+    uint32_t expected = (left < r->block_records) ? (uint32_t) left : r->block_records;
+
+    if (fread(header, 1, SER_BLOCK_HEADER_SIZE, r->in) != SER_BLOCK_HEADER_SIZE)
+        return ser_fail(r, "The stream is truncated.");
+    if (ser_get_u32(header) != expected)
+        return ser_fail(r, "The stream is corrupted: wrong block length.");
+
+    size_t len = expected * ser_record_size(r->flags);
+    if (fread(r->buf, 1, len, r->in) != len)
+        return ser_fail(r, "The stream is truncated.");
+    if (ser_crc32c(0, r->buf, len) != ser_get_u32(header + 4))
+        return ser_fail(r, "The stream is corrupted: checksum mismatch.");
+
+    r->block_len = expected;
+    r->pos = 0;
+    return true;
+}
+
+/* Store the next record in the output parameters. Return false after the last
+record, or if the stream is broken. */
+bool ser_read(ser_reader_t* r, int* key, unsigned int* count) {
+    if (!r->ok || r->read == r->n_records)
+        return false;
+    if (r->pos == r->block_len && !ser_load_block(r))
+        return false;
+
+    const unsigned char* p = r->buf + r->pos * ser_record_size(r->flags);
+    *key = (int) ser_get_u32(p);
+    *count = (r->flags & SER_COUNTS) ? ser_get_u32(p + 4) : 1;
+    if ((r->read && *key <= r->last_key) || !*count)
+        return ser_fail(r, "The stream is corrupted: invalid record.");
+
+    r->last_key = *key;
+    r->pos++;
+    r->read++;
+    return true;
+}
+
+/* Read the remaining records and return their keys in a new array of *n keys, where
+every key is repeated as many times as it occurs: for a loader whose nodes have no
+count. Return NULL if the stream breaks. */
+int* ser_read_keys(ser_reader_t* r, size_t* n) {
+    size_t cap = r->n_records - r->read + 1;
+    int* keys = malloc(cap * sizeof(int));
+    unsigned int count;
+    int key;
+
+    assert(keys);
+    *n = 0;
+    while (ser_read(r, &key, &count)) {
+        if (cap - *n < count) {
+            while (cap - *n < count)
+                cap *= 2;
+            keys = realloc(keys, cap * sizeof(int));
+            assert(keys);
+        }
+        while (count--)
+            keys[(*n)++] = key;
+    }
+    if (!r->ok) {
+        free(keys);
+        return NULL;
+    }
+    return keys;
+}
+
+/* Release the buffer. The FILE stays open, positioned after the stream. Return
+true if all the records were read without error. */
+bool ser_reader_finish(ser_reader_t* r) {
+    free(r->buf);
+    r->buf = NULL;
+    return r->ok && r->read == r->n_records;
+}
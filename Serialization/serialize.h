@@ -0,0 +1,73 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SER_VERSION 1
+#define SER_HEADER_SIZE 32
+#define SER_BLOCK_HEADER_SIZE 8
+#define SER_BLOCK_RECORDS (1 << 16)  // Records per block: 256 KiB of keys
+#define SER_MAX_BLOCK_RECORDS (1 << 24)  // Larger blocks in a header mean corruption
+
+/* Header flags. */
+#define SER_COUNTS 1u  // Every key is followed by its number of occurrences
+
+/* Writer of a stream of records (key, count) in strictly increasing key order.
+The number of records is fixed when the stream is opened, so that a loader can
+shape the tree before it has read any key. Records are packed into `buf`, which
+holds a whole block with its header, and each block is handed to the FILE in a
+single write. */
+typedef struct ser_writer {
+    FILE* out;
+    uint32_t flags;
+    uint64_t n_records;
+    uint64_t written;   // Records written so far
+    uint32_t fill;      // Records in the current block
+    unsigned char* buf;
+    bool ok;            // False after an I/O error or a misuse of the stream
+    int last_key;
+} ser_writer_t;
+
+/* Reader of a stream written by ser_writer_t. Every block is checked against its
+checksum as soon as it is read, and every record against the key order. */
+typedef struct ser_reader {
+    FILE* in;
+    uint32_t flags;
+    uint64_t n_records;
+    uint64_t read;        // Records returned so far
+    uint32_t block_records;
+    uint32_t block_len;   // Records in the current block
+    uint32_t pos;         // Next record of the current block
+    unsigned char* buf;
+    bool ok;              // False after an I/O error or a corrupted block
+    int last_key;
+} ser_reader_t;
+
+#if !(defined(__SSE4_2__) && defined(__x86_64__))
+static void ser_crc32c_init(void);
+#endif
+uint32_t ser_crc32c(uint32_t crc, const void* data, size_t len);
+static void ser_put_u32(unsigned char* p, uint32_t value);
+static void ser_put_u64(unsigned char* p, uint64_t value);
+static uint32_t ser_get_u32(const unsigned char* p);
+static uint64_t ser_get_u64(const unsigned char* p);
+static size_t ser_record_size(uint32_t flags);
+
+/* Writing. */
+bool ser_writer_init(ser_writer_t* w, FILE* out, uint64_t n_records, bool counts);
+static bool ser_flush_block(ser_writer_t* w);
+bool ser_write(ser_writer_t* w, int key, unsigned int count);
+bool ser_writer_finish(ser_writer_t* w);
+
+/* Reading. */
+bool ser_reader_init(ser_reader_t* r, FILE* in);
+static bool ser_fail(ser_reader_t* r, const char* msg);
+static bool ser_load_block(ser_reader_t* r);
+bool ser_read(ser_reader_t* r, int* key, unsigned int* count);
+int* ser_read_keys(ser_reader_t* r, size_t* n);
+bool ser_reader_finish(ser_reader_t* r);
+
+#endif
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "serialize.h"
+
+#define RECORDS (2 * SER_BLOCK_RECORDS + 5)  // Two full blocks and a short one
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+/* Write RECORDS records: key 3i - RECORDS with count i % 5 + 1. */
+FILE* write_stream(bool counts) {
+    ser_writer_t writer;
+    FILE* file = tmpfile();
+    ser_writer_init(&writer, file, RECORDS, counts);
+    for (int i = 0; i < RECORDS; i++)
+        ser_write(&writer, 3 * i - RECORDS, (counts) ? i % 5 + 1 : 1);
+    if (!ser_writer_finish(&writer)) {
+        fclose(file);
+        return NULL;
+    }
+    rewind(file);
+    return file;
+}
+
+/* Return true if the stream holds exactly the records of write_stream. */
+bool read_stream(FILE* file) {
+    ser_reader_t reader;
+    int key;
+    unsigned int count;
+    long i = 0;
+    bool ok = ser_reader_init(&reader, file);
+
+    while (ok && ser_read(&reader, &key, &count)) {
+        ok = key == 3 * i - RECORDS && count == ((reader.flags & SER_COUNTS) ? i % 5 + 1 : 1);
+        i++;
+    }
+    return ser_reader_finish(&reader) && ok && i == RECORDS;
+}
+
+/* Return a copy of the first len bytes of the file, with the byte at `flip`
+inverted (no byte if flip < 0). */
+FILE* damaged_copy(FILE* file, long len, long flip) {
+    FILE* copy = tmpfile();
+    rewind(file);
+    for (long i = 0; i < len; i++) {
+        int c = fgetc(file);
+        fputc((i == flip) ? ~c & 0xff : c, copy);
+    }
+    rewind(copy);
+    return copy;
+}
+
+int main() {
+    test_function("ser_crc32c");
+    const char* check = "123456789";
+    uint32_t crc = ser_crc32c(0, check, 9);
+    printf("CRC-32C of \"%s\": %08X (expected E3069283)\n", check, (unsigned) crc);
+    printf("Computed in two parts: %08X\n\n", (unsigned) ser_crc32c(ser_crc32c(0, check, 5), check + 5, 4));
+
+    test_function("ser_write and ser_read");
+    for (int counts = 0; counts <= 1; counts++) {
+        FILE* file = write_stream(counts);
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        rewind(file);
+        printf("%d records %s counts: %ld bytes, read back: %s\n", RECORDS,
+               (counts) ? "with" : "without", size, read_stream(file) ? "true" : "false");
+        fclose(file);
+    }
+
+    ser_writer_t writer;
+    FILE* file = tmpfile();
+    ser_writer_init(&writer, file, 3, false);
+    ser_write(&writer, 5, 1);
+    printf("%s", "Write 4 after 5: ");
+    ser_write(&writer, 4, 1);
+    printf("The writer reports the error: %s\n", ser_writer_finish(&writer) ? "false" : "true");
+    fclose(file);
+
+    file = tmpfile();
+    ser_writer_init(&writer, file, 3, false);
+    ser_write(&writer, 5, 1);
+    printf("%s", "Stop after 1 record out of 3: ");
+    printf("The writer reports the error: %s\n\n", ser_writer_finish(&writer) ? "false" : "true");
+    fclose(file);
+
+    test_function("Damaged streams");
+    file = write_stream(true);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    struct {
+        const char* what;
+        long len, flip;
+    } damages[] = {
+        {"Bad magic", size, 0},
+        {"Bad record count", size, 16},
+        {"Flipped key in the first block", size, SER_HEADER_SIZE + SER_BLOCK_HEADER_SIZE + 100},
+        {"Flipped count in the last block", size, size - 4},
+        {"Cut in the middle of a block", size / 2, -1},
+        {"Cut at a block boundary", SER_HEADER_SIZE + 2 * (SER_BLOCK_HEADER_SIZE + 8 * SER_BLOCK_RECORDS), -1},
+    };
+    for (size_t i = 0; i < sizeof(damages) / sizeof(damages[0]); i++) {
+        FILE* copy = damaged_copy(file, damages[i].len, damages[i].flip);
+        printf("%s: ", damages[i].what);
+        printf("Rejected: %s\n", read_stream(copy) ? "false" : "true");
+        fclose(copy);
+    }
+    fclose(file);
+    return 0;
+}
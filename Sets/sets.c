@@ -0,0 +1,665 @@
+/*
+* This is a compressed set of 32-bit unsigned integers in the style of a Roaring
+* bitmap. The values are grouped by their high 16 bits; each group keeps the low
+* 16 bits in a container whose representation depends on its density:
+*
+* - array: the sorted values, 2 bytes each, for up to SET_ARRAY_MAX values;
+* - bitmap: 65536 bits (8 KB), one per possible value, for more.
+*
+* So a value never costs more than 2 bytes plus its share of a 16-byte container
+* header, and dense ranges cost as little as 1 bit per value: a set of 10^9 IDs
+* out of 2^32 fits in about 512 MB, while a hash set would need several GB.
+* Lookups are a binary search over the keys and then a bit test or a binary
+* search over at most SET_ARRAY_MAX values.
+*
+* The set operations work container by container, and never look at the values
+* of the containers that only one side has. Between two bitmaps they are word-wise
+* OR, AND and ANDNOT, 256 bits at a time with AVX2, with the cardinality of the
+* result counted in the same pass (the popcount of a vector is a pair of nibble
+* lookups with `pshufb`). The result of an operation is again an array or a bitmap
+* according to its cardinality.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "sets.h"
+
+/* Allocate an empty set. */
+set_t* set_create(void) {
+    set_t* set = malloc(sizeof(set_t));
+    assert(set);
+    set->keys = NULL;
+    set->containers = NULL;
+    set->n_containers = 0;
+    set->cap = 0;
+    return set;
+}
+
+void set_destroy(set_t* set) {
+    if (!set)
+        return;
+    for (size_t i = 0; i < set->n_containers; i++)
+        set_container_free(&set->containers[i]);
+    free(set->keys);
+    free(set->containers);
+    free(set);
+}
+
+/* Add the value to the set. Return true if it was not there already. */
+bool set_insert(set_t* set, uint32_t value) {
+    uint16_t key = value >> 16;
+    size_t pos = set_lower_bound(set, key);
+    set_container_t* c = (pos < set->n_containers && set->keys[pos] == key) ?
+                         &set->containers[pos] : set_insert_container(set, pos, key);
+    return set_container_insert(c, (uint16_t) value);
+}
+
+/* Remove the value from the set. Return true if it was there. */
+bool set_remove(set_t* set, uint32_t value) {
+    uint16_t key = value >> 16;
+    size_t pos = set_lower_bound(set, key);
+    if (pos == set->n_containers || set->keys[pos] != key ||
+        !set_container_remove(&set->containers[pos], (uint16_t) value))
+        return false;
+    if (!set->containers[pos].card)
+        set_erase_container(set, pos);
+    return true;
+}
+
+bool set_contains(const set_t* set, uint32_t value) {
+    uint16_t key = value >> 16;
+    size_t pos = set_lower_bound(set, key);
+    return pos < set->n_containers && set->keys[pos] == key &&
+           set_container_contains(&set->containers[pos], (uint16_t) value);
+}
+
+/* Return the number of values, in O(number of containers). */
+uint64_t set_cardinality(const set_t* set) {
+    uint64_t card = 0;
+    for (size_t i = 0; i < set->n_containers; i++)
+        card += set->containers[i].card;
+    return card;
+}
+
+/* Store the values in increasing order in `out`, which must have room for
+set_cardinality(set) of them. Return their number. */
+size_t set_to_array(const set_t* set, uint32_t* out) {
+    size_t n = 0;
+    for (size_t i = 0; i < set->n_containers; i++) {
+        const set_container_t* c = &set->containers[i];
+        uint32_t high = (uint32_t) set->keys[i] << 16;
+        if (c->type == SET_ARRAY) {
+            for (uint32_t j = 0; j < c->card; j++)
+                out[n++] = high | c->array[j];
+            continue;
+        }
+        for (uint32_t w = 0; w < SET_BITMAP_WORDS; w++) {
+            for (uint64_t word = c->bitmap[w]; word; word &= word - 1)
+                out[n++] = high | (w << 6) | __builtin_ctzll(word);
+        }
+    }
+    return n;
+}
+
+/* Return the number of bytes allocated for the set. */
+size_t set_memory(const set_t* set) {
+    size_t bytes = sizeof(set_t) + set->cap * (sizeof(uint16_t) + sizeof(set_container_t));
+    for (size_t i = 0; i < set->n_containers; i++) {
+        const set_container_t* c = &set->containers[i];
+        bytes += (c->type == SET_ARRAY) ? c->cap * sizeof(uint16_t) : SET_BITMAP_WORDS * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+/* Return a new set with the values of a or b. */
+set_t* set_union(const set_t* a, const set_t* b) {
+    set_t* out = set_create();
+    set_container_t c;
+    size_t i = 0, j = 0;
+    while (i < a->n_containers || j < b->n_containers) {
+        if (j == b->n_containers || (i < a->n_containers && a->keys[i] < b->keys[j])) {
+            set_container_copy(&c, &a->containers[i]);
+            set_append(out, a->keys[i++], &c);
+        } else if (i == a->n_containers || b->keys[j] < a->keys[i]) {
+            set_container_copy(&c, &b->containers[j]);
+            set_append(out, b->keys[j++], &c);
+        } else {
+            set_container_union(&a->containers[i], &b->containers[j], &c);
+            set_append(out, a->keys[i], &c);
+            i++;
+            j++;
+        }
+    }
+    return out;
+}
+
+/* Return a new set with the values of both a and b. */
+set_t* set_intersection(const set_t* a, const set_t* b) {
+    set_t* out = set_create();
+    set_container_t c;
+    size_t i = 0, j = 0;
+    while (i < a->n_containers && j < b->n_containers) {
+        if (a->keys[i] < b->keys[j]) {
+            i++;
+        } else if (b->keys[j] < a->keys[i]) {
+            j++;
+        } else {
+            set_container_intersection(&a->containers[i], &b->containers[j], &c);
+            set_append(out, a->keys[i], &c);
+            i++;
+            j++;
+        }
+    }
+    return out;
+}
+
+/* Return a new set with the values of a that are not in b. */
+set_t* set_difference(const set_t* a, const set_t* b) {
+    set_t* out = set_create();
+    set_container_t c;
+    size_t j = 0;
+    for (size_t i = 0; i < a->n_containers; i++) {
+        while (j < b->n_containers && b->keys[j] < a->keys[i])
+            j++;
+        if (j < b->n_containers && b->keys[j] == a->keys[i])
+            set_container_difference(&a->containers[i], &b->containers[j], &c);
+        else
+            set_container_copy(&c, &a->containers[i]);
+        set_append(out, a->keys[i], &c);
+    }
+    return out;
+}
+
+/* Return the number of values of both a and b, without building the set. */
+uint64_t set_intersection_cardinality(const set_t* a, const set_t* b) {
+    uint64_t card = 0;
+    size_t i = 0, j = 0;
+    while (i < a->n_containers && j < b->n_containers) {
+        if (a->keys[i] < b->keys[j]) {
+            i++;
+        } else if (b->keys[j] < a->keys[i]) {
+            j++;
+        } else {
+            card += set_container_intersection_card(&a->containers[i], &b->containers[j]);
+            i++;
+            j++;
+        }
+    }
+    return card;
+}
+
+
+/**
+Containers. A container only holds the low 16 bits of its values.
+*/
+
+/* Return the number of values of the sorted array that are smaller than value. */
+static uint32_t set_array_rank(const uint16_t* array, uint32_t len, uint16_t value) {
+    uint32_t lo = 0, hi = len;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (array[mid] < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Return a zeroed bitmap, aligned for vector loads. */
+static uint64_t* set_bitmap_alloc(void) {
+    uint64_t* bitmap = aligned_alloc(SET_BITMAP_ALIGN, SET_BITMAP_WORDS * sizeof(uint64_t));
+    assert(bitmap);
+    memset(bitmap, 0, SET_BITMAP_WORDS * sizeof(uint64_t));
+    return bitmap;
+}
+
+static void set_array_to_bitmap(set_container_t* c) {
+    uint64_t* bitmap = set_bitmap_alloc();
+    for (uint32_t i = 0; i < c->card; i++)
+        bitmap[c->array[i] >> 6] |= 1ULL << (c->array[i] & 63);
+    free(c->array);
+    c->bitmap = bitmap;
+    c->type = SET_BITMAP;
+    c->cap = 0;
+}
+
+static void set_bitmap_to_array(set_container_t* c) {
+    uint16_t* array = malloc((c->card ? c->card : 1) * sizeof(uint16_t));
+    uint32_t n = 0;
+    assert(array);
+    for (uint32_t w = 0; w < SET_BITMAP_WORDS; w++) {
+        for (uint64_t word = c->bitmap[w]; word; word &= word - 1)
+            array[n++] = (w << 6) | __builtin_ctzll(word);
+    }
+    free(c->bitmap);
+    c->array = array;
+    c->type = SET_ARRAY;
+    c->cap = c->card;
+}
+
+static bool set_container_contains(const set_container_t* c, uint16_t low) {
+    if (c->type == SET_BITMAP)
+        return c->bitmap[low >> 6] >> (low & 63) & 1;
+    uint32_t pos = set_array_rank(c->array, c->card, low);
+    return pos < c->card && c->array[pos] == low;
+}
+
+/* Return true if the value was not there already. A full array becomes a bitmap. */
+static bool set_container_insert(set_container_t* c, uint16_t low) {
+    if (c->type == SET_BITMAP) {
+        uint64_t* word = &c->bitmap[low >> 6], bit = 1ULL << (low & 63);
+        if (*word & bit)
+            return false;
+        *word |= bit;
+        c->card++;
+        return true;
+    }
+    uint32_t pos = set_array_rank(c->array, c->card, low);
+    if (pos < c->card && c->array[pos] == low)
+        return false;
+    if (c->card == SET_ARRAY_MAX) {
+        set_array_to_bitmap(c);
+        return set_container_insert(c, low);
+    }
+    if (c->card == c->cap) {
+        c->cap = (c->cap) ? 2 * c->cap : 4;
+        c->cap = (c->cap < SET_ARRAY_MAX) ? c->cap : SET_ARRAY_MAX;
+        c->array = realloc(c->array, c->cap * sizeof(uint16_t));
+        assert(c->array);
+    }
+    memmove(c->array + pos + 1, c->array + pos, (c->card - pos) * sizeof(uint16_t));
+    c->array[pos] = low;
+    c->card++;
+    return true;
+}
+
+/* Return true if the value was there. A bitmap below half of SET_ARRAY_MAX values
+becomes an array. */
+static bool set_container_remove(set_container_t* c, uint16_t low) {
+    if (c->type == SET_BITMAP) {
+        uint64_t* word = &c->bitmap[low >> 6], bit = 1ULL << (low & 63);
+        if (!(*word & bit))
+            return false;
+        *word &= ~bit;
+        if (--c->card < SET_ARRAY_MAX / 2)
+            set_bitmap_to_array(c);
+        return true;
+    }
+    uint32_t pos = set_array_rank(c->array, c->card, low);
+    if (pos == c->card || c->array[pos] != low)
+        return false;
+    memmove(c->array + pos, c->array + pos + 1, (c->card - pos - 1) * sizeof(uint16_t));
+    c->card--;
+    return true;
+}
+
+static void set_container_copy(set_container_t* dst, const set_container_t* src) {
+    *dst = *src;
+    if (src->type == SET_BITMAP) {
+        dst->bitmap = set_bitmap_alloc();
+        memcpy(dst->bitmap, src->bitmap, SET_BITMAP_WORDS * sizeof(uint64_t));
+    } else {
+        dst->cap = src->card;
+        dst->array = malloc((src->card ? src->card : 1) * sizeof(uint16_t));
+        assert(dst->array);
+        memcpy(dst->array, src->array, src->card * sizeof(uint16_t));
+    }
+}
+
+static void set_container_free(set_container_t* c) {
+    if (c->type == SET_BITMAP)
+        free(c->bitmap);
+    else
+        free(c->array);
+}
+
+
+/**
+Set operations on containers. Each one builds a new container in `out`, which may
+be empty: set_append drops empty containers.
+*/
+
+/* Combine two bitmaps word by word and return the cardinality of the result. The
+result is stored in dst, unless it is NULL; dst may be a. */
+static uint32_t set_bitmap_op(uint64_t* dst, const uint64_t* a, const uint64_t* b, SET_OP op) {
+#if defined(__AVX2__)
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    for (int i = 0; i < SET_BITMAP_WORDS; i += 16) {
+        __m256i counts = _mm256_setzero_si256();  // Per byte: at most 4 * 8 bits
+        for (int j = i; j < i + 16; j += 4) {
+            __m256i x = _mm256_load_si256((const __m256i*) (a + j));
+            __m256i y = _mm256_load_si256((const __m256i*) (b + j));
+            __m256i r = (op == SET_OR) ? _mm256_or_si256(x, y) :
+                        (op == SET_AND) ? _mm256_and_si256(x, y) : _mm256_andnot_si256(y, x);
+            if (dst)
+                _mm256_store_si256((__m256i*) (dst + j), r);
+            counts = _mm256_add_epi8(counts, _mm256_shuffle_epi8(lookup, _mm256_and_si256(r, nibble)));
+            counts = _mm256_add_epi8(counts, _mm256_shuffle_epi8(lookup,
+                                     _mm256_and_si256(_mm256_srli_epi16(r, 4), nibble)));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+    }
+    return (uint32_t) (_mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+                       _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3));
+#else
+    uint32_t card = 0;
+    for (int i = 0; i < SET_BITMAP_WORDS; i++) {
+        uint64_t r = (op == SET_OR) ? a[i] | b[i] : (op == SET_AND) ? a[i] & b[i] : a[i] & ~b[i];
+        if (dst)
+            dst[i] = r;
+        card += __builtin_popcountll(r);
+    }
+    return card;
+#endif
+}
+
+/* Combine two bitmaps into a container of the right type. AND and ANDNOT count
+the result first, so a small result goes straight into an array. */
+static void set_bitmaps_combine(const uint64_t* a, const uint64_t* b, SET_OP op, set_container_t* out) {
+    if (op == SET_OR || (out->card = set_bitmap_op(NULL, a, b, op)) > SET_ARRAY_MAX) {
+        out->type = SET_BITMAP;
+        out->cap = 0;
+        out->bitmap = set_bitmap_alloc();
+        out->card = set_bitmap_op(out->bitmap, a, b, op);
+        if (out->card <= SET_ARRAY_MAX)
+            set_bitmap_to_array(out);
+        return;
+    }
+    uint32_t n = 0;
+    out->type = SET_ARRAY;
+    out->cap = out->card;
+    out->array = malloc((out->card ? out->card : 1) * sizeof(uint16_t));
+    assert(out->array);
+    for (uint32_t w = 0; w < SET_BITMAP_WORDS; w++) {
+        uint64_t word = (op == SET_AND) ? a[w] & b[w] : a[w] & ~b[w];
+        for (; word; word &= word - 1)
+            out->array[n++] = (w << 6) | __builtin_ctzll(word);
+    }
+}
+
+/* Merge two sorted arrays into out (NULL: only count) and return the length of
+the result. The OR needs room for na + nb values in out. When b is much longer
+than a, the AND gallops through b instead of scanning it. */
+static uint32_t set_arrays_merge(const uint16_t* a, uint32_t na, const uint16_t* b, uint32_t nb,
+                                 SET_OP op, uint16_t* out) {
+    uint32_t i = 0, j = 0, n = 0;
+    if (op == SET_AND && (uint64_t) na * 64 < nb) {
+        for (; i < na && j < nb; i++) {
+            uint32_t step = 1, hi = j;
+            while (hi < nb && b[hi] < a[i]) {  // b[j - 1] < a[i] <= b[hi]
+                j = hi + 1;
+                hi += step;
+                step *= 2;
+            }
+            j = j + set_array_rank(b + j, ((hi < nb) ? hi + 1 : nb) - j, a[i]);
+            if (j < nb && b[j] == a[i]) {
+                if (out)
+                    out[n] = a[i];
+                n++;
+            }
+        }
+        return n;
+    }
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            if (op != SET_AND) {
+                if (out)
+                    out[n] = a[i];
+                n++;
+            }
+            i++;
+        } else if (b[j] < a[i]) {
+            if (op == SET_OR) {
+                if (out)
+                    out[n] = b[j];
+                n++;
+            }
+            j++;
+        } else {
+            if (op != SET_ANDNOT) {
+                if (out)
+                    out[n] = a[i];
+                n++;
+            }
+            i++;
+            j++;
+        }
+    }
+    if (op != SET_AND) {
+        if (out)
+            memcpy(out + n, a + i, (na - i) * sizeof(uint16_t));
+        n += na - i;
+    }
+    if (op == SET_OR) {
+        if (out)
+            memcpy(out + n, b + j, (nb - j) * sizeof(uint16_t));
+        n += nb - j;
+    }
+    return n;
+}
+
+/* Copy to out (NULL: only count) the values of the array that are in the bitmap
+if `keep`, or that are not in it otherwise. Return their number. */
+static uint32_t set_array_filter(const uint16_t* array, uint32_t len, const uint64_t* bitmap,
+                                 bool keep, uint16_t* out) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        bool in = bitmap[array[i] >> 6] >> (array[i] & 63) & 1;
+        if (out)
+            out[n] = array[i];
+        n += (in == keep);
+    }
+    return n;
+}
+
+static void set_container_union(const set_container_t* a, const set_container_t* b, set_container_t* out) {
+    if (a->type == SET_BITMAP && b->type == SET_BITMAP) {
+        set_bitmaps_combine(a->bitmap, b->bitmap, SET_OR, out);
+        return;
+    }
+    if (a->type == SET_ARRAY && b->type == SET_ARRAY && a->card + b->card <= SET_ARRAY_MAX) {
+        out->type = SET_ARRAY;
+        out->array = malloc((a->card + b->card) * sizeof(uint16_t));
+        assert(out->array);
+        out->card = out->cap = set_arrays_merge(a->array, a->card, b->array, b->card, SET_OR, out->array);
+        return;
+    }
+    // The result is likely dense: set the bits of the arrays in a bitmap
+    if (a->type == SET_ARRAY)
+        set_container_copy(out, b);
+    else
+        set_container_copy(out, a);
+    if (out->type == SET_ARRAY)
+        set_array_to_bitmap(out);
+    for (int side = 0; side < 2; side++) {
+        const set_container_t* c = (side) ? b : a;
+        if (c->type == SET_BITMAP)
+            continue;
+        for (uint32_t i = 0; i < c->card; i++) {
+            uint64_t* word = &out->bitmap[c->array[i] >> 6], bit = 1ULL << (c->array[i] & 63);
+            out->card += !(*word & bit);
+            *word |= bit;
+        }
+    }
+    if (out->card <= SET_ARRAY_MAX)
+        set_bitmap_to_array(out);
+}
+
+static void set_container_intersection(const set_container_t* a, const set_container_t* b,
+                                       set_container_t* out) {
+    if (a->type == SET_BITMAP && b->type == SET_BITMAP) {
+        set_bitmaps_combine(a->bitmap, b->bitmap, SET_AND, out);
+        return;
+    }
+    if (a->type == SET_BITMAP) {  // The array goes first
+        const set_container_t* tmp = a;
+        a = b;
+        b = tmp;
+    }
+    out->type = SET_ARRAY;
+    out->array = malloc((a->card ? a->card : 1) * sizeof(uint16_t));
+    assert(out->array);
+    if (b->type == SET_BITMAP)
+        out->card = set_array_filter(a->array, a->card, b->bitmap, true, out->array);
+    else if (a->card <= b->card)
+        out->card = set_arrays_merge(a->array, a->card, b->array, b->card, SET_AND, out->array);
+    else
+        out->card = set_arrays_merge(b->array, b->card, a->array, a->card, SET_AND, out->array);
+    out->cap = a->card;
+}
+
+static void set_container_difference(const set_container_t* a, const set_container_t* b,
+                                     set_container_t* out) {
+    if (a->type == SET_BITMAP && b->type == SET_BITMAP) {
+        set_bitmaps_combine(a->bitmap, b->bitmap, SET_ANDNOT, out);
+        return;
+    }
+    if (a->type == SET_BITMAP) {  // Clear the bits of the array
+        set_container_copy(out, a);
+        for (uint32_t i = 0; i < b->card; i++) {
+            uint64_t* word = &out->bitmap[b->array[i] >> 6], bit = 1ULL << (b->array[i] & 63);
+            out->card -= !!(*word & bit);
+            *word &= ~bit;
+        }
+        if (out->card <= SET_ARRAY_MAX)
+            set_bitmap_to_array(out);
+        return;
+    }
+    out->type = SET_ARRAY;
+    out->array = malloc((a->card ? a->card : 1) * sizeof(uint16_t));
+    assert(out->array);
+    if (b->type == SET_BITMAP)
+        out->card = set_array_filter(a->array, a->card, b->bitmap, false, out->array);
+    else
+        out->card = set_arrays_merge(a->array, a->card, b->array, b->card, SET_ANDNOT, out->array);
+    out->cap = a->card;
+}
+
+static uint32_t set_container_intersection_card(const set_container_t* a, const set_container_t* b) {
+    if (a->type == SET_BITMAP && b->type == SET_BITMAP)
+        return set_bitmap_op(NULL, a->bitmap, b->bitmap, SET_AND);
+    if (a->type == SET_BITMAP) {
+        const set_container_t* tmp = a;
+        a = b;
+        b = tmp;
+    }
+    if (b->type == SET_BITMAP)
+        return set_array_filter(a->array, a->card, b->bitmap, true, NULL);
+    if (a->card <= b->card)
+        return set_arrays_merge(a->array, a->card, b->array, b->card, SET_AND, NULL);
+    return set_arrays_merge(b->array, b->card, a->array, a->card, SET_AND, NULL);
+}
+
+
+/**
+Containers of a set: two parallel arrays sorted by key, so a lookup binary-searches
+the dense array of keys and touches a single container.
+*/
+
+/* Return the position of the first key >= key. */
+static size_t set_lower_bound(const set_t* set, uint16_t key) {
+    size_t lo = 0, hi = set->n_containers;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (set->keys[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Insert an empty array container at the position and return it. */
+static set_container_t* set_insert_container(set_t* set, size_t pos, uint16_t key) {
+    if (set->n_containers == set->cap) {
+        set->cap = (set->cap) ? 2 * set->cap : 4;
+        set->keys = realloc(set->keys, set->cap * sizeof(uint16_t));
+        set->containers = realloc(set->containers, set->cap * sizeof(set_container_t));
+        assert(set->keys && set->containers);
+    }
+    memmove(set->keys + pos + 1, set->keys + pos, (set->n_containers - pos) * sizeof(uint16_t));
+    memmove(set->containers + pos + 1, set->containers + pos,
+            (set->n_containers - pos) * sizeof(set_container_t));
+    set->n_containers++;
+    set->keys[pos] = key;
+    set->containers[pos] = (set_container_t) {.type = SET_ARRAY, .card = 0, .cap = 0, .array = NULL};
+    return &set->containers[pos];
+}
+
+static void set_erase_container(set_t* set, size_t pos) {
+    set_container_free(&set->containers[pos]);
+    memmove(set->keys + pos, set->keys + pos + 1, (set->n_containers - pos - 1) * sizeof(uint16_t));
+    memmove(set->containers + pos, set->containers + pos + 1,
+            (set->n_containers - pos - 1) * sizeof(set_container_t));
+    set->n_containers--;
+}
+
+/* Add a container after the last one and take ownership of it; an empty one is
+freed instead. */
+static void set_append(set_t* set, uint16_t key, set_container_t* c) {
+    if (!c->card) {
+        set_container_free(c);
+        return;
+    }
+    set_insert_container(set, set->n_containers, key);
+    set->containers[set->n_containers - 1] = *c;
+}
+
+
+/*
+Personal implementation used on leetcode to solve the following problem:
+https://leetcode.com/problems/contains-duplicate/description/
+
+#define EMPTY 0
+#define OCCUPIED 1
+#define MAX 1000000000
+
+typedef struct {
+    int state, key;
+} dict_t;
+
+int hash(int key, int probe, int tab_size) {
+    int h1 = key % tab_size;
+    int h2 = 1 + 2*(key % tab_size/2);
+    return (h1 + h2*probe) % tab_size;
+}
+
+bool insert(dict_t* tab, int key, int tab_size) { // insert and search at the same time
+    if (key < 0)
+        key = -key + MAX;
+    int slot, probe = 0;
+    do {
+        slot = hash(key, probe, tab_size);
+        if (tab[slot].state == EMPTY) {
+            tab[slot].state = OCCUPIED;
+            tab[slot].key = key;
+            return false;
+        } else if (tab[slot].key == key) {
+            return true;
+        } else
+            probe++;
+    } while (probe < tab_size);
+    return false;
+}
+
+bool containsDuplicate(int* nums, int numsSize){
+    int dict_size = 2*numsSize;
+    dict_t* dct = calloc(dict_size, sizeof(dict_t));
+    for (int i = 0; i < numsSize; i++) {
+        if (insert(dct, nums[i], dict_size))
+            return true;
+    }
+    return false;
+}
+*/
@@ -0,0 +1,87 @@
+#ifndef SETS_H
+#define SETS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SET_ARRAY_MAX 4096  // Values of an array container; 2 bytes each, like a bitmap beyond this
+#define SET_BITMAP_WORDS 1024  // 65536 bits: 8 KB
+#define SET_BITMAP_ALIGN 64
+
+typedef enum {
+    SET_ARRAY, SET_BITMAP
+} SET_CONTAINER;
+
+typedef enum {
+    SET_OR, SET_AND, SET_ANDNOT
+} SET_OP;
+
+/* The low 16 bits of the values of the set that share their high 16 bits. A
+sparse container is a sorted array; a dense one is a bitmap with one bit per
+possible value. An array becomes a bitmap when it would exceed SET_ARRAY_MAX
+values, and a bitmap becomes an array again when it falls below half of that:
+the gap keeps a container near the threshold from switching at every update. */
+typedef struct set_container {
+    SET_CONTAINER type;
+    uint32_t card;  // Number of values
+    uint32_t cap;   // Slots of the array
+    union {
+        uint16_t* array;
+        uint64_t* bitmap;
+    };
+} set_container_t;
+
+/* Set of 32-bit unsigned integers, split by their high 16 bits into containers
+(a Roaring bitmap). `keys[i]` is the high part of the values of `containers[i]`;
+the keys increase and no container is empty. */
+typedef struct set {
+    uint16_t* keys;
+    set_container_t* containers;
+    size_t n_containers;
+    size_t cap;
+} set_t;
+
+set_t* set_create(void);
+void set_destroy(set_t* set);
+bool set_insert(set_t* set, uint32_t value);
+bool set_remove(set_t* set, uint32_t value);
+bool set_contains(const set_t* set, uint32_t value);
+uint64_t set_cardinality(const set_t* set);
+size_t set_to_array(const set_t* set, uint32_t* out);
+size_t set_memory(const set_t* set);
+set_t* set_union(const set_t* a, const set_t* b);
+set_t* set_intersection(const set_t* a, const set_t* b);
+set_t* set_difference(const set_t* a, const set_t* b);
+uint64_t set_intersection_cardinality(const set_t* a, const set_t* b);
+
+/* Containers. */
+static uint32_t set_array_rank(const uint16_t* array, uint32_t len, uint16_t value);
+static uint64_t* set_bitmap_alloc(void);
+static void set_array_to_bitmap(set_container_t* c);
+static void set_bitmap_to_array(set_container_t* c);
+static bool set_container_contains(const set_container_t* c, uint16_t low);
+static bool set_container_insert(set_container_t* c, uint16_t low);
+static bool set_container_remove(set_container_t* c, uint16_t low);
+static void set_container_copy(set_container_t* dst, const set_container_t* src);
+static void set_container_free(set_container_t* c);
+
+/* Set operations on containers. */
+static uint32_t set_bitmap_op(uint64_t* dst, const uint64_t* a, const uint64_t* b, SET_OP op);
+static void set_bitmaps_combine(const uint64_t* a, const uint64_t* b, SET_OP op, set_container_t* out);
+static uint32_t set_arrays_merge(const uint16_t* a, uint32_t na, const uint16_t* b, uint32_t nb,
+                                 SET_OP op, uint16_t* out);
+static uint32_t set_array_filter(const uint16_t* array, uint32_t len, const uint64_t* bitmap,
+                                 bool keep, uint16_t* out);
+static void set_container_union(const set_container_t* a, const set_container_t* b, set_container_t* out);
+static void set_container_intersection(const set_container_t* a, const set_container_t* b, set_container_t* out);
+static void set_container_difference(const set_container_t* a, const set_container_t* b, set_container_t* out);
+static uint32_t set_container_intersection_card(const set_container_t* a, const set_container_t* b);
+
+/* Containers of a set. */
+static size_t set_lower_bound(const set_t* set, uint16_t key);
+static set_container_t* set_insert_container(set_t* set, size_t pos, uint16_t key);
+static void set_erase_container(set_t* set, size_t pos);
+static void set_append(set_t* set, uint16_t key, set_container_t* c);
+
+#endif
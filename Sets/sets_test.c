@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "sets.h"
+
+#define RANGE (6 << 16)  // Six containers
+#define RANDOM_OPS 2000000
+#define BENCH_VALUES 20000000
+#define BENCH_ROUNDS 20
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Return true if the set holds exactly the values v < RANGE with ref[v], in
+increasing order, and its cardinality is right. */
+bool check_set(const set_t* set, const bool* ref) {
+    uint64_t card = set_cardinality(set);
+    uint32_t* values = malloc((card ? card : 1) * sizeof(uint32_t));
+    size_t n = set_to_array(set, values), j = 0;
+    bool ok = n == card;
+    for (uint32_t v = 0; v < RANGE && ok; v++) {
+        if (ref[v] != set_contains(set, v) || (ref[v] && (j == n || values[j++] != v)))
+            ok = false;
+    }
+    free(values);
+    return ok && j == n;
+}
+
+/* Fill the set and the reference with a different density in every container:
+from a few values to nearly all of them, around the array/bitmap threshold. */
+void random_set(set_t* set, bool* ref, unsigned int seed) {
+    static const double density[] = {0.0005, 0.03, 0.06, 0.07, 0.5, 0.99};
+    srand(seed);
+    memset(ref, 0, RANGE * sizeof(bool));
+    for (uint32_t v = 0; v < RANGE; v++) {
+        if (rand() < density[(v >> 16 ^ seed) % 6] * RAND_MAX) {
+            ref[v] = true;
+            set_insert(set, v);
+        }
+    }
+}
+
+void print_containers(const set_t* set) {
+    printf("Containers:");
+    for (size_t i = 0; i < set->n_containers; i++)
+        printf(" %u:%s(%u)", set->keys[i], (set->containers[i].type == SET_ARRAY) ? "array" : "bitmap",
+               set->containers[i].card);
+    puts("");
+}
+
+int main() {
+    test_function("set_insert, set_remove and set_contains");
+    set_t* set = set_create();
+    uint32_t values[] = {7, 3, 65536 + 5, 3, UINT32_MAX, 1u << 31, 65535};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+        printf("Insert %u: %s\n", values[i], set_insert(set, values[i]) ? "true" : "false");
+    printf("Cardinality: %llu\n", (unsigned long long) set_cardinality(set));
+    printf("Contains 65541: %s, contains 65540: %s\n", set_contains(set, 65541) ? "true" : "false",
+           set_contains(set, 65540) ? "true" : "false");
+    printf("Remove 65541: %s, ", set_remove(set, 65541) ? "true" : "false");
+    printf("remove 65541 again: %s\n", set_remove(set, 65541) ? "true" : "false");
+    print_containers(set);
+    set_destroy(set);
+
+    set = set_create();
+    for (uint32_t v = 0; v < 3 * SET_ARRAY_MAX; v += 2)
+        set_insert(set, v);
+    printf("%d even values: ", 3 * SET_ARRAY_MAX / 2);
+    print_containers(set);
+    for (uint32_t v = 0; v < 3 * SET_ARRAY_MAX; v += 4)
+        set_remove(set, v);
+    printf("After removing half of them: ");
+    print_containers(set);
+    for (uint32_t v = 2; v < 3 * SET_ARRAY_MAX; v += 8)
+        set_remove(set, v);
+    printf("After removing half of the rest: ");
+    print_containers(set);
+    set_destroy(set);
+    puts("");
+
+    test_function("Random operations");
+    // The share of insertions sets the density of each container, around the threshold for some
+    static const double insert_share[] = {0.01, 0.05, 0.0625, 0.08, 0.5, 0.9};
+    bool* ref = calloc(RANGE, sizeof(bool));
+    set = set_create();
+    srand(1);
+    for (int i = 0; i < RANDOM_OPS; i++) {
+        uint32_t v = rand() % RANGE;
+        if (rand() < insert_share[v >> 16] * RAND_MAX) {
+            ref[v] = true;
+            set_insert(set, v);
+        } else {
+            ref[v] = false;
+            set_remove(set, v);
+        }
+    }
+    printf("%d operations on %d values: %s\n", RANDOM_OPS, RANGE, check_set(set, ref) ? "true" : "false");
+    print_containers(set);
+    set_destroy(set);
+    puts("");
+
+    test_function("set_union, set_intersection and set_difference");
+    bool* ref_a = malloc(RANGE * sizeof(bool));
+    bool* ref_b = malloc(RANGE * sizeof(bool));
+    for (unsigned int seed = 0; seed < 6; seed++) {
+        set_t* a = set_create();
+        set_t* b = set_create();
+        random_set(a, ref_a, seed);
+        random_set(b, ref_b, seed + 1);
+        uint64_t card = 0;
+        set_t* results[] = {set_union(a, b), set_intersection(a, b), set_difference(a, b)};
+        bool ok[3];
+        for (int op = 0; op < 3; op++) {
+            for (uint32_t v = 0; v < RANGE; v++) {
+                ref[v] = (op == 0) ? ref_a[v] || ref_b[v] : (op == 1) ? ref_a[v] && ref_b[v] : ref_a[v] && !ref_b[v];
+                card += (op == 1 && ref[v]);
+            }
+            ok[op] = check_set(results[op], ref);
+            set_destroy(results[op]);
+        }
+        printf("Densities shifted by %u: union %s, intersection %s, difference %s, "
+               "set_intersection_cardinality %s\n", seed, ok[0] ? "true" : "false", ok[1] ? "true" : "false",
+               ok[2] ? "true" : "false", (set_intersection_cardinality(a, b) == card) ? "true" : "false");
+        set_destroy(a);
+        set_destroy(b);
+    }
+    free(ref_a);
+    free(ref_b);
+    free(ref);
+    puts("");
+
+    test_function("Memory and throughput");
+    set_t* a = set_create();
+    set_t* b = set_create();
+    uint32_t* sorted_a = malloc(BENCH_VALUES * sizeof(uint32_t));
+    uint32_t* sorted_b = malloc(BENCH_VALUES * sizeof(uint32_t));
+    srand(2);
+    // Dense IDs: every value of a range with probability 1/2
+    uint32_t na = 0, nb = 0;
+    for (uint32_t v = 0; na < BENCH_VALUES || nb < BENCH_VALUES; v++) {
+        if (na < BENCH_VALUES && rand() % 2)
+            set_insert(a, sorted_a[na++] = v);
+        if (nb < BENCH_VALUES && rand() % 2)
+            set_insert(b, sorted_b[nb++] = v);
+    }
+    printf("%d values: %.2f bytes per value (sorted array: 4, hash set: 8 or more)\n",
+           BENCH_VALUES, (double) set_memory(a) / BENCH_VALUES);
+
+    double start = seconds();
+    uint64_t card = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+        card += set_intersection_cardinality(a, b);
+    double set_time = (seconds() - start) / BENCH_ROUNDS;
+    start = seconds();
+    uint64_t merge_card = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (uint32_t i = 0, j = 0; i < na && j < nb;) {
+            if (sorted_a[i] < sorted_b[j])
+                i++;
+            else if (sorted_b[j] < sorted_a[i])
+                j++;
+            else {
+                merge_card++;
+                i++;
+                j++;
+            }
+        }
+    }
+    double merge_time = (seconds() - start) / BENCH_ROUNDS;
+    printf("Intersection cardinality: %.2f ms, merge of sorted arrays: %.2f ms (%.1fx), same result: %s\n",
+           set_time * 1e3, merge_time * 1e3, merge_time / set_time, (card == merge_card) ? "true" : "false");
+
+    start = seconds();
+    set_t* u = set_union(a, b);
+    set_t* x = set_intersection(a, b);
+    set_t* d = set_difference(a, b);
+    printf("set_union, set_intersection and set_difference: %.2f ms, |a| + |b| = |a | b| + |a & b|: %s, "
+           "|a - b| = |a| - |a & b|: %s\n", (seconds() - start) * 1e3,
+           (set_cardinality(u) + set_cardinality(x) == 2ull * BENCH_VALUES) ? "true" : "false",
+           (set_cardinality(d) == BENCH_VALUES - set_cardinality(x)) ? "true" : "false");
+    set_destroy(u);
+    set_destroy(x);
+    set_destroy(d);
+
+    start = seconds();
+    size_t hits = 0;
+    srand(3);
+    for (int i = 0; i < BENCH_VALUES; i++)
+        hits += set_contains(a, (uint32_t) rand() % (2 * BENCH_VALUES));
+    printf("%d random set_contains: %.2f s, hits: %zu\n", BENCH_VALUES, seconds() - start, hits);
+    set_destroy(a);
+    set_destroy(b);
+    free(sorted_a);
+    free(sorted_b);
+    return 0;
+}
@@ -0,0 +1,421 @@
+/*
+* This is a lock-free skip list (Herlihy, Lev, Luchangco and Shavit, after the
+* lock-free linked list of Harris and the skip list of Fraser). A balanced tree
+* has to rotate nodes to stay balanced, which no single compare-and-swap can
+* do; a skip list keeps its balance by chance, and every update only changes
+* the links in front of one node, one level at a time.
+*
+* A key is in the set when its node is linked at the bottom level and not
+* marked there. An insertion links the new node at the bottom with one CAS,
+* which makes the key visible, and then links the upper levels one by one. A
+* deletion marks the node at every level from the top down: the CAS that marks
+* the bottom level decides which of the competing deletions wins. Marked nodes
+* are then unlinked by any thread that walks past them with skiplist_find.
+* Lookups and range scans only read: they step over the marked nodes.
+*
+* Unlinked nodes are retired through an epoch domain (see Epoch/) owned by the
+* list. A deletion can finish while the insertion of the same node is still
+* linking its upper levels, and the insertion may then link the node again at
+* some level; it notices the mark at the end and unlinks the node once more.
+* So a node is unlinked for good only when both the insertion and the deletion
+* are over: the one that finishes second retires it (see `finished`). Retiring
+* it earlier would let a reader find it at an upper level after the epoch has
+* moved on.
+*
+* The towers live in per-thread arenas: a node and its successor pointers are
+* one object, carved from 64 KiB chunks, and reclaimed towers are reused for
+* new towers of the same height instead of going back to malloc.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <limits.h>
+#include "skiplist.h"
+
+#define SL_MARKED(link) ((link) & 1)
+#define SL_NODE(link) ((skiplist_node_t*) ((link) & ~(uintptr_t) 1))
+#define SL_NODE_SIZE(height) (sizeof(skiplist_node_t) + (height) * sizeof(uintptr_t))
+#define SL_CHUNK_HEADER_SIZE \
+    ((sizeof(skiplist_chunk_t) + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1))
+
+/* Allocate an empty list whose towers have at most max_level levels. A tower
+grows by one level with probability p. Return NULL on invalid arguments. */
+skiplist_t* skiplist_create(int max_level, double p) {
+    if (max_level < 1 || max_level > SKIPLIST_MAX_LEVEL || p <= 0 || p >= 1) {
+        puts("Invalid skip list parameters.");
+        return NULL;
+    }
+
+    skiplist_t* list = aligned_alloc(CACHE_LINE, sizeof(skiplist_t));
+    assert(list);
+    list->max_level = max_level;
+    list->threshold = (uint32_t) (p * 4294967296.0);
+    list->domain = epoch_create();
+
+    list->head = malloc(SL_NODE_SIZE(max_level));
+    assert(list->head);
+    list->head->key = INT_MIN;
+    list->head->height = max_level;
+    list->head->owner = NULL;
+    for (int i = 0; i < max_level; i++)
+        atomic_init(&list->head->next[i], 0);
+
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+        skiplist_thread_t* thread = &list->threads[i];
+        atomic_init(&thread->in_use, false);
+        thread->list = list;
+        thread->record = NULL;
+        thread->rng = 0x9E3779B97F4A7C15u * (i + 1);
+        for (int j = 0; j < SKIPLIST_MAX_LEVEL; j++) {
+            thread->free[j] = NULL;
+            atomic_init(&thread->remote_free[j], NULL);
+        }
+        thread->bump = NULL;
+        thread->bump_left = 0;
+        thread->chunks = NULL;
+    }
+    return list;
+}
+
+/* Free the list and all its towers. No thread may be using it. The retired
+towers go back to their arenas first, then the arenas are freed. */
+void skiplist_destroy(skiplist_t* list) {
+    if (!list)
+        return;
+    epoch_destroy(list->domain);
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+        skiplist_chunk_t* chunk = list->threads[i].chunks;
+        while (chunk) {
+            skiplist_chunk_t* next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+    }
+    free(list->head);
+    free(list);
+}
+
+/* Claim the state of a thread. Every thread that uses the list calls it once
+and passes the result to the operations. Exit the program if all are taken. */
+skiplist_thread_t* skiplist_register(skiplist_t* list) {
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&list->threads[i].in_use, &expected, true)) {
+            list->threads[i].record = epoch_register(list->domain);
+            return &list->threads[i];
+        }
+    }
+    puts("Too many threads registered with the skip list.");
+    exit(EXIT_FAILURE);
+}
+
+/* Give the state back. Its arena keeps the towers: they are still in the list,
+and the next thread that registers carves its towers from the same arena. */
+void skiplist_unregister(skiplist_thread_t* thread) {
+    epoch_unregister(thread->record);
+    thread->record = NULL;
+    atomic_store(&thread->in_use, false);
+}
+
+/* Xorshift64* generator, private to the thread. */
+static uint64_t skiplist_rand(skiplist_thread_t* thread) {
+    thread->rng ^= thread->rng >> 12;
+    thread->rng ^= thread->rng << 25;
+    thread->rng ^= thread->rng >> 27;
+    return thread->rng * 0x2545F4914F6CDD1Du;
+}
+
+static int skiplist_random_height(skiplist_thread_t* thread) {
+    int height = 1;
+    while (height < thread->list->max_level && (uint32_t) (skiplist_rand(thread) >> 32) < thread->list->threshold)
+        height++;
+    return height;
+}
+
+/* Take a tower of the given height from the arena of the thread. */
+static skiplist_node_t* skiplist_alloc(skiplist_thread_t* thread, int height) {
+    skiplist_free_t** free_list = &thread->free[height - 1];
+    skiplist_node_t* node;
+
+    if (!*free_list)
+        *free_list = atomic_exchange(&thread->remote_free[height - 1], NULL);
+    if (*free_list) {
+        node = (skiplist_node_t*) *free_list;
+        *free_list = (*free_list)->next;
+    } else {
+        size_t size = SL_NODE_SIZE(height);
+        if (thread->bump_left < size) {
+            skiplist_chunk_t* chunk = malloc(SKIPLIST_CHUNK_SIZE);
+            assert(chunk);
+            chunk->next = thread->chunks;
+            thread->chunks = chunk;
+            thread->bump = (char*) chunk + SL_CHUNK_HEADER_SIZE;
+            thread->bump_left = SKIPLIST_CHUNK_SIZE - SL_CHUNK_HEADER_SIZE;
+        }
+        node = (skiplist_node_t*) thread->bump;
+        thread->bump += size;
+        thread->bump_left -= size;
+    }
+    node->height = height;
+    atomic_store_explicit(&node->finished, 0, memory_order_relaxed);
+    node->owner = thread;
+    return node;
+}
+
+/* Give back a tower that was never linked. */
+static void skiplist_release(skiplist_thread_t* thread, skiplist_node_t* node) {
+    skiplist_free_t* tower = (skiplist_free_t*) node;
+    int height = node->height;
+    tower->next = thread->free[height - 1];
+    thread->free[height - 1] = tower;
+}
+
+/* Called by the epoch domain, from any thread, once no reader can see the
+node. The tower goes back to the arena it was carved from. */
+static void skiplist_reclaim(void* ptr) {
+    skiplist_node_t* node = ptr;
+    skiplist_thread_t* owner = node->owner;
+    _Atomic(skiplist_free_t*)* remote = &owner->remote_free[node->height - 1];
+    skiplist_free_t* tower = ptr;
+
+    tower->next = atomic_load(remote);
+    while (!atomic_compare_exchange_weak(remote, &tower->next, tower))
+        ;
+}
+
+/* Subroutine of skiplist_find. Return -1 if a CAS failed and the search must
+start over, otherwise return whether the key was found. */
+static int skiplist_find_once(skiplist_t* list, int key, skiplist_node_t** preds, skiplist_node_t** succs) {
+    skiplist_node_t *pred = list->head, *curr = NULL;
+
+    for (int level = list->max_level - 1; level >= 0; level--) {
+        curr = SL_NODE(atomic_load(&pred->next[level]));
+        while (curr) {
+            uintptr_t succ = atomic_load(&curr->next[level]);
+            if (SL_MARKED(succ)) {  // curr is being deleted: unlink it at this level
+                uintptr_t expected = (uintptr_t) curr;
+                if (!atomic_compare_exchange_strong(&pred->next[level], &expected, succ & ~(uintptr_t) 1))
+                    return -1;
+                curr = SL_NODE(succ);
+            } else if (curr->key < key) {
+                pred = curr;
+                curr = SL_NODE(succ);
+            } else {
+                break;
+            }
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+    return curr && curr->key == key;
+}
+
+/* Store in preds[i] the last node before the key at level i and in succs[i]
+the node after it, unlinking on the way the marked nodes. Return true if the
+key is in the list; its node is then succs[0]. Call it inside an epoch
+critical section. */
+static bool skiplist_find(skiplist_t* list, int key, skiplist_node_t** preds, skiplist_node_t** succs) {
+    int found;
+    while ((found = skiplist_find_once(list, key, preds, succs)) < 0)
+        ;
+    return found;
+}
+
+/* Return the first unmarked node at the bottom level with a key >= key, or
+NULL. Only reads: the marked nodes are stepped over, not unlinked. */
+static skiplist_node_t* skiplist_seek(skiplist_t* list, int key) {
+    skiplist_node_t *pred = list->head, *curr = NULL;
+
+    for (int level = list->max_level - 1; level >= 0; level--) {
+        curr = SL_NODE(atomic_load(&pred->next[level]));
+        while (curr) {
+            uintptr_t succ = atomic_load(&curr->next[level]);
+            if (!SL_MARKED(succ)) {
+                if (curr->key >= key)
+                    break;
+                pred = curr;
+            }
+            curr = SL_NODE(succ);
+        }
+    }
+    return curr;
+}
+
+/* Return the first unmarked node after the node at the bottom level, or NULL. */
+static skiplist_node_t* skiplist_successor(skiplist_node_t* node) {
+    skiplist_node_t* curr = SL_NODE(atomic_load(&node->next[0]));
+    while (curr) {
+        uintptr_t succ = atomic_load(&curr->next[0]);
+        if (!SL_MARKED(succ))
+            break;
+        curr = SL_NODE(succ);
+    }
+    return curr;
+}
+
+/* Add the key to the set. Return false if it was already there. */
+bool skiplist_insert(skiplist_thread_t* thread, int key) {
+    skiplist_t* list = thread->list;
+    skiplist_node_t *preds[SKIPLIST_MAX_LEVEL], *succs[SKIPLIST_MAX_LEVEL];
+    skiplist_node_t* node = NULL;
+    int height = skiplist_random_height(thread);
+
+    epoch_enter(thread->record);
+    for (;;) {
+        if (skiplist_find(list, key, preds, succs)) {
+            if (node)
+                skiplist_release(thread, node);
+            epoch_exit(thread->record);
+            return false;
+        }
+        if (!node) {
+            node = skiplist_alloc(thread, height);
+            node->key = key;
+        }
+        for (int level = 0; level < height; level++)
+            atomic_store_explicit(&node->next[level], (uintptr_t) succs[level], memory_order_relaxed);
+        uintptr_t expected = (uintptr_t) succs[0];
+        if (atomic_compare_exchange_strong(&preds[0]->next[0], &expected, (uintptr_t) node))
+            break;  // The key is in the set from here on
+    }
+
+    // Link the upper levels. Stop as soon as a deleter marks the node.
+    bool deleted = false;
+    for (int level = 1; level < height && !deleted; level++) {
+        for (;;) {
+            uintptr_t next = atomic_load(&node->next[level]);
+            if (SL_MARKED(next)) {
+                deleted = true;
+                break;
+            }
+            if (SL_NODE(next) != succs[level] &&
+                !atomic_compare_exchange_strong(&node->next[level], &next, (uintptr_t) succs[level]))
+                continue;
+            uintptr_t expected = (uintptr_t) succs[level];
+            if (atomic_compare_exchange_strong(&preds[level]->next[level], &expected, (uintptr_t) node))
+                break;
+            skiplist_find(list, key, preds, succs);
+            if (succs[0] != node) {  // Unlinked at the bottom: deleted
+                deleted = true;
+                break;
+            }
+        }
+    }
+
+    // A deleter that finished while the upper levels were being linked may have
+    // missed some of them: unlink the node again.
+    if (SL_MARKED(atomic_load(&node->next[0])))
+        skiplist_find(list, key, preds, succs);
+    epoch_exit(thread->record);
+    if (atomic_fetch_add(&node->finished, 1) == 1)  // The deletion is over too
+        epoch_retire(thread->record, node, skiplist_reclaim);
+    return true;
+}
+
+/* Remove the key from the set. Return false if it was not there. */
+bool skiplist_delete(skiplist_thread_t* thread, int key) {
+    skiplist_t* list = thread->list;
+    skiplist_node_t *preds[SKIPLIST_MAX_LEVEL], *succs[SKIPLIST_MAX_LEVEL];
+
+    epoch_enter(thread->record);
+    if (!skiplist_find(list, key, preds, succs)) {
+        epoch_exit(thread->record);
+        return false;
+    }
+
+    skiplist_node_t* node = succs[0];
+    for (int level = node->height - 1; level > 0; level--) {
+        uintptr_t next = atomic_load(&node->next[level]);
+        while (!SL_MARKED(next) && !atomic_compare_exchange_weak(&node->next[level], &next, next | 1))
+            ;
+    }
+    uintptr_t next = atomic_load(&node->next[0]);
+    for (;;) {
+        if (SL_MARKED(next)) {  // Another thread deleted it first
+            epoch_exit(thread->record);
+            return false;
+        }
+        if (atomic_compare_exchange_strong(&node->next[0], &next, next | 1))
+            break;
+    }
+
+    skiplist_find(list, key, preds, succs);  // Unlink the node at every level
+    epoch_exit(thread->record);
+    if (atomic_fetch_add(&node->finished, 1) == 1)  // The insertion is over too
+        epoch_retire(thread->record, node, skiplist_reclaim);
+    return true;
+}
+
+/* Return true if the key is in the set. */
+bool skiplist_is_key_in(skiplist_thread_t* thread, int key) {
+    epoch_enter(thread->record);
+    skiplist_node_t* node = skiplist_seek(thread->list, key);
+    bool found = node && node->key == key;
+    epoch_exit(thread->record);
+    return found;
+}
+
+
+/**
+Traversal and range iteration. An iterator walks the bottom level in increasing
+order while the other threads keep updating the list: every key that is in the
+set for the whole scan is returned exactly once and in order, the keys inserted
+or deleted during the scan may or may not be. End every scan with
+skiplist_iter_end: until then the thread holds back the reclamation of nodes.
+*/
+
+/* Place the iterator on the first key >= key. */
+void skiplist_iter_lower_bound(skiplist_iter_t* it, skiplist_thread_t* thread, int key) {
+    epoch_enter(thread->record);
+    it->thread = thread;
+    it->node = skiplist_seek(thread->list, key);
+}
+
+/* Place the iterator on the minimum key. */
+void skiplist_iter_first(skiplist_iter_t* it, skiplist_thread_t* thread) {
+    skiplist_iter_lower_bound(it, thread, INT_MIN);
+}
+
+/* Return false once the iterator has moved past the last key. */
+bool skiplist_iter_valid(skiplist_iter_t* it) {
+    return it->node != NULL;
+}
+
+/* Return the key under a valid iterator. */
+int skiplist_iter_key(skiplist_iter_t* it) {
+    return it->node->key;
+}
+
+/* Move a valid iterator to the next key. */
+void skiplist_iter_next(skiplist_iter_t* it) {
+    it->node = skiplist_successor(it->node);
+}
+
+/* Leave the critical section of the scan. The iterator cannot be used anymore. */
+void skiplist_iter_end(skiplist_iter_t* it) {
+    it->node = NULL;
+    epoch_exit(it->thread->record);
+}
+
+/* Call fn on every key in increasing order. ctx is passed to fn unchanged. */
+void skiplist_for_each(skiplist_thread_t* thread, void (*fn)(int key, void* ctx), void* ctx) {
+    skiplist_iter_t it;
+    for (skiplist_iter_first(&it, thread); skiplist_iter_valid(&it); skiplist_iter_next(&it))
+        fn(skiplist_iter_key(&it), ctx);
+    skiplist_iter_end(&it);
+}
+
+static void skiplist_print_key(int key, void* ctx) {
+    (void) ctx;
+    printf("%d ", key);
+}
+
+/* Print the keys in increasing order. */
+void skiplist_traverse(skiplist_thread_t* thread) {
+    if (!SL_NODE(atomic_load(&thread->list->head->next[0])))
+        puts("The list is empty.");
+    else
+        skiplist_for_each(thread, skiplist_print_key, NULL);
+}
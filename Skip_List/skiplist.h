@@ -0,0 +1,97 @@
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "../Epoch/epoch.h"
+
+#define SKIPLIST_MAX_LEVEL 32
+#define SKIPLIST_CHUNK_SIZE (64 * 1024)  // Arena chunks the towers are carved from
+
+/* A node and its tower are a single object: next[i] is the successor at level
+i, for i < height. Bit 0 of next[i] marks the node as deleted at level i; once
+set, next[i] never changes again. The key and the height never change after
+the node is linked. */
+typedef struct skiplist_node {
+    int key;
+    int16_t height;
+    _Atomic int16_t finished;  // Insertion and winning deletion done so far; the second one retires the node
+    struct skiplist_thread* owner;  // Arena the tower was carved from
+    _Atomic uintptr_t next[];
+} skiplist_node_t;
+
+/* A released tower, linked through its first word. */
+typedef struct skiplist_free {
+    struct skiplist_free* next;
+} skiplist_free_t;
+
+typedef struct skiplist_chunk {
+    struct skiplist_chunk* next;
+} skiplist_chunk_t;
+
+/* Per-thread state: the epoch record, the random generator of the tower
+heights and the arena. The arena hands out towers from the free list of their
+height, or carves them from the current chunk. Towers reclaimed by other
+threads come back through `remote_free` and are moved to `free` in bulk. */
+typedef struct skiplist_thread {
+    _Alignas(CACHE_LINE) _Atomic bool in_use;
+    struct skiplist* list;
+    epoch_record_t* record;
+    uint64_t rng;
+    skiplist_free_t* free[SKIPLIST_MAX_LEVEL];  // free[i]: towers of height i + 1
+    _Atomic(skiplist_free_t*) remote_free[SKIPLIST_MAX_LEVEL];
+    char* bump;
+    size_t bump_left;
+    skiplist_chunk_t* chunks;
+} skiplist_thread_t;
+
+/* Lock-free ordered set of distinct keys. A tower has height h with probability
+(1 - p) p^(h - 1), capped at max_level; p is stored as `threshold` / 2^32. */
+typedef struct skiplist {
+    skiplist_node_t* head;  // Sentinel with a tower of max_level
+    int max_level;
+    uint32_t threshold;
+    epoch_domain_t* domain;
+    skiplist_thread_t threads[EPOCH_MAX_THREADS];
+} skiplist_t;
+
+/* Cursor for range scans. It keeps the thread inside an epoch critical section
+until skiplist_iter_end, so that the node under it cannot be reclaimed. */
+typedef struct skiplist_iter {
+    skiplist_thread_t* thread;
+    skiplist_node_t* node;
+} skiplist_iter_t;
+
+skiplist_t* skiplist_create(int max_level, double p);
+void skiplist_destroy(skiplist_t* list);
+skiplist_thread_t* skiplist_register(skiplist_t* list);
+void skiplist_unregister(skiplist_thread_t* thread);
+
+static uint64_t skiplist_rand(skiplist_thread_t* thread);
+static int skiplist_random_height(skiplist_thread_t* thread);
+static skiplist_node_t* skiplist_alloc(skiplist_thread_t* thread, int height);
+static void skiplist_release(skiplist_thread_t* thread, skiplist_node_t* node);
+static void skiplist_reclaim(void* ptr);
+
+static int skiplist_find_once(skiplist_t* list, int key, skiplist_node_t** preds, skiplist_node_t** succs);
+static bool skiplist_find(skiplist_t* list, int key, skiplist_node_t** preds, skiplist_node_t** succs);
+static skiplist_node_t* skiplist_seek(skiplist_t* list, int key);
+static skiplist_node_t* skiplist_successor(skiplist_node_t* node);
+bool skiplist_insert(skiplist_thread_t* thread, int key);
+bool skiplist_delete(skiplist_thread_t* thread, int key);
+bool skiplist_is_key_in(skiplist_thread_t* thread, int key);
+
+/* Traversal and range iteration. */
+void skiplist_iter_lower_bound(skiplist_iter_t* it, skiplist_thread_t* thread, int key);
+void skiplist_iter_first(skiplist_iter_t* it, skiplist_thread_t* thread);
+bool skiplist_iter_valid(skiplist_iter_t* it);
+int skiplist_iter_key(skiplist_iter_t* it);
+void skiplist_iter_next(skiplist_iter_t* it);
+void skiplist_iter_end(skiplist_iter_t* it);
+void skiplist_for_each(skiplist_thread_t* thread, void (*fn)(int key, void* ctx), void* ctx);
+static void skiplist_print_key(int key, void* ctx);
+void skiplist_traverse(skiplist_thread_t* thread);
+
+#endif
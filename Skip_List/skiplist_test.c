@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include "skiplist.h"
+#include "../Red_Black_Tree/red_black_tree.h"
+
+#define SIZE 8
+#define RANDOM_OPS 200000
+#define KEY_RANGE 5000
+#define HEIGHT_KEYS 100000
+#define THREADS 4
+#define THREAD_OPS 100000
+#define SHARED_RANGE 64
+#define BENCH_KEYS 100000
+#define BENCH_OPS 400000
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+/* Check a list no thread is updating: no marked node is left, every level is
+sorted, and every node of a level is also in the level below. Store the number
+of keys in *n. */
+bool check_skiplist(skiplist_t* list, size_t* n) {
+    *n = 0;
+    for (int level = list->max_level - 1; level >= 0; level--) {
+        skiplist_node_t* below = list->head;
+        long prev = LONG_MIN;
+        for (uintptr_t link = atomic_load(&list->head->next[level]); link;
+             link = atomic_load(&((skiplist_node_t*) link)->next[level])) {
+            skiplist_node_t* node = (skiplist_node_t*) link;
+            if ((link & 1) || node->key <= prev || node->height <= level)
+                return false;
+            prev = node->key;
+            if (level == 0) {
+                (*n)++;
+                continue;
+            }
+            while (below && below != node)  // The node must follow in the level below
+                below = (skiplist_node_t*) atomic_load(&below->next[level - 1]);
+            if (!below)
+                return false;
+        }
+    }
+    return true;
+}
+
+double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct thread_arg {
+    skiplist_t* list;
+    int id;
+    bool* in;           // The keys of the thread's own range currently in the list
+    long* net;          // Per shared key: successful insertions minus deletions
+    size_t errors, scans;
+} thread_arg_t;
+
+/* Thread `id` owns the keys k * THREADS + id + SHARED_RANGE and checks every
+answer about them. All the threads also fight over the keys 0..SHARED_RANGE - 1
+and run range scans, which must always return increasing keys. */
+void* worker(void* p) {
+    thread_arg_t* arg = p;
+    skiplist_thread_t* thread = skiplist_register(arg->list);
+    unsigned int seed = arg->id + 1;
+
+    for (int i = 0; i < THREAD_OPS; i++) {
+        int op = rand_r(&seed) % 8;
+        if (op < 4) {
+            int k = rand_r(&seed) % (KEY_RANGE / THREADS);
+            int key = k * THREADS + arg->id + SHARED_RANGE;
+            bool changed = (arg->in[k]) ? skiplist_delete(thread, key) : skiplist_insert(thread, key);
+            arg->errors += !changed || skiplist_is_key_in(thread, key) == arg->in[k];
+            arg->in[k] = !arg->in[k];
+        } else if (op < 7) {
+            int key = rand_r(&seed) % SHARED_RANGE;
+            if (op == 4)
+                arg->net[key] += skiplist_insert(thread, key);
+            else if (op == 5)
+                arg->net[key] -= skiplist_delete(thread, key);
+            else
+                skiplist_is_key_in(thread, key);
+        } else {
+            skiplist_iter_t it;
+            int prev = INT_MIN, steps = 0;
+            skiplist_iter_lower_bound(&it, thread, rand_r(&seed) % KEY_RANGE);
+            for (; skiplist_iter_valid(&it) && steps < 50; skiplist_iter_next(&it), steps++) {
+                arg->errors += skiplist_iter_key(&it) <= prev;
+                prev = skiplist_iter_key(&it);
+            }
+            skiplist_iter_end(&it);
+            arg->scans++;
+        }
+    }
+    skiplist_unregister(thread);
+    return NULL;
+}
+
+typedef struct bench_arg {
+    skiplist_t* list;
+    rbt_t* tree;  // NULL: use the skip list
+    pthread_mutex_t* lock;
+    int id, nthreads;
+} bench_arg_t;
+
+/* Half updates, half lookups. */
+void* bench_worker(void* p) {
+    bench_arg_t* arg = p;
+    skiplist_thread_t* thread = (arg->tree) ? NULL : skiplist_register(arg->list);
+    unsigned int seed = arg->id + 1;
+
+    for (int i = 0; i < BENCH_OPS / arg->nthreads; i++) {
+        int key = rand_r(&seed) % (2 * BENCH_KEYS), op = rand_r(&seed) % 4;
+        if (thread) {
+            if (op == 0)
+                skiplist_insert(thread, key);
+            else if (op == 1)
+                skiplist_delete(thread, key);
+            else
+                skiplist_is_key_in(thread, key);
+        } else {
+            pthread_mutex_lock(arg->lock);
+            bool in = rbt_is_key_in(arg->tree, key);
+            if (op == 0 && !in)
+                rbt_insert(arg->tree, key);
+            else if (op == 1 && in)
+                rbt_delete(arg->tree, key);
+            pthread_mutex_unlock(arg->lock);
+        }
+    }
+    if (thread)
+        skiplist_unregister(thread);
+    return NULL;
+}
+
+/* Return the operations per second of nthreads threads. */
+double throughput(skiplist_t* list, rbt_t* tree, pthread_mutex_t* lock, int nthreads) {
+    pthread_t threads[THREADS];
+    bench_arg_t args[THREADS];
+    double start = seconds();
+    for (int i = 0; i < nthreads; i++) {
+        args[i] = (bench_arg_t) {list, tree, lock, i, nthreads};
+        pthread_create(&threads[i], NULL, bench_worker, &args[i]);
+    }
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+    return (BENCH_OPS / nthreads) * nthreads / (seconds() - start);
+}
+
+int main() {
+    int arr[SIZE] = {11, 2, 14, 1, 7, 15, 5, 8};
+    size_t n;
+
+    test_function("skiplist_insert");
+    skiplist_t* list = skiplist_create(16, 0.5);
+    skiplist_thread_t* thread = skiplist_register(list);
+    for (int i = 0; i < SIZE; i++)
+        skiplist_insert(thread, arr[i]);
+    printf("Insert 7 again: %s\n", skiplist_insert(thread, 7) ? "inserted" : "already there");
+    printf("%s", "Keys: ");
+    skiplist_traverse(thread);
+    printf("\n14 is in the list: %s, 3 is in the list: %s\n\n",
+           skiplist_is_key_in(thread, 14) ? "true" : "false", skiplist_is_key_in(thread, 3) ? "true" : "false");
+
+    test_function("skiplist_delete");
+    skiplist_delete(thread, 11);
+    skiplist_delete(thread, 1);
+    printf("Delete 1 again: %s\n", skiplist_delete(thread, 1) ? "deleted" : "not there");
+    printf("%s", "After deleting 11 and 1: ");
+    skiplist_traverse(thread);
+    printf("\nValid: %s\n\n", (check_skiplist(list, &n) && n == SIZE - 2) ? "true" : "false");
+    skiplist_unregister(thread);
+    skiplist_destroy(list);
+
+    test_function("Random insertions and deletions");
+    bool* in = calloc(KEY_RANGE, sizeof(bool));
+    list = skiplist_create(16, 0.5);
+    thread = skiplist_register(list);
+    bool ok = true;
+    srand(1);
+    for (int i = 0; i < RANDOM_OPS && ok; i++) {
+        int key = rand() % KEY_RANGE;
+        if (rand() % 2) {
+            ok = skiplist_insert(thread, key) == !in[key];
+            in[key] = true;
+        } else {
+            ok = skiplist_delete(thread, key) == in[key];
+            in[key] = false;
+        }
+        ok = ok && skiplist_is_key_in(thread, key) == in[key];
+    }
+    size_t expected = 0;
+    skiplist_iter_t it;
+    skiplist_iter_lower_bound(&it, thread, KEY_RANGE / 2);
+    for (int key = KEY_RANGE / 2; key < KEY_RANGE && ok; key++) {
+        if (in[key]) {
+            ok = skiplist_iter_valid(&it) && skiplist_iter_key(&it) == key;
+            skiplist_iter_next(&it);
+        }
+    }
+    ok = ok && !skiplist_iter_valid(&it);
+    skiplist_iter_end(&it);
+    for (int key = 0; key < KEY_RANGE; key++)
+        expected += in[key];
+    printf("Keys: %zu\n", expected);
+    printf("Levels and range scan agree with a reference set: %s\n\n",
+           (ok && check_skiplist(list, &n) && n == expected) ? "true" : "false");
+    skiplist_unregister(thread);
+    skiplist_destroy(list);
+
+    test_function("Level distribution");
+    double probabilities[] = {0.5, 0.25};
+    for (int i = 0; i < 2; i++) {
+        list = skiplist_create(SKIPLIST_MAX_LEVEL, probabilities[i]);
+        thread = skiplist_register(list);
+        for (int key = 0; key < HEIGHT_KEYS; key++)
+            skiplist_insert(thread, key);
+        size_t links = 0;
+        int levels = 0;
+        for (int level = 0; level < list->max_level; level++) {
+            size_t count = 0;
+            for (uintptr_t link = atomic_load(&list->head->next[level]); link;
+                 link = atomic_load(&((skiplist_node_t*) link)->next[level]))
+                count++;
+            links += count;
+            levels += (count > 0);
+        }
+        printf("p = %.2f: %d keys, %d levels in use, %.2f links per key (expected %.2f)\n",
+               probabilities[i], HEIGHT_KEYS, levels, (double) links / HEIGHT_KEYS, 1 / (1 - probabilities[i]));
+        skiplist_unregister(thread);
+        skiplist_destroy(list);
+    }
+    puts("");
+
+    test_function("Concurrent insertions, deletions and scans");
+    list = skiplist_create(16, 0.5);
+    pthread_t threads[THREADS];
+    thread_arg_t args[THREADS];
+    long net[THREADS][SHARED_RANGE] = {{0}};
+    bool* owned = calloc(THREADS * (KEY_RANGE / THREADS), sizeof(bool));
+    for (int i = 0; i < THREADS; i++) {
+        args[i] = (thread_arg_t) {list, i, owned + i * (KEY_RANGE / THREADS), net[i], 0, 0};
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    size_t errors = 0, scans = 0;
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+        scans += args[i].scans;
+    }
+    thread = skiplist_register(list);
+    expected = 0;
+    for (int key = 0; key < SHARED_RANGE; key++) {
+        long total = 0;
+        for (int i = 0; i < THREADS; i++)
+            total += net[i][key];
+        errors += (total != 0 && total != 1) || total != skiplist_is_key_in(thread, key);
+        expected += total;
+    }
+    for (int i = 0; i < THREADS; i++)
+        for (int k = 0; k < KEY_RANGE / THREADS; k++)
+            expected += args[i].in[k];
+    printf("%d threads, %d operations each, %zu range scans, %zu wrong answers\n", THREADS, THREAD_OPS, scans, errors);
+    printf("Keys: %zu. The levels are valid and agree with the threads: %s\n\n", expected,
+           (check_skiplist(list, &n) && n == expected) ? "true" : "false");
+    skiplist_unregister(thread);
+    skiplist_destroy(list);
+    free(owned);
+    free(in);
+
+    test_function("Skip list against rbt_t under a mutex");
+    list = skiplist_create(20, 0.5);
+    thread = skiplist_register(list);
+    rbt_t* tree = rbt_create();
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        int key = (int) ((unsigned) i * 2654435761u % (2 * BENCH_KEYS));
+        skiplist_insert(thread, key);
+        if (!rbt_is_key_in(tree, key))
+            rbt_insert(tree, key);
+    }
+    skiplist_unregister(thread);
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    printf("%d operations (25%% inserts, 25%% deletes), millions of operations per second:\n", BENCH_OPS);
+    printf("%8s %12s %12s\n", "threads", "skip list", "rbt + mutex");
+    for (int nthreads = 1; nthreads <= THREADS; nthreads *= 2)
+        printf("%8d %12.2f %12.2f\n", nthreads, throughput(list, NULL, NULL, nthreads) / 1e6,
+               throughput(NULL, tree, &lock, nthreads) / 1e6);
+    rbt_free_tree(tree);
+    free(tree);
+    skiplist_destroy(list);
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*
+* This is a read-only search index built from a sorted array of keys, e.g. the
+* keys of a BST or a red-black tree that is not going to change anymore (see
+* `bst_freeze` and `rbt_freeze`). The keys are stored in one contiguous array in
+* one of two implicit layouts, so a lookup never chases pointers:
+*
+* - SIDX_EYTZINGER: the binary search tree is stored in BFS order, i.e. the
+*   children of slot i are the slots 2i and 2i + 1. The descent has no branch
+*   other than the loop condition. The 16 descendants four levels below the
+*   current slot are contiguous, so they are prefetched while the current level
+*   is compared.
+* - SIDX_BTREE: a 17-ary search tree whose nodes are blocks of 16 keys (one cache
+*   line) in BFS order. Each level costs one cache miss and one SIMD comparison of
+*   the key against the whole block.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "static_index.h"
+
+#define NOT_FOUND SIZE_MAX
+
+/* Subroutine of sidx_build. In-order visit of the Eytzinger tree rooted at slot i:
+the in-order position of a slot is the sorted position of its key. */
+static size_t eytzinger_fill(sidx_t* index, const int* sorted, size_t pos, size_t i) {
+    if (i > index->n)
+        return pos;
+    pos = eytzinger_fill(index, sorted, pos, 2*i);
+    index->keys[i] = sorted[pos];
+    index->ranks[i] = pos;
+    pos++;
+    return eytzinger_fill(index, sorted, pos, 2*i + 1);
+}
+
+/* Subroutine of sidx_build. In-order visit of the B-tree rooted at `block`. The
+slots left over after the last key are padded with INT_MAX and rank n. */
+static size_t btree_fill(sidx_t* index, const int* sorted, size_t pos, size_t block) {
+    if (block >= index->n_blocks)
+        return pos;
+    for (size_t i = 0; i < SIDX_BLOCK; i++) {
+        size_t slot = block * SIDX_BLOCK + i;
+        pos = btree_fill(index, sorted, pos, block * (SIDX_BLOCK + 1) + i + 1);
+        if (pos < index->n) {
+            index->keys[slot] = sorted[pos];
+            index->ranks[slot] = pos++;
+        } else {
+            index->keys[slot] = INT_MAX;
+            index->ranks[slot] = index->n;
+        }
+    }
+    return btree_fill(index, sorted, pos, block * (SIDX_BLOCK + 1) + SIDX_BLOCK + 1);
+}
+
+/* Build an index over n keys sorted in non-decreasing order. */
+sidx_t* sidx_build(const int* sorted, size_t n, SIDX_LAYOUT layout) {
+    if (n >= UINT32_MAX) {
+        puts("Too many keys for a static index.");
+        exit(EXIT_FAILURE);
+    }
+
+    sidx_t* index = malloc(sizeof(sidx_t));
+    assert(index);
+    index->layout = layout;
+    index->n = n;
+
+    if (layout == SIDX_EYTZINGER) {
+        index->n_blocks = 0;
+        index->n_slots = n + 1;  // Slot 0 is not used
+    } else {
+        index->n_blocks = (n + SIDX_BLOCK - 1) / SIDX_BLOCK;
+        index->n_slots = index->n_blocks * SIDX_BLOCK;
+    }
+
+    // Cache-line aligned, so that a block of the B-tree layout is a single line.
+    size_t bytes = (index->n_slots * sizeof(int) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    index->keys = aligned_alloc(CACHE_LINE, bytes ? bytes : CACHE_LINE);
+    index->ranks = malloc((index->n_slots + 1) * sizeof(uint32_t));
+    assert(index->keys && index->ranks);
+
+    if (layout == SIDX_EYTZINGER)
+        eytzinger_fill(index, sorted, 0, 1);
+    else
+        btree_fill(index, sorted, 0, 0);
+
+    return index;
+}
+
+void sidx_free(sidx_t* index) {
+    if (!index)
+        return;
+    free(index->keys);
+    free(index->ranks);
+    free(index);
+}
+
+/* Return the slot of the first key >= key, or NOT_FOUND. The descent records the
+turns in the bits of i; the last left turn marks the answer, so we drop the
+trailing right turns (the trailing ones of i) and that left turn. */
+static size_t eytzinger_lower_bound(sidx_t* index, int key) {
+    const int* keys = index->keys;
+    size_t i = 1;
+
+    while (i <= index->n) {
+        __builtin_prefetch((const char*) keys + 16 * i * sizeof(int));
+        i = 2*i + (keys[i] < key);
+    }
+    i >>= __builtin_ffsll(~i);
+
+    return (i == 0) ? NOT_FOUND : i;
+}
+
+/* Return the number of keys of the block that are smaller than key. The block is
+sorted, so that is also the position of the first key >= key. */
+static unsigned block_rank(const int* block, int key) {
+#if defined(__AVX2__)
+    __m256i x = _mm256_set1_epi32(key);
+    __m256i lo = _mm256_cmpgt_epi32(x, _mm256_load_si256((const __m256i*) block));
+    __m256i hi = _mm256_cmpgt_epi32(x, _mm256_load_si256((const __m256i*) (block + 8)));
+    unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(lo)) |
+                    _mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8;
+    return __builtin_popcount(mask);
+#elif defined(__SSE2__)
+    __m128i x = _mm_set1_epi32(key);
+    unsigned mask = 0;
+    for (int i = 0; i < SIDX_BLOCK; i += 4) {
+        __m128i lt = _mm_cmpgt_epi32(x, _mm_load_si128((const __m128i*) (block + i)));
+        mask |= _mm_movemask_ps(_mm_castsi128_ps(lt)) << i;
+    }
+    return __builtin_popcount(mask);
+#else
+    unsigned count = 0;
+    for (int i = 0; i < SIDX_BLOCK; i++)
+        count += (block[i] < key);
+    return count;
+#endif
+}
+
+/* Return the slot of the first key >= key, or NOT_FOUND. The answer is the
+last slot that stopped the comparison on the way down. */
+static size_t btree_lower_bound(sidx_t* index, int key) {
+    size_t found = NOT_FOUND;
+    size_t block = 0;
+
+    while (block < index->n_blocks) {
+        unsigned i = block_rank(index->keys + block * SIDX_BLOCK, key);
+        if (i < SIDX_BLOCK)
+            found = block * SIDX_BLOCK + i;
+        block = block * (SIDX_BLOCK + 1) + i + 1;
+    }
+    if (found != NOT_FOUND && index->ranks[found] == index->n)
+        found = NOT_FOUND;  // Padding
+
+    return found;
+}
+
+static size_t sidx_lower_bound_slot(sidx_t* index, int key) {
+    if (index->layout == SIDX_EYTZINGER)
+        return eytzinger_lower_bound(index, key);
+    return btree_lower_bound(index, key);
+}
+
+/* Store in the output parameter the smallest key >= key.
+Return false if every key is smaller than key. */
+bool sidx_lower_bound(sidx_t* index, int key, int* found) {
+    size_t slot = sidx_lower_bound_slot(index, key);
+    if (slot == NOT_FOUND)
+        return false;
+    *found = index->keys[slot];
+    return true;
+}
+
+/* Return the number of keys smaller than key. */
+size_t sidx_rank(sidx_t* index, int key) {
+    size_t slot = sidx_lower_bound_slot(index, key);
+    return (slot == NOT_FOUND) ? index->n : index->ranks[slot];
+}
+
+/* Return true if the key is in the index, else false. */
+bool sidx_contains(sidx_t* index, int key) {
+    size_t slot = sidx_lower_bound_slot(index, key);
+    return slot != NOT_FOUND && index->keys[slot] == key;
+}
@@ -0,0 +1,40 @@
+#ifndef STATIC_INDEX_H
+#define STATIC_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIDX_BLOCK 16  // Keys per node of the B-tree layout (one cache line)
+#define CACHE_LINE 64
+
+typedef enum {
+    SIDX_EYTZINGER,  // Binary tree in BFS order: branchless descent with prefetching
+    SIDX_BTREE       // 17-ary tree of 16-key blocks: one SIMD comparison per level
+} SIDX_LAYOUT;
+
+/* Read-only search index over a sorted set of keys, stored in one contiguous
+array without pointers. `ranks[i]` is the position of `keys[i]` in sorted order;
+slots that do not hold a key (the padding of the last block) have rank n. */
+typedef struct static_index {
+    SIDX_LAYOUT layout;
+    size_t n;         // Number of keys
+    size_t n_slots;   // Size of keys and ranks
+    size_t n_blocks;  // SIDX_BTREE only
+    int* keys;
+    uint32_t* ranks;
+} sidx_t;
+
+static size_t eytzinger_fill(sidx_t* index, const int* sorted, size_t pos, size_t i);
+static size_t btree_fill(sidx_t* index, const int* sorted, size_t pos, size_t block);
+sidx_t* sidx_build(const int* sorted, size_t n, SIDX_LAYOUT layout);
+void sidx_free(sidx_t* index);
+static size_t eytzinger_lower_bound(sidx_t* index, int key);
+static unsigned block_rank(const int* block, int key);
+static size_t btree_lower_bound(sidx_t* index, int key);
+static size_t sidx_lower_bound_slot(sidx_t* index, int key);
+bool sidx_lower_bound(sidx_t* index, int key, int* found);
+size_t sidx_rank(sidx_t* index, int key);
+bool sidx_contains(sidx_t* index, int key);
+
+#endif
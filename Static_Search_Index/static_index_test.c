@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include "static_index.h"
+#include "../BST/bst.h"
+
+#define SIZE 20
+#define BIG_SIZE 1000000
+#define LOOKUPS 4000000
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+/* Reference implementation: number of keys smaller than key. */
+size_t linear_rank(int* sorted, size_t n, int key) {
+    size_t rank = 0;
+    while (rank < n && sorted[rank] < key)
+        rank++;
+    return rank;
+}
+
+/* Compare rank, lower_bound and contains with a linear scan for every key in [lo, hi]. */
+bool check_index(sidx_t* index, int* sorted, size_t n, int lo, int hi) {
+    for (long key = lo; key <= hi; key++) {
+        size_t rank = linear_rank(sorted, n, key);
+        int found;
+        bool has_lower_bound = sidx_lower_bound(index, key, &found);
+        if (sidx_rank(index, key) != rank ||
+            has_lower_bound != (rank < n) ||
+            (has_lower_bound && found != sorted[rank]) ||
+            sidx_contains(index, key) != (rank < n && sorted[rank] == key))
+            return false;
+    }
+    return true;
+}
+
+double seconds_since(clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main() {
+    int sorted[SIZE] = {-7, -3, 0, 0, 1, 4, 4, 4, 9, 12, 15, 21, 22, 30, 31, 40, 41, 50, 60, INT_MAX};
+    char* names[] = {"SIDX_EYTZINGER", "SIDX_BTREE"};
+
+    for (int layout = SIDX_EYTZINGER; layout <= SIDX_BTREE; layout++) {
+        test_function(names[layout]);
+        sidx_t* index = sidx_build(sorted, SIZE, layout);
+        int found;
+        printf("Rank of 4: %zu, rank of 5: %zu, rank of 100: %zu\n",
+               sidx_rank(index, 4), sidx_rank(index, 5), sidx_rank(index, 100));
+        sidx_lower_bound(index, 13, &found);
+        printf("Lower bound of 13: %d\n", found);
+        printf("Key 22 is in the index: %s\n", sidx_contains(index, 22) ? "true" : "false");
+        printf("Key 23 is in the index: %s\n", sidx_contains(index, 23) ? "true" : "false");
+        printf("Every key in [-10, 70] agrees with a linear scan: %s\n",
+               check_index(index, sorted, SIZE, -10, 70) ? "true" : "false");
+        for (size_t n = 0; n < SIZE; n++) {
+            sidx_t* prefix = sidx_build(sorted, n, layout);
+            if (!check_index(prefix, sorted, n, -10, 70))
+                printf("Mismatch with the first %zu keys\n", n);
+            sidx_free(prefix);
+        }
+        sidx_free(index);
+        puts("");
+    }
+
+    test_function("bst_freeze");
+    srand(1);
+    BST_t* tree = bst_create();
+    int* probes = malloc(LOOKUPS * sizeof(int));
+    for (int i = 0; i < BIG_SIZE; i++)  // Distinct keys in pseudo-random order
+        bst_insert(tree, (int) ((unsigned) i * 2654435761u));
+    for (int i = 0; i < LOOKUPS; i++)
+        probes[i] = (int) ((unsigned) (rand() % (2 * BIG_SIZE)) * 2654435761u);
+
+    size_t hits = 0;
+    clock_t start = clock();
+    for (int i = 0; i < LOOKUPS; i++)
+        hits += bst_is_key_in(tree, probes[i]);
+    printf("Pointer tree:   %zu hits in %.3f s\n", hits, seconds_since(start));
+
+    for (int layout = SIDX_EYTZINGER; layout <= SIDX_BTREE; layout++) {
+        sidx_t* index = bst_freeze(tree, layout);
+        hits = 0;
+        start = clock();
+        for (int i = 0; i < LOOKUPS; i++)
+            hits += sidx_contains(index, probes[i]);
+        printf("%-15s %zu hits in %.3f s\n", names[layout], hits, seconds_since(start));
+        sidx_free(index);
+    }
+
+    bst_free_tree(tree);
+    free(tree);
+    free(probes);
+    return 0;
+}
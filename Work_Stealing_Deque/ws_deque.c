@@ -0,0 +1,130 @@
+/*
+* This is the work-stealing deque of Chase and Lev with the C11 memory orderings
+* of Le, Pop, Cohen and Zappa Nardelli ("Correct and Efficient Work-Stealing for
+* Weak Memory Models", PPoPP 2013). Like the stack in stack.c, the owner pushes
+* and pops at one end (the bottom). The other threads steal the oldest items
+* from the other end (the top). Push uses no read-modify-write instruction.
+* Pop needs a CAS only when it races with a thief for the last item. Steal
+* always uses a CAS on `top`.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "ws_deque.h"
+
+/* Allocate a circular array of `size` slots. */
+static ws_array_t* ws_array_create(long size) {
+    ws_array_t* array = malloc(sizeof(ws_array_t) + size * sizeof(_Atomic int));
+    assert(array);
+    array->size = size;
+    array->prev = NULL;
+    return array;
+}
+
+/* Allocate a deque able to store `capacity` items before growing. */
+ws_deque_t* ws_deque_create(size_t capacity) {
+    ws_deque_t* deque = aligned_alloc(CACHE_LINE, sizeof(ws_deque_t));
+    assert(deque);
+
+    long size = WS_MIN_CAPACITY;
+    while (size < (long) capacity)
+        size <<= 1;
+
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, ws_array_create(size));
+    return deque;
+}
+
+/* Free the deque and all its arrays. No thread may be using it. */
+void ws_deque_free(ws_deque_t* deque) {
+    if (!deque)
+        return;
+    ws_array_t* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    while (array) {
+        ws_array_t* prev = array->prev;
+        free(array);
+        array = prev;
+    }
+    free(deque);
+}
+
+/* Return the number of items. The value is only a hint while thieves are running. */
+size_t ws_deque_len(ws_deque_t* deque) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    return (bottom > top) ? (size_t) (bottom - top) : 0;
+}
+
+/* Owner only. Copy the items in [top, bottom) to an array twice as big and publish it. */
+static ws_array_t* ws_deque_grow(ws_deque_t* deque, ws_array_t* array, long top, long bottom) {
+    ws_array_t* bigger = ws_array_create(2 * array->size);
+    for (long i = top; i < bottom; i++) {
+        int item = atomic_load_explicit(&array->items[i & (array->size - 1)], memory_order_relaxed);
+        atomic_store_explicit(&bigger->items[i & (bigger->size - 1)], item, memory_order_relaxed);
+    }
+    bigger->prev = array;
+    atomic_store_explicit(&deque->array, bigger, memory_order_release);
+    return bigger;
+}
+
+/* Owner only. Insert an item at the bottom. */
+void ws_deque_push(ws_deque_t* deque, int item) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    ws_array_t* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    if (bottom - top > array->size - 1)
+        array = ws_deque_grow(deque, array, top, bottom);
+
+    atomic_store_explicit(&array->items[bottom & (array->size - 1)], item, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+}
+
+/* Owner only. Remove the most recently pushed item and store it in the
+output parameter. Return false if the deque is empty. */
+bool ws_deque_pop(ws_deque_t* deque, int* item) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    ws_array_t* array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {  // Empty
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return false;
+    }
+
+    *item = atomic_load_explicit(&array->items[bottom & (array->size - 1)], memory_order_relaxed);
+    if (top == bottom) {  // Last item: race with the thieves for it
+        bool won = atomic_compare_exchange_strong_explicit(
+            &deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+/* Any thread. Remove the oldest item and store it in the output parameter. Return
+WS_EMPTY if there is nothing to steal and WS_ABORT if another thread took the item
+first; in the latter case the caller may retry. */
+STEAL_RESULT ws_deque_steal(ws_deque_t* deque, int* item) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom)
+        return WS_EMPTY;
+
+    ws_array_t* array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    int stolen = atomic_load_explicit(&array->items[top & (array->size - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(
+            &deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+        return WS_ABORT;
+
+    *item = stolen;
+    return WS_STOLEN;
+}
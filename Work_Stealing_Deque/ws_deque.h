@@ -0,0 +1,40 @@
+#ifndef WS_DEQUE_H
+#define WS_DEQUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define WS_MIN_CAPACITY 32
+#define CACHE_LINE 64
+
+typedef enum {
+    WS_STOLEN, WS_EMPTY, WS_ABORT
+} STEAL_RESULT;
+
+/* Circular array of the deque. Arrays replaced by a bigger one are kept in
+the `prev` list until the deque is freed, because a thief may still read them. */
+typedef struct ws_array {
+    long size;  // Power of two
+    struct ws_array* prev;
+    _Atomic int items[];
+} ws_array_t;
+
+/* Chase-Lev work-stealing deque. The owner thread pushes and pops at the bottom
+like a stack, the other threads steal from the top. `top` only grows. */
+typedef struct ws_deque {
+    _Alignas(CACHE_LINE) _Atomic long top;
+    _Alignas(CACHE_LINE) _Atomic long bottom;
+    _Atomic(ws_array_t*) array;
+} ws_deque_t;
+
+static ws_array_t* ws_array_create(long size);
+ws_deque_t* ws_deque_create(size_t capacity);
+void ws_deque_free(ws_deque_t* deque);
+size_t ws_deque_len(ws_deque_t* deque);
+static ws_array_t* ws_deque_grow(ws_deque_t* deque, ws_array_t* array, long top, long bottom);
+void ws_deque_push(ws_deque_t* deque, int item);
+bool ws_deque_pop(ws_deque_t* deque, int* item);
+STEAL_RESULT ws_deque_steal(ws_deque_t* deque, int* item);
+
+#endif
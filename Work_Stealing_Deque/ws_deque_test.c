@@ -0,0 +1,129 @@
+/*
+* The stress test is meant to be run under ThreadSanitizer as well, e.g.
+*     gcc -O1 -g -fsanitize=thread -pthread ws_deque.c ws_deque_test.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "ws_deque.h"
+
+#define THIEVES 3
+#define ITEMS 1000000
+#define BURST 100
+
+typedef struct {
+    ws_deque_t* deque;
+    _Atomic unsigned char* seen;  // How many times each item was taken
+    _Atomic bool* done;
+    size_t taken;
+} worker_t;
+
+void test_function(char* func) {
+    unsigned int pad;
+    char str[80] = {'\0'};
+    sprintf(str, "Test `%s`.", func);
+    pad = 40 - strlen(str)/2;
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    printf("\n%*s%s\n", pad, "", str);
+    for (int i = 0; i < 80; i++) printf("%s", "=");
+    puts("");
+}
+
+/* The owner pushes the items in bursts and pops half of each burst. */
+void* owner(void* arg) {
+    worker_t* w = arg;
+    int item;
+    for (int i = 0; i < ITEMS; i += BURST) {
+        for (int j = i; j < i + BURST && j < ITEMS; j++)
+            ws_deque_push(w->deque, j);
+        for (int j = 0; j < BURST / 2; j++) {
+            if (ws_deque_pop(w->deque, &item)) {
+                atomic_fetch_add(&w->seen[item], 1);
+                w->taken++;
+            }
+        }
+    }
+    while (ws_deque_pop(w->deque, &item)) {
+        atomic_fetch_add(&w->seen[item], 1);
+        w->taken++;
+    }
+    atomic_store(w->done, true);
+    return NULL;
+}
+
+/* A thief steals until the owner is done and the deque is empty. */
+void* thief(void* arg) {
+    worker_t* w = arg;
+    int item;
+    for (;;) {
+        STEAL_RESULT result = ws_deque_steal(w->deque, &item);
+        if (result == WS_STOLEN) {
+            atomic_fetch_add(&w->seen[item], 1);
+            w->taken++;
+        } else if (result == WS_EMPTY) {
+            if (atomic_load(w->done) && ws_deque_len(w->deque) == 0)
+                break;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int main() {
+    int item;
+
+    test_function("Owner push and pop");
+    ws_deque_t* deque = ws_deque_create(4);
+    for (int i = 0; i < 100; i++)  // Grows the array twice
+        ws_deque_push(deque, i);
+    printf("Items after 100 pushes: %zu\n", ws_deque_len(deque));
+    printf("%s", "Pop 5 items (LIFO): ");
+    for (int i = 0; i < 5; i++) {
+        ws_deque_pop(deque, &item);
+        printf("%d ", item);
+    }
+    printf("%s", "\nSteal 5 items (FIFO): ");
+    for (int i = 0; i < 5; i++) {
+        ws_deque_steal(deque, &item);
+        printf("%d ", item);
+    }
+    puts("");
+    while (ws_deque_pop(deque, &item))
+        ;
+    printf("Steal from an empty deque: %s\n\n",
+           ws_deque_steal(deque, &item) == WS_EMPTY ? "WS_EMPTY" : "item");
+    ws_deque_free(deque);
+
+    test_function("Concurrent steal");
+    pthread_t threads[THIEVES + 1];
+    worker_t workers[THIEVES + 1];
+    _Atomic unsigned char* seen = calloc(ITEMS, sizeof(_Atomic unsigned char));
+    _Atomic bool done = false;
+    deque = ws_deque_create(0);
+
+    for (int i = 0; i <= THIEVES; i++) {
+        workers[i] = (worker_t) {deque, seen, &done, 0};
+        pthread_create(&threads[i], NULL, (i == 0) ? owner : thief, &workers[i]);
+    }
+    size_t total = 0;
+    for (int i = 0; i <= THIEVES; i++) {
+        pthread_join(threads[i], NULL);
+        printf("%s %d took %zu items\n", (i == 0) ? "Owner" : "Thief", i, workers[i].taken);
+        total += workers[i].taken;
+    }
+
+    bool exactly_once = (total == ITEMS);
+    for (int i = 0; i < ITEMS; i++)
+        if (seen[i] != 1)
+            exactly_once = false;
+    printf("Every item was taken exactly once: %s\n", exactly_once ? "true" : "false");
+
+    free(seen);
+    ws_deque_free(deque);
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include "Node_Pool/node_pool.h"
 
 typedef struct node {
     char ch;
@@ -23,4 +24,23 @@ char pop(node_t** head) {
     free(*head);
     *head = tmp;
     return popped;
-}
\ No newline at end of file
+}
+
+/* Same as `push`, but the node is taken from the pool instead of `malloc`. */
+void push_pooled(pool_t* pool, node_t** head, char ch) {
+    node_t* new_node = pool_alloc(pool);
+    new_node->ch = ch;
+    new_node->prev = *head;
+    *head = new_node;
+}
+
+/* Same as `pop`, but the node is given back to the pool instead of `free`. */
+char pop_pooled(pool_t* pool, node_t** head) {
+    if (!(*head))
+        return '\0';
+    char popped = (*head)->ch;
+    node_t* tmp = (*head)->prev;
+    pool_release(pool, *head);
+    *head = tmp;
+    return popped;
+}